@@ -76,6 +76,9 @@ void annot_t::wipe()
       ++ii;
     }    
   all_instances.clear();
+
+  // instances have released their rows, so can reset the store
+  meta.clear();
 }
 
 instance_t * annot_t::add( const std::string & id , const interval_t & interval , const std::string & ch )
@@ -106,7 +109,7 @@ instance_t * annot_t::add( const std::string & id , const interval_t & interval
     return interval_events[ idx ];
 
   // else create a new instance
-  instance_t * instance = new instance_t ;  
+  instance_t * instance = new instance_t( &meta );
 
   interval_events[ instance_idx_t( this , interval , id2 , ch ) ] = instance;
   
@@ -150,32 +153,112 @@ void annot_t::rebuild_tree()
 }
 
 
+//
+// instance_data_t
+//
+
+instance_data_t::~instance_data_t()
+{
+  map_t::iterator ii = cache.begin();
+  while ( ii != cache.end() )
+    {
+      delete ii->second;
+      ++ii;
+    }
+  if ( store != NULL )
+    {
+      if ( own ) delete store;
+      else if ( row >= 0 ) store->drop_row( row );
+    }
+}
+
+meta_store_t * instance_data_t::writable()
+{
+  if ( store == NULL ) store = new meta_store_t;
+  if ( row < 0 ) row = store->add_row();
+  return store;
+}
+
+instance_data_t::const_iterator instance_data_t::find( const std::string & key ) const
+{
+  if ( row < 0 ) return cache.end();
+  map_t::iterator ii = cache.find( key );
+  if ( ii != cache.end() ) return ii;
+  const int c = store->find_column( key );
+  if ( c == -1 || ! store->has( c , row ) ) return cache.end();
+  return cache.insert( map_t::value_type( key , store->make_avar( c , row ) ) ).first;
+}
+
+void instance_data_t::materialize() const
+{
+  if ( complete ) return;
+  complete = true;
+  if ( row < 0 ) return;
+  const std::map<std::string,int> & cols = store->columns();
+  std::map<std::string,int>::const_iterator cc = cols.begin();
+  map_t::iterator hint = cache.begin();
+  while ( cc != cols.end() )
+    {
+      if ( store->has( cc->second , row ) )
+	{
+	  hint = cache.lower_bound( cc->first );
+	  if ( hint == cache.end() || hint->first != cc->first )
+	    cache.insert( hint , map_t::value_type( cc->first , store->make_avar( cc->second , row ) ) );
+	}
+      ++cc;
+    }
+}
+
+void instance_data_t::invalidate( const std::string & key )
+{
+  map_t::iterator ii = cache.find( key );
+  if ( ii != cache.end() )
+    {
+      delete ii->second;
+      cache.erase( ii );
+    }
+  complete = false;
+}
+
+
+//
+// instance_t
+//
+
 std::string instance_t::print( const std::string & delim , const std::string & prelim ) const
 {
   std::stringstream ss;
 
-  std::map<std::string,avar_t*>::const_iterator dd = data.begin();
-  while ( dd != data.end() )
+  const meta_store_t * m = meta();
+  if ( m == NULL ) return "";
+
+  const int r = row();
+  bool first = true;
+
+  std::map<std::string,int>::const_iterator cc = m->columns().begin();
+  while ( cc != m->columns().end() )
     {
-      
-      if ( dd != data.begin() ) ss << delim;
+      const int c = cc->second;
+      const globals::atype_t t = m->type( c , r );
+
+      if ( t == globals::A_NULL_T ) { ++cc; continue; }
+
+      if ( ! first ) ss << delim;
+      first = false;
 
       ss << prelim;
       
-      if ( dd->second == NULL )
-	ss << dd->first;
-      else if ( dd->second->atype() == globals::A_BOOLVEC_T )
-	ss << dd->first << "=" << Helper::stringize( dd->second->text_vector() , "," ) ;
-      else if ( dd->second->atype() == globals::A_INTVEC_T )
-	ss << dd->first << "=" << Helper::stringize( dd->second->int_vector() , "," ) ;
-      else if ( dd->second->atype() == globals::A_DBLVEC_T )
-	ss << dd->first << "=" << Helper::stringize( dd->second->double_vector() , "," ) ;
-      else if ( dd->second->atype() == globals::A_TXTVEC_T )
-	ss << dd->first << "=" << Helper::stringize( dd->second->text_vector() , "," ) ;
-
+      if ( t == globals::A_BOOLVEC_T )
+	ss << cc->first << "=" << Helper::stringize( m->text_vector( c , r ) , "," ) ;
+      else if ( t == globals::A_INTVEC_T )
+	ss << cc->first << "=" << Helper::stringize( m->int_vector( c , r ) , "," ) ;
+      else if ( t == globals::A_DBLVEC_T )
+	ss << cc->first << "=" << Helper::stringize( m->double_vector( c , r ) , "," ) ;
+      else if ( t == globals::A_TXTVEC_T )
+	ss << cc->first << "=" << Helper::stringize( m->text_vector( c , r ) , "," ) ;
       else
- 	ss << dd->first << "=" << dd->second->text_value();
-      ++dd;
+ 	ss << cc->first << "=" << m->text_value( c , r );
+      ++cc;
 
     }
 
@@ -184,129 +267,118 @@ std::string instance_t::print( const std::string & delim , const std::string & p
 
 globals::atype_t instance_t::type( const std::string & s ) const 
 {
-  std::map<std::string,avar_t*>::const_iterator ii = data.find( s );
-  if ( ii == data.end() ) return globals::A_NULL_T;  
-  return ii->second->atype();
+  const meta_store_t * m = meta();
+  if ( m == NULL ) return globals::A_NULL_T;
+  const int c = m->find_column( s );
+  if ( c == -1 ) return globals::A_NULL_T;
+  return m->type( c , row() );
 }
 
 void instance_t::check( const std::string & name )
 {
-
-  std::map<std::string,avar_t*>::iterator dd = data.find( name );
-
-  if ( dd == data.end() ) return;
-
-  if ( dd->second == NULL ) return;  // flag, so no storage set
-  
-  // erase actual storage...
-  delete dd->second; 
-
-  // erase place in the tracker
-  std::set<avar_t*>::iterator ff = tracker.find( dd->second );
-  if ( ff != tracker.end() )
-    tracker.erase( tracker.find( dd->second ) ); 
-  else 
-    Helper::halt( "internal error in instance_t::check()... avar_t not tracked" );
-  
-  // and erase from this data map instance
-  data.erase( dd );  
-  
-  return;
+  if ( data.row < 0 ) return;
+  data.invalidate( name );
+  const int c = data.store->find_column( name );
+  if ( c != -1 ) data.store->unset( c , data.row );
 }
 
 void instance_t::set( const std::string & name ) 
 {
-  check( name );
-  avar_t * a = new flag_avar_t ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set_flag( m->column( name ) , data.row );
 }
 
 void instance_t::set( const std::string & name , const int i ) 
 {
-  check( name );
-  avar_t * a = new int_avar_t( i ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , i );
 }
 
 void instance_t::set( const std::string & name , const std::string & s ) 
 {
-  check( name );
-  avar_t * a = new text_avar_t( s ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , s );
 }
 
 void instance_t::set( const std::string & name , const bool b )
 {
-  check( name );
-  avar_t * a = new bool_avar_t( b ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , b );
 }
 
 void instance_t::set_mask( const std::string & name , const bool b )
 {
-  check( name );
-  avar_t * a = new mask_avar_t( b ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set_mask( m->column( name ) , data.row , b );
 }
 
 void instance_t::set( const std::string & name , const double d )
 {
-  check( name );
-  avar_t * a = new double_avar_t( d ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , d );
 }
 
 
 // vectors
 void instance_t::set( const std::string & name , const std::vector<int> &  i ) 
 {
-  check( name );
-  avar_t * a = new intvec_avar_t( i ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , i );
 }
 
 void instance_t::set( const std::string & name , const std::vector<std::string> & s ) 
 {
-  check( name );
-  avar_t * a = new textvec_avar_t( s ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , s );
 }
 
 void instance_t::set( const std::string & name , const std::vector<bool> & b )
 {
-  check( name );
-  avar_t * a = new boolvec_avar_t( b ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , b );
 }
 
 void instance_t::set( const std::string & name , const std::vector<double> & d )
 {
-  check( name );
-  avar_t * a = new doublevec_avar_t( d ) ;
-  tracker.insert( a );
-  data[ name ] = a;    
+  data.invalidate( name );
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , d );
 }
 
+void instance_t::set( const std::string & name , const avar_t & a )
+{
+  // a may be this instance's cached value, so copy before invalidating
+  meta_store_t * m = data.writable();
+  m->set( m->column( name ) , data.row , a );
+  data.invalidate( name );
+}
 
-
-instance_t::~instance_t()
+void instance_t::copy( const instance_t & rhs )
 {
-  std::set<avar_t *>::iterator ii = tracker.begin();
-  while ( ii != tracker.end() )
-    {	 
-      delete *ii;
-      ++ii;
+  const meta_store_t * m = rhs.meta();
+  if ( m == NULL ) return;
+  std::map<std::string,int>::const_iterator cc = m->columns().begin();
+  while ( cc != m->columns().end() )
+    {
+      avar_t * a = m->make_avar( cc->second , rhs.row() );
+      if ( a != NULL )
+	{
+	  set( cc->first , *a );
+	  delete a;
+	}
+      ++cc;
     }
-}  
+}
+
 
 std::ostream & operator<<( std::ostream & out , const avar_t & a )
 {
@@ -5203,25 +5275,29 @@ void annotation_set_t::write( const std::string & filename1 , param_t & param ,
 							      globals::annot_meta_delim2 ,
 							      '=' ) );
 	      
-	      // generic meta-data
+	      // generic meta-data (read directly from the class store)
+
+	      const meta_store_t * meta = inst->meta();
+	      const int row = inst->row();
+	      bool first = true;
 	      
-	      std::map<std::string,avar_t*>::const_iterator dd = inst->data.begin();
+	      std::map<std::string,int>::const_iterator dd = meta->columns().begin();
 	      
-	      while ( dd != inst->data.end() )
+	      while ( dd != meta->columns().end() )
 		{
+		  if ( ! meta->has( dd->second , row ) ) { ++dd; continue; }
+
 		  // semi-colon or pipe-delimiter
-		  if ( dd != inst->data.begin() || set_id ) O1 << globals::annot_meta_delim;
+		  if ( ! first || set_id ) O1 << globals::annot_meta_delim;
+		  first = false;
 		  
 		  // meta-data value, always key/value pairing
 		  // as there may be missing data
 		  // if the meta-data is string and contains a pipe, then
 		  // we need to quote this
 		  
-		  std::stringstream ss;
-		  ss << *dd->second;
-		  
 		  O1 << dd->first << "="
-		     << Helper::quote_spaced( Helper::quote_if( ss.str() ,
+		     << Helper::quote_spaced( Helper::quote_if( meta->text_value( dd->second , row ) ,
 								globals::annot_meta_delim,
 								globals::annot_meta_delim2 ,
 								'=' ) );
@@ -5241,13 +5317,12 @@ void annotation_set_t::write( const std::string & filename1 , param_t & param ,
 	      while ( mm != mhdr.end() )
 		{
 		  
-		  std::map<std::string,avar_t*>::const_iterator dd = inst->data.find( *mm );
-		  if ( dd != inst->data.end() )
+		  const meta_store_t * meta = inst->meta();
+		  const int c = meta == NULL ? -1 : meta->find_column( *mm );
+		  if ( c != -1 && meta->has( c , inst->row() ) )
 		    {
-		      std::stringstream ss;
-		      ss << *dd->second;
 		      O1 << "\t"
-			 << ss.str();
+			 << meta->text_value( c , inst->row() );
 		    }
 		  else if ( set_id && *mm == set_id_key )
 		    {
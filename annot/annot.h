@@ -45,6 +45,7 @@
 #include "intervals/intervals.h"
 #include "miscmath/miscmath.h"
 #include "helper/helper.h"
+#include "annot/metastore.h"
 
 
 // annotation_set_t  is the top-level set of annotations
@@ -241,8 +242,8 @@ private:
     
     const int lc = nodes_[u].l, rc = nodes_[u].r;
     
-    // Left can overlap only if some stop > qs
-    if (lc >= 0 && nodes_[lc].maxStop > qs)
+    // Left can overlap only if some stop > qs (or a point [p,p) at p == qs)
+    if (lc >= 0 && nodes_[lc].maxStop >= qs)
       query_rec(lc, qs, qe, out);
     
     // Current node
@@ -299,6 +300,9 @@ struct annot_t
   // for clean-up
   std::set<instance_t*> all_instances;
 
+  // meta-data for all instances (one row per instance)
+  meta_store_t meta;
+
   // parent
   annotation_set_t * parent;
   
@@ -441,16 +445,71 @@ public:
 
 
 
+//
+// instance_t::data : the instance's row of the class meta_store_t,
+// presented as the former std::map<std::string,avar_t*>; avar_t
+// values are only built (and cached) when a key is looked up or the
+// map is iterated, and are owned here
+//
+
+struct instance_data_t {
+
+  typedef instance_table_t map_t;
+  typedef map_t::const_iterator const_iterator;
+
+  // store NULL: standalone instance, own store made on first write
+  explicit instance_data_t( meta_store_t * store )
+    : store(store) , row(-1) , own( store == NULL ) , complete(true) { }
+
+  ~instance_data_t();
+
+  const_iterator begin() const { materialize(); return cache.begin(); }
+  const_iterator end() const { return cache.end(); }
+  const_iterator find( const std::string & key ) const;
+
+  size_t size() const { return row < 0 ? 0 : store->count( row ); }
+  bool empty() const { return size() == 0; }
+
+  operator const map_t & () const { materialize(); return cache; }
+
+  // drop any cached value for key (i.e. after it is changed)
+  void invalidate( const std::string & key );
+
+  // store and row, making them if needed
+  meta_store_t * writable();
+
+  meta_store_t * store;
+  int row;
+  bool own;
+
+ private:
+
+  void materialize() const;
+
+  mutable map_t cache;
+  mutable bool complete;
+
+  instance_data_t( const instance_data_t & );
+  instance_data_t & operator=( const instance_data_t & );
+
+};
+
+
 struct instance_t {   
-  
+
+  // standalone instance (e.g. for expression evaluation)
+  instance_t() : data( NULL ) { }
+
+  // an instance of an annot_t: meta-data go in the class store
+  explicit instance_t( meta_store_t * store ) : data( store ) { }
+
   // an instance then has 0 or more variable/value pairs
   
-  std::map<std::string,avar_t*> data;
-  
-  // for clean-up
-  
-  std::set<avar_t*> tracker;
+  instance_data_t data;
 
+  // columnar access: the store (or NULL if no meta-data) and this row
+  const meta_store_t * meta() const { return data.row < 0 ? NULL : data.store; }
+  int row() const { return data.row; }
 
   //
   // In/out functions
@@ -464,7 +523,7 @@ struct instance_t {
   
   avar_t * find( const std::string & name ) const
   { 
-    std::map<std::string,avar_t*>::const_iterator aa = data.find( name );
+    instance_data_t::const_iterator aa = data.find( name );
     if ( aa == data.end() ) return NULL;
     return aa->second;
   } 
@@ -476,12 +535,13 @@ struct instance_t {
     n = NULL;
     d = NULL;
     if ( data.size() != 1 ) return false;
-    std::map<std::string,avar_t*>::const_iterator aa = data.begin();
+    instance_data_t::const_iterator aa = data.begin();
     n = &(aa->first);
     d = aa->second;
     return true;
   }
 
+  // remove any existing value
   void check( const std::string & name );
   
   // add flag 
@@ -514,6 +574,12 @@ struct instance_t {
   // add double vec
   void set( const std::string & name , const std::vector<double> & d );
 
+  // add a copy of any value
+  void set( const std::string & name , const avar_t & a );
+
+  // copy all meta-data from another instance
+  void copy( const instance_t & rhs );
+
   // convenience function to add FTR metadate (i.e. str->str key/value pairs)
   void add( const std::map<std::string,std::string> & d )
   {
@@ -527,15 +593,10 @@ struct instance_t {
 
   std::string print( const std::string & delim = ";" , const std::string & prelim = "" ) const;
   
-  //
-  // Misc helper functions
-  //
-  
-  // the instance controls adding data-points, so it is also responsible for clean-up
-
-  ~instance_t();
-
+ private:
 
+  instance_t( const instance_t & );
+  instance_t & operator=( const instance_t & );
 
 };
 
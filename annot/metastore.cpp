@@ -0,0 +1,440 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "annot/metastore.h"
+#include "annot/annot.h"
+#include "helper/helper.h"
+
+
+void meta_store_t::clear()
+{
+  keys.clear();
+  key2col.clear();
+  cols.clear();
+  strings.clear();
+  str2idx.clear();
+  bvecs.clear();
+  ivecs.clear();
+  dvecs.clear();
+  svecs.clear();
+  for (int i=0; i<4; i++) free_slots[i].clear();
+  nrows = 0;
+  free_rows.clear();
+}
+
+
+//
+// rows
+//
+
+int meta_store_t::add_row()
+{
+  if ( free_rows.size() != 0 )
+    {
+      const int r = free_rows.back();
+      free_rows.pop_back();
+      return r;
+    }
+  return nrows++;
+}
+
+void meta_store_t::drop_row( const int r )
+{
+  for (int c=0; c<cols.size(); c++)
+    unset( c , r );
+  free_rows.push_back( r );
+}
+
+
+//
+// columns
+//
+
+int meta_store_t::column( const std::string & key )
+{
+  std::map<std::string,int>::const_iterator kk = key2col.find( key );
+  if ( kk != key2col.end() ) return kk->second;
+  const int c = keys.size();
+  keys.push_back( key );
+  key2col[ key ] = c;
+  cols.resize( c + 1 );
+  return c;
+}
+
+int meta_store_t::find_column( const std::string & key ) const
+{
+  std::map<std::string,int>::const_iterator kk = key2col.find( key );
+  return kk == key2col.end() ? -1 : kk->second;
+}
+
+
+//
+// cells
+//
+
+int meta_store_t::count( const int r ) const
+{
+  int n = 0;
+  for (int c=0; c<cols.size(); c++)
+    if ( has( c , r ) ) ++n;
+  return n;
+}
+
+meta_store_t::cell_t & meta_store_t::cell( const int c , const int r , const globals::atype_t t )
+{
+  column_t & col = cols[c];
+  if ( r >= col.t.size() )
+    {
+      col.t.resize( r + 1 , (signed char)globals::A_NULL_T );
+      col.v.resize( r + 1 );
+    }
+  else
+    release( c , r );
+  col.t[r] = t;
+  return col.v[r];
+}
+
+void meta_store_t::release( const int c , const int r )
+{
+  const globals::atype_t t = type( c , r );
+  if ( t < globals::A_BOOLVEC_T ) return;
+  const uint32_t s = cols[c].v[r].s;
+  if      ( t == globals::A_BOOLVEC_T ) std::vector<bool>().swap( bvecs[s] );
+  else if ( t == globals::A_INTVEC_T ) std::vector<int>().swap( ivecs[s] );
+  else if ( t == globals::A_DBLVEC_T ) std::vector<double>().swap( dvecs[s] );
+  else std::vector<std::string>().swap( svecs[s] );
+  free_slots[ t - globals::A_BOOLVEC_T ].push_back( s );
+}
+
+uint32_t meta_store_t::slot( const globals::atype_t t )
+{
+  std::vector<uint32_t> & f = free_slots[ t - globals::A_BOOLVEC_T ];
+  if ( f.size() != 0 )
+    {
+      const uint32_t s = f.back();
+      f.pop_back();
+      return s;
+    }
+  if ( t == globals::A_BOOLVEC_T ) { bvecs.resize( bvecs.size() + 1 ); return bvecs.size() - 1; }
+  if ( t == globals::A_INTVEC_T ) { ivecs.resize( ivecs.size() + 1 ); return ivecs.size() - 1; }
+  if ( t == globals::A_DBLVEC_T ) { dvecs.resize( dvecs.size() + 1 ); return dvecs.size() - 1; }
+  svecs.resize( svecs.size() + 1 );
+  return svecs.size() - 1;
+}
+
+void meta_store_t::set_flag( const int c , const int r )
+{
+  cell( c , r , globals::A_FLAG_T ).i = 0;
+}
+
+void meta_store_t::set_mask( const int c , const int r , const bool b )
+{
+  cell( c , r , globals::A_MASK_T ).i = b;
+}
+
+void meta_store_t::set( const int c , const int r , const bool b )
+{
+  cell( c , r , globals::A_BOOL_T ).i = b;
+}
+
+void meta_store_t::set( const int c , const int r , const int i )
+{
+  cell( c , r , globals::A_INT_T ).i = i;
+}
+
+void meta_store_t::set( const int c , const int r , const double d )
+{
+  cell( c , r , globals::A_DBL_T ).d = d;
+}
+
+void meta_store_t::set( const int c , const int r , const std::string & s )
+{
+  const uint32_t i = intern( s );
+  cell( c , r , globals::A_TXT_T ).s = i;
+}
+
+void meta_store_t::set( const int c , const int r , const std::vector<bool> & b )
+{
+  cell( c , r , globals::A_BOOLVEC_T ).s = slot( globals::A_BOOLVEC_T );
+  bvecs[ cols[c].v[r].s ] = b;
+}
+
+void meta_store_t::set( const int c , const int r , const std::vector<int> & i )
+{
+  cell( c , r , globals::A_INTVEC_T ).s = slot( globals::A_INTVEC_T );
+  ivecs[ cols[c].v[r].s ] = i;
+}
+
+void meta_store_t::set( const int c , const int r , const std::vector<double> & d )
+{
+  cell( c , r , globals::A_DBLVEC_T ).s = slot( globals::A_DBLVEC_T );
+  dvecs[ cols[c].v[r].s ] = d;
+}
+
+void meta_store_t::set( const int c , const int r , const std::vector<std::string> & s )
+{
+  cell( c , r , globals::A_TXTVEC_T ).s = slot( globals::A_TXTVEC_T );
+  svecs[ cols[c].v[r].s ] = s;
+}
+
+void meta_store_t::set( const int c , const int r , const avar_t & a )
+{
+  switch ( a.atype() )
+    {
+    case globals::A_FLAG_T    : set_flag( c , r ); break;
+    case globals::A_MASK_T    : set_mask( c , r , a.bool_value() ); break;
+    case globals::A_BOOL_T    : set( c , r , a.bool_value() ); break;
+    case globals::A_INT_T     : set( c , r , a.int_value() ); break;
+    case globals::A_DBL_T     : set( c , r , a.double_value() ); break;
+    case globals::A_TXT_T     : set( c , r , a.text_value() ); break;
+    case globals::A_BOOLVEC_T : set( c , r , a.bool_vector() ); break;
+    case globals::A_INTVEC_T  : set( c , r , a.int_vector() ); break;
+    case globals::A_DBLVEC_T  : set( c , r , a.double_vector() ); break;
+    case globals::A_TXTVEC_T  : set( c , r , a.text_vector() ); break;
+    default : unset( c , r );
+    }
+}
+
+void meta_store_t::unset( const int c , const int r )
+{
+  if ( ! has( c , r ) ) return;
+  release( c , r );
+  cols[c].t[r] = globals::A_NULL_T;
+}
+
+
+//
+// values: these follow the corresponding avar_t types exactly
+//
+
+bool meta_store_t::bool_value( const int c , const int r ) const
+{
+  const cell_t & v = cols[c].v[r];
+  switch ( type( c , r ) )
+    {
+    case globals::A_FLAG_T : return true;
+    case globals::A_MASK_T :
+    case globals::A_BOOL_T :
+    case globals::A_INT_T  : return v.i != 0;
+    case globals::A_DBL_T  : return v.d != 0;
+    case globals::A_TXT_T  : return strings[ v.s ] != "0" && strings[ v.s ] != "false";
+    case globals::A_NULL_T : return false;
+    default : return size( c , r ) > 0;
+    }
+}
+
+int meta_store_t::int_value( const int c , const int r ) const
+{
+  const cell_t & v = cols[c].v[r];
+  switch ( type( c , r ) )
+    {
+    case globals::A_FLAG_T : return 1;
+    case globals::A_MASK_T :
+    case globals::A_BOOL_T :
+    case globals::A_INT_T  : return v.i;
+    case globals::A_DBL_T  : return v.d;
+    case globals::A_TXT_T  :
+      {
+	int i = 0;
+	if ( ! Helper::str2int( strings[ v.s ] , &i ) ) return 0;
+	return i;
+      }
+    case globals::A_NULL_T : return 0;
+    default : return size( c , r );
+    }
+}
+
+double meta_store_t::double_value( const int c , const int r ) const
+{
+  const cell_t & v = cols[c].v[r];
+  switch ( type( c , r ) )
+    {
+    case globals::A_FLAG_T : return 1;
+    case globals::A_MASK_T :
+    case globals::A_BOOL_T :
+    case globals::A_INT_T  : return v.i;
+    case globals::A_DBL_T  : return v.d;
+    case globals::A_TXT_T  :
+      {
+	double d = 0;
+	if ( ! Helper::str2dbl( strings[ v.s ] , &d ) ) return 0;
+	return d;
+      }
+    case globals::A_NULL_T : return 0;
+    default : return size( c , r );
+    }
+}
+
+std::string meta_store_t::text_value( const int c , const int r ) const
+{
+  const cell_t & v = cols[c].v[r];
+  switch ( type( c , r ) )
+    {
+    case globals::A_MASK_T :
+    case globals::A_BOOL_T : return v.i ? "true" : "false";
+    case globals::A_INT_T  : return Helper::int2str( v.i );
+    case globals::A_DBL_T  : return Helper::dbl2str( v.d );
+    case globals::A_TXT_T  : return strings[ v.s ];
+    case globals::A_FLAG_T :
+    case globals::A_NULL_T : return ".";
+    default : return Helper::int2str( size( c , r ) );
+    }
+}
+
+std::vector<bool> meta_store_t::bool_vector( const int c , const int r ) const
+{
+  const globals::atype_t t = type( c , r );
+  if ( t == globals::A_NULL_T || t == globals::A_FLAG_T ) return std::vector<bool>(0);
+  const uint32_t s = cols[c].v[r].s;
+  if ( t == globals::A_BOOLVEC_T ) return bvecs[s];
+  if ( t == globals::A_INTVEC_T ) return annot_t::as_bool_vec( ivecs[s] );
+  if ( t == globals::A_DBLVEC_T ) return annot_t::as_bool_vec( dvecs[s] );
+  if ( t == globals::A_TXTVEC_T ) return annot_t::as_bool_vec( svecs[s] );
+  return std::vector<bool>( 1 , bool_value( c , r ) );
+}
+
+std::vector<int> meta_store_t::int_vector( const int c , const int r ) const
+{
+  const globals::atype_t t = type( c , r );
+  if ( t == globals::A_NULL_T || t == globals::A_FLAG_T ) return std::vector<int>(0);
+  const uint32_t s = cols[c].v[r].s;
+  if ( t == globals::A_BOOLVEC_T ) return annot_t::as_int_vec( bvecs[s] );
+  if ( t == globals::A_INTVEC_T ) return ivecs[s];
+  if ( t == globals::A_DBLVEC_T ) return annot_t::as_int_vec( dvecs[s] );
+  if ( t == globals::A_TXTVEC_T ) return annot_t::as_int_vec( svecs[s] );
+  return std::vector<int>( 1 , int_value( c , r ) );
+}
+
+std::vector<double> meta_store_t::double_vector( const int c , const int r ) const
+{
+  const globals::atype_t t = type( c , r );
+  if ( t == globals::A_NULL_T || t == globals::A_FLAG_T ) return std::vector<double>(0);
+  const uint32_t s = cols[c].v[r].s;
+  if ( t == globals::A_BOOLVEC_T ) return annot_t::as_dbl_vec( bvecs[s] );
+  if ( t == globals::A_INTVEC_T ) return annot_t::as_dbl_vec( ivecs[s] );
+  if ( t == globals::A_DBLVEC_T ) return dvecs[s];
+  if ( t == globals::A_TXTVEC_T ) return annot_t::as_dbl_vec( svecs[s] );
+  return std::vector<double>( 1 , double_value( c , r ) );
+}
+
+std::vector<std::string> meta_store_t::text_vector( const int c , const int r ) const
+{
+  const globals::atype_t t = type( c , r );
+  if ( t == globals::A_NULL_T || t == globals::A_FLAG_T ) return std::vector<std::string>(0);
+  const uint32_t s = cols[c].v[r].s;
+  if ( t == globals::A_BOOLVEC_T ) return annot_t::as_txt_vec( bvecs[s] );
+  if ( t == globals::A_INTVEC_T ) return annot_t::as_txt_vec( ivecs[s] );
+  if ( t == globals::A_DBLVEC_T ) return annot_t::as_txt_vec( dvecs[s] );
+  if ( t == globals::A_TXTVEC_T ) return svecs[s];
+  return std::vector<std::string>( 1 , text_value( c , r ) );
+}
+
+bool meta_store_t::is_vector( const int c , const int r ) const
+{
+  return type( c , r ) >= globals::A_BOOLVEC_T;
+}
+
+int meta_store_t::size( const int c , const int r ) const
+{
+  const globals::atype_t t = type( c , r );
+  if ( t == globals::A_NULL_T || t == globals::A_FLAG_T ) return 0;
+  const uint32_t s = cols[c].v[r].s;
+  if ( t == globals::A_BOOLVEC_T ) return bvecs[s].size();
+  if ( t == globals::A_INTVEC_T ) return ivecs[s].size();
+  if ( t == globals::A_DBLVEC_T ) return dvecs[s].size();
+  if ( t == globals::A_TXTVEC_T ) return svecs[s].size();
+  return 1;
+}
+
+avar_t * meta_store_t::make_avar( const int c , const int r ) const
+{
+  const cell_t & v = cols[c].v[r];
+  switch ( type( c , r ) )
+    {
+    case globals::A_FLAG_T    : return new flag_avar_t;
+    case globals::A_MASK_T    : return new mask_avar_t( v.i != 0 );
+    case globals::A_BOOL_T    : return new bool_avar_t( v.i != 0 );
+    case globals::A_INT_T     : return new int_avar_t( v.i );
+    case globals::A_DBL_T     : return new double_avar_t( v.d );
+    case globals::A_TXT_T     : return new text_avar_t( strings[ v.s ] );
+    case globals::A_BOOLVEC_T : return new boolvec_avar_t( bvecs[ v.s ] );
+    case globals::A_INTVEC_T  : return new intvec_avar_t( ivecs[ v.s ] );
+    case globals::A_DBLVEC_T  : return new doublevec_avar_t( dvecs[ v.s ] );
+    case globals::A_TXTVEC_T  : return new textvec_avar_t( svecs[ v.s ] );
+    default : return NULL;
+    }
+}
+
+
+//
+// interned strings
+//
+
+uint32_t meta_store_t::intern( const std::string & s )
+{
+  std::unordered_map<std::string,uint32_t>::const_iterator ss = str2idx.find( s );
+  if ( ss != str2idx.end() ) return ss->second;
+  const uint32_t i = strings.size();
+  strings.push_back( s );
+  str2idx[ s ] = i;
+  return i;
+}
+
+
+//
+// stats
+//
+
+size_t meta_store_t::num_values() const
+{
+  size_t n = 0;
+  for (int c=0; c<cols.size(); c++)
+    for (int r=0; r<cols[c].t.size(); r++)
+      if ( cols[c].t[r] != globals::A_NULL_T ) ++n;
+  return n;
+}
+
+size_t meta_store_t::bytes() const
+{
+  size_t b = sizeof( meta_store_t );
+
+  for (int c=0; c<cols.size(); c++)
+    b += sizeof( column_t ) + keys[c].capacity() + cols[c].t.capacity() + cols[c].v.capacity() * sizeof( cell_t );
+
+  // each string is held twice (pool + index), plus hash-node overhead
+  for (int i=0; i<strings.size(); i++)
+    b += 2 * ( sizeof( std::string ) + strings[i].capacity() ) + sizeof( uint32_t ) + 2 * sizeof( void* );
+
+  b += bvecs.capacity() * sizeof( std::vector<bool> );
+  for (int i=0; i<bvecs.size(); i++) b += bvecs[i].capacity() / 8;
+  b += ivecs.capacity() * sizeof( std::vector<int> );
+  for (int i=0; i<ivecs.size(); i++) b += ivecs[i].capacity() * sizeof( int );
+  b += dvecs.capacity() * sizeof( std::vector<double> );
+  for (int i=0; i<dvecs.size(); i++) b += dvecs[i].capacity() * sizeof( double );
+  b += svecs.capacity() * sizeof( std::vector<std::string> );
+  for (int i=0; i<svecs.size(); i++)
+    for (int j=0; j<svecs[i].size(); j++)
+      b += sizeof( std::string ) + svecs[i][j].capacity();
+
+  b += free_rows.capacity() * sizeof( int );
+
+  return b;
+}
@@ -0,0 +1,201 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_METASTORE_H__
+#define __LUNA_METASTORE_H__
+
+#include "defs/defs.h"
+
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <stdint.h>
+#include <cstddef>
+
+struct avar_t;
+
+//
+// Columnar store for the meta-data of one annotation class's instances
+//
+//  One column per meta-data key, holding a per-row type and an 8-byte
+//  cell (an int, double or bool value, or an index into the interned
+//  strings or the vector pools).  Each instance_t is one row.  This
+//  replaces a per-instance std::map of heap-allocated avar_t values:
+//  loading N events with K fields now costs K column appends rather
+//  than N*K allocations.  Values convert exactly as the avar_t types
+//  do; make_avar() builds a standalone avar_t copy for the
+//  instance_t::data adapter.
+//
+
+struct meta_store_t
+{
+
+  meta_store_t() : nrows(0) { }
+
+  void clear();
+
+  //
+  // rows (instances)
+  //
+
+  // new (or recycled) empty row
+  int add_row();
+
+  // drop all values in row r and recycle it
+  void drop_row( const int r );
+
+  //
+  // columns (keys)
+  //
+
+  // column for key, adding it if needed
+  int column( const std::string & key );
+
+  // column for key, or -1
+  int find_column( const std::string & key ) const;
+
+  const std::string & key( const int c ) const { return keys[c]; }
+
+  int num_columns() const { return keys.size(); }
+
+  // key -> column, in key order (i.e. as the former per-instance std::map)
+  const std::map<std::string,int> & columns() const { return key2col; }
+
+  //
+  // cells
+  //
+
+  // A_NULL_T if not set
+  globals::atype_t type( const int c , const int r ) const
+  {
+    const column_t & col = cols[c];
+    return r < col.t.size() ? (globals::atype_t)col.t[r] : globals::A_NULL_T ;
+  }
+
+  bool has( const int c , const int r ) const { return type( c , r ) != globals::A_NULL_T; }
+
+  // number of values set in row r
+  int count( const int r ) const;
+
+  void set_flag( const int c , const int r );
+  void set_mask( const int c , const int r , const bool b );
+  void set( const int c , const int r , const bool b );
+  void set( const int c , const int r , const int i );
+  void set( const int c , const int r , const double d );
+  void set( const int c , const int r , const std::string & s );
+  void set( const int c , const int r , const std::vector<bool> & b );
+  void set( const int c , const int r , const std::vector<int> & i );
+  void set( const int c , const int r , const std::vector<double> & d );
+  void set( const int c , const int r , const std::vector<std::string> & s );
+
+  // copy from any avar_t
+  void set( const int c , const int r , const avar_t & a );
+
+  void unset( const int c , const int r );
+
+  //
+  // values, converted as for the corresponding avar_t type
+  //
+
+  bool        bool_value( const int c , const int r ) const;
+  int         int_value( const int c , const int r ) const;
+  double      double_value( const int c , const int r ) const;
+  std::string text_value( const int c , const int r ) const;
+
+  std::vector<bool>        bool_vector( const int c , const int r ) const;
+  std::vector<int>         int_vector( const int c , const int r ) const;
+  std::vector<double>      double_vector( const int c , const int r ) const;
+  std::vector<std::string> text_vector( const int c , const int r ) const;
+
+  bool is_vector( const int c , const int r ) const;
+
+  int size( const int c , const int r ) const;
+
+  // a (heap) avar_t holding this value, or NULL if not set
+  avar_t * make_avar( const int c , const int r ) const;
+
+  //
+  // interned strings
+  //
+
+  uint32_t intern( const std::string & s );
+
+  const std::string & str( const uint32_t i ) const { return strings[i]; }
+
+  //
+  // stats
+  //
+
+  int num_rows() const { return nrows - free_rows.size(); }
+
+  size_t num_values() const;
+
+  size_t num_strings() const { return strings.size(); }
+
+  // approximate heap use
+  size_t bytes() const;
+
+ private:
+
+  union cell_t
+  {
+    double d;
+    int32_t i;
+    uint32_t s;  // string or vector-pool index
+  };
+
+  struct column_t
+  {
+    std::vector<signed char> t;
+    std::vector<cell_t> v;
+  };
+
+  // ensure column c has row r; returns the cell
+  cell_t & cell( const int c , const int r , const globals::atype_t t );
+
+  // release any vector-pool slot held by cell (c,r)
+  void release( const int c , const int r );
+
+  // pool slot for a new vector value of type t
+  uint32_t slot( const globals::atype_t t );
+
+  std::vector<std::string> keys;
+  std::map<std::string,int> key2col;
+  std::vector<column_t> cols;
+
+  std::vector<std::string> strings;
+  std::unordered_map<std::string,uint32_t> str2idx;
+
+  std::vector<std::vector<bool> > bvecs;
+  std::vector<std::vector<int> > ivecs;
+  std::vector<std::vector<double> > dvecs;
+  std::vector<std::vector<std::string> > svecs;
+
+  // free pool slots, indexed by type - A_BOOLVEC_T
+  std::vector<uint32_t> free_slots[4];
+
+  int nrows;
+  std::vector<int> free_rows;
+
+};
+
+#endif
@@ -1380,7 +1380,7 @@ void  chep_mask( edf_t & edf , param_t & param )
 
   // if at any step we are ignoring the prior mask, copy/clear/merge in using this:
 
-  std::map<int,std::set<std::string> > chep_copy;
+  chep_mask_t chep_copy;
 
   if ( ep_th.size() > 0 ) 
     logger << "  within-channel/between-epoch outlier detection, ep-th" << ( ep_ignore ? "0" : "" ) << " = " 
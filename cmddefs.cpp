@@ -2799,6 +2799,7 @@ void cmddefs_t::init()
   add_param( "WRITE" , "edf-dir" , "edfs/" , "Output folder for the written EDF" );
   add_param( "WRITE" , "edf-tag" , "v2" , "Append this tag to the existing EDF root name" );
   add_param( "WRITE" , "edfz" , "T" , "Write a compressed .edf.gz / EDFZ-style file" );
+  add_param( "WRITE" , "edfx" , "T" , "Write a channel-major, chunk-compressed .edfx file" );
   add_param( "WRITE" , "sample-list" , "v2.lst" , "Append the written EDF to this sample list" );
   add_param( "WRITE" , "with-annots" , "" , "When appending to sample-list, also append linked annotation files" );
   add_param( "WRITE" , "force-edf" , "" , "Force EDF/EDF+C style output after restructuring" );
@@ -156,6 +156,22 @@ bool globals::set_annot_inst2hms;
 bool globals::set_annot_inst2hms_force;
 bool globals::skip_sl_annots;
 bool globals::edf_stream_read;
+bool globals::edf_mmap;
+bool globals::edf_channel_store;
+int globals::edf_read_chunk;
+bool globals::edf_readahead;
+bool globals::edf_prefetch;
+bool globals::edf_tindex;
+int globals::edf_write_buffer;
+int globals::edfz_threads;
+bool globals::edfz_index;
+double globals::edfx_chunk_sec;
+bool globals::float_signals;
+bool globals::edf_selective_read;
+uint64_t globals::edf_mem_limit;
+bool globals::slice_fast_path;
+bool globals::epoch_tables;
+bool globals::mask_compile;
 
 
 std::set<std::string> globals::id_excludes;
@@ -569,6 +585,22 @@ void globals::init_defs()
   skip_nonedf_annots = false;
   skip_sl_annots = false;
   edf_stream_read = false;
+  edf_mmap = false;
+  edf_channel_store = false;
+  edf_read_chunk = 16;
+  edf_readahead = false;
+  edf_prefetch = false;
+  edf_selective_read = false;
+  edf_mem_limit = 0;
+  slice_fast_path = true;
+  epoch_tables = true;
+  mask_compile = true;
+  edf_tindex = false;
+  edf_write_buffer = 16;
+  edfz_threads = 1;
+  edfz_index = false;
+  edfx_chunk_sec = 30;
+  float_signals = false;
 
   
   set_annot_inst2hms = false;
@@ -257,6 +257,22 @@ struct globals
   static bool skip_sl_annots;
   
   static bool edf_stream_read;
+  static bool edf_mmap;
+  static bool edf_channel_store;
+  static int edf_read_chunk;
+  static bool edf_readahead;
+  static bool edf_prefetch;
+  static bool edf_selective_read;
+  static uint64_t edf_mem_limit;
+  static bool slice_fast_path;
+  static bool epoch_tables;
+  static bool mask_compile;
+  static bool edf_tindex;
+  static int edf_write_buffer;
+  static int edfz_threads;
+  static bool edfz_index;
+  static double edfx_chunk_sec;
+  static bool float_signals;
 
   static bool set_annot_inst2hms;
   static bool set_annot_inst2hms_force;
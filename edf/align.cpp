@@ -215,6 +215,9 @@ bool edf_t::align( const std::vector<std::string> & annots )
   //
 
   drop_annots();
+
+  // new records are filled from the int16 samples
+  flush_float_store();
   
   //
   // Create a buffer for the new data
@@ -353,6 +356,8 @@ bool edf_t::align( const std::vector<std::string> & annots )
 
   records = new_records;
   new_records.clear();
+  chstore.clear();
+  disable_record_cache();
   
   
   //
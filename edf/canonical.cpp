@@ -1379,6 +1379,8 @@ void canonical_t::proc( )
 	  edf.header.label[ canonical_slot ] = rule.canonical_label;
 	  
 	  edf.header.label2header[ rule.canonical_label ] = canonical_slot ;
+
+	  edf.header.labels_changed();
 	}
       
       
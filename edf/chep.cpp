@@ -102,27 +102,9 @@ void timeline_t::proc_chep( edf_t & edf , param_t & param )
 	channels.insert( edf.header.label[s] );
     }
 
-  // copy/clear/reset chep mask
-  std::map<int,std::set<std::string> > copy = edf.timeline.chep;
-  edf.timeline.clear_chep_mask();
-
-  std::map<int,std::set<std::string> >::const_iterator ii = copy.begin();
-  while ( ii != copy.end() )
-    {
-
-      // got this epoch?
-    if ( epochs.find( ii->first ) != epochs.end() )
-      {
-	std::set<std::string>::const_iterator jj = ii->second.begin();
-	while ( jj != ii->second.end() )
-	  {
-	    if ( channels.find( *jj ) != channels.end() )
-	      edf.timeline.chep[ ii->first ].insert( *jj );
-	    ++jj;
-	  }
-      }
-    ++ii;
-  }
+  // reset chep mask: keep only current epochs and data channels
+  // (epochs left with no masked channels are dropped)
+  edf.timeline.chep.retain( epochs , channels );
 
   //
   // manually specify good/bad channels/epochs
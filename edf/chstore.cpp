@@ -0,0 +1,86 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "edf/chstore.h"
+
+void chstore_t::init( const int n , const std::vector<int> & w )
+{
+  clear();
+  
+  if ( n <= 0 ) return;
+
+  nr = n;
+  width = w;
+  has.resize( nr , false );
+
+  // nb. default-init allocator: no pages are touched until records are read
+  data.resize( width.size() );
+  for (int s=0; s<width.size(); s++)
+    data[s] = std::make_shared<chbuf_t>( (uint64_t)nr * width[s] );
+}
+
+int16_t * chstore_t::wptr( const int s , const int r )
+{
+  if ( data[s].use_count() > 1 )
+    data[s] = std::make_shared<chbuf_t>( *data[s] );
+  return data[s]->data() + (uint64_t)r * width[s];
+}
+
+void chstore_t::clear()
+{
+  nr = 0;
+  nloaded = 0;
+  width.clear();
+  has.clear();
+  // swap to actually release memory
+  std::vector<std::shared_ptr<chbuf_t> >().swap( data );
+}
+
+void chstore_t::set_loaded( const int r )
+{
+  if ( r < 0 || r >= nr || has[r] ) return;
+  has[r] = true;
+  ++nloaded;
+}
+
+void chstore_t::release( const int r )
+{
+  if ( r < 0 || r >= nr || ! has[r] ) return;
+  has[r] = false;
+  --nloaded;
+  if ( nloaded == 0 ) clear();
+}
+
+void chstore_t::drop( const int s )
+{
+  if ( s < 0 || s >= width.size() ) return;
+  width.erase( width.begin() + s );
+  data.erase( data.begin() + s );
+}
+
+uint64_t chstore_t::bytes() const
+{
+  uint64_t b = 0;
+  for (int s=0; s<data.size(); s++)
+    b += data[s]->size() * sizeof(int16_t);
+  return b;
+}
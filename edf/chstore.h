@@ -0,0 +1,124 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_CHSTORE_H__
+#define __LUNA_CHSTORE_H__
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+//
+// Channel-major sample store (channel-store=T)
+//
+//  An alternative to holding each loaded record as an edf_record_t in
+//  edf_t::records: every loaded channel is one contiguous int16 buffer
+//  of nr_all x (samples per record), indexed by record offset, so
+//  reading a slice is a single pointer walk and there is one heap
+//  allocation per channel rather than one per record per channel.
+//
+//  The store only ever holds data exactly as read from the file: the
+//  first time a record is requested for modification (ensure_loaded()
+//  etc) it is moved into edf_t::records, which stays authoritative.
+//  Annotation channels are held in the same (one byte per int16 slot)
+//  form used by edf_record_t.
+//
+//  Channel buffers are reference-counted, so copies of a store (i.e.
+//  of an edf_t, for FREEZE) share them; a buffer is only duplicated
+//  if a shared store is written to again (wptr()).
+//
+
+// allocator that skips value-initialization, so that untouched
+// (i.e. never read) regions of a channel buffer are not paged in
+
+template <typename T>
+struct default_init_allocator_t : public std::allocator<T>
+{
+  template <typename U> struct rebind { typedef default_init_allocator_t<U> other; };
+  default_init_allocator_t() noexcept { }
+  template <typename U> default_init_allocator_t( const default_init_allocator_t<U> & ) noexcept { }
+  template <typename U> void construct( U * p ) { ::new( static_cast<void*>(p) ) U; }
+  template <typename U, typename... Args> void construct( U * p , Args&&... args )
+  { ::new( static_cast<void*>(p) ) U( std::forward<Args>(args)... ); }
+};
+
+typedef std::vector<int16_t,default_init_allocator_t<int16_t> > chbuf_t;
+
+
+struct chstore_t
+{
+
+  chstore_t() { clear(); }
+
+  // set up an (empty) store for nr records, where 'width' gives the
+  // per-record number of int16 slots for each (loaded) channel
+  void init( const int nr , const std::vector<int> & width );
+
+  // release everything (and deactivate)
+  void clear();
+
+  bool active() const { return nr != 0; }
+
+  // does the store's layout still match the current record structure?
+  bool matches( const std::vector<int> & w ) const { return active() && w == width; }
+
+  bool loaded( const int r ) const
+  { return r >= 0 && r < nr && has[r]; }
+
+  const int16_t * ptr( const int s , const int r ) const
+  { return data[s]->data() + (uint64_t)r * width[s]; }
+
+  // for decoding into: first unshares this channel's buffer
+  int16_t * wptr( const int s , const int r );
+
+  // mark a record as populated (i.e. after decoding into ptr())
+  void set_loaded( const int r );
+
+  // forget a record (e.g. moved into edf_t::records); once nothing
+  // is left, all buffers are freed and the store is deactivated
+  void release( const int r );
+
+  // drop channel slot 's' (mirrors edf_t::drop_signal())
+  void drop( const int s );
+
+  int ns() const { return width.size(); }
+
+  int n_loaded() const { return nloaded; }
+
+  // bytes held in channel buffers (i.e. allocated, not necessarily touched)
+  uint64_t bytes() const;
+
+ private:
+
+  int nr;
+
+  int nloaded;
+
+  std::vector<int> width;
+
+  std::vector<std::shared_ptr<chbuf_t> > data;
+
+  std::vector<bool> has;
+
+};
+
+#endif
@@ -21,6 +21,7 @@
 //    --------------------------------------------------------------------
 
 #include "edf.h"
+#include "simd.h"
 #include "param.h"
 #include "defs/defs.h"
 #include "helper/helper.h"
@@ -41,8 +42,16 @@
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <limits>
 #include <sstream>
 
+#include <sys/stat.h>
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 extern writer_t writer;
 extern logger_t logger;
 
@@ -69,6 +78,10 @@ edf_t::edf_t( annotation_set_t * a ) : timeline( this )
   file = NULL;  // uncompressed
   edfz = NULL;  // legacy indexed BGZF
   edfz2 = NULL; // unindexed gzstream
+  edfx = NULL;  // channel-major chunked
+  mapped = NULL;
+  mapped_size = 0;
+  reset_read_window();
   init();
 } 
 
@@ -82,6 +95,14 @@ edf_t::~edf_t()
 void edf_t::closeout_inputs()
 {
   //    std::cerr << " closing out\n";
+
+  if ( globals::edf_selective_read && nbytes_record != 0 && ( file != NULL || mapped != NULL ) )
+    logger << "  selective-read: read " << nbytes_read << " of " << nbytes_record << " record bytes ("
+	   << Helper::dbl2str( 100.0 * nbytes_read / (double)nbytes_record , 1 ) << "%)\n";
+  
+  unmap_file();
+  reset_read_window();
+
   if ( file != NULL )
     fclose(file);
   file = NULL;
@@ -100,13 +121,25 @@ void edf_t::closeout_inputs()
     }
   edfz2 = NULL;
 
+  if ( edfx != NULL )
+    {
+      edfx->close();
+      delete edfx;
+    }
+  edfx = NULL;
   
   cached_EDF_timepoints.clear();
+
+  // evicted records could no longer be re-read (e.g. after FREEZE)
+  disable_record_cache();
  
 }
   
 void edf_t::init()
 {
+  unmap_file();
+  reset_read_window();
+
   if ( file != NULL ) 
     fclose(file);
   file = NULL;
@@ -124,6 +157,13 @@ void edf_t::init()
       delete edfz2;
     }
   edfz2 = NULL;
+
+  if ( edfx != NULL ) 
+    {
+      edfx->close();
+      delete edfx;
+    }
+  edfx = NULL;
   
   header.init();  
 
@@ -132,7 +172,17 @@ void edf_t::init()
   timeline.annotations = annotations;
   
   records.clear();    
+  chstore.clear();
+  fstore.clear();
+  fstale.clear();
   inp_signals_n.clear();
+  read_spans.clear();
+  read_spans_sigs.clear();
+  read_spans_set = false;
+  nbytes_read = nbytes_record = 0;
+  rcache.clear();
+  rcache_ok = false;
+  rcache_hold = 0;
   has_edf_annots = false;
   cached_EDF_timepoints.clear();
 }
@@ -633,17 +683,18 @@ void edf_t::terse_summary( param_t & param )
 
 
 
-std::set<int> edf_header_t::read( FILE * file , edfz_t * edfz , edfz2_t * edfz2,
+std::set<int> edf_header_t::read( FILE * file , edfz_t * edfz , edfz2_t * edfz2, edfx_t * edfx , 
 				  const std::set<std::string> * inp_signals )
 {
 
   // file  --> implies uncompressed EDF
   // edfz2 --> implies gzipped EDF (gzstream interface / always preloaded)
   // edfz  --> implies BGZF EDF (legacy, phase out)
+  // edfx  --> implies channel-major chunked EDFX
   
   // only one of these must be set
   
-  if ( (int)(file != NULL) + (int)(edfz != NULL) + (int)(edfz2 != NULL ) != 1 )
+  if ( (int)(file != NULL) + (int)(edfz != NULL) + (int)(edfz2 != NULL ) + (int)(edfx != NULL ) != 1 )
     Helper::halt( "internal error in edf_header_t::read(), unclear whether EDF or which EDFZ type" );
   
   // Fixed buffer size for header
@@ -665,6 +716,8 @@ std::set<int> edf_header_t::read( FILE * file , edfz_t * edfz , edfz2_t * edfz2,
     rdsz = fread( q , 1, hdrSz , file);
   } else if ( edfz2 ) {
     rdsz = edfz2->read( q , hdrSz );        
+  } else if ( edfx ) {
+    rdsz = edfx->read( q , hdrSz );        
   } else {
     rdsz = edfz->read( q , hdrSz );
   }
@@ -856,6 +909,8 @@ std::set<int> edf_header_t::read( FILE * file , edfz_t * edfz , edfz2_t * edfz2,
     rdsz = fread( p , 1, hdrSz * ns_all , file);      
   else if ( edfz2 )
     rdsz = edfz2->read( p , hdrSz * ns_all );
+  else if ( edfx )
+    rdsz = edfx->read( p , hdrSz * ns_all );
   else
     rdsz = edfz->read( p , hdrSz * ns_all );
 
@@ -1185,6 +1240,8 @@ std::set<int> edf_header_t::read( FILE * file , edfz_t * edfz , edfz2_t * edfz2,
   // clean up buffer
   delete [] p0 ;
 
+  // new label index
+  labels_changed();
 
   // return mapping of imported channel numbers
   return channels;
@@ -1205,47 +1262,243 @@ bool edf_record_t::read( int r )
   // as we force preloads, we should never reach here if in unindexed EDFZ mode
   // i.e. as that was preloaded
   if ( edf->edfz2 != NULL ) Helper::halt( "internal error: EDFZ should have preloaded" );
+
+  //
+  // already decoded into the channel store? if so, move it from there
+  // (records[] is authoritative from now on)
+  //
+
+  if ( edf->chstore.loaded( r ) )
+    {
+      if ( edf->chstore.matches( edf->record_widths() ) )
+	{
+	  for (int s=0; s<edf->header.ns; s++)
+	    {
+	      const int16_t * d = edf->chstore.ptr( s , r );
+	      std::copy( d , d + data[s].size() , data[s].begin() );
+	    }
+	  edf->chstore.release( r );
+	  return true;
+	}
+      
+      // else, layout has since changed: the store is no longer of use
+      edf->chstore.clear();
+    }
   
-  // allocate space in the buffer for a single record, and read from file
+  //
+  // get the raw record (directly from the memory-mapped file, or
+  // read into the reusable record buffer)
+  //
   
-  byte_t * p = new byte_t[ edf->record_size ];
+  const byte_t * p = edf->record_bytes( r );
+
+  if ( p == NULL ) 
+    return Helper::vmode_halt( "corrupt EDF/EDFZ, could not read record " + Helper::int2str( r ) );
+
+  //
+  // decode the selected signals
+  //
+
+  std::vector<int16_t*> dst( edf->header.ns );
+  for (int s=0; s<edf->header.ns; s++)
+    dst[s] = data[s].data();
+
+  edf->decode_record( p , dst.data() );
+    
+  return true;
+
+}
+
+
+const byte_t * edf_t::record_bytes( const int r )
+{
+
+  // determine offset into EDF
+  const uint64_t offset = header_size + (uint64_t)(record_size) * r;
   
-  byte_t * p0 = p;
+  // memory-mapped EDF: no copy needed (and decode_record() only
+  // touches the selected signals)
+  if ( mapped ) 
+    {
+      if ( offset + record_size > mapped_size ) return NULL;
+      nbytes_record += record_size;
+      if ( globals::edf_selective_read && set_read_spans() )
+	for (int i=0; i<read_spans.size(); i++) nbytes_read += read_spans[i].second;
+      else
+	nbytes_read += record_size;
+      return mapped + offset;
+    }
 
   // EDF?
-  if ( edf->file ) 
+  if ( file ) 
     {
+      // already read, as part of the current run?
+      if ( r >= rbuf_r1 && r <= rbuf_r2 )
+	return record_buffer.data() + (uint64_t)record_size * ( r - rbuf_r1 );
+
+      // read this record and any that directly follow in this run
+      const int n = read_run_length( r );
+      
+      if ( record_buffer.size() < (uint64_t)record_size * n )
+	record_buffer.resize( (uint64_t)record_size * n );
+
+      byte_t * p = record_buffer.data();
+
+      int nread = 0;
+
+      if ( globals::edf_selective_read && set_read_spans() )
+	{
+	  // only the selected signals' bytes
+	  nread = read_selected( r , n , p );
+	}
+      else
+	{
+	  // find the appropriate record
+	  fseek( file , offset , SEEK_SET );
+	  
+	  // and read it (them)
+	  size_t rdsz = fread( p , 1, (uint64_t)record_size * n , file );
+	  nbytes_read += rdsz;
+	  nread = rdsz / record_size;
+	}
+
+      nbytes_record += (uint64_t)record_size * nread;
       
-      // determine offset into EDF
-      uint64_t offset = edf->header_size + (uint64_t)(edf->record_size) * r;
+      // only keep whole records in the window (a short read of a single
+      // record is passed back as before)
+      if ( nread > 0 ) 
+	{
+	  rbuf_r1 = r;
+	  rbuf_r2 = r + nread - 1;
+	}
+      else
+	rbuf_r1 = rbuf_r2 = -1;
       
-      // find the appropriate record
-      fseek( edf->file , offset , SEEK_SET );
+      // hint that the next part of this run will be wanted shortly
+      if ( globals::edf_readahead && nread == n )
+	readahead( r + n , read_run_r2 - ( r + n ) + 1 );
       
-      // and read it
-      size_t rdsz = fread( p , 1, edf->record_size , edf->file );
+      return p;
+    }
+
+  if ( record_buffer.size() < record_size ) 
+    record_buffer.resize( record_size );
+
+  byte_t * p = record_buffer.data();
+
+  // EDFX: only the selected channels' chunks are decompressed (the
+  // rest of the record buffer is left as is, as decode_record() skips it)
+  if ( edfx != NULL )
+    {
+      const uint64_t z0 = edfx->bytes_read();
+      if ( set_read_spans() )
+	{
+	  for (int j=0; j<read_spans.size(); j++)
+	    if ( ! edfx->read_record( r , read_spans[j].first , read_spans[j].second , p + read_spans[j].first ) )
+	      return NULL;
+	}
+      else if ( ! edfx->read_record( r , 0 , record_size , p ) )
+	return NULL;
+      nbytes_read += edfx->bytes_read() - z0;
+      nbytes_record += record_size;
+      return p;
+    }
+  
+  // EDFZ (BGZF legacy only)
+  if ( edfz != NULL ) 
+    {
+      if ( ! edfz->read_record( r , p , record_size ) ) return NULL;
+      nbytes_read += record_size;
+      nbytes_record += record_size;
+      return p;
+    }
+
+  return NULL;
+}
+
+
+bool edf_t::set_read_spans()
+{
+  // returns true if reading only the selected signals would skip
+  // anything (i.e. otherwise, just read whole records)
+  
+  if ( read_spans_set && read_spans_sigs == inp_signals_n ) 
+    return ! read_spans.empty();
+
+  read_spans.clear();
+  read_spans_sigs = inp_signals_n;
+  read_spans_set = true;
+  
+  int off = 0 , total = 0;
+  for (int s0=0; s0<header.ns_all; s0++)
+    {
+      const int nbytes = 2 * header.n_samples_all[s0];
+      if ( inp_signals_n.find( s0 ) != inp_signals_n.end() )
+	{
+	  // extend the previous span if contiguous
+	  if ( ! read_spans.empty() && read_spans.back().first + read_spans.back().second == off )
+	    read_spans.back().second += nbytes;
+	  else
+	    read_spans.push_back( std::make_pair( off , nbytes ) );
+	  total += nbytes;
+	}
+      off += nbytes;
     }
-  else // EDFZ (BGZF legacy only)
+
+  // nothing to skip?
+  if ( total == record_size ) 
+    read_spans.clear();
+  
+  return ! read_spans.empty();
+}
+
+
+int edf_t::read_selected( const int r , const int n , byte_t * p )
+{
+  // read the spans for records r .. r+n-1 into p (laid out as whole
+  // records); returns the number of records completely read
+
+  for (int i=0; i<n; i++)
     {
-      if ( ! edf->edfz->read_record( r , p , edf->record_size ) ) 
-	return Helper::vmode_halt( "corrupt .edfz or .idx, on record " + Helper::int2str( r ) );
+      const uint64_t offset = header_size + (uint64_t)(record_size) * ( r + i );
+      byte_t * q = p + (uint64_t)record_size * i;
+      
+      for (int j=0; j<read_spans.size(); j++)
+	{
+	  const int off = read_spans[j].first;
+	  const int len = read_spans[j].second;
+#ifndef WINDOWS
+	  const ssize_t rdsz = pread( fileno( file ) , q + off , len , offset + off );
+#else
+	  fseek( file , offset + off , SEEK_SET );
+	  const size_t rdsz = fread( q + off , 1 , len , file );
+#endif
+	  if ( rdsz > 0 ) nbytes_read += rdsz;
+	  if ( rdsz != len ) return i;
+	}
     }
+  return n;
+}
+
+
+void edf_t::decode_record( const byte_t * p , int16_t ** dst ) const
+{
 
   // which signals/channels do we actually want to read?
   // header : 0..(ns-1)
   // from record data : 0..(ns_all-1), from which we pick the 'ns' entries is 'channels'
-  // data[] is already created for 'ns' signals
+  // dst[] is already created for 'ns' signals
   
   // for convenience, use name 'channels' below
-  std::set<int> & channels = edf->inp_signals_n;
+  const std::set<int> & channels = inp_signals_n;
     
   int s = 0;
 
-  for (int s0=0; s0<edf->header.ns_all; s0++)
+  for (int s0=0; s0<header.ns_all; s0++)
     {
 
       // need to EDF-based header, i.e. if skipped signal still need size to skip
-      const int nsamples = edf->header.n_samples_all[s0];
+      const int nsamples = header.n_samples_all[s0];
       
       //
       // skip this signal?
@@ -1263,29 +1516,20 @@ bool edf_record_t::read( int r )
       // 's0', i.w. loaded channels, not all EDF channels
       //
       
-      bool annotation = edf->header.is_annotation_channel( s );
+      const bool annotation = header.is_annotation_channel( s );
 
       //
       // s0 : actual signal in EDF
       // s  : where this signal will land in edf_t
       //
+
+      int16_t * d = dst[s];
       
       if ( ! annotation ) 
 	{
-	  
-	  for (int j=0; j < nsamples ; j++)
-	    {
-
-	      //int d = tc2dec( **p ,  *((*p)+1)  ); 
-	      int16_t d = tc2dec( *p ,  *(p+1)  ); 
-	      
-	      // advance pointer
-	      p += 2;
-
-	      // store digital data-point
-	      data[s][j] = d;
-	      
-	    }
+	  // bulk decode of the 2-byte little-endian samples
+	  edf_simd::decode_int16( p , d , nsamples );
+	  p += 2 * nsamples;
 	}
       else // read as a ANNOTATION
 	{
@@ -1294,14 +1538,12 @@ bool edf_record_t::read( int r )
 	  // here we read twice the number of datapoints
 	  
 	  for (int j=0; j < 2 * nsamples; j++)
-	    {
-	      
+	    {	      
 	      // store digital data-point
-	      data[s][j] = *p;
+	      d[j] = *p;
 	      
 	      // advance pointer
-	      p++;
-	      
+	      p++;	      
 	    }	  
 	  
 	}
@@ -1310,16 +1552,105 @@ bool edf_record_t::read( int r )
       ++s;
 
     }
+  
+}
 
 
-  //
-  // Clean up
-  //
+int edf_t::read_run_length( const int r )
+{
+  // number of consecutive records from r to fetch in one read: stop at
+  // the end of the current range, at a masked or already-loaded record,
+  // or when the chunk limit is reached
+
+  const uint64_t chunk = (uint64_t)globals::edf_read_chunk * 1024 * 1024;
+  int maxn = record_size > 0 ? chunk / record_size : 1;
+  if ( maxn < 1 ) maxn = 1;
+
+  int n = 1;
+  while ( n < maxn && r + n <= read_run_r2 
+	  && timeline.retained( r + n ) 
+	  && ! loaded( r + n ) 
+	  && ! chstore.loaded( r + n ) )
+    ++n;
+  return n;
+}
+
+
+void edf_t::readahead( const int r , const int n )
+{
+  // ask the OS to start fetching the next (up to) read-chunk MB of
+  // records [r,r+n) in the background, i.e. while the current
+  // chunk is being decoded (most useful for network filesystems)
+
+  if ( n < 1 || r >= header.nr_all ) return;
+
+#if ! defined(WINDOWS) && defined(POSIX_FADV_WILLNEED)
+  const uint64_t chunk = (uint64_t)globals::edf_read_chunk * 1024 * 1024;
+  uint64_t len = (uint64_t)record_size * n;
+  if ( len > chunk ) len = chunk;
+  posix_fadvise( fileno( file ) , header_size + (uint64_t)record_size * r , len , POSIX_FADV_WILLNEED );
+#endif
+}
+
+
+std::vector<int> edf_t::record_widths() const
+{
+  // as allocated by edf_record_t::edf_record_t()
+  std::vector<int> w( header.ns );
+  for (int s=0; s<header.ns; s++)
+    w[s] = header.is_annotation_channel(s) ? 2 * header.n_samples[s] : header.n_samples[s];
+  return w;
+}
+
+
+bool edf_t::cache_records( int r1 , int r2 )
+{
 
-  delete [] p0;
+  // if not using the channel store (or the record structure has
+  // changed since it was set up), this is just read_records()
+
+  if ( chstore.active() && ! chstore.matches( record_widths() ) )
+    chstore.clear();
   
-  return true;
+  if ( ! chstore.active() )
+    return read_records( r1 , r2 );
+  
+  if ( r1 < 0 ) r1 = 0;
+  if ( r1 >= header.nr_all ) r1 = header.nr_all - 1;
+
+  if ( r2 < r1 ) r2 = r1;
+  if ( r2 >= header.nr_all ) r2 = header.nr_all - 1;
+
+  std::vector<int16_t*> dst( header.ns );
+
+  read_run_r2 = r2;
+  
+  for (int r=r1;r<=r2;r++)
+    {
+      if ( ! timeline.retained(r) ) continue;
+
+      // already in records[] or the store?
+      if ( loaded( r ) || chstore.loaded( r ) ) continue;
+      
+      const byte_t * p = record_bytes( r );
+      
+      if ( p == NULL )
+	{
+	  read_run_r2 = -1;
+	  return Helper::vmode_halt( "corrupt EDF/EDFZ, could not read record " + Helper::int2str( r ) );
+	}
+      
+      for (int s=0; s<header.ns; s++)
+	dst[s] = chstore.wptr( s , r );
+      
+      decode_record( p , dst.data() );
+
+      chstore.set_loaded( r );
+    }
 
+  read_run_r2 = -1;
+  
+  return true;
 }
 
 
@@ -1337,6 +1668,9 @@ bool edf_t::read_records( int r1 , int r2 )
   if ( r2 >= header.nr_all ) r2 = header.nr_all - 1;
   
   //  std::cerr << "edf_t::read_records :: scanning ... r1, r2 " << r1 << "\t" << r2 << "\n";
+
+  // allow runs of consecutive records to be read in one go
+  read_run_r2 = r2;
   
   for (int r=r1;r<=r2;r++)
     {
@@ -1349,15 +1683,57 @@ bool edf_t::read_records( int r1 , int r2 )
 	  if ( ! loaded( r ) ) 
 	    {
 	      edf_record_t record( this ); 
-	      if ( ! record.read( r ) ) return false;
+	      if ( ! record.read( r ) ) 
+		{
+		  read_run_r2 = -1;
+		  return false;
+		}
 	      records.insert( std::map<int,edf_record_t>::value_type( r , record ) );	      
 	    }
+	  touch_record( r );
 	}
     }
+
+  read_run_r2 = -1;
+
+  // drop least recently used records (outside this range) if over budget
+  evict_records( r1 , r2 );
+  
   return true;
 }
 
 
+void edf_t::evict_records( const int r1 , const int r2 )
+{
+  if ( ! rcache_ok || rcache_hold != 0 ) return;
+
+  // approximate heap use per record
+  const std::vector<int> w = record_widths();
+  uint64_t per_record = sizeof( edf_record_t ) + 64; 
+  for (int s=0; s<w.size(); s++)
+    per_record += sizeof( std::vector<int16_t> ) + 2 * (uint64_t)w[s];
+  
+  while ( per_record * records.size() > globals::edf_mem_limit )
+    {
+      const int r = rcache.oldest( r1 , r2 );
+      if ( r == -1 )
+	{
+	  // modified records are pinned in memory, not spilled to disk,
+	  // so say if they alone put us over the budget
+	  if ( ! rcache.warned && per_record * rcache.n_pinned() > globals::edf_mem_limit )
+	    {
+	      logger << "  *** warning: " << rcache.n_pinned() << " modified records are held in memory,"
+		     << " exceeding mem-limit (" << globals::edf_mem_limit << " bytes)\n";
+	      rcache.warned = true;
+	    }
+	  break;
+	}
+      records.erase( r );
+      rcache.forget( r );
+    }
+}
+
+
 bool edf_t::init_empty( const std::string & i ,
 			const int nr ,
 			const int rs ,
@@ -1910,20 +2286,39 @@ bool edf_t::attach( const std::string & f ,
   edfz = NULL;
   
   edfz2 = NULL;
+
+  edfx = NULL;
   
   bool edfz_mode = Helper::file_extension( filename , "edfz" )
     || Helper::file_extension( filename , "edf.gz" ); 
+
+  const bool edfx_mode = Helper::file_extension( filename , "edfx" );
   
   // keep old code, but force a pre-read all for EDFZ now, given inefficiencies
-  // and quirks w/ legacy BGZF
+  // and quirks w/ legacy BGZF; the exception is edfz-index=T, for a BGZF
+  // EDFZ with a .idx (as written by WRITE edfz with edfz-index=T), when
+  // records are read on demand via the index
   
-  const bool edfz2_mode = true;
+  const bool edfz2_mode = ! ( edfz_mode && globals::edfz_index && ! globals::edf_stream_read
+			      && Helper::fileExists( filename + ".idx" )
+			      && bgzf_is_bgzf( filename.c_str() ) );
   
   //
   // Attach the file
   //
-  
-  if ( ! edfz_mode ) 
+
+  if ( edfx_mode )
+    {
+      edfx = new edfx_t;
+      
+      if ( ! edfx->open_for_reading( filename ) )
+	{
+	  delete edfx;
+	  edfx = NULL;
+	  return Helper::vmode_halt( "could not open specified EDFX: " + filename );
+	}
+    }
+  else if ( ! edfz_mode ) 
     {
       if ( ( file = fopen( filename.c_str() , "rb" ) ) == NULL )
 	{      
@@ -1939,7 +2334,7 @@ bool edf_t::attach( const std::string & f ,
 	  
 	  edfz2 = new edfz2_t;
 	  
-	  if ( ! edfz2->open_for_reading( filename ) )
+	  if ( ! edfz2->open_for_reading( filename , globals::edfz_threads ) )
 	    {
 	      delete edfz2;
 	      edfz2 = NULL;
@@ -1988,7 +2383,7 @@ bool edf_t::attach( const std::string & f ,
   // signal codes store so we know how to read records
   //
 
-  inp_signals_n = header.read( file , edfz , edfz2, inp_signals );
+  inp_signals_n = header.read( file , edfz , edfz2, edfx , inp_signals );
 
 
   //
@@ -2069,6 +2464,16 @@ bool edf_t::attach( const std::string & f ,
 
 	  return Helper::vmode_halt( "internal error, different record size in EDFZ header versus index" );
 	}
+
+      // i.e. a stale .idx (the EDFZ re-written without it)
+      if ( header.nr_all != edfz->n_indexed() )
+	return Helper::vmode_halt( "EDFZ .idx does not match the EDFZ (re-write with edfz-index=T): " + filename );
+    }
+
+  if ( edfx )
+    {
+      if ( record_size != edfx->record_size() || header.nr_all != edfx->nrecords() )
+	return Helper::vmode_halt( "corrupt EDFX, header does not match chunk index: " + filename );
     }
   
 
@@ -2140,6 +2545,29 @@ bool edf_t::attach( const std::string & f ,
 
 
 
+  //
+  // memory-map a standard EDF? (if this fails, we fall back to stdio reads)
+  //
+
+  if ( file && globals::edf_mmap )
+    map_file();
+
+  //
+  // hold (read-only) signal data in channel-major buffers?
+  //
+
+  if ( globals::edf_channel_store && globals::edf_mem_limit == 0 )
+    chstore.init( header.nr_all , record_widths() );
+
+  //
+  // bound the memory held by records[]? (records can be re-read from
+  // standard EDF, EDFX or, with edfz-index=T, indexed EDFZ; nb. the
+  // channel store is not used in this case)
+  //
+
+  rcache_ok = globals::edf_mem_limit != 0 && ( file != NULL || edfz != NULL || edfx != NULL );
+
+  
   //
   // pre-load?  this will also read EDF+D timestamps (and so init_timeline() will 
   // use cached record timestamps when calling timepoint_from_EDF() ;
@@ -2156,6 +2584,15 @@ bool edf_t::attach( const std::string & f ,
     }
   
   
+  //
+  // EDF+D: get all record time-stamps up front (unless already cached
+  // via the preload), rather than one seek per record
+  //
+
+  if ( file != NULL && header.edfplus && ! header.continuous ) 
+    scan_EDF_timepoints();
+
+  
   //
   // Create timeline (relates time-points to records and vice-versa)
   // Here we assume a continuous EDF, but timeline is set up so that 
@@ -2319,10 +2756,11 @@ std::vector<double> edf_t::fixedrate_signal( uint64_t start ,
   
   //
   // Ensure that these records are loaded into memory
-  // (if they are already, they will not be re-read)
+  // (if they are already, they will not be re-read); if
+  // using the channel store, this will decode into that
   //
   
-  bool successful_read = read_records( start_record , stop_record );
+  bool successful_read = cache_records( start_record , stop_record );
 
   // sets problem flag
   if ( ! successful_read )
@@ -2338,53 +2776,398 @@ std::vector<double> edf_t::fixedrate_signal( uint64_t start ,
   double bitvalue = header.bitvalue[ signal ];
   double offset   = header.offset[ signal ];
 
-  int r = start_record;
+  // float32-backed signal (precision=float)? physical values come
+  // straight from that, but digital values need the int16 form
+  const bool use_float = has_float_store( signal ) && ddata == NULL && ! globals::read_digital_values;
 
-  while ( r <= stop_record )
+  if ( ! use_float )
+    sync_float_store( signal );
+  
+
+  //
+  // Fast path: a continuous, fully-retained timeline, so records
+  // start_record .. stop_record are all present and record r starts at
+  // r * record_duration_tp; no per-record/per-sample map lookups, and
+  // runs of records held in the channel store are converted in one go
+  //
+
+  if ( globals::slice_fast_path && timeline.simple_records() )
     {
+      const int nspr = n_samples_per_record;
+      const uint64_t rec_tp = header.record_duration_tp;
 
-      //std::cout << " r = " << r << " " << stop_record << " " << n_samples_per_record << "\n";
+      // size outputs up front
+      const uint64_t ntot = (uint64_t)( stop_record - start_record ) * nspr + stop_sample - start_sample + 1;
+      const uint64_t nout = downsample == 1 ? ntot : ( stop_record - start_record + 1 ) * ( nspr / downsample + 1 );
       
-      const edf_record_t * record = &(records.find( r )->second);
+      if ( tp != NULL ) tp->reserve( nout );
+      if ( rec != NULL ) rec->reserve( nout );
+      if ( smp != NULL ) smp->reserve( nout );
+      if ( ddata != NULL ) ddata->reserve( nout );
+      else ret.reserve( nout );
       
-      const int start = r == start_record ? start_sample : 0 ;
-      // std::cout << " n_samples_per_record = " << n_samples_per_record << "\n";
-      // std::cout << " n_samples_per_record = " << n_samples_per_record -1 << "\n";
-      // std::cout << " stop_sample = " << stop_sample << "\n";
-      const int stop  = r == stop_record  ? stop_sample  : n_samples_per_record - 1;
+      // channel store rows are contiguous across records (not so for
+      // annotation channels, stored as two slots per sample)
+      const bool contiguous_store = downsample == 1 && ! header.is_annotation_channel( signal );
 
-      //      std::cout << " st/st " << start << " " << stop << "\n";
+      // records[] takes precedence over the channel store
+      std::map<int,edf_record_t>::const_iterator rr = records.lower_bound( start_record );
       
-      for (int s=start;s<=stop;s+=downsample)
+      int r = start_record;
+      
+      while ( r <= stop_record )
 	{
+	  while ( rr != records.end() && rr->first < r ) ++rr;
+	  
+	  const bool in_records = rr != records.end() && rr->first == r;
+
+	  const int16_t * d = in_records ? rr->second.data[ signal ].data() : chstore.ptr( signal , r );
+
+	  const float * f = use_float ? float_samples( r , signal ) : NULL ;
 	  
-	  if ( tp != NULL ) 
-	    tp->push_back( timeline.timepoint( r , s , n_samples_per_record ) );
-	  if ( rec != NULL ) 
-	    rec->push_back( r );
-	  if ( smp != NULL )
-	    smp->push_back( r * n_samples_per_record + s );
+	  // a run of records r .. r2, all in the channel store (or the
+	  // float store, which is always contiguous)?
+	  int r2 = r;
+	  if ( use_float && downsample == 1 )
+	    r2 = stop_record;
+	  else if ( ! in_records && contiguous_store )
+	    r2 = rr == records.end() || rr->first > stop_record ? stop_record : rr->first - 1 ;
 	  
-	  // just return digital values separately...
-	  if ( ddata != NULL )
-	    ddata->push_back( record->data[ signal ][ s ] );
-	  else if ( globals::read_digital_values ) // return digital to standard vector
-	    ret.push_back( record->data[ signal ][ s ] );
-	  else // ... or convert from digital to physical on-the-fly
-	    ret.push_back( edf_record_t::dig2phys( record->data[ signal ][ s ] , bitvalue , offset ) );	  
+	  const int start = r == start_record ? start_sample : 0 ;
+	  const int stop  = r2 == stop_record  ? stop_sample  : nspr - 1;
+	  
+	  if ( downsample == 1 )
+	    {
+	      // samples in this run
+	      const uint64_t n = (uint64_t)( r2 - r ) * nspr + stop - start + 1;
+	      
+	      for (int q = r ; q <= r2 ; q++ )
+		{
+		  const int s1 = q == r ? start : 0 ;
+		  const int s2 = q == r2 ? stop : nspr - 1;
+		  
+		  if ( tp != NULL )
+		    {
+		      const uint64_t tp0 = q * rec_tp;
+		      for (int s=s1;s<=s2;s++)
+			tp->push_back( tp0 + rec_tp * s / nspr );
+		    }
+		  
+		  if ( rec != NULL ) 
+		    rec->insert( rec->end() , s2 - s1 + 1 , q );
+		  
+		  if ( smp != NULL )
+		    for (int s=s1;s<=s2;s++)
+		      smp->push_back( q * n_samples_per_record + s );
+		}
+	      
+	      if ( ddata != NULL )
+		ddata->insert( ddata->end() , d + start , d + start + n );
+	      else if ( globals::read_digital_values )
+		ret.insert( ret.end() , d + start , d + start + n );
+	      else if ( use_float )
+		ret.insert( ret.end() , f + start , f + start + n );
+	      else
+		{
+		  const size_t n0 = ret.size();
+		  ret.resize( n0 + n );
+		  edf_simd::dig2phys( d + start , ret.data() + n0 , n , bitvalue , offset );
+		}
+	    }
+	  else
+	    {
+	      const uint64_t tp0 = r * rec_tp;
+	      for (int s=start;s<=stop;s+=downsample)
+		{
+		  if ( tp != NULL ) 
+		    tp->push_back( tp0 + rec_tp * s / nspr );
+		  if ( rec != NULL ) 
+		    rec->push_back( r );
+		  if ( smp != NULL )
+		    smp->push_back( r * n_samples_per_record + s );
+		  
+		  if ( ddata != NULL )
+		    ddata->push_back( d[ s ] );
+		  else if ( globals::read_digital_values )
+		    ret.push_back( d[ s ] );
+		  else if ( use_float )
+		    ret.push_back( f[ s ] );
+		  else
+		    ret.push_back( edf_record_t::dig2phys( d[ s ] , bitvalue , offset ) );	  
+		}
+	    }
+
+	  r = r2 + 1;
 	}
       
-      r = timeline.next_record(r);
-      if ( r == -1 ) break;
+      return ret;
     }
-  
-  // will be length==0 if digital == T 
-  return ret;  
-}
-
 
-
-//
+  
+  //
+  // General case (e.g. EDF+D, or masked records removed)
+  //
+  
+  int r = start_record;
+
+  while ( r <= stop_record )
+    {
+
+      //std::cout << " r = " << r << " " << stop_record << " " << n_samples_per_record << "\n";
+      
+      // records[] takes precedence over the channel store
+      std::map<int,edf_record_t>::const_iterator rr = records.find( r );
+
+      const int16_t * d = rr != records.end() ? rr->second.data[ signal ].data() : chstore.ptr( signal , r );
+
+      const float * f = use_float ? float_samples( r , signal ) : NULL ;
+      
+      const int start = r == start_record ? start_sample : 0 ;
+      // std::cout << " n_samples_per_record = " << n_samples_per_record << "\n";
+      // std::cout << " n_samples_per_record = " << n_samples_per_record -1 << "\n";
+      // std::cout << " stop_sample = " << stop_sample << "\n";
+      const int stop  = r == stop_record  ? stop_sample  : n_samples_per_record - 1;
+
+      //      std::cout << " st/st " << start << " " << stop << "\n";
+      
+      if ( downsample == 1 )
+	{
+
+	  // bulk copy/conversion of this run of samples
+	  
+	  const int n = stop - start + 1;
+	  
+	  if ( n > 0 ) 
+	    {
+	      
+	      if ( tp != NULL ) 
+		for (int s=start;s<=stop;s++)
+		  tp->push_back( timeline.timepoint( r , s , n_samples_per_record ) );
+	      
+	      if ( rec != NULL ) 
+		rec->insert( rec->end() , n , r );
+	      
+	      if ( smp != NULL )
+		for (int s=start;s<=stop;s++)
+		  smp->push_back( r * n_samples_per_record + s );
+	      
+	      if ( ddata != NULL )
+		ddata->insert( ddata->end() , d + start , d + stop + 1 );
+	      else if ( globals::read_digital_values )
+		ret.insert( ret.end() , d + start , d + stop + 1 );
+	      else if ( use_float )
+		ret.insert( ret.end() , f + start , f + stop + 1 );
+	      else
+		{
+		  const size_t n0 = ret.size();
+		  ret.resize( n0 + n );
+		  edf_simd::dig2phys( d + start , ret.data() + n0 , n , bitvalue , offset );
+		}
+	    }
+	}
+      else
+	{
+	  
+	  for (int s=start;s<=stop;s+=downsample)
+	    {
+	      
+	      if ( tp != NULL ) 
+		tp->push_back( timeline.timepoint( r , s , n_samples_per_record ) );
+	      if ( rec != NULL ) 
+		rec->push_back( r );
+	      if ( smp != NULL )
+		smp->push_back( r * n_samples_per_record + s );
+	      
+	      // just return digital values separately...
+	      if ( ddata != NULL )
+		ddata->push_back( d[ s ] );
+	      else if ( globals::read_digital_values ) // return digital to standard vector
+		ret.push_back( d[ s ] );
+	      else if ( use_float )
+		ret.push_back( f[ s ] );
+	      else // ... or convert from digital to physical on-the-fly
+		ret.push_back( edf_record_t::dig2phys( d[ s ] , bitvalue , offset ) );	  
+	    }
+	}
+      
+      r = timeline.next_record(r);
+      if ( r == -1 ) break;
+    }
+  
+  // will be length==0 if digital == T 
+  return ret;  
+}
+
+
+
+const int16_t * edf_t::record_samples( const int r , const int signal ) const
+{
+  if ( float_store_stale( signal ) )
+    Helper::halt( "internal error: int16 samples read before sync_float_store()" );
+  std::map<int,edf_record_t>::const_iterator rr = records.find( r );
+  return rr != records.end() ? rr->second.data[ signal ].data() : chstore.ptr( signal , r );
+}
+
+
+void edf_t::set_float_store( const int s , const std::vector<double> & d , const double lwr , const double upr )
+{
+  if ( s < 0 || s >= header.ns ) return;
+
+  if ( fstore.size() < header.ns )
+    {
+      fstore.resize( header.ns );
+      fstale.resize( header.ns , false );
+    }
+
+  const int nspr = header.n_samples[s];
+
+  // indexed by record, so unaffected by RESTRUCTURE (masked records
+  // are just never touched); a new buffer if still shared with a
+  // frozen copy
+  const uint64_t n = (uint64_t)header.nr_all * nspr;
+  if ( ! fstore[s] || fstore[s].use_count() > 1 || fstore[s]->size() != n )
+    fstore[s] = std::make_shared<std::vector<float> >( n , 0 );
+
+  std::vector<float> & f = *fstore[s];
+
+  uint64_t cnt = 0;
+  int r = timeline.first_record();
+  while ( r != -1 )
+    {
+      float * p = f.data() + (uint64_t)r * nspr;
+      for (int i=0; i<nspr; i++)
+	{
+	  const double x = d[ cnt++ ];
+	  p[i] = x < lwr ? lwr : ( x > upr ? upr : x );
+	}
+      r = timeline.next_record(r);
+    }
+
+  fstale[s] = true;
+}
+
+
+void edf_t::sync_float_store( const int s )
+{
+  if ( ! has_float_store( s ) || ! fstale[s] ) return;
+
+  const int nspr = header.n_samples[s];
+  const double bv = header.bitvalue[s];
+  const double os = header.offset[s];
+
+  std::vector<double> x( nspr );
+
+  int r = timeline.first_record();
+  while ( r != -1 )
+    {
+      ensure_loaded( r );
+      pin_record( r );
+
+      std::vector<int16_t> & data = records.find(r)->second.data[ s ];
+      if ( data.size() != nspr ) data.resize( nspr , 0 );
+
+      const float * f = fstore[s]->data() + (uint64_t)r * nspr;
+      std::copy( f , f + nspr , x.begin() );
+      edf_simd::phys2dig( x.data() , data.data() , nspr , bv , os ,
+			  header.physical_min[s] , header.physical_max[s] );
+
+      r = timeline.next_record(r);
+    }
+
+  fstale[s] = false;
+}
+
+
+void edf_t::sync_float_store()
+{
+  for (int s=0; s<fstore.size(); s++)
+    sync_float_store( s );
+}
+
+
+void edf_t::flush_float_store()
+{
+  sync_float_store();
+  fstore.clear();
+  fstale.clear();
+}
+
+bool edf_t::sample_runs( uint64_t start , 
+			 uint64_t stop , 
+			 const int signal , 
+			 std::vector<sample_run_t> * runs )
+{
+
+  runs->clear();
+  
+  if ( stop > timeline.last_time_point_tp + 1 )
+    stop = timeline.last_time_point_tp + 1 ;      
+
+  const uint64_t n_samples_per_record = header.n_samples[signal];
+   
+  int start_record, stop_record;
+  int start_sample, stop_sample;
+
+  if ( ! timeline.interval2records( interval_t( start , stop ) , 
+				    n_samples_per_record , 
+				    &start_record, &start_sample , 
+				    &stop_record, &stop_sample ) )
+    return true; // i.e. empty
+  
+  if ( ! cache_records( start_record , stop_record ) )
+    return Helper::vmode_halt( "problem reading EDF records" );
+
+  // views are of the int16 samples
+  sync_float_store( signal );
+  
+  const bool simple = globals::slice_fast_path && timeline.simple_records();
+
+  // channel store rows are contiguous across consecutive records
+  const bool contiguous_store = simple && ! header.is_annotation_channel( signal );
+  
+  std::map<int,edf_record_t>::const_iterator rr = records.lower_bound( start_record );
+  
+  int r = start_record;
+
+  while ( r <= stop_record )
+    {
+      
+      while ( rr != records.end() && rr->first < r ) ++rr;
+      
+      const bool in_records = rr != records.end() && rr->first == r;
+      
+      sample_run_t run;
+      run.d = in_records ? rr->second.data[ signal ].data() : chstore.ptr( signal , r );
+      run.rec = r;
+      run.smp = r == start_record ? start_sample : 0 ;
+
+      int r2 = r;
+      if ( ! in_records && contiguous_store )
+	r2 = rr == records.end() || rr->first > stop_record ? stop_record : rr->first - 1 ;
+      
+      const int stop  = r2 == stop_record  ? stop_sample  : n_samples_per_record - 1;
+      
+      run.d += run.smp;
+      run.n = ( r2 - r ) * n_samples_per_record + stop - run.smp + 1;
+
+      if ( run.n > 0 ) 
+	runs->push_back( run );
+
+      if ( simple )
+	r = r2 + 1;
+      else
+	{
+	  r = timeline.next_record( r );
+	  if ( r == -1 ) break;
+	}
+    }
+
+  return true;
+}
+
+
+
+//
 // Functions to write an EDF
 //
 
@@ -2519,7 +3302,7 @@ bool edf_header_t::write( edfz2_t * edfz , const std::vector<int> & ch2slot )
 
 
 
-bool edf_record_t::write( FILE * file , const std::vector<int> & ch2slot )
+bool edf_record_t::write( FILE * file , const std::vector<int> & ch2slot ) const
 {
 
   const int ns2 = ch2slot.size();
@@ -2529,6 +3312,10 @@ bool edf_record_t::write( FILE * file , const std::vector<int> & ch2slot )
       // get actual from-slot 
       const int s = ch2slot[s2];
 
+      // i.e. edf_t::write() syncs any float-backed signals first
+      if ( edf->float_store_stale( s ) )
+	return Helper::vmode_halt( "internal error: int16 samples written before sync_float_store()" );
+
       const int nsamples = edf->header.n_samples[s];
 
       //
@@ -2565,7 +3352,254 @@ bool edf_record_t::write( FILE * file , const std::vector<int> & ch2slot )
 }
 
 
-bool edf_record_t::write( edfz_t * edfz , const std::vector<int> & ch2slot )
+std::vector<int> edf_t::passthrough_offsets() const
+{
+
+  // for each (in-memory) signal slot, the byte offset of its samples
+  // within a record of the input file, or -1 if that slot cannot be
+  // copied straight from the file; this requires that slots still map
+  // 1:1 onto the signals read from the file (i.e. as decode_record())
+  
+  std::vector<int> src( header.ns , -1 );
+
+  if ( ( file == NULL && ! mapped ) || edfz != NULL ) return src;
+
+  if ( header.ns != inp_signals_n.size() ) return src;
+
+  int offset = 0;
+  int s = 0;
+  
+  for (int s0=0; s0<header.ns_all; s0++)
+    {
+      if ( inp_signals_n.find( s0 ) != inp_signals_n.end() )
+	{
+	  if ( header.n_samples[s] == header.n_samples_all[s0] ) 
+	    src[s] = offset;
+	  ++s;
+	}
+      offset += 2 * header.n_samples_all[s0];
+    }
+
+  return src;
+}
+
+
+bool edf_t::assemble_record( const int r , 
+			     const std::vector<int> & ch2slot , 
+			     const std::vector<int> & src , 
+			     byte_t * p )
+{
+
+  const int ns2 = ch2slot.size();
+
+  for (int s2=0; s2<ns2; s2++)
+    if ( float_store_stale( ch2slot[s2] ) )
+      return Helper::vmode_halt( "internal error: int16 samples written before sync_float_store()" );
+  
+  //
+  // loaded record: encode from memory
+  //
+
+  std::map<int,edf_record_t>::const_iterator rr = records.find( r );
+  
+  if ( rr != records.end() )
+    {
+      const edf_record_t & record = rr->second;
+      for (int s2=0; s2<ns2; s2++)
+	{
+	  const int s = ch2slot[s2];
+	  const int nsamples = header.n_samples[s];
+	  const std::vector<int16_t> & d = record.data[s];
+	  
+	  if ( header.is_annotation_channel(s) )
+	    for (int j=0; j<2*nsamples; j++)
+	      *p++ = j >= d.size() ? '\x00' : (char)d[j];	      
+	  else
+	    {
+	      edf_simd::encode_int16( d.data() , p , nsamples );
+	      p += 2 * nsamples;
+	    }
+	}
+      return true;
+    }
+  
+  //
+  // in the channel store (i.e. as read from the file)
+  //
+
+  if ( chstore.loaded( r ) && chstore.matches( record_widths() ) )
+    {
+      for (int s2=0; s2<ns2; s2++)
+	{
+	  const int s = ch2slot[s2];
+	  const int nsamples = header.n_samples[s];
+	  const int16_t * d = chstore.ptr( s , r );
+	  
+	  if ( header.is_annotation_channel(s) )
+	    for (int j=0; j<2*nsamples; j++)
+	      *p++ = (char)d[j];
+	  else
+	    {
+	      edf_simd::encode_int16( d , p , nsamples );
+	      p += 2 * nsamples;
+	    }
+	}
+      return true;
+    }
+
+  //
+  // not loaded: copy bytes straight through from the input file
+  //
+
+  bool passthrough = true;
+  for (int s2=0; s2<ns2; s2++)
+    if ( src[ ch2slot[s2] ] == -1 ) passthrough = false;
+
+  if ( passthrough )
+    {
+      const byte_t * q = record_bytes( r );
+      if ( q == NULL ) 
+	return Helper::vmode_halt( "corrupt EDF, could not read record " + Helper::int2str( r ) );
+      
+      for (int s2=0; s2<ns2; s2++)
+	{
+	  const int s = ch2slot[s2];
+	  const int n = 2 * header.n_samples[s];
+	  memcpy( p , q + src[s] , n );
+	  p += n;
+	}
+      return true;
+    }
+  
+  //
+  // otherwise, load as usual (i.e. the per-record write())
+  //
+  
+  ensure_loaded( r );
+
+  return assemble_record( r , ch2slot , src , p );
+}
+
+
+bool edf_t::write_records( FILE * outfile , const std::vector<int> & ch2slot )
+{
+  
+  uint64_t rec_bytes = 0;
+  for (int s2=0; s2<ch2slot.size(); s2++)
+    rec_bytes += 2 * header.n_samples[ ch2slot[s2] ];
+  
+  if ( rec_bytes == 0 ) return true;
+
+  // records are assembled from the int16 samples
+  sync_float_store();
+  
+  const uint64_t buf_bytes = globals::edf_write_buffer * 1024LLU * 1024LLU ;
+  const int n_per_write = buf_bytes > rec_bytes ? buf_bytes / rec_bytes : 1 ; 
+  
+  const std::vector<int> src = passthrough_offsets();
+  
+  std::vector<byte_t> buf( rec_bytes * n_per_write );
+  
+  // i.e. passed-through records are read in runs (as read_records())
+  read_run_r2 = header.nr_all - 1;
+  
+  bool okay = true;
+
+  int n = 0;
+  
+  int r = timeline.first_record();
+
+  while ( r != -1 ) 
+    {
+      if ( ! assemble_record( r , ch2slot , src , buf.data() + rec_bytes * n ) )
+	{
+	  okay = false;
+	  break;
+	}
+      
+      if ( ++n == n_per_write )
+	{
+	  if ( fwrite( buf.data() , 1 , rec_bytes * n , outfile ) != rec_bytes * n ) 
+	    {
+	      okay = false;
+	      break;
+	    }
+	  n = 0;
+	}
+      
+      r = timeline.next_record(r);
+    }
+  
+  if ( okay && n != 0 && fwrite( buf.data() , 1 , rec_bytes * n , outfile ) != rec_bytes * n ) 
+    okay = false;
+
+  read_run_r2 = -1;
+  
+  return okay;
+}
+
+
+bool edf_t::write_records( edfx_t * out , const std::vector<int> & ch2slot )
+{
+
+  std::vector<int> nbytes( ch2slot.size() );
+  uint64_t rec_bytes = 0;
+  for (int s2=0; s2<ch2slot.size(); s2++)
+    {
+      nbytes[s2] = 2 * header.n_samples[ ch2slot[s2] ];
+      rec_bytes += nbytes[s2];
+    }
+  
+  if ( ! out->set_layout( nbytes ) ) return false;
+
+  // records are assembled from the int16 samples
+  sync_float_store();
+
+  const int n_per_write = out->records_per_chunk();
+  
+  const std::vector<int> src = passthrough_offsets();
+  
+  std::vector<byte_t> buf( rec_bytes * n_per_write );
+
+  read_run_r2 = header.nr_all - 1;
+  
+  bool okay = true;
+
+  int n = 0;
+  
+  int r = timeline.first_record();
+
+  while ( r != -1 ) 
+    {
+      if ( ! assemble_record( r , ch2slot , src , buf.data() + rec_bytes * n ) )
+	{
+	  okay = false;
+	  break;
+	}
+      
+      if ( ++n == n_per_write )
+	{
+	  if ( ! out->write_records( buf.data() , n ) )
+	    {
+	      okay = false;
+	      break;
+	    }
+	  n = 0;
+	}
+      
+      r = timeline.next_record(r);
+    }
+
+  if ( okay && n != 0 && ! out->write_records( buf.data() , n ) )
+    okay = false;
+  
+  read_run_r2 = -1;
+  
+  return okay;
+}
+
+
+bool edf_record_t::write( edfz_t * edfz , const std::vector<int> & ch2slot ) const
 {
   
   const int ns2 = ch2slot.size();
@@ -2575,6 +3609,10 @@ bool edf_record_t::write( edfz_t * edfz , const std::vector<int> & ch2slot )
       
       const int s = ch2slot[s2];
 
+      // i.e. edf_t::write() syncs any float-backed signals first
+      if ( edf->float_store_stale( s ) )
+	return Helper::vmode_halt( "internal error: int16 samples written before sync_float_store()" );
+
       const int nsamples = edf->header.n_samples[s];
 
       //
@@ -2616,7 +3654,7 @@ bool edf_record_t::write( edfz_t * edfz , const std::vector<int> & ch2slot )
   return true;
 }
 
-bool edf_record_t::write( edfz2_t * edfz2 , const std::vector<int> & ch2slot )
+bool edf_record_t::write( edfz2_t * edfz2 , const std::vector<int> & ch2slot ) const
 {
   
   const int ns2 = ch2slot.size();
@@ -2626,6 +3664,10 @@ bool edf_record_t::write( edfz2_t * edfz2 , const std::vector<int> & ch2slot )
       
       const int s = ch2slot[s2];
 
+      // i.e. edf_t::write() syncs any float-backed signals first
+      if ( edf->float_store_stale( s ) )
+	return Helper::vmode_halt( "internal error: int16 samples written before sync_float_store()" );
+
       const int nsamples = edf->header.n_samples[s];
 
       //
@@ -2767,6 +3809,9 @@ bool edf_t::write( const std::string & f , bool as_edfz , int write_as_edf , boo
   //  want offset times always from the EDF+D start
   //
 
+  // any float32-backed signals are (only now) encoded as int16
+  sync_float_store();
+  
   bool actually_EDFD = is_actually_discontinuous();
   
   bool make_EDFC = (!always_edfd) && (!header.continuous) && (! actually_EDFD ); 
@@ -2862,7 +3907,46 @@ bool edf_t::write( const std::string & f , bool as_edfz , int write_as_edf , boo
 
   filename = f;
 
-  if ( ! as_edfz ) 
+  //
+  // .edfx (channel-major chunks)
+  //
+  
+  if ( Helper::file_extension( filename , "edfx" ) )
+    {
+      
+      // records per chunk, i.e. edfx-chunk seconds (at least one record)
+      int k = header.record_duration > 0 ? globals::edfx_chunk_sec / header.record_duration : 1 ;
+      if ( k < 1 ) k = 1;
+      
+      edfx_t edfxout;
+      
+      if ( ! edfxout.open_for_writing( filename , k ) )
+	{
+	  logger << " ** could not open " << filename << " for writing **\n";
+	  return false;
+	}
+      
+      if ( make_EDFC ) set_continuous();
+      
+      header.write( edfxout.file , ch2slot );
+
+      if ( make_EDFC ) set_discontinuous();
+
+      if ( ! write_records( &edfxout , ch2slot ) )
+	{
+	  edfxout.close();
+	  logger << " ** problem writing to " << filename << " **\n";
+	  return false;
+	}
+      
+      edfxout.close();
+    }
+
+  //
+  // standard EDF
+  //
+  
+  else if ( ! as_edfz ) 
     {
 
       FILE * outfile = NULL;
@@ -2882,20 +3966,32 @@ bool edf_t::write( const std::string & f , bool as_edfz , int write_as_edf , boo
       // change back if needed, as subsequent commands after will be happier
       if ( make_EDFC ) set_discontinuous();
 
-      int r = timeline.first_record();
-      while ( r != -1 ) 
+      if ( globals::edf_write_buffer > 0 )
 	{
-	  // we may need to load this record, before we can write it
-	  if ( ! loaded( r ) )
+	  if ( ! write_records( outfile , ch2slot ) )
 	    {
-	      edf_record_t record( this ); 
-	      record.read( r );
-	      records.insert( std::map<int,edf_record_t>::value_type( r , record ) );	      
+	      fclose( outfile );
+	      logger << " ** problem writing to " << filename << " **\n";
+	      return false;
+	    }
+	}
+      else
+	{
+	  int r = timeline.first_record();
+	  while ( r != -1 ) 
+	    {
+	      // we may need to load this record, before we can write it
+	      if ( ! loaded( r ) )
+		{
+		  edf_record_t record( this ); 
+		  record.read( r );
+		  records.insert( std::map<int,edf_record_t>::value_type( r , record ) );	      
+		}
+	      
+	      records.find(r)->second.write( outfile , ch2slot );
+	      
+	      r = timeline.next_record(r);
 	    }
-	  
-	  records.find(r)->second.write( outfile , ch2slot );
-	  
-	  r = timeline.next_record(r);
 	}
       
       fclose(outfile);
@@ -2910,7 +4006,11 @@ bool edf_t::write( const std::string & f , bool as_edfz , int write_as_edf , boo
 
       edfz2_t edfz2;
 
-      if ( ! edfz2.open_for_writing( filename ) )
+      // edfz-index=T: write as BGZF, plus a (binary) .idx, so that
+      // records can be read on demand rather than preloaded
+      const bool indexed = globals::edfz_index;
+      
+      if ( ! edfz2.open_for_writing( filename , globals::edfz_threads , indexed ) )
 	{
 	  logger << " ** could not open " << filename << " for writing **\n";
 	  return false;
@@ -2924,6 +4024,12 @@ bool edf_t::write( const std::string & f , bool as_edfz , int write_as_edf , boo
 
       if ( make_EDFC ) set_discontinuous();
 
+      // for the index: time-stamps and any EDF Annotations of each
+      // record, as written
+      edfz_t idx;
+      idx.filename = filename;
+      
+      int rc = 0;
       
       int r = timeline.first_record();
       while ( r != -1 ) 
@@ -2937,72 +4043,49 @@ bool edf_t::write( const std::string & f , bool as_edfz , int write_as_edf , boo
 	      records.insert( std::map<int,edf_record_t>::value_type( r , record ) );	      
 	    }
 	  
-
-	  // legacy stuff, only needed for BGZF
-	  if ( 0 )
+	  if ( indexed )
 	    {
-	      // set index :
-	      // record -> offset into EDFZ and time-point	  
-	      //        -> string representation of EDF Annots
-	      
-	      // offset into file
-	      //int64_t offset = edfz.tell();	  
-	      
-	      // time-point offset
-	      //uint64_t tp = timeline.timepoint( r );
-	      
-	      // any annots
-	      //const std::string edf_annot_str = edf_annots[ r ] == "" ? "." : edf_annots[ r ] ;
-	      
-	      // write to the index
-	      //edfz.add_index( r , offset , timeline.timepoint( r ) , edf_annot_str  );
+	      std::map<int,std::string>::const_iterator aa = edf_annots.find( r );
+	      idx.add_index( rc , -1 , timeline.timepoint( r ) ,
+			     aa == edf_annots.end() || aa->second == "" ? "." : aa->second );
 	    }
 	  
 	  // now write to the .edfz
 	  records.find(r)->second.write( &edfz2 , ch2slot );
 	  
 	  // next record
+	  ++rc;
 	  r = timeline.next_record(r);
 	}
       
 
       //
-      // Write .idx (legacy)
+      // All done
       //
 
-      if ( 0 )
-	{
+      edfz2.close();
 
-	  //logger << "  writing EDFZ index to " << filename << ".idx\n";
-	  
-	  // update record_size (e.g. if channels dropped)
-	  // at this point, we will have read all information in from
-	  // the existing 
+
+      //
+      // Write .idx: record offsets from the BGZF block sizes
+      //
+
+      if ( indexed )
+	{
+	  // allowing for dropped channels
+	  int new_record_size = 0;
+	  for (int s2=0; s2<ns2; s2++)
+	    new_record_size += 2 * header.n_samples[ ch2slot[s2] ] ; // 2 bytes each
 	  
-	  // int new_record_size = 0;
+	  if ( ! idx.index_records( 256 + ns2 * 256 , new_record_size , rc ) )
+	    Helper::halt( "problem indexing " + filename );
 	  
-	  // old
-	  // for (int s=0;s<header.ns;s++)
-	  // 	new_record_size += 2 * header.n_samples[s] ; // 2 bytes each                                                       
+	  logger << "  writing EDFZ index to " << filename << ".idx\n";
 	  
-	  // now allowing for dropped channels
-	  //for (int s2=0; s2<ns2; s2++)
-	  //{
-	  //const int s = ch2slot[s2];
-	  //new_record_size += 2 * header.n_samples[s] ; // 2 bytes each                                                       
-	  //}	  
-	  //edfz.write_index( new_record_size );
-
+	  if ( ! idx.write_index( new_record_size , true ) )
+	    Helper::halt( "problem writing " + filename + ".idx" );
 	}
       
-      
-      //
-      // All done
-      //
-
-      edfz2.close();
-
-
     }
   
   logger << "  saved new EDF" 
@@ -3069,6 +4152,7 @@ void edf_t::drop_signal( const int s )
   for (int l=0;l<header.label.size();l++)     
     if ( header.is_data_channel(l) ) 
       header.label2header[ Helper::toupper( header.label[l] ) ] = l;      
+  header.labels_changed();
   
   // records
   int r = timeline.first_record();
@@ -3079,6 +4163,16 @@ void edf_t::drop_signal( const int s )
       r = timeline.next_record(r);
     }
 
+  // and the channel store
+  chstore.drop( s );
+
+  // and any float32 store
+  if ( s < fstore.size() )
+    {
+      fstore.erase( fstore.begin() + s );
+      fstale.erase( fstale.begin() + s );
+    }
+
   // reset/clear time-track?
   // do not touch t_track_edf_offset, as that should be fixed
   // w.r.t actual file
@@ -3097,8 +4191,7 @@ void edf_t::drop_signal( const int s )
 
 void edf_record_t::drop( const int s )
 {
-  data[ s ].clear();
-  data.erase( data.begin() + s );
+  data.erase( s );
 }
 
 
@@ -3106,6 +4199,9 @@ bool edf_t::init_signal( const std::string & label, const double Fs )
 {
 
   if ( header.has_signal( label ) ) return false;
+
+  // records will no longer match the file
+  disable_record_cache();
   
   const int n_samples = Fs * header.record_duration ;
   const int64_t dmax = 32767;
@@ -3139,6 +4235,7 @@ bool edf_t::init_signal( const std::string & label, const double Fs )
   header.annotation_channel.push_back( ( header.edfplus ? 
 					 Helper::imatch( label , "EDF Annotation" , 14 ) :
 					 false ) ) ;
+  header.labels_changed();
 
   header.transducer_type.push_back( "n/a" );
   header.phys_dimension.push_back( "n/a" );
@@ -3168,6 +4265,9 @@ void edf_t::add_signal( const std::string & label ,
 			int16_t dmin , int16_t dmax )
 {
 
+  // records will no longer match the file
+  disable_record_cache();
+
   const int ndata = data.size();
 
   // normally, n_samples is Fs * record length.
@@ -3242,7 +4342,10 @@ void edf_t::add_signal( const std::string & label ,
   double bv = ( pmax - pmin ) / (double)( dmax - dmin );
   double os = ( pmax / bv ) - dmax;
 
-  // store (after converting to digital form)
+  // store (after converting to digital form, unless precision=float,
+  // in which case that is deferred: see set_float_store() below)
+
+  const bool as_float = globals::float_signals && ! Helper::imatch( label , "EDF Annotation" , 14 );
   
   int c = 0;
   int r = timeline.first_record();
@@ -3254,8 +4357,9 @@ void edf_t::add_signal( const std::string & label ,
       
       std::vector<int16_t> t(n_samples);
       
-      for (int i=0;i<n_samples;i++) 
-	t[i] = edf_record_t::phys2dig( data[c++] , bv , os );
+      if ( ! as_float )
+	for (int i=0;i<n_samples;i++) 
+	  t[i] = edf_record_t::phys2dig( data[c++] , bv , os );
 
       records.find(r)->second.add_data(t);
 
@@ -3277,6 +4381,7 @@ void edf_t::add_signal( const std::string & label ,
   header.annotation_channel.push_back( ( header.edfplus ? 
 					 Helper::imatch( label , "EDF Annotation" , 14 ) :
 					 false ) ) ;
+  header.labels_changed();
 
   header.transducer_type.push_back( "n/a" );
   header.phys_dimension.push_back( "n/a" );
@@ -3292,6 +4397,9 @@ void edf_t::add_signal( const std::string & label ,
   header.n_samples.push_back( n_samples );  
   header.signal_reserved.push_back( "" );  
 
+  if ( as_float )
+    set_float_store( header.ns - 1 , data , pmin , pmax );
+  
   // add to TYPES, by recallig this
   cmd_t::define_channel_type_variables( *this );
   
@@ -3308,6 +4416,8 @@ void edf_t::add_signal_int16( const std::string & label ,
 
   // this function, as add_signal() except takes vector of digitial int16_t values
   //  i.e. for use in EDF-MINUS when we don't need to look at the whole signal
+
+  disable_record_cache();
   
   const int ndata = data.size();
 
@@ -3396,6 +4506,7 @@ void edf_t::add_signal_int16( const std::string & label ,
   header.annotation_channel.push_back( ( header.edfplus ? 
 					 Helper::imatch( label , "EDF Annotation" , 14 ) :
 					 false ) ) ;
+  header.labels_changed();
 
   header.transducer_type.push_back( "n/a" );
   header.phys_dimension.push_back( "n/a" );
@@ -3417,8 +4528,13 @@ void edf_t::add_signal_int16( const std::string & label ,
 }
 
 
-std::vector<double> edf_record_t::get_pdata( const int s )
+std::vector<double> edf_record_t::get_pdata( const int s ) const
 {
+  // if float-backed (precision=float), the int16 samples may be stale
+  // w.r.t. the header's bitvalue/offset: re-encode first (a no-op if
+  // already current)
+  edf->sync_float_store( s );
+
   const double & bv     = edf->header.bitvalue[s];
   const double & offset = edf->header.offset[s];
   const int n = data[s].size();
@@ -3477,6 +4593,9 @@ void edf_t::reset_record_size( const double new_record_duration )
 
   // nothing to do?
   if ( header.record_duration == new_record_duration ) return;
+
+  // records are rebuilt from the int16 samples
+  flush_float_store();
   
   std::vector<int> new_nsamples;
 
@@ -3573,7 +4692,7 @@ void edf_t::reset_record_size( const double new_record_duration )
       int r = timeline.first_record();
       while ( r != -1 )
 	{
-	  edf_record_t & record = records.find(r)->second;
+	  const edf_record_t & record = records.find(r)->second;
 	  
 	  for (int i = 0 ; i < n ; i++ )
 	    xx.push_back( record.data[ s ][ i ] );
@@ -3647,6 +4766,8 @@ void edf_t::reset_record_size( const double new_record_duration )
   
   records = new_records;
   new_records.clear();
+  chstore.clear();
+  disable_record_cache();
 
   //
   // and update EDF header
@@ -3662,6 +4783,7 @@ void edf_t::reset_record_size( const double new_record_duration )
   // index
   
   record_size = new_record_size ; 
+  reset_read_window();
 
   // make a new timeline & re-epoch
   timeline.re_init_timeline();
@@ -4125,7 +5247,7 @@ bool  edf_header_t::has_signal( const std::string & s )
 
 int  edf_header_t::original_signal_no_aliasing( const std::string & s  )
 {  
-  std::map<std::string,int>::const_iterator ff = label_all.find( Helper::toupper( s ) );
+  std::unordered_map<std::string,int>::const_iterator ff = label_all.find( Helper::toupper( s ) );
   if ( ff != label_all.end() ) return ff->second;
   return -1;
 }
@@ -4139,7 +5261,7 @@ int  edf_header_t::original_signal( const std::string & s  )
 
   const std::string uc_s = Helper::toupper( s );
   
-  std::map<std::string,int>::const_iterator ff = label_all.find( uc_s );
+  std::unordered_map<std::string,int>::const_iterator ff = label_all.find( uc_s );
   
   if ( ff != label_all.end() ) return ff->second;
   
@@ -4172,11 +5294,57 @@ int  edf_header_t::original_signal( const std::string & s  )
 }
 
 
+std::vector<uint64_t> edf_header_t::signal_list_state() const
+{
+  // a cheap check that nothing signal_list() depends on has changed
+  // without labels_changed() being called
+  std::vector<uint64_t> st( 7 );
+  st[0] = label.size();
+  st[1] = label2header.size();
+  st[2] = annotation_channel.size();
+  st[3] = cmd_t::label_aliases.size();
+  st[4] = cmd_t::primary_alias.size();
+  st[5] = globals::order_signal_list_alphabetically;
+  st[6] = globals::retain_alias_case;
+  return st;
+}
+
+
 signal_list_t edf_header_t::signal_list( const std::string & s , 
 					 bool no_annotation_channels , 
 					 bool show_warnings )
 {
 
+  // the same spec is typically resolved many times (i.e. by each
+  // command, and via signal()), so keep parsed results until the
+  // labels change
+
+  const std::string key = ( no_annotation_channels ? "1|" : "0|" ) + s;
+
+  if ( slist_cache_state != signal_list_state() )
+    labels_changed();
+  else
+    {
+      std::unordered_map<std::string,signal_list_t>::const_iterator cc = slist_cache.find( key );
+      if ( cc != slist_cache.end() ) return cc->second;
+    }
+
+  signal_list_t r = parse_signal_list( s , no_annotation_channels );
+
+  // nb. parsing may itself have swapped in aliases
+  if ( slist_cache.empty() )
+    slist_cache_state = signal_list_state();
+  
+  slist_cache[ key ] = r;
+
+  return r;
+}
+
+
+signal_list_t edf_header_t::parse_signal_list( const std::string & s , 
+					       bool no_annotation_channels )
+{
+
   signal_list_t r;
   
   // wildcard means all signals '*'
@@ -4215,6 +5383,7 @@ signal_list_t edf_header_t::signal_list( const std::string & s ,
 	      lb = cmd_t::label_aliases[ uppercase_lb ];
 	      label2header[ Helper::toupper( lb ) ] = s;
 	      label[s] = lb;
+	      labels_changed();
 	      
 	    }
 
@@ -4229,6 +5398,7 @@ signal_list_t edf_header_t::signal_list( const std::string & s ,
 		      lb = cmd_t::primary_upper2orig[ uppercase_lb ];
 		      label2header[ Helper::toupper( lb ) ] = s;
 		      label[s] = lb;
+		      labels_changed();
 		    }
 		}
 	    }
@@ -4423,6 +5593,7 @@ signal_list_t edf_header_t::signal_list( const std::string & s ,
 	      if ( t2 > 0 ) // relabel if wasn't first choice?
 		{
 		  label2header[ Helper::toupper( tok2[0] ) ] = l;		  
+		  labels_changed();
 		}	  
 	      
 	      const int l0 = label2header[ Helper::toupper( tok2[0] ) ] ;
@@ -4462,6 +5633,7 @@ void edf_header_t::rename_channel( const std::string & old_label , const std::st
   for (int s=0;s<label.size();s++) if ( label[s] == old_label ) label[s] = new_label;
   label_all[ Helper::toupper( new_label ) ] = label_all[ Helper::toupper( old_label ) ];
   label2header[ Helper::toupper( new_label ) ] = label2header[ Helper::toupper( old_label ) ];
+  labels_changed();
   
 }
 
@@ -4639,6 +5811,9 @@ bool edf_t::restructure( const bool force , const bool verbose , const bool pres
 
   std::set<int> include;
 
+  // all included records need to be in records[] at once
+  ++rcache_hold;
+  
   for (int r = 0 ; r < header.nr_all; r++)
     {
       // do we need to load this record in from disk?
@@ -4700,6 +5875,8 @@ bool edf_t::restructure( const bool force , const bool verbose , const bool pres
 		  }    
 	    }
 
+  --rcache_hold;
+  
   if ( luna_re_debug_enabled() )
     std::cerr << "[LUNA_RE_DEBUG] edf_t::restructure(): include.size=" << include.size() << "\n";
 
@@ -4708,30 +5885,37 @@ bool edf_t::restructure( const bool force , const bool verbose , const bool pres
   
   
   //
-  // Remove records based on epoch-mask
+  // Remove records based on epoch-mask: compact records[] in place,
+  // in one ordered pass (retained records are neither copied nor
+  // moved; both records[] and include are sorted by record)
   //
 
-  std::map<int,edf_record_t> copy = records;
-  records.clear();
-  
-  //
-  // Copy back, but now use iterator instead
-  //
+  const int n_before = records.size();
 
   std::set<int>::const_iterator ii = include.begin();
-  while ( ii != include.end() )
+  std::map<int,edf_record_t>::iterator cc = records.begin();
+  while ( cc != records.end() )
     {
-      records.insert( std::map<int,edf_record_t>::value_type( *ii , copy.find( *ii )->second ) );
-      ++ii;
+      while ( ii != include.end() && *ii < cc->first ) ++ii;
+
+      if ( ii != include.end() && *ii == cc->first )
+	++cc;
+      else
+	{
+	  // record cache: no longer holding this record
+	  rcache.forget( cc->first );
+	  cc = records.erase( cc );
+	}
     }
 
+  // all included records are now in records[]
+  chstore.clear();
+  
        
   // set warning flags, if not enough data left
   
   if ( records.size() == 0 ) globals::empty = true;
     
-
-  const int n_before = copy.size();
   const int n_after  = records.size();
   
   const double s_before = header.record_duration * n_before  ;
@@ -4957,26 +6141,34 @@ void edf_t::update_records( int a , int b , int s , const std::vector<double> *
 
   read_records( a , b );
 
+  // unshare any float store (i.e. from a frozen copy) before writing
+  if ( has_float_store( s ) && fstore[s].use_count() > 1 )
+    fstore[s] = std::make_shared<std::vector<float> >( *fstore[s] );
+  
   for ( int r = a ; r <= b ; r++ ) 
     {
       
-      // find records      
+      // find records (and keep, as now modified)
+      pin_record( r );
       std::vector<int16_t>    & data  = records.find(r)->second.data[ s ];
       
       // check that we did not change sample rate      
       if ( data.size() != points_per_record ) 
 	Helper::halt( "changed sample rate, cannot update record" );
-      
-      for (int p=0;p<points_per_record;p++)
-	{
-	  double x = (*d)[cnt];
-	  if ( x < pmin ) x = pmin;
-	  else if ( x > pmax ) x = pmax;
 
-	  data[p] = edf_record_t::phys2dig( (*d)[cnt] , bv , os );
-	  ++cnt;	  
-	}
+      // nb. as before, values are not actually clamped to pmin/pmax here
+      if ( has_float_store( s ) )
+	std::copy( d->begin() + cnt , d->begin() + cnt + points_per_record ,
+		   fstore[s]->begin() + (uint64_t)r * points_per_record );
+      else
+	edf_simd::phys2dig( d->data() + cnt , data.data() , points_per_record , bv , os ,
+			    -std::numeric_limits<double>::infinity() ,
+			    std::numeric_limits<double>::infinity() );
+      cnt += points_per_record;
     }
+
+  if ( has_float_store( s ) )
+    fstale[s] = true;
 }
 
   
@@ -5070,11 +6262,8 @@ void edf_t::update_signal( int s , const std::vector<double> * d , int16_t * dmi
   else
     {
       // empirically find physical min/max for this signal
-      for (int i=0;i<n;i++)
-	{
-	  if      ( (*d)[i] < pmin ) pmin = (*d)[i];
-	  else if ( (*d)[i] > pmax ) pmax = (*d)[i];
-	}
+      if ( n != 0 ) 
+	edf_simd::minmax( d->data() , n , &pmin , &pmax );
       
       // exapand range as needed
       if ( fabs( pmin - pmax ) < 1e-6 )
@@ -5113,6 +6302,15 @@ void edf_t::update_signal( int s , const std::vector<double> * d , int16_t * dmi
 
   header.bitvalue[s] = bv;
   header.offset[s] = os;
+
+  // precision=float: keep the new values as float32, and leave the
+  // int16 encoding until it is needed (e.g. WRITE)
+  const bool as_float = globals::float_signals;
+  
+  if ( as_float )
+    set_float_store( s , *d , pmin , pmax );
+  else if ( has_float_store( s ) )
+    fstore[s].reset();
   
   int cnt = 0;
 
@@ -5130,7 +6328,11 @@ void edf_t::update_signal( int s , const std::vector<double> * d , int16_t * dmi
 	  std::cout << " s = " << s << "\n";
 	}
 		  
-      // find records
+      // find records (nb. if read via the channel store, this
+      // moves the record into records[] first)
+
+      ensure_loaded( r );
+      pin_record( r );
       
       //      std::vector<double> & pdata = records.find(r)->second.pdata[ s ];
       std::vector<int16_t>    & data  = records.find(r)->second.data[ s ];
@@ -5144,23 +6346,12 @@ void edf_t::update_signal( int s , const std::vector<double> * d , int16_t * dmi
 	}
 
       
-      for (int p=0;p<points_per_record;p++)
-	{
-	  
-	  // check that does not exceed range
-	  double x = (*d)[cnt];
-	  if ( x < pmin ) x = pmin;
-	  if ( x > pmax ) x = pmax;
-	  
-	  // also need to convert to bit-value
-	  // pdata[s][j] = header->bitvalue[s] * ( header->offset[s] + d );	  
-	  // reverse digital --> physical scaling
-	  
-	  //data[p] = (*d)[cnt] / bv - os;
-	  data[p] = edf_record_t::phys2dig( x , bv , os );
-	
-	  ++cnt;	  
-	}
+      // clamp to [pmin,pmax], then physical --> digital scaling (the
+      // whole record in one pass; as edf_record_t::phys2dig())
+      if ( ! as_float )
+	edf_simd::phys2dig( d->data() + cnt , data.data() , points_per_record , bv , os , pmin , pmax );
+      
+      cnt += points_per_record;
 
       r = timeline.next_record(r);
     }
@@ -5332,6 +6523,8 @@ int edf_t::add_time_track( const std::vector<uint64_t> * tps )
   // done by calling this function by having tps != NULL but a vector
   // of time-points for each record
 
+  // records will no longer match the file
+  disable_record_cache();
   const bool contin = tps == NULL;
   
   if ( contin && ! header.continuous ) 
@@ -5374,7 +6567,7 @@ int edf_t::add_time_track( const std::vector<uint64_t> * tps )
       // how many existing 'EDF Annotations' tracks?
       int annot_tracks = 0 ; 
       
-      std::map<std::string,int>::const_iterator jj = header.label_all.begin();
+      std::unordered_map<std::string,int>::const_iterator jj = header.label_all.begin();
       while ( jj != header.label_all.end() )
 	{
 	  if ( Helper::imatch( jj->first  , "EDF Annotation" , 14 ) ) 
@@ -5384,6 +6577,7 @@ int edf_t::add_time_track( const std::vector<uint64_t> * tps )
       
       header.label.push_back( "EDF Annotations" + ( annot_tracks > 0 ? Helper::int2str( annot_tracks ) : "" ) );
       header.annotation_channel.push_back( true );
+      header.labels_changed();
 
       // note: annot, so not added to header/record signal map label2header
 
@@ -5490,16 +6684,62 @@ int edf_t::add_time_track( const std::vector<uint64_t> * tps )
 
 
 
+// parse the first TAL onset (of up to ttsize bytes) of an EDF+ time-track
+
+static uint64_t tal_timepoint( const byte_t * p , const int ttsize )
+{
+  int e = 0;
+  while ( e < ttsize && p[e] != '\x14' && p[e] != '\x15' ) ++e;
+  
+  double tt_sec = 0;
+
+  if ( ! Helper::str2dbl( std::string( (const char*)p , e ) , &tt_sec ) ) 
+    Helper::halt( "problem converting time-track in EDF+" );
+  
+  uint64_t tp = globals::tp_1sec * tt_sec;
+
+  // to handle floating point issues -- enforce that the last few digits of an EDF+ specified time-point should be zeros
+  uint64_t div10 = tp % 10LLU ; 
+
+  if ( div10 != 0 )
+    {
+      // round down, or up
+      if ( div10 < 5 ) tp -= div10 ;
+      else tp += 10LLU - div10;
+    }
+  
+  return tp;
+}
+
+
 uint64_t edf_t::timepoint_from_EDF( int r )
 {
   
   //
   // cached? (i.e. if done prior stream-read)
   //
+
+  std::map<int,uint64_t>::const_iterator cc = cached_EDF_timepoints.find( r );
+  if ( cc != cached_EDF_timepoints.end() )
+    return cc->second;
   
-  if ( cached_EDF_timepoints.find( r ) != cached_EDF_timepoints.end() )
-    return cached_EDF_timepoints[ r ];
   
+  //
+  // for EDFX, read just the time-track (i.e. only its chunks are decompressed)
+  //
+
+  if ( edfx != NULL )
+    {
+      const int ttsize = 2 * globals::edf_timetrack_size;
+      const int off = header.time_track_offset();
+      const int n = off + ttsize > record_size ? record_size - off : ttsize ;
+      std::vector<byte_t> p( ttsize , 0 );
+      if ( ! edfx->read_record( r , off , n , p.data() ) )
+	Helper::halt( "problem reading EDF+D time-track from " + filename );
+      const uint64_t tp = tal_timepoint( p.data() , n );
+      cached_EDF_timepoints[ r ] = tp;
+      return tp;
+    }
   
   //
   // for EDFZ, this will be stored in the .idx
@@ -5518,57 +6758,253 @@ uint64_t edf_t::timepoint_from_EDF( int r )
   if (   header.continuous ) Helper::halt( "should not call timepoint_from_EDF for EDF+C");
   if (   header.time_track() == -1 ) Helper::halt( "internal error: no EDF+D time-track" );
   
-  // allocate buffer space
-  int ttsize = 2 * globals::edf_timetrack_size;  
-  byte_t * p = new byte_t[ ttsize ];
-  byte_t * p0 = p;
-  
+  const int ttsize = 2 * globals::edf_timetrack_size;  
+
   // determine offset into EDF
   uint64_t offset = header_size + (uint64_t)(record_size) * r;      
   offset += header.time_track_offset(); 
+
+  uint64_t tp = 0;
   
-  // time-track is record : edf->header.time_track 
-  // find the appropriate record
-  fseek( file , offset , SEEK_SET );
-      
-  // and read only time-track (all of it)
-  size_t rdsz = fread( p , 1, ttsize , file );
+  if ( mapped && offset + ttsize <= mapped_size )
+    {
+      // read directly from the mapped file
+      tp = tal_timepoint( mapped + offset , ttsize );
+    }
+  else
+    {
+      // time-track is record : edf->header.time_track 
+      // find the appropriate record, and read only time-track
+      std::vector<byte_t> p( ttsize , 0 );
+      fseek( file , offset , SEEK_SET );      
+      size_t rdsz = fread( p.data() , 1, ttsize , file );
+      tp = tal_timepoint( p.data() , ttsize );
+    }
   
-  std::string tt( ttsize , '\x00' );
+  // cache in case recalled 
+  cached_EDF_timepoints[ r ] = tp;
 
-  int e = 0;
-  for (int j=0; j < ttsize; j++)
-    {      
-      tt[j] = *p;
-      if ( tt[j] == '\x14' || tt[j] == '\x15' ) break;
-      ++p;
-      ++e;
-    }
+  return tp;
+}
 
-  double tt_sec = 0;
 
-  if ( ! Helper::str2dbl( tt.substr(0,e) , &tt_sec ) ) 
-    Helper::halt( "problem converting time-track in EDF+" );
+void edf_t::scan_EDF_timepoints()
+{
+  
+  if ( file == NULL ) return;
+  if ( ! header.edfplus || header.continuous ) return;
+  if ( header.time_track() == -1 ) return;
+
+  const int nr = header.nr_all;
+
+  // already done (i.e. stream-read)?
+  if ( cached_EDF_timepoints.size() == nr ) return;
+
+  const uint64_t fsize = mapped ? mapped_size : get_filesize( file );
   
-  delete [] p0;
+  const std::string tidx = filename + ".tidx";
   
-  uint64_t tp = globals::tp_1sec * tt_sec;
+  if ( globals::edf_tindex && read_tindex( tidx , fsize ) )
+    {
+      logger << "  read EDF+D record time-stamps from " << tidx << "\n";
+      return;
+    }
+  
+  const int ttsize = 2 * globals::edf_timetrack_size;  
 
-  // to handle floating point issues -- enforce that the last few digits of an EDF+ specified time-point should be zeros
-  uint64_t div10 = tp % 10LLU ; 
+  const uint64_t tt_offset = header.time_track_offset();
 
-  if ( div10 != 0 )
+  std::map<int,uint64_t>::iterator hint = cached_EDF_timepoints.begin();
+
+  bool scanned = false;
+  
+  if ( mapped )
     {
-      // round down, or up
-      if ( div10 < 5 ) tp -= div10 ;
-      else tp += 10LLU - div10;
+      // straight walk of the mapping; any record whose time-track
+      // would run past the end is left for timepoint_from_EDF()
+      for (int r=0; r<nr; r++)
+	{
+	  const uint64_t offset = header_size + (uint64_t)record_size * r + tt_offset;
+	  if ( offset + ttsize > mapped_size ) break;
+	  hint = cached_EDF_timepoints.insert( hint , std::make_pair( r , tal_timepoint( mapped + offset , ttsize ) ) );
+	}
+      scanned = true;
     }
+  else if ( record_size > 4096 )
+    {
+      // read only each record's time-track, i.e. not whole records; a
+      // short read (e.g. a truncated file) drops to the scan below
+      std::vector<byte_t> p( ttsize );
+
+      scanned = true;
+      
+      for (int r=0; r<nr; r++)
+	{
+	  const uint64_t offset = header_size + (uint64_t)record_size * r + tt_offset;
+#ifndef WINDOWS
+	  const int64_t rdsz = pread( fileno( file ) , p.data() , ttsize , offset );
+#else
+	  fseek( file , offset , SEEK_SET );
+	  const int64_t rdsz = fread( p.data() , 1 , ttsize , file );
+#endif
+	  if ( rdsz != ttsize ) 
+	    {
+	      scanned = false;
+	      break;
+	    }
+	  hint = cached_EDF_timepoints.insert( hint , std::make_pair( r , tal_timepoint( p.data() , ttsize ) ) );
+	}
+
+#ifdef WINDOWS
+      // the coalesced-read window (if any) no longer matches the file position
+      reset_read_window();
+#endif
+    }
+
+  if ( ! scanned )
+    {
+      // small records: the gaps between time-tracks are no more than
+      // a block or so, so read runs of whole records (up to read-chunk
+      // MB, and at least one), with a ttsize tail so the last record's
+      // time-track is always in the buffer (zero-padded past the end
+      // of file); records not read in full are left for
+      // timepoint_from_EDF()
+      
+      const uint64_t chunk = ( globals::edf_read_chunk > 0 ? globals::edf_read_chunk : 1 ) * 1024LLU * 1024LLU ;
+      const int n_per_read = record_size > 0 && chunk > record_size ? chunk / record_size : 1 ; 
+      
+      std::vector<byte_t> buf;
+      
+      int r = 0;
+      
+      while ( r < nr )
+	{
+	  const int n = r + n_per_read > nr ? nr - r : n_per_read ;
+	  const uint64_t len = (uint64_t)record_size * n + ttsize ;
+	  buf.assign( len , 0 );
+	  
+	  fseek( file , header_size + (uint64_t)record_size * r , SEEK_SET );
+	  const uint64_t rdsz = fread( buf.data() , 1 , len , file );
+	  
+	  for (int i=0; i<n; i++)
+	    {
+	      if ( (uint64_t)record_size * ( i + 1 ) > rdsz ) break;
+	      hint = cached_EDF_timepoints.insert( hint , std::make_pair( r + i , tal_timepoint( buf.data() + (uint64_t)record_size * i + tt_offset , ttsize ) ) );
+	    }
+	  
+	  r += n;
+	}
+
+      // the coalesced-read window (if any) no longer matches the file position
+      reset_read_window();
+    }
+
+  if ( globals::edf_tindex )
+    write_tindex( tidx , fsize );
   
-  // cache in case recalled 
-  cached_EDF_timepoints[ r ] = tp;
+}
+
+
+//
+// .tidx sidecar: "LUNATIDX2", then (uint64) file size, (int64) file
+// modification time, (int32) header size, (int32) record size, (int32)
+// number of records, then one uint64 time-point per record
+//
+
+// modification time of a file (seconds), or 0 if not known
+static int64_t file_mtime( const std::string & f )
+{
+  struct stat st;
+  return stat( f.c_str() , &st ) == 0 ? (int64_t)st.st_mtime : 0 ;
+}
+
+bool edf_t::read_tindex( const std::string & f , const uint64_t fsize )
+{
+  
+  if ( ! Helper::fileExists( f ) ) return false;
+
+  std::ifstream IN1( f.c_str() , std::ios::binary | std::ios::in );
+  
+  const std::string magic = "LUNATIDX2";
+  std::string m( magic.size() , ' ' );
+  IN1.read( &m[0] , magic.size() );
+  
+  uint64_t fs = 0;
+  int64_t mt = 0;
+  int32_t hs = 0 , rs = 0 , n = 0;
+  IN1.read( (char*)&fs , sizeof(uint64_t) );
+  IN1.read( (char*)&mt , sizeof(int64_t) );
+  IN1.read( (char*)&hs , sizeof(int32_t) );
+  IN1.read( (char*)&rs , sizeof(int32_t) );
+  IN1.read( (char*)&n , sizeof(int32_t) );
+  
+  // i.e. an EDF re-written in place (same size) since the .tidx was made
+  if ( ! IN1 || m != magic || fs != fsize || mt != file_mtime( filename ) 
+       || hs != header_size || rs != record_size || n != header.nr_all || n == 0 ) 
+    return false;
+  
+  std::vector<uint64_t> tp( n );
+  IN1.read( (char*)tp.data() , sizeof(uint64_t) * (uint64_t)n );
+  if ( ! IN1 ) return false;
+  IN1.close();
+  
+  // cheap check against the EDF itself: the time-stamps of (up to) 16
+  // evenly spaced records, incl. the first and last, must match
+  const int nchk = n < 16 ? n : 16;
+  for (int k=0; k<nchk; k++)
+    {
+      const int r = nchk == 1 ? 0 : (int)( (uint64_t)( n - 1 ) * k / ( nchk - 1 ) );
+      cached_EDF_timepoints.erase( r );
+      if ( timepoint_from_EDF( r ) != tp[ r ] ) 
+	{
+	  cached_EDF_timepoints.clear();
+	  return false;
+	}
+    }
+  
+  std::map<int,uint64_t>::iterator hint = cached_EDF_timepoints.begin();
+  for (int r=0; r<n; r++)
+    hint = cached_EDF_timepoints.insert( hint , std::make_pair( r , tp[r] ) );
+  
+  return true;
+}
+
 
-  return tp; 
+void edf_t::write_tindex( const std::string & f , const uint64_t fsize ) const
+{
+
+  const int32_t n = header.nr_all;
+  
+  // only if every record was scanned
+  if ( cached_EDF_timepoints.size() != n ) return;
+  
+  std::ofstream O1( f.c_str() , std::ios::binary | std::ios::out );
+  
+  if ( ! O1 ) 
+    {
+      logger << "  ** could not write " << f << "\n";
+      return;
+    }
   
+  const std::string magic = "LUNATIDX2";
+  const int64_t mt = file_mtime( filename );
+  const int32_t hs = header_size , rs = record_size ;
+  O1.write( magic.c_str() , magic.size() );
+  O1.write( (const char*)&fsize , sizeof(uint64_t) );
+  O1.write( (const char*)&mt , sizeof(int64_t) );
+  O1.write( (const char*)&hs , sizeof(int32_t) );
+  O1.write( (const char*)&rs , sizeof(int32_t) );
+  O1.write( (const char*)&n , sizeof(int32_t) );
+  
+  std::map<int,uint64_t>::const_iterator tt = cached_EDF_timepoints.begin();
+  while ( tt != cached_EDF_timepoints.end() )
+    {
+      O1.write( (const char*)&(tt->second) , sizeof(uint64_t) );
+      ++tt;
+    }
+  O1.close();
+
+  logger << "  wrote EDF+D record time-stamps to " << f << "\n";
 }
   
 void edf_t::flip( const int s )
@@ -6099,22 +7535,37 @@ bool edf_t::basic_stats( param_t & param )
       //
       
       interval_t interval = timeline.wholetrace();
+
+      // minimal, i.e. only the mean: read one record at a time, rather
+      // than copying the whole signal
       
-      slice_t slice( *this , signals(s) , interval );
-	  
-      const std::vector<double> * d = slice.pdata();
-      
-      const int n = d->size();
+      if ( minimal )
+	{
+	  signal_view_t view( *this , signals(s) , interval );
 
-      if ( n == 0 ) { continue; } 
- 
-      double mean = MiscMath::mean( *d );
-      //double median = calc_median ? MiscMath::median( *d ) : 0 ;
+	  if ( view.empty() ) { continue; }
 
-      writer.value( "MEAN" , mean );
-      
-      if ( ! minimal )
+	  double sum = 0;
+	  for ( signal_view_t::record_iterator rr = view.by_record() ; rr.more() ; rr.next() )
+	    for (int j=0; j<rr.size(); j++) sum += rr[j];
+	  
+	  writer.value( "MEAN" , sum / (double)view.size() );
+	}
+      else
 	{
+	  slice_t slice( *this , signals(s) , interval );
+	  
+	  const std::vector<double> * d = slice.pdata();
+	  
+	  const int n = d->size();
+	  
+	  if ( n == 0 ) { continue; } 
+	  
+	  double mean = MiscMath::mean( *d );
+	  //double median = calc_median ? MiscMath::median( *d ) : 0 ;
+	  
+	  writer.value( "MEAN" , mean );
+	  
 	  double rms  = MiscMath::rms( *d );
 	  double sd = MiscMath::sdev( *d );
 	  double skew = MiscMath::skewness( *d , mean , sd );
@@ -6210,9 +7661,11 @@ bool edf_t::basic_stats( param_t & param )
       if ( hist )
 	{
 	  
+	  signal_view_t view( *this , signals(s) , interval );
+	  
 	  std::map<double,int> counts;
-	  for (int i = 0 ; i < n ; i++ )
-	    counts[ (*d)[i] ]++;
+	  for ( signal_view_t::record_iterator rr = view.by_record() ; rr.more() ; rr.next() )
+	    for (int j=0; j<rr.size(); j++) counts[ rr[j] ]++;
 	  
 	  writer.value( "OBS_ENCODING" , (int)counts.size() );
 	  
@@ -6663,10 +8116,11 @@ void edf_t::set_headers( param_t & param )
 
 void edf_t::update_edf_pointers( edf_t * p )
 {
-  for (int r = 0 ; r < header.nr_all; r++)
+  std::map<int,edf_record_t>::iterator rr = records.begin();
+  while ( rr != records.end() )
     {
-      bool found = records.find(r) != records.end();
-      records.find(r)->second.edf = p; 
+      rr->second.edf = p;
+      ++rr;
     }
 }
 
@@ -6799,16 +8253,24 @@ bool edf_t::stream_read()
   // EDF timepoints too
 
   
-  // allocate buffer for a single record  
-  byte_t * p = new byte_t[ record_size ];
+  // if memory-mapped, walk the mapped file directly; otherwise
+  // allocate buffer for a single record
+  const bool use_map = mapped != NULL && edfz2 == NULL;
+  
+  byte_t * p0 = use_map ? NULL : new byte_t[ record_size ]; // for 'free' after reading all
 
-  byte_t * p0 = p; // for 'free' after reading all
+  const byte_t * p = p0;
 
   
   // expecting an EDF+D timestamps? (first annot of first EDF Annotations channel)
   const bool edfd = header.edfplus && ! header.continuous;
   
   int ttsize = edfd ? 2 * globals::edf_timetrack_size : 0 ; 
+
+  // decode into the channel store rather than records[]?
+  const bool use_store = chstore.matches( record_widths() );
+
+  std::vector<int16_t*> dst( header.ns );
   
   
   // read every record
@@ -6818,20 +8280,39 @@ bool edf_t::stream_read()
       // only needed for EDF+
       bool got_time = edfd ? false : true; 
       
-      edf_record_t record( this ); 
+      // add record (unless using the channel store), and set where
+      // each signal will be decoded to
+      std::map<int,edf_record_t>::iterator rr = use_store ? records.end() :
+	records.insert( std::map<int,edf_record_t>::value_type( r , edf_record_t( this ) ) ).first;
       
-      // point to the start of the buffer
-      p = p0;
+      for (int s=0; s<header.ns; s++)
+	dst[s] = use_store ? chstore.wptr( s , r ) : rr->second.data[s].data();
+      
+      if ( use_map )
+	{
+	  // point to this record in the mapped file
+	  const uint64_t offset = header_size + (uint64_t)(record_size) * r;
+
+	  if ( offset + record_size > mapped_size ) 
+	    Helper::halt( "problem preloading EDF - truncated file" );
+
+	  p = mapped + offset;
+	}
+      else
+	{
+	  // point to the start of the buffer
+	  p = p0;
       
-      // read record into buffer (either from unindexed EDFZ or EDF)     
-      size_t rdsz = edfz2 != NULL ?
-	edfz2->read( p , record_size ) :
-	fread( p , 1, record_size , file ) ;
+	  // read record into buffer (either from unindexed EDFZ or EDF)     
+	  size_t rdsz = edfz2 != NULL ?
+	    edfz2->read( p0 , record_size ) :
+	    fread( p0 , 1, record_size , file ) ;
       	      
-      //std::cout << " read " << r << " / " << header.nr_all << " --> " << rdsz << "\n";
+	  //std::cout << " read " << r << " / " << header.nr_all << " --> " << rdsz << "\n";
       
-      if ( rdsz != record_size ) Helper::halt( "problem preloading EDF - truncated file\n"
-					       "for details, gunzip and then reload w/out preload=T" );
+	  if ( rdsz != record_size ) Helper::halt( "problem preloading EDF - truncated file\n"
+						   "for details, gunzip and then reload w/out preload=T" );
+	}
       
       // which signals/channels do we actually want to read?
       // header : 0..(ns-1)
@@ -6879,7 +8360,7 @@ bool edf_t::stream_read()
 		{
 		  int16_t d = edf_record_t::tc2dec( *p ,  *(p+1)  ); 
 		  p += 2;
-		  record.data[s][j] = d;	      
+		  dst[s][j] = d;	      
 		}
 	    }
 	  else // read as a ANNOTATION
@@ -6888,7 +8369,7 @@ bool edf_t::stream_read()
 	      // expecing a TAL EDF+D timestamp?
 	      if ( edfd && ! got_time ) 
 		{
-		  byte_t * pt = p;
+		  const byte_t * pt = p;
 		  
 		  // extract tt
 		  std::string tt( ttsize , '\x00' );
@@ -6939,7 +8420,7 @@ bool edf_t::stream_read()
 	      
 	      for (int j=0; j < 2 * nsamples; j++)
 		{
-		  record.data[s][j] = *p;
+		  dst[s][j] = *p;
 		  p++;		  
 		}	  
 	      
@@ -6952,10 +8433,11 @@ bool edf_t::stream_read()
      
 
       //
-      // Add record
+      // Mark record as loaded, if using the channel store
       //      
       
-      records.insert( std::map<int,edf_record_t>::value_type( r , record ) );
+      if ( use_store )
+	chstore.set_loaded( r );
       
       
       //
@@ -6966,8 +8448,9 @@ bool edf_t::stream_read()
   //
   // Clean up
   //
-  
-  delete [] p0;
+
+  if ( p0 != NULL ) 
+    delete [] p0;
   
   return true;
 
@@ -28,12 +28,17 @@
 #include "tal.h"
 #include "edfz/edfz.h"
 #include "edfz/edfz2.h"
+#include "edfz/edfx.h"
 #include "edf/signal-list.h"
+#include "edf/chstore.h"
+#include "edf/recdata.h"
+#include "edf/reccache.h"
 
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <stdint.h>
 
@@ -45,6 +50,8 @@ struct edf_t;
 
 struct cansigs_t;
 
+struct sample_run_t;
+
 struct edf_header_t
 {
   
@@ -97,7 +104,7 @@ struct edf_header_t
   //
 
   std::vector<std::string> label;           // e.g. actual (case-sensitive) label EEG or BodyTemp
-  std::map<std::string,int> label_all;      // still need to track orig. for read() records ; use UPPER
+  std::unordered_map<std::string,int> label_all;      // still need to track orig. for read() records ; use UPPER
 
   std::vector<std::string> transducer_type; // e.g. AgAgCl electrode
   
@@ -129,9 +136,19 @@ struct edf_header_t
   std::vector<double>      offset;
 
   // signal label --> edf_header_t slot 
-  // i.e. may include annotations
+  // i.e. may include annotations; keys are UPPERCASE (hashed)
+
+  std::unordered_map<std::string,int> label2header;
+
+  // parsed signal_list() results, keyed on the spec string: call
+  // labels_changed() whenever label[], label2header or the annotation
+  // channel flags are altered
 
-  std::map<std::string,int> label2header;
+  std::unordered_map<std::string,signal_list_t> slist_cache;
+
+  std::vector<uint64_t> slist_cache_state;
+
+  void labels_changed() { slist_cache.clear(); slist_cache_state.clear(); }
   
   // EDF+ -- annotation versus data channel
   std::vector<bool>        annotation_channel;
@@ -165,6 +182,7 @@ struct edf_header_t
     label.clear();
     label_all.clear();
     label2header.clear();    
+    labels_changed();
     transducer_type.clear(); 
     phys_dimension.clear(); 
     physical_min.clear();
@@ -186,7 +204,7 @@ struct edf_header_t
 
   std::string summary() const;
 
-  std::set<int> read( FILE * file, edfz_t * edfz , edfz2_t * edfz2 , const std::set<std::string> * inp_signals );
+  std::set<int> read( FILE * file, edfz_t * edfz , edfz2_t * edfz2 , edfx_t * edfx , const std::set<std::string> * inp_signals );
   
   bool write( FILE * file , const std::vector<int> & ch2slot );
   
@@ -203,6 +221,10 @@ struct edf_header_t
   int  original_signal_no_aliasing( const std::string & s );
 
   signal_list_t signal_list( const std::string & s , bool no_annotation_channels = false , bool show_warnings = true );
+
+  signal_list_t parse_signal_list( const std::string & s , bool no_annotation_channels );
+
+  std::vector<uint64_t> signal_list_state() const;
   
   void signal_alias( const std::string & s );
 
@@ -274,15 +296,15 @@ struct edf_record_t
   bool read( int r ); 
 
   // for writing, split out into two separate functions (no particular reason for the differences...)
-  bool write( FILE * file , const std::vector<int> & ch2slot );
+  bool write( FILE * file , const std::vector<int> & ch2slot ) const;
   
-  bool write( edfz_t * , const std::vector<int> & ch2slot );
+  bool write( edfz_t * , const std::vector<int> & ch2slot ) const;
 
-  bool write( edfz2_t * , const std::vector<int> & ch2slot );
+  bool write( edfz2_t * , const std::vector<int> & ch2slot ) const;
   
   void add_data( const std::vector<int16_t> & );
   
-  std::vector<double> get_pdata( const int signal );
+  std::vector<double> get_pdata( const int signal ) const;
   
   // here we know which slot to add to
   void add_annot( const std::string & , int signal );
@@ -304,7 +326,8 @@ private:
   
   edf_t * edf;
   
-  std::vector<std::vector<int16_t> >    data;
+  // shared copy-on-write between copies of a record (see recdata.h)
+  record_data_t                         data;
     
  public:
 
@@ -360,6 +383,18 @@ public:
   
   std::map<int,edf_record_t> records;
 
+  chstore_t                  chstore;       // optional channel-major store (channel-store=T)
+
+  // optional float32 store for new/modified signals (precision=float):
+  // per header slot, either empty or nr_all x n_samples[s] values,
+  // indexed by record; when present, this is authoritative, and the
+  // int16 samples in records[] are only re-encoded when needed
+  // (sync_float_store(), e.g. at WRITE), as flagged by fstale[];
+  // buffers are shared by copies of an edf_t (FREEZE) until modified
+  std::vector<std::shared_ptr<std::vector<float> > > fstore;
+
+  std::vector<bool>          fstale;
+
   std::set<int>              inp_signals_n; // read these signals
   
   int                        record_size;   // bytes per record (for ns_all signals)
@@ -388,6 +423,10 @@ public:
   
   std::map<int,uint64_t> cached_EDF_timepoints;
 
+  // EDF+D: get all record time-stamps in one sequential pass (or from
+  // a .tidx sidecar if tindex=T), filling cached_EDF_timepoints
+  void scan_EDF_timepoints();
+
   
   //
   // Stream read
@@ -418,6 +457,11 @@ public:
     return edfz2;
   }
 
+  edfx_t * edfx_ptr() const
+  {
+    return edfx;
+  }
+
   
   //
   // Annotations
@@ -436,10 +480,26 @@ public:
   int records_loaded() const { return records.size(); } 
 
   
-  // has this record already been loaded?
+  // has this record already been loaded? (nb. into records[]; records
+  // only decoded into the channel store do not count here, but
+  // edf_record_t::read() will pull from the store rather than the file)
 
   bool loaded( const int r ) const { return records.find(r) != records.end(); } 
 
+  // read-only access: as read_records(), but if the channel store is
+  // active, decode into that rather than into records[]
+  
+  bool cache_records( int r , int r2 );
+
+  // bytes of EDF record data actually read (or, if memory-mapped,
+  // accessed) since attaching, versus the size of the whole records
+  uint64_t bytes_read() const { return nbytes_read; }
+  uint64_t bytes_record() const { return nbytes_record; }
+
+  // per-record int16 slots for each signal (i.e. as edf_record_t::data)
+
+  std::vector<int> record_widths() const;
+
   // load if not loaded
   void ensure_loaded( const int rec )
   {
@@ -449,9 +509,16 @@ public:
 	edf_record_t record( this ); 
 	record.read( rec );
 	records.insert( std::map<int,edf_record_t>::value_type( rec , record ) );	      
+	touch_record( rec );
       }
   }
 
+  // record cache (mem-limit=): note use of a loaded record, or that
+  // it has been modified (and so cannot be evicted and re-read)
+  void touch_record( const int r ) { if ( rcache_ok ) rcache.touch( r ); }
+
+  void pin_record( const int r ) { if ( rcache_ok ) rcache.pin( r ); }
+
   
   std::vector<double> fixedrate_signal( uint64_t start , 
 					uint64_t stop , 
@@ -461,6 +528,49 @@ public:
 					std::vector<int> * rec ,
 					std::vector<int> * smp , 
 					std::vector<int16_t> * ddata );
+
+  // as fixedrate_signal() (no downsampling), but rather than copying,
+  // give pointers to the loaded int16 samples, as runs of consecutive
+  // samples (see sample_run_t, slice.h); used by signal_view_t
+  
+  bool sample_runs( uint64_t start , 
+		    uint64_t stop , 
+		    const int signal , 
+		    std::vector<sample_run_t> * runs );
+
+  // int16 samples of one loaded (i.e. cached) record for one signal,
+  // from records[] or else the channel store
+  const int16_t * record_samples( const int r , const int signal ) const;
+
+  // float32-backed signals (precision=float)
+  bool has_float_store( const int s ) const
+  { return s >= 0 && s < (int)fstore.size() && fstore[s] && ! fstore[s]->empty(); }
+
+  // int16 samples not yet re-encoded from the float store (i.e. a
+  // reader of the int16 form must call sync_float_store() first)
+  bool float_store_stale( const int s ) const
+  { return has_float_store( s ) && fstale[s]; }
+  
+  // samples of record r, or NULL if not float-backed
+  const float * float_samples( const int r , const int s ) const
+  { return has_float_store( s ) ? fstore[s]->data() + (uint64_t)r * header.n_samples[s] : NULL ; }
+
+  // (re)populate from whole-signal physical values, clamped to [lwr,upr]
+  void set_float_store( const int s , const std::vector<double> & d , const double lwr , const double upr );
+
+  // bring the int16 samples of one (or all) float-backed signals up to date
+  void sync_float_store( const int s );
+
+  void sync_float_store();
+
+  // as above, then drop all float stores (i.e. before the record
+  // structure is changed)
+  void flush_float_store();
+
+  // hold off record-cache eviction (e.g. while a view is alive)
+  void hold_records() { ++rcache_hold; }
+
+  void release_records() { if ( rcache_hold > 0 ) --rcache_hold; }
   
   
   tal_t tal( const int signal , const int rec );
@@ -607,6 +717,118 @@ private:
   //
 
   edfz2_t * edfz2;
+
+
+  //
+  // Channel-major chunked container (.edfx): random access by
+  // channel and record
+  //
+
+  edfx_t * edfx;
+
+
+  //
+  // Optional read-only memory map of a standard EDF (mmap=T); when
+  // set, records are decoded directly from the mapped region
+  //
+
+  const byte_t * mapped;
+
+  uint64_t mapped_size;
+
+  bool map_file();
+
+  void unmap_file();
+
+
+  //
+  // Raw record access: pointer to the bytes of record r (either into
+  // the mapped file, or read into record_buffer), and decode those
+  // bytes for the selected signals into per-signal destinations
+  //
+
+  std::vector<byte_t> record_buffer;
+  
+  const byte_t * record_bytes( const int r );
+
+  //
+  // Coalesced reads (plain EDF, not mapped): record_buffer holds a
+  // window of consecutive records [rbuf_r1,rbuf_r2], filled by a
+  // single fread(); read_records() sets read_run_r2 to the end of the
+  // range it is walking, so that a run of retained, not-yet-loaded
+  // records up to there (and up to read-chunk MB) is read at once
+  //
+
+  int rbuf_r1 , rbuf_r2;
+
+  int read_run_r2;
+
+  void reset_read_window() { rbuf_r1 = rbuf_r2 = read_run_r2 = -1; }
+
+  int read_run_length( const int r );
+
+  // Buffered WRITE (write-buffer=N MB): records are assembled into a
+  // large output buffer; loaded records are encoded from memory, while
+  // records never loaded (i.e. exactly as on disk) have the selected
+  // channels' bytes copied straight from the input file
+  
+  std::vector<int> passthrough_offsets() const;
+
+  bool assemble_record( const int r , const std::vector<int> & ch2slot , const std::vector<int> & src , byte_t * p );
+
+  bool write_records( FILE * outfile , const std::vector<int> & ch2slot );
+
+  // as above, but K records at a time into a channel-major .edfx
+  bool write_records( edfx_t * edfx , const std::vector<int> & ch2slot );
+
+  // EDF+D record time-stamp sidecar (tindex=T)
+  bool read_tindex( const std::string & f , const uint64_t fsize );
+
+  void write_tindex( const std::string & f , const uint64_t fsize ) const;
+
+  void readahead( const int r , const int n );
+
+  //
+  // Selective reads (selective-read=T): only the byte spans of the
+  // signals in inp_signals_n are read from each record (adjacent
+  // signals merged into one span; offsets are within the record);
+  // these land at their usual place in record_buffer, so that
+  // decode_record() is unchanged
+  //
+
+  std::vector<std::pair<int,int> > read_spans;
+
+  // the signal set that read_spans was built for
+  std::set<int> read_spans_sigs;
+
+  bool read_spans_set;
+
+  bool set_read_spans();
+
+  int read_selected( const int r , const int n , byte_t * p );
+
+  uint64_t nbytes_read , nbytes_record;
+
+
+  //
+  // Memory-budgeted record cache (mem-limit=): only used while every
+  // unpinned record in records[] could be re-read from the file as-is,
+  // i.e. rcache_ok is cleared by adding signals, RESTRUCTURE etc;
+  // eviction is held off (rcache_hold) where a caller needs a set of
+  // records to stay put
+  //
+
+  record_cache_t rcache;
+
+  bool rcache_ok;
+
+  int rcache_hold;
+
+  void evict_records( const int r1 , const int r2 );
+
+  void disable_record_cache() { rcache.clear(); rcache_ok = false; }
+
+  void decode_record( const byte_t * p , int16_t ** dst ) const;
   
   
   //
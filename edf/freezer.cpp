@@ -59,7 +59,9 @@ void freezer_t::edf2edf( const edf_t & from , edf_t & to , bool preserve_cache )
   // std::cout << " from annots N = " << from.annotations->names().size() << "\n";
   // std::cout << " to annots N = " << to.annotations->names().size() << "\n\n";
  
-  // primary shallow copy
+  // primary shallow copy: record samples, the channel store and any
+  // float store are shared (copy-on-write) rather than duplicated, so
+  // this is cheap; see recdata.h
   to = from;
   
   // swap original cache back in
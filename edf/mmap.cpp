@@ -0,0 +1,94 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "edf.h"
+#include "helper/helper.h"
+#include "helper/logger.h"
+
+#ifndef WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+extern logger_t logger;
+
+
+//
+// Memory-mapped reads for standard (uncompressed) EDF/EDF+: the whole
+// file is mapped read-only, and edf_record_t::read() then decodes
+// samples straight from the mapped pages, i.e. no per-record fseek(),
+// fread() or temporary buffer.  If the map cannot be made (or on
+// Windows), we quietly stay with the stdio path.
+//
+
+bool edf_t::map_file()
+{
+
+  unmap_file();
+
+#ifdef WINDOWS
+  return false;
+#else
+
+  // only for plain EDF
+  if ( file == NULL ) return false;
+
+  int fd = open( filename.c_str() , O_RDONLY );
+  if ( fd == -1 ) return false;
+
+  struct stat st;
+  if ( fstat( fd , &st ) != 0 || st.st_size == 0 )
+    {
+      close( fd );
+      return false;
+    }
+
+  void * m = mmap( NULL , st.st_size , PROT_READ , MAP_PRIVATE , fd , 0 );
+
+  // the mapping stays valid after the descriptor is closed
+  close( fd );
+
+  if ( m == MAP_FAILED )
+    {
+      logger << "  could not memory-map " << filename << ", using standard reads\n";
+      return false;
+    }
+
+  mapped = (const byte_t*)m;
+  mapped_size = st.st_size;
+
+  return true;
+#endif
+}
+
+
+void edf_t::unmap_file()
+{
+#ifndef WINDOWS
+  if ( mapped != NULL )
+    munmap( (void*)mapped , mapped_size );
+#endif
+  mapped = NULL;
+  mapped_size = 0;
+}
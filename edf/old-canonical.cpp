@@ -836,6 +836,8 @@ cansigs_t edf_t::make_canonicals( const std::vector<std::string> & files,
 	      header.label[ canonical_signal(0) ] = canon;
 
 	      header.label2header[ canon ] = canonical_signal(0) ;
+
+	      header.labels_changed();
 	    }
 	  
 	  //
@@ -0,0 +1,74 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "edf/reccache.h"
+
+void record_cache_t::clear()
+{
+  clock = 0;
+  warned = false;
+  last_use.clear();
+  by_use.clear();
+  pins.clear();
+}
+
+void record_cache_t::touch( const int r )
+{
+  if ( pinned( r ) ) return;
+  
+  std::map<int,uint64_t>::iterator ii = last_use.find( r );
+  if ( ii != last_use.end() )
+    {
+      by_use.erase( ii->second );
+      ii->second = ++clock;
+    }
+  else
+    last_use[ r ] = ++clock;
+
+  by_use[ clock ] = r;
+}
+
+void record_cache_t::forget( const int r )
+{
+  std::map<int,uint64_t>::iterator ii = last_use.find( r );
+  if ( ii == last_use.end() ) return;
+  by_use.erase( ii->second );
+  last_use.erase( ii );
+}
+
+void record_cache_t::pin( const int r )
+{
+  forget( r );
+  pins.insert( r );
+}
+
+int record_cache_t::oldest( const int r1 , const int r2 ) const
+{
+  std::map<uint64_t,int>::const_iterator ii = by_use.begin();
+  while ( ii != by_use.end() )
+    {
+      if ( ii->second < r1 || ii->second > r2 )
+	return ii->second;
+      ++ii;
+    }
+  return -1;
+}
@@ -0,0 +1,80 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_RECCACHE_H__
+#define __LUNA_RECCACHE_H__
+
+#include <map>
+#include <set>
+#include <stdint.h>
+
+//
+// Bookkeeping for the memory-budgeted record cache (mem-limit=)
+//
+//  Tracks, for records in edf_t::records that could be re-read from
+//  the file, when each was last used; edf_t::evict_records() then
+//  drops the least recently used ones when over budget.  Records that
+//  have been modified (update_signal() etc) are pinned, i.e. never
+//  evicted.
+//
+
+struct record_cache_t
+{
+
+  record_cache_t() { clear(); }
+
+  void clear();
+
+  // note a (re)use of record r
+  void touch( const int r );
+
+  // r is no longer in records[]
+  void forget( const int r );
+
+  // r has been modified: never evict
+  void pin( const int r );
+
+  bool pinned( const int r ) const { return pins.find( r ) != pins.end(); }
+
+  int size() const { return last_use.size(); }
+
+  int n_pinned() const { return pins.size(); }
+
+  // whether the user has been told that pins keep us over budget
+  bool warned;
+
+  // least recently used (unpinned) record, outside [r1,r2]; -1 if none
+  int oldest( const int r1 , const int r2 ) const;
+
+ private:
+
+  uint64_t clock;
+
+  std::map<int,uint64_t> last_use;
+
+  std::map<uint64_t,int> by_use;
+
+  std::set<int> pins;
+
+};
+
+#endif
@@ -0,0 +1,79 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_RECDATA_H__
+#define __LUNA_RECDATA_H__
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+//
+// Per-record sample storage (edf_record_t::data), shared copy-on-write
+//
+//  Behaves as a std::vector<std::vector<int16_t> > (signal x samples),
+//  but each signal's samples are reference-counted: copying a record
+//  (e.g. copying an edf_t for FREEZE) only copies pointers, and a
+//  signal is duplicated the first time it is accessed through a
+//  non-const reference while still shared.  Read-only code should
+//  therefore go through a const edf_record_t (or const data).
+//
+
+struct record_data_t
+{
+
+  typedef std::vector<int16_t> channel_t;
+
+  size_t size() const { return ch.size(); }
+
+  const channel_t & operator[]( const size_t s ) const { return *ch[s]; }
+
+  channel_t & operator[]( const size_t s )
+  {
+    if ( ch[s].use_count() > 1 )
+      ch[s] = std::make_shared<channel_t>( *ch[s] );
+    return *ch[s];
+  }
+
+  void resize( const size_t n )
+  {
+    const size_t n0 = ch.size();
+    ch.resize( n );
+    for (size_t s=n0; s<n; s++)
+      ch[s] = std::make_shared<channel_t>();
+  }
+
+  void push_back( const channel_t & x ) { ch.push_back( std::make_shared<channel_t>( x ) ); }
+
+  void erase( const size_t s ) { ch.erase( ch.begin() + s ); }
+
+  void clear() { ch.clear(); }
+
+  // is signal s currently shared with another copy?
+  bool shared( const size_t s ) const { return ch[s].use_count() > 1; }
+
+ private:
+
+  std::vector<std::shared_ptr<channel_t> > ch;
+
+};
+
+#endif
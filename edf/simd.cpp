@@ -0,0 +1,431 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "edf/simd.h"
+
+#include <cstring>
+
+#if ( defined(__x86_64__) || defined(__i386__) ) && ( defined(__GNUC__) || defined(__clang__) )
+#define LUNA_SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+//
+// Scalar kernels (any platform)
+//
+
+static bool host_little_endian()
+{
+  const uint16_t one = 1;
+  return *(const unsigned char*)&one == 1;
+}
+
+static void decode_int16_scalar( const unsigned char * p , int16_t * d , const int n )
+{
+  // EDF is little-endian: on a little-endian host this is a straight
+  // copy (which the C library will already vectorize)
+
+  if ( host_little_endian() )
+    {
+      memcpy( d , p , 2 * (size_t)n );
+      return;
+    }
+
+  for (int i=0; i<n; i++)
+    {
+      d[i] = (int16_t)( (uint16_t)p[0] | ( (uint16_t)p[1] << 8 ) );
+      p += 2;
+    }
+}
+
+static void encode_int16_scalar( const int16_t * d , unsigned char * p , const int n )
+{
+  if ( host_little_endian() )
+    {
+      memcpy( p , d , 2 * (size_t)n );
+      return;
+    }
+
+  for (int i=0; i<n; i++)
+    {
+      const uint16_t u = (uint16_t)d[i];
+      *p++ = (unsigned char)( u & 0xff );
+      *p++ = (unsigned char)( u >> 8 );
+    }
+}
+
+static void dig2phys_scalar( const int16_t * d , double * x , const int n , const double bv , const double offset )
+{
+  for (int i=0; i<n; i++)
+    x[i] = bv * ( offset + d[i] );
+}
+
+static void dig2physf_scalar( const int16_t * d , float * x , const int n , const double bv , const double offset )
+{
+  for (int i=0; i<n; i++)
+    x[i] = bv * ( offset + d[i] );
+}
+
+static void phys2dig_scalar( const double * x , int16_t * d , const int n , const double bv , const double offset ,
+			     const double lwr , const double upr )
+{
+  for (int i=0; i<n; i++)
+    {
+      double v = x[i];
+      if ( v < lwr ) v = lwr;
+      if ( v > upr ) v = upr;
+      d[i] = v / bv - offset;
+    }
+}
+
+static void minmax_scalar( const double * x , const int n , double * mn , double * mx )
+{
+  double a = x[0] , b = x[0];
+  for (int i=0; i<n; i++)
+    {
+      if      ( x[i] < a ) a = x[i];
+      else if ( x[i] > b ) b = x[i];
+    }
+  *mn = a;
+  *mx = b;
+}
+
+
+//
+// x86 kernels: eight samples per iteration; nb. no FMA, so that the
+// (add, then multiply) matches the scalar version exactly
+//
+// phys2dig: min/max with the bound as the first operand (i.e. NaNs
+// pass through, as the scalar compares); double --> int16 as the
+// compiler does it, i.e. truncate to int32 then keep the low 16 bits
+//
+
+#ifdef LUNA_SIMD_X86
+
+__attribute__((target("sse2")))
+static inline __m128i low16_sse2( const __m128i a , const __m128i b )
+{
+  // sign-extend the low 16 bits of each int32, then pack (exact, as
+  // now all in range)
+  return _mm_packs_epi32( _mm_srai_epi32( _mm_slli_epi32( a , 16 ) , 16 ) ,
+			  _mm_srai_epi32( _mm_slli_epi32( b , 16 ) , 16 ) );
+}
+
+__attribute__((target("sse2")))
+static void phys2dig_sse2( const double * x , int16_t * d , const int n , const double bv , const double offset ,
+			   const double lwr , const double upr )
+{
+  const __m128d vb = _mm_set1_pd( bv );
+  const __m128d vo = _mm_set1_pd( offset );
+  const __m128d vl = _mm_set1_pd( lwr );
+  const __m128d vu = _mm_set1_pd( upr );
+  int i = 0;
+  for ( ; i + 8 <= n ; i += 8 )
+    {
+      __m128i w[4];
+      for (int k=0; k<4; k++)
+	{
+	  __m128d v = _mm_loadu_pd( x + i + 2 * k );
+	  v = _mm_min_pd( vu , _mm_max_pd( vl , v ) );
+	  w[k] = _mm_cvttpd_epi32( _mm_sub_pd( _mm_div_pd( v , vb ) , vo ) );
+	}
+      const __m128i lo = _mm_unpacklo_epi64( w[0] , w[1] );
+      const __m128i hi = _mm_unpacklo_epi64( w[2] , w[3] );
+      _mm_storeu_si128( (__m128i*)( d + i ) , low16_sse2( lo , hi ) );
+    }
+  phys2dig_scalar( x + i , d + i , n - i , bv , offset , lwr , upr );
+}
+
+__attribute__((target("sse2")))
+static void minmax_sse2( const double * x , const int n , double * mn , double * mx )
+{
+  __m128d a = _mm_set1_pd( x[0] );
+  __m128d b = a;
+  int i = 0;
+  for ( ; i + 2 <= n ; i += 2 )
+    {
+      const __m128d v = _mm_loadu_pd( x + i );
+      a = _mm_min_pd( v , a );
+      b = _mm_max_pd( v , b );
+    }
+  double ta[2] , tb[2];
+  _mm_storeu_pd( ta , a );
+  _mm_storeu_pd( tb , b );
+  *mn = ta[0]; *mx = tb[0];
+  if ( ta[1] < *mn ) *mn = ta[1];
+  if ( tb[1] > *mx ) *mx = tb[1];
+  for ( ; i < n ; i++ )
+    {
+      if ( x[i] < *mn ) *mn = x[i];
+      if ( x[i] > *mx ) *mx = x[i];
+    }
+  // +0 / -0 ties: which is kept depends on order, so defer to the scalar scan
+  if ( *mn == 0 || *mx == 0 ) minmax_scalar( x , n , mn , mx );
+}
+
+__attribute__((target("sse2")))
+static void dig2phys_sse2( const int16_t * d , double * x , const int n , const double bv , const double offset )
+{
+  const __m128d vb = _mm_set1_pd( bv );
+  const __m128d vo = _mm_set1_pd( offset );
+  int i = 0;
+  for ( ; i + 8 <= n ; i += 8 )
+    {
+      const __m128i a  = _mm_loadu_si128( (const __m128i*)( d + i ) );
+      // sign-extend int16 --> int32
+      const __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( a , a ) , 16 );
+      const __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( a , a ) , 16 );
+      _mm_storeu_pd( x + i     , _mm_mul_pd( vb , _mm_add_pd( vo , _mm_cvtepi32_pd( lo ) ) ) );
+      _mm_storeu_pd( x + i + 2 , _mm_mul_pd( vb , _mm_add_pd( vo , _mm_cvtepi32_pd( _mm_shuffle_epi32( lo , 0x4E ) ) ) ) );
+      _mm_storeu_pd( x + i + 4 , _mm_mul_pd( vb , _mm_add_pd( vo , _mm_cvtepi32_pd( hi ) ) ) );
+      _mm_storeu_pd( x + i + 6 , _mm_mul_pd( vb , _mm_add_pd( vo , _mm_cvtepi32_pd( _mm_shuffle_epi32( hi , 0x4E ) ) ) ) );
+    }
+  for ( ; i < n ; i++ )
+    x[i] = bv * ( offset + d[i] );
+}
+
+__attribute__((target("sse2")))
+static void dig2physf_sse2( const int16_t * d , float * x , const int n , const double bv , const double offset )
+{
+  const __m128d vb = _mm_set1_pd( bv );
+  const __m128d vo = _mm_set1_pd( offset );
+  int i = 0;
+  for ( ; i + 8 <= n ; i += 8 )
+    {
+      const __m128i a  = _mm_loadu_si128( (const __m128i*)( d + i ) );
+      const __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( a , a ) , 16 );
+      const __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( a , a ) , 16 );
+      const __m128 f0 = _mm_cvtpd_ps( _mm_mul_pd( vb , _mm_add_pd( vo , _mm_cvtepi32_pd( lo ) ) ) );
+      const __m128 f1 = _mm_cvtpd_ps( _mm_mul_pd( vb , _mm_add_pd( vo , _mm_cvtepi32_pd( _mm_shuffle_epi32( lo , 0x4E ) ) ) ) );
+      const __m128 f2 = _mm_cvtpd_ps( _mm_mul_pd( vb , _mm_add_pd( vo , _mm_cvtepi32_pd( hi ) ) ) );
+      const __m128 f3 = _mm_cvtpd_ps( _mm_mul_pd( vb , _mm_add_pd( vo , _mm_cvtepi32_pd( _mm_shuffle_epi32( hi , 0x4E ) ) ) ) );
+      _mm_storeu_ps( x + i     , _mm_movelh_ps( f0 , f1 ) );
+      _mm_storeu_ps( x + i + 4 , _mm_movelh_ps( f2 , f3 ) );
+    }
+  for ( ; i < n ; i++ )
+    x[i] = bv * ( offset + d[i] );
+}
+
+__attribute__((target("avx2")))
+static void dig2phys_avx2( const int16_t * d , double * x , const int n , const double bv , const double offset )
+{
+  const __m256d vb = _mm256_set1_pd( bv );
+  const __m256d vo = _mm256_set1_pd( offset );
+  int i = 0;
+  for ( ; i + 8 <= n ; i += 8 )
+    {
+      const __m256i w = _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i*)( d + i ) ) );
+      const __m256d lo = _mm256_cvtepi32_pd( _mm256_castsi256_si128( w ) );
+      const __m256d hi = _mm256_cvtepi32_pd( _mm256_extracti128_si256( w , 1 ) );
+      _mm256_storeu_pd( x + i     , _mm256_mul_pd( vb , _mm256_add_pd( vo , lo ) ) );
+      _mm256_storeu_pd( x + i + 4 , _mm256_mul_pd( vb , _mm256_add_pd( vo , hi ) ) );
+    }
+  for ( ; i < n ; i++ )
+    x[i] = bv * ( offset + d[i] );
+}
+
+__attribute__((target("avx2")))
+static void dig2physf_avx2( const int16_t * d , float * x , const int n , const double bv , const double offset )
+{
+  const __m256d vb = _mm256_set1_pd( bv );
+  const __m256d vo = _mm256_set1_pd( offset );
+  int i = 0;
+  for ( ; i + 8 <= n ; i += 8 )
+    {
+      const __m256i w = _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i*)( d + i ) ) );
+      const __m256d lo = _mm256_cvtepi32_pd( _mm256_castsi256_si128( w ) );
+      const __m256d hi = _mm256_cvtepi32_pd( _mm256_extracti128_si256( w , 1 ) );
+      _mm_storeu_ps( x + i     , _mm256_cvtpd_ps( _mm256_mul_pd( vb , _mm256_add_pd( vo , lo ) ) ) );
+      _mm_storeu_ps( x + i + 4 , _mm256_cvtpd_ps( _mm256_mul_pd( vb , _mm256_add_pd( vo , hi ) ) ) );
+    }
+  for ( ; i < n ; i++ )
+    x[i] = bv * ( offset + d[i] );
+}
+
+__attribute__((target("avx2")))
+static void phys2dig_avx2( const double * x , int16_t * d , const int n , const double bv , const double offset ,
+			   const double lwr , const double upr )
+{
+  const __m256d vb = _mm256_set1_pd( bv );
+  const __m256d vo = _mm256_set1_pd( offset );
+  const __m256d vl = _mm256_set1_pd( lwr );
+  const __m256d vu = _mm256_set1_pd( upr );
+  int i = 0;
+  for ( ; i + 8 <= n ; i += 8 )
+    {
+      __m256d a = _mm256_loadu_pd( x + i );
+      __m256d b = _mm256_loadu_pd( x + i + 4 );
+      a = _mm256_min_pd( vu , _mm256_max_pd( vl , a ) );
+      b = _mm256_min_pd( vu , _mm256_max_pd( vl , b ) );
+      const __m128i ia = _mm256_cvttpd_epi32( _mm256_sub_pd( _mm256_div_pd( a , vb ) , vo ) );
+      const __m128i ib = _mm256_cvttpd_epi32( _mm256_sub_pd( _mm256_div_pd( b , vb ) , vo ) );
+      _mm_storeu_si128( (__m128i*)( d + i ) , low16_sse2( ia , ib ) );
+    }
+  phys2dig_scalar( x + i , d + i , n - i , bv , offset , lwr , upr );
+}
+
+__attribute__((target("avx2")))
+static void minmax_avx2( const double * x , const int n , double * mn , double * mx )
+{
+  __m256d a = _mm256_set1_pd( x[0] );
+  __m256d b = a;
+  int i = 0;
+  for ( ; i + 4 <= n ; i += 4 )
+    {
+      const __m256d v = _mm256_loadu_pd( x + i );
+      a = _mm256_min_pd( v , a );
+      b = _mm256_max_pd( v , b );
+    }
+  double ta[4] , tb[4];
+  _mm256_storeu_pd( ta , a );
+  _mm256_storeu_pd( tb , b );
+  *mn = ta[0]; *mx = tb[0];
+  for (int k=1; k<4; k++)
+    {
+      if ( ta[k] < *mn ) *mn = ta[k];
+      if ( tb[k] > *mx ) *mx = tb[k];
+    }
+  for ( ; i < n ; i++ )
+    {
+      if ( x[i] < *mn ) *mn = x[i];
+      if ( x[i] > *mx ) *mx = x[i];
+    }
+  if ( *mn == 0 || *mx == 0 ) minmax_scalar( x , n , mn , mx );
+}
+
+#endif
+
+
+//
+// Run-time dispatch
+//
+
+struct simd_kernels_t
+{
+  std::string name;
+  void (*decode)( const unsigned char * , int16_t * , const int );
+  void (*d2p)( const int16_t * , double * , const int , const double , const double );
+  void (*d2pf)( const int16_t * , float * , const int , const double , const double );
+  void (*p2d)( const double * , int16_t * , const int , const double , const double , const double , const double );
+  void (*mm)( const double * , const int , double * , double * );
+};
+
+static simd_kernels_t make_kernels( const std::string & k )
+{
+  simd_kernels_t s;
+  s.name   = "scalar";
+  s.decode = decode_int16_scalar;
+  s.d2p    = dig2phys_scalar;
+  s.d2pf   = dig2physf_scalar;
+  s.p2d    = phys2dig_scalar;
+  s.mm     = minmax_scalar;
+
+#ifdef LUNA_SIMD_X86
+  if ( k == "avx2" )
+    {
+      s.name = k;
+      s.d2p  = dig2phys_avx2;
+      s.d2pf = dig2physf_avx2;
+      s.p2d  = phys2dig_avx2;
+      s.mm   = minmax_avx2;
+    }
+  else if ( k == "sse2" )
+    {
+      s.name = k;
+      s.d2p  = dig2phys_sse2;
+      s.d2pf = dig2physf_sse2;
+      s.p2d  = phys2dig_sse2;
+      s.mm   = minmax_sse2;
+    }
+#endif
+
+  return s;
+}
+
+static simd_kernels_t & kernels()
+{
+  static simd_kernels_t k = make_kernels( edf_simd::available()[0] );
+  return k;
+}
+
+
+std::vector<std::string> edf_simd::available()
+{
+  std::vector<std::string> k;
+#ifdef LUNA_SIMD_X86
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) k.push_back( "avx2" );
+  if ( __builtin_cpu_supports( "sse2" ) ) k.push_back( "sse2" );
+#endif
+  k.push_back( "scalar" );
+  return k;
+}
+
+bool edf_simd::force( const std::string & k )
+{
+  std::vector<std::string> a = available();
+  for (int i=0; i<a.size(); i++)
+    if ( a[i] == k )
+      {
+	kernels() = make_kernels( k );
+	return true;
+      }
+  return false;
+}
+
+std::string edf_simd::kernel()
+{
+  return kernels().name;
+}
+
+void edf_simd::decode_int16( const unsigned char * p , int16_t * d , const int n )
+{
+  kernels().decode( p , d , n );
+}
+
+void edf_simd::encode_int16( const int16_t * d , unsigned char * p , const int n )
+{
+  // nb. a byte copy on little-endian hosts, so no per-kernel versions
+  encode_int16_scalar( d , p , n );
+}
+
+void edf_simd::dig2phys( const int16_t * d , double * x , const int n , const double bv , const double offset )
+{
+  kernels().d2p( d , x , n , bv , offset );
+}
+
+void edf_simd::dig2phys( const int16_t * d , float * x , const int n , const double bv , const double offset )
+{
+  kernels().d2pf( d , x , n , bv , offset );
+}
+
+void edf_simd::phys2dig( const double * x , int16_t * d , const int n , const double bv , const double offset ,
+			 const double lwr , const double upr )
+{
+  kernels().p2d( x , d , n , bv , offset , lwr , upr );
+}
+
+void edf_simd::minmax( const double * x , const int n , double * mn , double * mx )
+{
+  kernels().mm( x , n , mn , mx );
+}
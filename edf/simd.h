@@ -0,0 +1,76 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_EDF_SIMD_H__
+#define __LUNA_EDF_SIMD_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//
+// Bulk sample conversion kernels for EDF records
+//
+//  - decode_int16(): little-endian 2-byte EDF samples --> int16
+//  - encode_int16(): int16 --> little-endian 2-byte EDF samples
+//  - dig2phys()    : int16 --> physical units, x = bv * ( offset + d )
+//  - phys2dig()    : physical --> int16 (after clamping to [lwr,upr]),
+//                    d = x / bv - offset, as edf_record_t::phys2dig()
+//  - minmax()      : min/max of a double array (NaNs are skipped, as
+//                    with the scalar < / > comparisons)
+//
+//  On x86, AVX2 or SSE2 versions are picked at run time (first use),
+//  with a scalar fallback elsewhere.  All kernels evaluate exactly the
+//  same expression as edf_record_t::dig2phys() / phys2dig(), so results
+//  are bit-identical whichever is used.
+//
+
+namespace edf_simd
+{
+
+  void decode_int16( const unsigned char * p , int16_t * d , const int n );
+
+  void encode_int16( const int16_t * d , unsigned char * p , const int n );
+
+  void dig2phys( const int16_t * d , double * x , const int n , const double bv , const double offset );
+
+  void dig2phys( const int16_t * d , float * x , const int n , const double bv , const double offset );
+
+  void phys2dig( const double * x , int16_t * d , const int n , const double bv , const double offset ,
+		 const double lwr , const double upr );
+
+  // requires n > 0; both start from x[0]
+  void minmax( const double * x , const int n , double * mn , double * mx );
+
+  // which kernel set is in use: "avx2", "sse2" or "scalar"
+  std::string kernel();
+
+  // kernels usable on this machine (in order of preference)
+  std::vector<std::string> available();
+
+  // force a particular kernel set (e.g. for benchmarking); returns
+  // false (and leaves things unchanged) if not available
+  bool force( const std::string & k );
+
+}
+
+#endif
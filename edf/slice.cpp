@@ -30,8 +30,11 @@
 #include "fftw/fftwrap.h"
 #include "defs/defs.h"
 #include "edf.h"
+#include "simd.h"
 #include "intervals/intervals.h"
 
+#include <algorithm>
+
 
 
 //
@@ -118,6 +121,169 @@ slice_t::slice_t( edf_t & edf ,
  
 
 
+//
+// signal_view_t
+//
+
+signal_view_t::signal_view_t( edf_t & edf , 
+			      int signal ,
+			      const interval_t & interval )
+  : edf(edf) , signal(signal) , n(0) , last(0)
+{
+  
+  if ( signal < 0 || signal >= edf.header.ns ) 
+    Helper::halt( "problem in signal_view_t, bad signal requested: " 
+		  + Helper::int2str(signal) 
+		  + " of " + Helper::int2str( edf.header.ns ) );
+  
+  nspr = edf.header.n_samples[ signal ];
+  bv   = edf.header.bitvalue[ signal ];
+  os   = edf.header.offset[ signal ];
+  digital_values = globals::read_digital_values;
+
+  // digital values of float32-backed signals are taken from the int16 form
+  if ( digital_values )
+    edf.sync_float_store( signal );
+
+  edf.hold_records();
+  
+  if ( interval.empty() ) return;
+
+  edf.sample_runs( interval.start , interval.stop , signal , &sruns );
+
+  first.resize( sruns.size() );
+  for (int r=0; r<sruns.size(); r++)
+    {
+      first[r] = n;
+      n += sruns[r].n;
+    }
+}
+
+signal_view_t::~signal_view_t()
+{
+  edf.release_records();
+}
+
+int signal_view_t::locate( const int i , int * j ) const
+{
+  if ( i < 0 || i >= n ) 
+    Helper::halt( "signal_view_t: sample index out of range" );
+
+  // usually sequential: try the last run (or the next) first
+  if ( ! ( i >= first[last] && i < first[last] + sruns[last].n ) )
+    {
+      if ( last + 1 < sruns.size() && i >= first[last+1] && i < first[last+1] + sruns[last+1].n )
+	++last;
+      else
+	last = std::upper_bound( first.begin() , first.end() , i ) - first.begin() - 1;
+    }
+  
+  *j = i - first[last];
+  return last;
+}
+
+double signal_view_t::operator[]( const int i ) const
+{
+  int j;
+  const int r = locate( i , &j );
+  if ( ! digital_values )
+    {
+      // float store is indexed by record, so runs are contiguous there too
+      const float * f = edf.float_samples( sruns[r].rec , signal );
+      if ( f != NULL ) return f[ sruns[r].smp + j ];
+    }
+  const int16_t d = sruns[r].d[j];
+  return digital_values ? d : edf_record_t::dig2phys( d , bv , os );
+}
+
+int16_t signal_view_t::digital( const int i ) const
+{
+  int j;
+  const int r = locate( i , &j );
+  return sruns[r].d[j];
+}
+
+uint64_t signal_view_t::timepoint( const int i ) const
+{
+  int j;
+  const int r = locate( i , &j );
+  // runs may span consecutive records
+  const int k = sruns[r].smp + j;
+  return edf.timeline.timepoint( sruns[r].rec + k / nspr , k % nspr , nspr );
+}
+
+int signal_view_t::record( const int i ) const
+{
+  int j;
+  const int r = locate( i , &j );
+  return sruns[r].rec + ( sruns[r].smp + j ) / nspr;
+}
+
+void signal_view_t::physical( double * x ) const
+{
+  for (int r=0; r<sruns.size(); r++)
+    {
+      const float * f = digital_values ? NULL : edf.float_samples( sruns[r].rec , signal );
+      if ( f != NULL )
+	std::copy( f + sruns[r].smp , f + sruns[r].smp + sruns[r].n , x );
+      else if ( digital_values )
+	std::copy( sruns[r].d , sruns[r].d + sruns[r].n , x );
+      else
+	edf_simd::dig2phys( sruns[r].d , x , sruns[r].n , bv , os );
+      x += sruns[r].n;
+    }
+}
+
+std::vector<double> signal_view_t::physical() const
+{
+  std::vector<double> x( n );
+  if ( n ) physical( x.data() );
+  return x;
+}
+
+signal_view_t::record_iterator::record_iterator( const signal_view_t & view )
+  : view(view) , run(0) , off(0) , len(0) , buf( view.nspr )
+{
+  load();
+}
+
+void signal_view_t::record_iterator::next()
+{
+  off += len;
+  if ( off >= view.sruns[run].n )
+    {
+      ++run;
+      off = 0;
+    }
+  load();
+}
+
+int signal_view_t::record_iterator::record() const
+{
+  return view.sruns[run].rec + ( view.sruns[run].smp + off ) / view.nspr;
+}
+
+void signal_view_t::record_iterator::load()
+{
+  len = 0;
+  if ( ! more() ) return;
+
+  // up to the end of this record (i.e. runs may span records)
+  const sample_run_t & sr = view.sruns[run];
+  const int k = sr.smp + off;
+  len = std::min( sr.n - off , view.nspr - k % view.nspr );
+
+  const float * f = view.digital_values ? NULL : view.edf.float_samples( sr.rec , view.signal );
+  if ( f != NULL )
+    std::copy( f + k , f + k + len , buf.begin() );
+  else if ( view.digital_values )
+    std::copy( sr.d + off , sr.d + off + len , buf.begin() );
+  else
+    edf_simd::dig2phys( sr.d + off , buf.data() , len , view.bv , view.os );
+}
+
+
+
 //
 // mslice_t
 //
@@ -236,69 +402,178 @@ eigen_matslice_t::eigen_matslice_t( edf_t & edf ,
 				    const interval_t & interval )
 {
 
-  
   data.resize(0,0);
   
   time_points.clear();
   
   labels.clear();
 
-  //
-  // Empty?
-  //
+  for (int s=0;s<signals.size();s++)
+    labels.push_back( signals.label(s) );
+
+  extract( edf , signals , interval , data , &time_points );
+  
+}
+
+
+template<typename T>
+static int extract_matrix( edf_t & edf , 
+			   const signal_list_t & signals , 
+			   const interval_t & interval , 
+			   Eigen::Matrix<T,Eigen::Dynamic,Eigen::Dynamic> & X ,
+			   std::vector<uint64_t> * tp )
+{
 
   const int ns = signals.size();
   
-  if ( ns == 0 ) return;
+  if ( tp != NULL ) tp->clear();
   
-  if ( interval.empty() ) return;
+  if ( ns == 0 || interval.empty() )
+    {
+      X.resize( 0 , ns );
+      return 0;
+    }
+
+  //
+  // check SR
+  //
   
+  const int nspr = edf.header.n_samples[ signals(0) ];
+  
+  for (int s=1;s<ns;s++)
+    if ( edf.header.n_samples[ signals(s) ] != nspr )
+      Helper::halt( "unequal sample rates in matslice_t: use RESAMPLE" );
+
   //
-  // Get labels and check SR
+  // which records/samples? (as edf_t::fixedrate_signal())
   //
 
-  const int Fs = edf.header.n_samples[ signals(0) ];
+  uint64_t stop = interval.stop;
+  if ( stop > edf.timeline.last_time_point_tp + 1 )
+    stop = edf.timeline.last_time_point_tp + 1 ;      
+  
+  int start_record, stop_record;
+  int start_sample, stop_sample;
 
-  labels.push_back( signals.label(0) );
+  if ( ! edf.timeline.interval2records( interval_t( interval.start , stop ) , 
+					nspr , 
+					&start_record, &start_sample , 
+					&stop_record, &stop_sample ) )
+    {
+      if ( ! globals::api_mode )
+	logger << " ** warning ... empty intervals returned (check intervals/sampling rates)\n";
+      X.resize( 0 , ns );
+      return 0;
+    }
   
-  for (int s=1;s<ns;s++)
+  if ( ! edf.cache_records( start_record , stop_record ) )
     {
-      if ( edf.header.n_samples[ signals(s) ] != Fs )
-	Helper::halt( "unequal sample rates in matslice_t: use RESAMPLE" );
-      labels.push_back( signals.label(s) );
+      Helper::vmode_halt( "problem reading EDF records" );
+      X.resize( 0 , ns );
+      return 0;
     }
 
+  const bool simple = globals::slice_fast_path && edf.timeline.simple_records();
+
   //
-  // use fixed channel/signal sampling rate (i.e. array can be ragged), and populate time-points
+  // size output (nb. walks the record list only)
   //
 
-  std::vector<double> ch1 = edf.fixedrate_signal( interval.start , 
-						  interval.stop , 
-						  signals(0) ,    // first channel
-						  1 ,             // no downsampling
-						  &time_points ,  // get TPs for first channel only
-						  NULL, NULL, NULL ) ;        // no records, smps or dig. data
-
-  const int nr = ch1.size();
-
-  // size output matrix, and assign first row:
-  data.resize( nr , ns );
+  int n = 0;
+  int r = start_record;
+  while ( r <= stop_record )
+    {
+      const int s1 = r == start_record ? start_sample : 0 ;
+      const int s2 = r == stop_record ? stop_sample : nspr - 1;
+      if ( s2 >= s1 ) n += s2 - s1 + 1;
+      r = simple ? r + 1 : edf.timeline.next_record( r );
+      if ( r == -1 ) break;
+    }
 
-  data.col(0) = Eigen::VectorXd::Map( &ch1[0] , nr );
+  X.resize( n , ns );
   
+  if ( tp != NULL ) tp->reserve( n );
   
   //
-  // get all other channels (w/out time-points)
+  // single pass over records: each record's samples go straight into
+  // each channel's column
   //
+
+  // digital values of float32-backed signals are taken from the int16 form
+  if ( globals::read_digital_values )
+    for (int s=0;s<ns;s++)
+      edf.sync_float_store( signals(s) );
   
-  for (int s=1;s<ns;s++) 
+  std::vector<double> bv( ns ) , os( ns );
+  for (int s=0;s<ns;s++)
     {
-      // TODO: add a version of fixedrate_signal() that directly outputs to Eigen matrix class
-      std::vector<double> tmp = edf.fixedrate_signal( interval.start , interval.stop , signals(s) , 1 , NULL , NULL , NULL , NULL ) ;
-      data.col(s) = Eigen::VectorXd::Map( &tmp[0] , nr );
+      bv[s] = edf.header.bitvalue[ signals(s) ];
+      os[s] = edf.header.offset[ signals(s) ];
     }
   
+  const uint64_t rec_tp = edf.header.record_duration_tp;
+  
+  int row = 0;
+  r = start_record;
   
+  while ( r <= stop_record )
+    {
+      const int s1 = r == start_record ? start_sample : 0 ;
+      const int s2 = r == stop_record ? stop_sample : nspr - 1;
+      const int m = s2 - s1 + 1;
+
+      if ( m > 0 )
+	{
+	  for (int s=0;s<ns;s++)
+	    {
+	      T * x = X.col(s).data() + row;
+	      const float * f = globals::read_digital_values ? NULL : edf.float_samples( r , signals(s) );
+	      if ( f != NULL )
+		{
+		  std::copy( f + s1 , f + s2 + 1 , x );
+		  continue;
+		}
+	      const int16_t * d = edf.record_samples( r , signals(s) );
+	      if ( globals::read_digital_values )
+		std::copy( d + s1 , d + s2 + 1 , x );
+	      else
+		edf_simd::dig2phys( d + s1 , x , m , bv[s] , os[s] );
+	    }
+	  
+	  if ( tp != NULL )
+	    {
+	      const uint64_t tp0 = simple ? r * rec_tp : edf.timeline.timepoint( r );
+	      for (int j=s1;j<=s2;j++)
+		tp->push_back( tp0 + rec_tp * j / nspr );
+	    }
+	  
+	  row += m;
+	}
+      
+      r = simple ? r + 1 : edf.timeline.next_record( r );
+      if ( r == -1 ) break;
+    }
+
+  return n;
+}
+
+
+int eigen_matslice_t::extract( edf_t & edf , 
+			       const signal_list_t & signals , 
+			       const interval_t & interval , 
+			       Eigen::MatrixXd & X ,
+			       std::vector<uint64_t> * tp )
+{
+  return extract_matrix( edf , signals , interval , X , tp );
+}
+
+int eigen_matslice_t::extract( edf_t & edf , 
+			       const signal_list_t & signals , 
+			       const interval_t & interval , 
+			       Eigen::MatrixXf & X ,
+			       std::vector<uint64_t> * tp )
+{
+  return extract_matrix( edf , signals , interval , X , tp );
 }
 
 
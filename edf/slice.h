@@ -36,6 +36,22 @@ struct edf_t;
 struct timeline_t;
 
 
+//
+// A run of consecutive samples of one signal, pointing into the loaded
+// int16 data (edf_t::records or the channel store): rec/smp give the
+// first sample; a run spans several records only when they are
+// consecutive in the channel store
+//
+
+struct sample_run_t
+{
+  const int16_t * d;
+  int rec;
+  int smp;
+  int n;
+};
+
+
 class slice_t
 {
 
@@ -134,6 +150,133 @@ class slice_t
 
 
 
+//
+// signal_view_t : a lightweight, read-only alternative to slice_t
+//
+//  No copies are made: samples are converted to physical units as they
+//  are accessed (or in bulk, via physical()) and time-points are
+//  computed on demand, rather than storing a double, a uint64_t time
+//  point and a record number for every sample.  As with slice_t,
+//  read-digital=T gives the digital values, and float-backed signals
+//  (precision=float) give the float32 values.
+//
+//  The view points into the loaded records, so it is only valid until
+//  the signal/records are next changed (update_signal(), RESTRUCTURE,
+//  etc); record-cache eviction (mem-limit) is held off while a view
+//  exists.
+//
+
+class signal_view_t
+{
+
+ public:
+  
+  signal_view_t( edf_t & edf , int signal , const interval_t & interval );
+
+  ~signal_view_t();
+  
+  int size() const { return n; }
+
+  bool empty() const { return n == 0; }
+  
+  // sample i, in physical units
+  double operator[]( const int i ) const;
+
+  // sample i, digital value
+  int16_t digital( const int i ) const;
+
+  // time-point and record of sample i
+  uint64_t timepoint( const int i ) const;
+
+  int record( const int i ) const;
+
+  // bulk conversion of all samples (to a vector, or to n doubles at x)
+  std::vector<double> physical() const;
+
+  void physical( double * x ) const;
+  
+  // underlying runs of int16 samples
+  const std::vector<sample_run_t> & runs() const { return sruns; }
+
+  //
+  // record-wise iteration (i.e. no per-sample lookup): each step gives
+  // the view's samples from one record, converted as for operator[]
+  // into a buffer of (at most) one record
+  //
+  //   signal_view_t::record_iterator rr = view.by_record();
+  //   for ( ; rr.more() ; rr.next() )
+  //     for (int j=0; j<rr.size(); j++) ... rr[j] ...
+  //
+  
+  class record_iterator
+  {
+  public:
+
+    bool more() const { return run < view.sruns.size(); }
+
+    void next();
+
+    // samples in this step, and their values
+    int size() const { return len; }
+
+    double operator[]( const int j ) const { return buf[j]; }
+
+    const double * data() const { return buf.data(); }
+    
+    // record, and index (in the view) of the first sample of this step
+    int record() const;
+
+    int index() const { return view.first[run] + off; }
+    
+  private:
+
+    friend class signal_view_t;
+    
+    record_iterator( const signal_view_t & view );
+
+    void load();
+    
+    const signal_view_t & view;
+
+    // current run, and offset of this step into it
+    int run , off;
+
+    int len;
+    
+    std::vector<double> buf;
+  };
+
+  record_iterator by_record() const { return record_iterator( *this ); }
+  
+ private:
+
+  // not copyable
+  signal_view_t( const signal_view_t & );
+  signal_view_t & operator=( const signal_view_t & );
+
+  // run containing sample i, and offset into that run
+  int locate( const int i , int * j ) const;
+  
+  edf_t & edf;
+  const int signal;
+  int nspr;
+  double bv , os;
+  bool digital_values;
+  
+  std::vector<sample_run_t> sruns;
+
+  // sample index of start of each run
+  std::vector<int> first;
+  
+  int n;
+
+  // last run located (for sequential access)
+  mutable int last;
+  
+};
+
+
+
 class mslice_t {
   
  public:
@@ -258,6 +401,23 @@ class eigen_matslice_t {
     time_points.clear();
   }
 
+  // fill X (samples x channels, contiguous columns) directly from the
+  // loaded records, in a single pass over them, for equal-rate signals;
+  // X is only resized if its shape differs (i.e. can be preallocated);
+  // optionally also get time-points; returns number of samples
+  
+  static int extract( edf_t & edf , 
+		      const signal_list_t & signals , 
+		      const interval_t & interval , 
+		      Eigen::MatrixXd & X ,
+		      std::vector<uint64_t> * tp = NULL );
+
+  static int extract( edf_t & edf , 
+		      const signal_list_t & signals , 
+		      const interval_t & interval , 
+		      Eigen::MatrixXf & X ,
+		      std::vector<uint64_t> * tp = NULL );
+  
  private:
 
   Eigen::MatrixXd data;  
@@ -145,12 +145,13 @@ int fn_luna_slbuilder( const std::string & filename )
   
   const bool has_edf_ext = Helper::file_extension( filename , "edf" ) ; // 4 chars
   const bool has_edfz_ext = Helper::file_extension( filename , "edfz" ) ; // 5 
+  const bool has_edfx_ext = Helper::file_extension( filename , "edfx" ) ; // 5 
   const bool has_edfgz_ext = Helper::file_extension( filename , "edf.gz" ) ; // 7  
   
-  if ( has_edf_ext || has_edfz_ext || has_edfgz_ext ) 
+  if ( has_edf_ext || has_edfz_ext || has_edfx_ext || has_edfgz_ext ) 
     {
       
-      const int xchar = has_edf_ext ? 4 : ( has_edfz_ext ? 5 : 7 ) ;
+      const int xchar = has_edf_ext ? 4 : ( has_edfz_ext || has_edfx_ext ? 5 : 7 ) ;
 
       std::string id;
       
@@ -58,7 +58,8 @@ tal_t edf_t::tal( const int signal , const int rec )
   // std::cout << "s = " << records[rec].data.size() << "\n";
   // std::cout << "signal = " <<signal << "\n";
   
-  const std::vector<int16_t> & raw = records.find(rec)->second.data[signal];
+  const edf_record_t & record = records.find(rec)->second;
+  const std::vector<int16_t> & raw = record.data[signal];
 
   const int np_used = raw.size();
   
@@ -23,6 +23,9 @@
 */
 
 #include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -170,14 +173,12 @@ BGZF *bgzf_dopen(int fd, const char *mode)
   return fp;
 }
 
-// Deflate the block in fp->uncompressed_block into fp->compressed_block. Also adds an extra field that stores the compressed block length.
-static int deflate_block(BGZF *fp, int block_length)
+// Deflate up to block_length bytes of input into one BGZF block in buffer (BGZF_BLOCK_SIZE bytes). Sets *consumed, which is less than block_length if the data did not compress enough. Returns the block size, or -1 on a zlib error.
+static int deflate_into(const uint8_t *input, int block_length, uint8_t *buffer, int compress_level, int *consumed)
 {
-  uint8_t *buffer = (uint8_t*)fp->compressed_block;
   int buffer_size = BGZF_BLOCK_SIZE;
   int input_length = block_length;
   int compressed_length = 0;
-  int remaining;
   uint32_t crc;
   
   assert(block_length <= BGZF_BLOCK_SIZE); // guaranteed by the caller
@@ -187,15 +188,12 @@ static int deflate_block(BGZF *fp, int block_length)
     z_stream zs;
     zs.zalloc = NULL;
     zs.zfree = NULL;
-    zs.next_in = (Bytef*)fp->uncompressed_block;
+    zs.next_in = (Bytef*)input;
     zs.avail_in = input_length;
     zs.next_out = (Bytef*)&buffer[BLOCK_HEADER_LENGTH];
     zs.avail_out = buffer_size - BLOCK_HEADER_LENGTH - BLOCK_FOOTER_LENGTH;
-    status = deflateInit2(&zs, fp->compress_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY); // -15 to disable zlib header/footer
-    if (status != Z_OK) {
-      fp->errcode |= BGZF_ERR_ZLIB;
-      return -1;
-    }
+    status = deflateInit2(&zs, compress_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY); // -15 to disable zlib header/footer
+    if (status != Z_OK) return -1;
     status = deflate(&zs, Z_FINISH);
     if (status != Z_STREAM_END) { // not compressed enough
       deflateEnd(&zs); // reset the stream
@@ -204,13 +202,9 @@ static int deflate_block(BGZF *fp, int block_length)
 	assert(input_length > 0); // logically, this should not happen
 	continue;
       }
-      fp->errcode |= BGZF_ERR_ZLIB;
-      return -1;
-    }
-    if (deflateEnd(&zs) != Z_OK) {
-      fp->errcode |= BGZF_ERR_ZLIB;
       return -1;
     }
+    if (deflateEnd(&zs) != Z_OK) return -1;
     compressed_length = zs.total_out;
     compressed_length += BLOCK_HEADER_LENGTH + BLOCK_FOOTER_LENGTH;
     assert(compressed_length <= BGZF_BLOCK_SIZE);
@@ -220,10 +214,24 @@ static int deflate_block(BGZF *fp, int block_length)
   assert(compressed_length > 0);
   packInt16((uint8_t*)&buffer[16], compressed_length - 1); // write the compressed_length; -1 to fit 2 bytes
   crc = crc32(0L, NULL, 0L);
-  crc = crc32(crc, (const Bytef*)fp->uncompressed_block, input_length);
+  crc = crc32(crc, (const Bytef*)input, input_length);
   packInt32((uint8_t*)&buffer[compressed_length-8], crc);
   packInt32((uint8_t*)&buffer[compressed_length-4], input_length);
 
+  *consumed = input_length;
+  return compressed_length;
+}
+
+// Deflate the block in fp->uncompressed_block into fp->compressed_block. Also adds an extra field that stores the compressed block length.
+static int deflate_block(BGZF *fp, int block_length)
+{
+  int input_length, remaining;
+  int compressed_length = deflate_into((const uint8_t*)fp->uncompressed_block, block_length, (uint8_t*)fp->compressed_block, fp->compress_level, &input_length);
+  if (compressed_length < 0) {
+    fp->errcode |= BGZF_ERR_ZLIB;
+    return -1;
+  }
+  
   remaining = block_length - input_length;
   if (remaining > 0) {
     assert(remaining <= input_length);
@@ -233,33 +241,35 @@ static int deflate_block(BGZF *fp, int block_length)
   return compressed_length;
 }
 
-// Inflate the block in fp->compressed_block into fp->uncompressed_block
-static int inflate_block(BGZF* fp, int block_length)
+// Inflate a block (of block_length bytes, header included) into output (BGZF_BLOCK_SIZE bytes); returns the uncompressed size, or -1 on a zlib error
+static int inflate_into(const uint8_t *block, int block_length, uint8_t *output)
 {
   z_stream zs;
   zs.zalloc = NULL;
   zs.zfree = NULL;
-  zs.next_in = (Bytef*)fp->compressed_block + 18;
+  zs.next_in = (Bytef*)block + 18;
   zs.avail_in = block_length - 16;
-  zs.next_out = (Bytef*)fp->uncompressed_block;
+  zs.next_out = (Bytef*)output;
   zs.avail_out = BGZF_BLOCK_SIZE;
 
-  if (inflateInit2(&zs, -15) != Z_OK) {
-    fp->errcode |= BGZF_ERR_ZLIB;
-    return -1;
-  }
+  if (inflateInit2(&zs, -15) != Z_OK) return -1;
   if (inflate(&zs, Z_FINISH) != Z_STREAM_END) {
     inflateEnd(&zs);
-    fp->errcode |= BGZF_ERR_ZLIB;
-    return -1;
-  }
-  if (inflateEnd(&zs) != Z_OK) {
-    fp->errcode |= BGZF_ERR_ZLIB;
     return -1;
   }
+  if (inflateEnd(&zs) != Z_OK) return -1;
   return zs.total_out;
 }
 
+// Inflate the block in fp->compressed_block into fp->uncompressed_block
+static int inflate_block(BGZF* fp, int block_length)
+{
+  int n = inflate_into((const uint8_t*)fp->compressed_block, block_length, (uint8_t*)fp->uncompressed_block);
+  if (n < 0) fp->errcode |= BGZF_ERR_ZLIB;
+  return n;
+}
+
+
 static int check_header(const uint8_t *header)
 {
   return (header[0] == 31 && header[1] == 139 && header[2] == 8 && (header[3] & 4) != 0
@@ -268,6 +278,179 @@ static int check_header(const uint8_t *header)
 	  && unpackInt16((uint8_t*)&header[14]) == 2);
 }
 
+/* Multithreading (bgzf_mt()): BGZF blocks are independent, so chunks are
+   staged (writing) or read ahead (reading) in batches of n_threads x
+   n_blocks, and each batch is (de)compressed in parallel; blocks are
+   always written/returned in their original order.  A chunk is exactly
+   what bgzf_flush() would deflate, i.e. usually one block, or more if
+   it did not compress enough, so the output bytes do not depend on the
+   number of threads. */
+
+struct bgzf_mt_t {
+  int n_threads;
+  int n_batch;                                  // chunks/blocks per batch
+  // writing
+  std::vector<std::vector<uint8_t> > chunks;    // staged, uncompressed
+  std::vector<std::vector<uint8_t> > packed;    // deflated (one or more blocks)
+  int n_staged;
+  // reading
+  std::vector<std::vector<uint8_t> > blocks;    // compressed
+  std::vector<std::vector<uint8_t> > inflated;  // BGZF_BLOCK_SIZE each
+  std::vector<int> length;                      // inflated size, or -1
+  std::vector<int64_t> address;                 // of each block
+  std::vector<int> status;                      // 0 okay, else BGZF_ERR_*
+  int n_queued, next;
+  int64_t next_address;                         // i.e. after the last queued block
+};
+
+// run f(0) .. f(n-1) on up to n_threads threads (including this one)
+template<typename F>
+static void mt_run(int n, int n_threads, F f)
+{
+  std::atomic<int> job(0);
+  auto worker = [&]() { int j; while ((j = job++) < n) f(j); };
+  std::vector<std::thread> pool;
+  for (int t = 1; t < n_threads && t < n; ++t) pool.push_back(std::thread(worker));
+  worker();
+  for (size_t t = 0; t < pool.size(); ++t) pool[t].join();
+}
+
+// deflate a whole chunk, as bgzf_flush() would
+static int deflate_chunk(const uint8_t *input, int length, int compress_level, std::vector<uint8_t> &out)
+{
+  uint8_t block[BGZF_BLOCK_SIZE];
+  out.clear();
+  while (length > 0) {
+    int consumed;
+    int n = deflate_into(input, length, block, compress_level, &consumed);
+    if (n < 0) return -1;
+    out.insert(out.end(), block, block + n);
+    input += consumed;
+    length -= consumed;
+  }
+  return 0;
+}
+
+// stage the current (full or final) chunk
+static void mt_stage(BGZF *fp)
+{
+  bgzf_mt_t *mt = (bgzf_mt_t*)fp->mt;
+  mt->chunks[mt->n_staged].assign((uint8_t*)fp->uncompressed_block, (uint8_t*)fp->uncompressed_block + fp->block_offset);
+  ++mt->n_staged;
+  fp->block_offset = 0;
+}
+
+// deflate all staged chunks in parallel, and write them in order
+static int mt_write_batch(BGZF *fp)
+{
+  bgzf_mt_t *mt = (bgzf_mt_t*)fp->mt;
+  if (mt->n_staged == 0) return 0;
+  std::vector<int> ok(mt->n_staged, 0);
+  const int level = fp->compress_level;
+  mt_run(mt->n_staged, mt->n_threads, [&](int j) {
+      ok[j] = deflate_chunk(mt->chunks[j].data(), mt->chunks[j].size(), level, mt->packed[j]);
+    });
+  const int n = mt->n_staged;
+  mt->n_staged = 0;
+  for (int j = 0; j < n; ++j) {
+    if (ok[j] != 0) {
+      fp->errcode |= BGZF_ERR_ZLIB;
+      return -1;
+    }
+    if (fwrite(mt->packed[j].data(), 1, mt->packed[j].size(), (_bgzf_file_t)fp->fp) != mt->packed[j].size()) {
+      fp->errcode |= BGZF_ERR_IO; // possibly truncated file
+      return -1;
+    }
+    fp->block_address += mt->packed[j].size();
+  }
+  return 0;
+}
+
+// read ahead (up to) a batch of compressed blocks, and inflate them in parallel
+static void mt_read_batch(BGZF *fp)
+{
+  bgzf_mt_t *mt = (bgzf_mt_t*)fp->mt;
+  mt->n_queued = mt->next = 0;
+  while (mt->n_queued < mt->n_batch) {
+    const int j = mt->n_queued;
+    uint8_t header[BLOCK_HEADER_LENGTH];
+    int64_t block_address = _bgzf_tell((_bgzf_file_t)fp->fp);
+    int count = _bgzf_read((_bgzf_file_t)fp->fp, header, sizeof(header));
+    if (count == 0) break; // end of file
+    mt->address[j] = block_address;
+    mt->length[j] = -1;
+    ++mt->n_queued;
+    if (count != sizeof(header) || !check_header(header)) {
+      mt->status[j] = BGZF_ERR_HEADER;
+      break;
+    }
+    int block_length = unpackInt16((uint8_t*)&header[16]) + 1;
+    mt->blocks[j].resize(block_length);
+    memcpy(mt->blocks[j].data(), header, BLOCK_HEADER_LENGTH);
+    int remaining = block_length - BLOCK_HEADER_LENGTH;
+    count = _bgzf_read((_bgzf_file_t)fp->fp, mt->blocks[j].data() + BLOCK_HEADER_LENGTH, remaining);
+    if (count != remaining) {
+      mt->status[j] = BGZF_ERR_IO;
+      break;
+    }
+    mt->status[j] = 0;
+  }
+  mt->next_address = _bgzf_tell((_bgzf_file_t)fp->fp);
+  mt_run(mt->n_queued, mt->n_threads, [&](int j) {
+      if (mt->status[j] == 0) {
+	mt->length[j] = inflate_into(mt->blocks[j].data(), mt->blocks[j].size(), mt->inflated[j].data());
+	if (mt->length[j] < 0) mt->status[j] = BGZF_ERR_ZLIB;
+      }
+    });
+}
+
+// address of the block that the next bgzf_read_block() will return
+static int64_t next_block_address(BGZF *fp)
+{
+  bgzf_mt_t *mt = (bgzf_mt_t*)fp->mt;
+  if (mt == NULL || fp->open_mode != 'r') return _bgzf_tell((_bgzf_file_t)fp->fp);
+  return mt->next < mt->n_queued ? mt->address[mt->next] : mt->next_address;
+}
+
+static void mt_free(BGZF *fp)
+{
+  delete (bgzf_mt_t*)fp->mt;
+  fp->mt = NULL;
+}
+
+int bgzf_mt(BGZF *fp, int n_threads, int n_blocks)
+{
+  if (fp == NULL) return -1;
+  if (fp->mt != NULL) {
+    // i.e. finish anything pending on the current setting first
+    if (fp->open_mode == 'w' && bgzf_flush(fp) != 0) return -1;
+    if (fp->open_mode == 'r') {
+      bgzf_mt_t *mt = (bgzf_mt_t*)fp->mt;
+      if (mt->next < mt->n_queued && _bgzf_seek((_bgzf_file_t)fp->fp, mt->address[mt->next], SEEK_SET) < 0) return -1;
+    }
+    mt_free(fp);
+  }
+  if (n_threads <= 1) return 0;
+  if (n_blocks <= 0) n_blocks = 16;
+  bgzf_mt_t *mt = new bgzf_mt_t;
+  mt->n_threads = n_threads;
+  mt->n_batch = n_threads * n_blocks;
+  mt->n_staged = mt->n_queued = mt->next = 0;
+  mt->next_address = 0;
+  if (fp->open_mode == 'w') {
+    mt->chunks.resize(mt->n_batch);
+    mt->packed.resize(mt->n_batch);
+  } else {
+    mt->blocks.resize(mt->n_batch);
+    mt->inflated.resize(mt->n_batch, std::vector<uint8_t>(BGZF_BLOCK_SIZE));
+    mt->length.resize(mt->n_batch);
+    mt->address.resize(mt->n_batch);
+    mt->status.resize(mt->n_batch);
+  }
+  fp->mt = mt;
+  return 0;
+}
+
 #ifdef BGZF_CACHE
 static void free_cache(BGZF *fp)
 {
@@ -332,15 +515,32 @@ int bgzf_read_block(BGZF *fp)
   uint8_t header[BLOCK_HEADER_LENGTH], *compressed_block;
   int count, size = 0, block_length, remaining;
   int64_t block_address;
+
+  if (fp->mt != NULL) { // i.e. from the read-ahead queue
+    bgzf_mt_t *mt = (bgzf_mt_t*)fp->mt;
+    if (mt->next == mt->n_queued) mt_read_batch(fp);
+    if (mt->n_queued == 0) { // end of file
+      fp->block_length = 0;
+      return 0;
+    }
+    const int j = mt->next++;
+    if (mt->status[j] != 0) {
+      fp->errcode |= mt->status[j];
+      return -1;
+    }
+    memcpy(fp->uncompressed_block, mt->inflated[j].data(), mt->length[j]);
+    if (fp->block_length != 0) fp->block_offset = 0; // Do not reset offset if this read follows a seek.
+    fp->block_address = mt->address[j];
+    fp->block_length = mt->length[j];
+    return 0;
+  }
+  
   block_address = _bgzf_tell((_bgzf_file_t)fp->fp);
   if (load_block_from_cache(fp, block_address)) return 0;
 
-  std::cout << "bgzf_read_block " << block_address << "\n";
-  
   count = _bgzf_read((_bgzf_file_t)fp->fp, header, sizeof(header));
 
   if (count == 0) { // no data read
-    std::cout << " bgzf_read_block : count = 0, *** no data **** \n";
     fp->block_length = 0;
     return 0;
   }
@@ -363,22 +563,12 @@ int bgzf_read_block(BGZF *fp)
   if (fp->block_length != 0) fp->block_offset = 0; // Do not reset offset if this read follows a seek.
   fp->block_address = block_address;
   fp->block_length = count;
-  std::cout << " bgzf_read_block: set  fp->block_length = " << fp->block_length << "\n";
   cache_block(fp, size);
   return 0;
 }
 
 ssize_t bgzf_read(BGZF *fp, void *data, ssize_t length)
 {
-
-  // attempting a bug fix here... adding extra safety guard
-  // for edge cases
-  // if (fp->block_length < fp->block_offset) {
-  //   std::cout << " hmmmm\n";
-  //   fp->block_offset = fp->block_length = 0;
-  // }
-  // -----
-  
   ssize_t bytes_read = 0;
 
   uint8_t *output = (uint8_t*)data;
@@ -386,33 +576,16 @@ ssize_t bgzf_read(BGZF *fp, void *data, ssize_t length)
   if (length <= 0) return 0;
   
   assert(fp->open_mode == 'r');
-  std::cout << "\n\n----\nin read()\n";
   while (bytes_read < length) {
-
-    std::cout << " while " << bytes_read << " < " << length << "\n";
     int copy_length, available = fp->block_length - fp->block_offset;
-
-    std::cout << " avail = " << available << " " << fp->block_length << " " << fp->block_offset << "\n";
-
-    // added code
-    // if (available < 0) {
-    //   fp->errcode |= BGZF_ERR_IO;
-    //   return -1;
-    // }
-    // -----
-  
     uint8_t *buffer;
     if (available <= 0) {
-      std::cout << " none available, so making a read_block() \n";
       if (bgzf_read_block(fp) != 0) return -1;
       available = fp->block_length - fp->block_offset;
-      std::cout << " ---> avail = " <<	available << " " << fp->block_length <<	" " << fp->block_offset	<< "\n";
-
       if (available <= 0) break;
     }
     
     copy_length = length - bytes_read < available? length - bytes_read : available;
-    std::cout << " now want to read " << copy_length << "\n";
     buffer = (uint8_t*)fp->uncompressed_block;
     memcpy(output, buffer + fp->block_offset, copy_length);
     fp->block_offset += copy_length;
@@ -421,19 +594,20 @@ ssize_t bgzf_read(BGZF *fp, void *data, ssize_t length)
   }
 
   if (fp->block_offset == fp->block_length) {
-    std::cout << " end of block\n";
-    fp->block_address = _bgzf_tell((_bgzf_file_t)fp->fp);
+    fp->block_address = next_block_address(fp);
     fp->block_offset = fp->block_length = 0;
   }
   
-  std::cout << " read " << bytes_read << "\n";
-  std::cout << " final fp->block_length = " << fp->block_length << "\n";
   return bytes_read;
 }
 
 int bgzf_flush(BGZF *fp)
 {
   assert(fp->open_mode == 'w');
+  if (fp->mt != NULL) {
+    if (fp->block_offset > 0) mt_stage(fp);
+    return mt_write_batch(fp);
+  }
   while (fp->block_offset > 0) {
     int block_length;
     block_length = deflate_block(fp, fp->block_offset);
@@ -468,7 +642,13 @@ ssize_t bgzf_write(BGZF *fp, const void *data, ssize_t length)
     fp->block_offset += copy_length;
     input += copy_length;
     bytes_written += copy_length;
-    if (fp->block_offset == block_length && bgzf_flush(fp)) break;
+    if (fp->block_offset == block_length) {
+      if (fp->mt != NULL) { // stage, and only deflate once a batch is ready
+	mt_stage(fp);
+	if (((bgzf_mt_t*)fp->mt)->n_staged == ((bgzf_mt_t*)fp->mt)->n_batch && mt_write_batch(fp)) break;
+      }
+      else if (bgzf_flush(fp)) break;
+    }
   }
   return bytes_written;
 }
@@ -487,6 +667,7 @@ int bgzf_close(BGZF* fp)
     }
   }
   ret = fp->open_mode == 'w'? fclose((_bgzf_file_t)fp->fp) : _bgzf_close((_bgzf_file_t)fp->fp);
+  mt_free(fp);
   if (ret != 0) return -1;
   free(fp->uncompressed_block);
   free(fp->compressed_block);
@@ -529,10 +710,12 @@ int64_t bgzf_seek(BGZF* fp, int64_t pos, int where)
     return -1;
   }
 
+  if (fp->mt != NULL) // drop any read-ahead
+    ((bgzf_mt_t*)fp->mt)->n_queued = ((bgzf_mt_t*)fp->mt)->next = 0;
+  
   fp->block_length = 0;  // indicates current block has not been loaded
   fp->block_address = block_address;
   fp->block_offset = block_offset;
-  std::cout << "bgzf_seek() = " << fp->block_length  << " " << fp->block_address  << " " << fp->block_offset  << "\n";
   return 0;
 }
 
@@ -558,7 +741,7 @@ int bgzf_getc(BGZF *fp)
   }
   c = ((unsigned char*)fp->uncompressed_block)[fp->block_offset++];
   if (fp->block_offset == fp->block_length) {
-    fp->block_address = _bgzf_tell((_bgzf_file_t)fp->fp);
+    fp->block_address = next_block_address(fp);
     fp->block_offset = 0;
     fp->block_length = 0;
   }
@@ -593,7 +776,7 @@ int bgzf_getline(BGZF *fp, int delim, kstring_t *str)
     str->l += l;
     fp->block_offset += l + 1;
     if (fp->block_offset >= fp->block_length) {
-      fp->block_address = _bgzf_tell((_bgzf_file_t)fp->fp);
+      fp->block_address = next_block_address(fp);
       fp->block_offset = 0;
       fp->block_length = 0;
     } 
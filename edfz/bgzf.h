@@ -50,6 +50,7 @@ typedef struct {
   void *uncompressed_block, *compressed_block;
   void *cache; // a pointer to a hash table
   void *fp; // actual file handler; FILE* on writing; FILE* or knetFile* on reading
+  void *mt; // multithreading state (bgzf_mt()), or NULL
 } BGZF;
 
 #ifndef KSTRING_T
@@ -189,6 +190,21 @@ extern "C" {
    */
   int bgzf_read_block(BGZF *fp);
 
+  /**
+   * (De)compress blocks on n_threads threads. When writing, up to
+   * n_blocks 64k chunks per thread are queued, then deflated in
+   * parallel and written in order; the output is byte-identical to
+   * the single-threaded writer. When reading, up to n_blocks per
+   * thread are read ahead and inflated in parallel. Nb. when writing,
+   * bgzf_tell() is only exact directly after bgzf_flush().
+   *
+   * @param fp         BGZF file handler
+   * @param n_threads  number of threads (1 to switch off)
+   * @param n_blocks   queue length per thread (0 for the default)
+   * @return           0 on success and -1 on error
+   */
+  int bgzf_mt(BGZF *fp, int n_threads, int n_blocks);
+
 #ifdef __cplusplus
 }
 #endif
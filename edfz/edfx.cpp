@@ -0,0 +1,363 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "edfz/edfx.h"
+#include "helper/helper.h"
+#include "zlib-1.3/zlib.h"
+
+#include <cstring>
+
+static const char edfx_magic[8] = { 'E','D','F','X','v','1','\0','\0' };
+static const char edfx_idx_magic[8] = { 'E','D','F','X','i','d','x','\0' };
+
+// fixed-width, little-endian integers (whatever the host)
+
+static void put_u32( std::vector<byte_t> & b , const uint32_t x )
+{
+  for (int i=0; i<4; i++) b.push_back( ( x >> ( 8 * i ) ) & 0xff );
+}
+
+static void put_u64( std::vector<byte_t> & b , const uint64_t x )
+{
+  for (int i=0; i<8; i++) b.push_back( ( x >> ( 8 * i ) ) & 0xff );
+}
+
+static uint32_t get_u32( const byte_t * p )
+{
+  uint32_t x = 0;
+  for (int i=0; i<4; i++) x |= (uint32_t)p[i] << ( 8 * i );
+  return x;
+}
+
+static uint64_t get_u64( const byte_t * p )
+{
+  uint64_t x = 0;
+  for (int i=0; i<8; i++) x |= (uint64_t)p[i] << ( 8 * i );
+  return x;
+}
+
+static int64_t edfx_tell( FILE * f )
+{
+#ifndef WINDOWS
+  return ftello( f );
+#else
+  return _ftelli64( f );
+#endif
+}
+
+static int edfx_seek( FILE * f , const int64_t offset , const int whence )
+{
+#ifndef WINDOWS
+  return fseeko( f , offset , whence );
+#else
+  return _fseeki64( f , offset , whence );
+#endif
+}
+
+
+edfx_t::edfx_t()
+{
+  filename = "";
+  file = NULL;
+  mode = 0;
+  hsize = K = ns = nr = rsize = 0;
+  hpos = 0;
+  nbytes_read = 0;
+}
+
+
+bool edfx_t::open_for_reading( const std::string & fn )
+{
+  close();
+
+  filename = fn;
+
+  if ( ( file = fopen( fn.c_str() , "rb" ) ) == NULL ) return false;
+
+  mode = -1;
+
+  //
+  // fixed preamble
+  //
+
+  byte_t pre[16];
+  if ( fread( pre , 1 , 16 , file ) != 16 || memcmp( pre , edfx_magic , 8 ) )
+    {
+      close();
+      return false;
+    }
+
+  hsize = get_u32( pre + 8 );
+  K = get_u32( pre + 12 );
+
+  //
+  // trailer --> index
+  //
+
+  byte_t tail[16];
+  if ( edfx_seek( file , -16 , SEEK_END ) != 0
+       || fread( tail , 1 , 16 , file ) != 16
+       || memcmp( tail + 8 , edfx_idx_magic , 8 ) )
+    {
+      close();
+      return false;
+    }
+
+  const int64_t idx_offset = get_u64( tail );
+  const int64_t idx_size = edfx_tell( file ) - 16 - idx_offset;
+
+  std::vector<byte_t> idx( idx_size > 0 ? idx_size : 0 );
+  if ( idx_size < 12
+       || edfx_seek( file , idx_offset , SEEK_SET ) != 0
+       || fread( idx.data() , 1 , idx_size , file ) != idx_size )
+    {
+      close();
+      return false;
+    }
+
+  const byte_t * q = idx.data();
+  ns = get_u32( q );
+  nr = get_u32( q + 4 );
+  if ( get_u32( q + 8 ) != K || K < 1 ) { close(); return false; }
+  q += 12;
+
+  const int nchunks = ( nr + K - 1 ) / K;
+
+  if ( idx_size != 12 + 4 * (int64_t)ns + 12 * (int64_t)nchunks * ns )
+    {
+      close();
+      return false;
+    }
+
+  nbytes.resize( ns );
+  choff.resize( ns );
+  rsize = 0;
+  for (int s=0; s<ns; s++)
+    {
+      nbytes[s] = get_u32( q ); q += 4;
+      choff[s] = rsize;
+      rsize += nbytes[s];
+    }
+
+  offset.resize( (uint64_t)nchunks * ns );
+  csize.resize( (uint64_t)nchunks * ns );
+  for (uint64_t i=0; i<offset.size(); i++)
+    {
+      offset[i] = get_u64( q );
+      csize[i] = get_u32( q + 8 );
+      q += 12;
+    }
+
+  cached_chunk.assign( ns , -1 );
+  cache.resize( ns );
+
+  // ready to read the EDF header
+  hpos = 0;
+  edfx_seek( file , 16 , SEEK_SET );
+
+  return true;
+}
+
+
+size_t edfx_t::read( byte_t * p , const int n )
+{
+  // only the EDF header is read sequentially
+  const int n2 = hpos + n > hsize ? hsize - hpos : n ;
+  if ( n2 <= 0 ) return 0;
+  edfx_seek( file , 16 + hpos , SEEK_SET );
+  const size_t rdsz = fread( p , 1 , n2 , file );
+  hpos += rdsz;
+  return rdsz;
+}
+
+
+bool edfx_t::load_chunk( const int s , const int c )
+{
+  if ( cached_chunk[s] == c ) return true;
+
+  const uint64_t i = (uint64_t)c * ns + s;
+
+  const int nrc = c == ( nr - 1 ) / K ? nr - c * K : K ;
+  uLongf len = (uLongf)nrc * nbytes[s];
+
+  cache[s].resize( len );
+  if ( zbuf.size() < csize[i] ) zbuf.resize( csize[i] );
+
+  if ( edfx_seek( file , offset[i] , SEEK_SET ) != 0
+       || fread( zbuf.data() , 1 , csize[i] , file ) != csize[i] )
+    return false;
+
+  nbytes_read += csize[i];
+
+  if ( uncompress( cache[s].data() , &len , zbuf.data() , csize[i] ) != Z_OK
+       || len != (uLongf)nrc * nbytes[s] )
+    Helper::halt( "corrupt EDFX chunk in " + filename );
+
+  cached_chunk[s] = c;
+  return true;
+}
+
+
+bool edfx_t::read_record( const int r , const int off , const int n , byte_t * p )
+{
+  if ( mode != -1 || r < 0 || r >= nr ) return false;
+
+  const int c = r / K;
+  const int rc = r - c * K;
+
+  for (int s=0; s<ns; s++)
+    {
+      // overlap of this channel with [ off , off + n )
+      const int a = choff[s] > off ? choff[s] : off ;
+      const int b = choff[s] + nbytes[s] < off + n ? choff[s] + nbytes[s] : off + n ;
+      if ( a >= b ) continue;
+
+      if ( ! load_chunk( s , c ) ) return false;
+
+      memcpy( p + ( a - off ) ,
+	      cache[s].data() + (uint64_t)rc * nbytes[s] + ( a - choff[s] ) ,
+	      b - a );
+    }
+
+  return true;
+}
+
+
+bool edfx_t::open_for_writing( const std::string & fn , const int recs_per_chunk )
+{
+  close();
+
+  filename = fn;
+
+  if ( ( file = fopen( fn.c_str() , "wb" ) ) == NULL ) return false;
+
+  mode = +1;
+  K = recs_per_chunk < 1 ? 1 : recs_per_chunk ;
+  nr = 0;
+
+  // header size is patched in set_layout()
+  std::vector<byte_t> pre( edfx_magic , edfx_magic + 8 );
+  put_u32( pre , 0 );
+  put_u32( pre , K );
+  fwrite( pre.data() , 1 , pre.size() , file );
+
+  return true;
+}
+
+
+bool edfx_t::set_layout( const std::vector<int> & bytes_per_record )
+{
+  if ( mode != +1 ) return false;
+
+  // the EDF header has now been written
+  hsize = edfx_tell( file ) - 16;
+
+  ns = bytes_per_record.size();
+  nbytes = bytes_per_record;
+  choff.resize( ns );
+  rsize = 0;
+  for (int s=0; s<ns; s++)
+    {
+      choff[s] = rsize;
+      rsize += nbytes[s];
+    }
+  return true;
+}
+
+
+bool edfx_t::write_records( const byte_t * p , const int n )
+{
+  if ( mode != +1 || n < 1 ) return false;
+  if ( n > K || nr % K != 0 )
+    Helper::halt( "internal error: EDFX records must be written in whole chunks" );
+
+  std::vector<byte_t> raw;
+
+  for (int s=0; s<ns; s++)
+    {
+      // gather this channel across the n records
+      raw.resize( (uint64_t)n * nbytes[s] );
+      for (int r=0; r<n; r++)
+	memcpy( raw.data() + (uint64_t)r * nbytes[s] , p + (uint64_t)r * rsize + choff[s] , nbytes[s] );
+
+      uLongf len = compressBound( raw.size() );
+      if ( zbuf.size() < len ) zbuf.resize( len );
+      if ( compress2( zbuf.data() , &len , raw.data() , raw.size() , Z_DEFAULT_COMPRESSION ) != Z_OK )
+	return false;
+
+      offset.push_back( edfx_tell( file ) );
+      csize.push_back( len );
+
+      if ( fwrite( zbuf.data() , 1 , len , file ) != len ) return false;
+    }
+
+  nr += n;
+  return true;
+}
+
+
+void edfx_t::close()
+{
+
+  if ( file != NULL && mode == +1 )
+    {
+      //
+      // index and trailer
+      //
+
+      const uint64_t idx_offset = edfx_tell( file );
+
+      std::vector<byte_t> idx;
+      put_u32( idx , ns );
+      put_u32( idx , nr );
+      put_u32( idx , K );
+      for (int s=0; s<ns; s++) put_u32( idx , nbytes[s] );
+      for (uint64_t i=0; i<offset.size(); i++)
+	{
+	  put_u64( idx , offset[i] );
+	  put_u32( idx , csize[i] );
+	}
+      put_u64( idx , idx_offset );
+      idx.insert( idx.end() , edfx_idx_magic , edfx_idx_magic + 8 );
+      fwrite( idx.data() , 1 , idx.size() , file );
+
+      // patch the EDF header size
+      std::vector<byte_t> h;
+      put_u32( h , hsize );
+      edfx_seek( file , 8 , SEEK_SET );
+      fwrite( h.data() , 1 , 4 , file );
+    }
+
+  if ( file != NULL ) fclose( file );
+  file = NULL;
+  mode = 0;
+
+  hsize = ns = nr = rsize = 0;
+  nbytes.clear();
+  choff.clear();
+  offset.clear();
+  csize.clear();
+  cached_chunk.clear();
+  cache.clear();
+  zbuf.clear();
+  hpos = 0;
+}
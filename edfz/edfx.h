@@ -0,0 +1,157 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_EDFX_H__
+#define __LUNA_EDFX_H__
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+
+typedef unsigned char byte_t;
+
+//
+// EDFX: channel-major, chunked EDF container (.edfx)
+//
+//  EDF and EDFZ are both record-major, so pulling one channel out
+//  means reading (or decompressing) every byte of the file.  Here,
+//  each channel is instead stored as a series of independently
+//  zlib-compressed chunks, each spanning a fixed number of EDF
+//  records; reading one channel, or a short window, only touches the
+//  chunks needed.
+//
+//  Layout (all integers little-endian)
+//
+//     char[8]     'EDFXv1\0\0'
+//     int32       size of EDF header (H)
+//     int32       records per chunk (K)
+//     char[H]     EDF header, exactly as for a standard EDF (so
+//                 labels, EDF+ flags, etc are all unchanged)
+//     ...         chunks (zlib streams), for chunk 0 of channel 0, 1,
+//                 ..., ns-1, then chunk 1, etc; a chunk holds the
+//                 EDF-encoded bytes of one channel for K records
+//                 (fewer for the final chunk)
+//     index       int32 ns, int32 nr, int32 K,
+//                 int32[ns] bytes per record for each channel, then
+//                 for each chunk (as above) uint64 offset, uint32 size
+//     uint64      offset of the index
+//     char[8]     'EDFXidx\0'
+//
+//  EDF Annotations channels (incl. any EDF+D time-track) are held as
+//  any other channel.
+//
+
+struct edfx_t
+{
+
+  edfx_t();
+
+  ~edfx_t() { close(); }
+
+  //
+  // reading
+  //
+
+  bool open_for_reading( const std::string & fn );
+
+  // sequential read of the EDF header (i.e. for edf_header_t::read())
+  size_t read( byte_t * p , const int n );
+
+  // fill in bytes [ off , off + n ) of record r (i.e. laid out as in
+  // a standard EDF record), decompressing only the chunks needed
+  bool read_record( const int r , const int off , const int n , byte_t * p );
+
+  int nrecords() const { return nr; }
+
+  int record_size() const { return rsize; }
+
+  // compressed bytes read so far
+  uint64_t bytes_read() const { return nbytes_read; }
+
+
+  //
+  // writing: open, then write the EDF header to 'file' directly, then
+  // call set_layout(), then write_records() for K records at a time
+  //
+
+  bool open_for_writing( const std::string & fn , const int recs_per_chunk );
+
+  bool set_layout( const std::vector<int> & bytes_per_record );
+
+  // p holds n (<= K) whole EDF records, i.e. as a standard EDF
+  bool write_records( const byte_t * p , const int n );
+
+  void close();
+
+  int records_per_chunk() const { return K; }
+
+
+  //
+  // Members
+  //
+
+  std::string filename;
+
+  FILE * file;
+
+ private:
+
+  int mode;  // 0 closed, -1 read from , +1 write to
+
+  int hsize;
+
+  int K;
+
+  int ns;
+
+  int nr;
+
+  int rsize;
+
+  // per channel: bytes per record, and offset within a record
+  std::vector<int> nbytes;
+
+  std::vector<int> choff;
+
+  // chunk index, [ chunk * ns + channel ]
+  std::vector<uint64_t> offset;
+
+  std::vector<uint32_t> csize;
+
+  // reading: next header byte
+  int hpos;
+
+  // reading: the last decompressed chunk for each channel
+  std::vector<int> cached_chunk;
+
+  std::vector<std::vector<byte_t> > cache;
+
+  std::vector<byte_t> zbuf;
+
+  uint64_t nbytes_read;
+
+  bool load_chunk( const int s , const int c );
+
+};
+
+#endif
@@ -22,6 +22,17 @@
 
 #include "edfz/edfz.h"
 
+#include <cstring>
+#include <cstdio>
+#include <iterator>
+
+#ifndef WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 
 bool edfz_t::open_for_reading( const std::string & fn )
 {    
@@ -90,21 +101,12 @@ void edfz_t::writestring( const double & s , int n )
 // primary read, given an index (for record)
 bool edfz_t::read_record( int r, byte_t * p , const int n )
 {
-  std::cout << "\n\n --> entering read_record \n";
-  std::map<int,int64_t>::const_iterator ii = index.find( r );
-  if ( ii == index.end() ) return false;
-  
-  if ( ! seek( ii->second ) ) return false;
+  const int64_t offset = get_index( r );
+  if ( offset < 0 ) return false;
   
-  // tmp
-  int64_t offset = tell();
-  std::cout << " offset = " << offset << " for rec " << r << " " << ii->second << "\n";
-  // --tmp
+  if ( ! seek( offset ) ) return false;
   
-  ssize_t ss = bgzf_read( file , p , n );
-  std::cout << "done read\n";
-  return ss == n ; 
-  //  return bgzf_read( file , p , n ) == n ;
+  return bgzf_read( file , p , n ) == n ;
 }
 
 // for header
@@ -137,6 +139,7 @@ bool edfz_t::eof()
 
 void edfz_t::clear_index() 
 {
+  unmap_index();
   index.clear();
   tindex.clear();
   annots.clear();
@@ -144,39 +147,144 @@ void edfz_t::clear_index()
 
 void edfz_t::add_index( int r , int64_t offset , uint64_t tp , const std::string & a )
 {
+  if ( r < 0 ) return;
+  own_index();
+  if ( r >= index.size() )
+    {
+      index.resize( r + 1 , -1 );
+      tindex.resize( r + 1 , 0 );
+      annots.resize( r + 1 , "." );
+    }
   index[ r ] = offset ;
   tindex[ r ] = tp ;
   annots[ r ] = a ;
 }
 
-int64_t edfz_t::get_index( int r ) 
+
+//
+// .idx formats
+//
+//  text (EDFZv1) : 'EDFZv1', record size, then one line per record:
+//                  offset <tab> time-point <tab> annots
+//
+//  binary (EDFZv2) : all little-endian, fixed-width, 8-byte aligned
+//                    arrays (i.e. can be used as a memory map)
+//     char[8]    'EDFZv2\0\0'
+//     int32      record size
+//     int32      n (records)
+//     int64[n]   offsets
+//     uint64[n]  time-points
+//     uint64[n+1] start of each record's annots in the text block (+ end)
+//     char[]     annots text block
+//
+
+static const char edfz_idx_v2[8] = { 'E','D','F','Z','v','2','\0','\0' };
+
+bool edfz_t::read_index()
 {
-  std::map<int,int64_t>::const_iterator ii = index.find( r );
-  if ( ii == index.end() ) return -1;
-  return ii->second;
+  std::string indexname = filename + ".idx";
+  if ( ! Helper::fileExists( indexname ) ) return false;
+  clear_index();
+  std::ifstream I1( indexname.c_str() , std::ios::in | std::ios::binary );
+
+  char magic[8];
+  I1.read( magic , 8 );
+  if ( I1.gcount() == 8 && memcmp( magic , edfz_idx_v2 , 8 ) == 0 ) 
+    {
+      I1.close();
+      return read_index_binary();
+    }
+  
+  I1.clear();
+  I1.seekg( 0 );
+  return read_index_text( I1 );
 }
 
-uint64_t edfz_t::get_tindex( int r ) 
+bool edfz_t::read_index_binary()
 {
-  std::map<int,uint64_t>::const_iterator ii = tindex.find( r );
-  if ( ii == tindex.end() ) return 0;
-  return ii->second;
+  const std::string indexname = filename + ".idx";
+
+  unmap_index();
+  
+#ifndef WINDOWS
+  int fd = open( indexname.c_str() , O_RDONLY );
+  if ( fd == -1 ) return false;
+  struct stat st;
+  if ( fstat( fd , &st ) == 0 && st.st_size > 0 )
+    {
+      void * m = mmap( NULL , st.st_size , PROT_READ , MAP_PRIVATE , fd , 0 );
+      if ( m != MAP_FAILED )
+	{
+	  imap = (const char*)m;
+	  imap_size = st.st_size;
+	}
+    }
+  ::close( fd );
+#endif
+
+  // otherwise (or on Windows), read the whole file
+  if ( imap == NULL )
+    {
+      std::ifstream I1( indexname.c_str() , std::ios::in | std::ios::binary );
+      imap_copy.assign( std::istreambuf_iterator<char>( I1 ) , std::istreambuf_iterator<char>() );
+      imap_size = imap_copy.size();
+      if ( imap_size ) imap = imap_copy.data();
+    }
+
+  // header: magic, record size, n; then the three fixed-width arrays,
+  // which must fit in the file (checked before anything is indexed)
+  int32_t rs = 0 , n = 0;
+  if ( imap == NULL || imap_size < 16 ) 
+    Helper::halt( "bad EDFZv2 .idx: " + indexname );
+  memcpy( &rs , imap + 8 , sizeof(int32_t) );
+  memcpy( &n , imap + 12 , sizeof(int32_t) );
+  if ( n < 0 || 16 + ( 3 * (uint64_t)n + 1 ) * 8 > imap_size )
+    Helper::halt( "bad EDFZv2 .idx: " + indexname );
+
+  imap_index  = (const int64_t*)( imap + 16 );
+  imap_tindex = (const uint64_t*)( imap + 16 + 8 * (uint64_t)n );
+  imap_aoff   = (const uint64_t*)( imap + 16 + 16 * (uint64_t)n );
+  imap_text   = imap + 16 + ( 3 * (uint64_t)n + 1 ) * 8;
+
+  // annots offsets must be ordered and within the text block
+  const uint64_t text_size = imap + imap_size - imap_text;
+  if ( imap_aoff[0] != 0 || imap_aoff[n] > text_size )
+    Helper::halt( "bad EDFZv2 .idx: " + indexname );
+  for (int r=0; r<n; r++)
+    if ( imap_aoff[r] > imap_aoff[r+1] )
+      Helper::halt( "bad EDFZv2 .idx: " + indexname );
+  
+  imap_n = n;
+  record_size = rs;
+  return true;
 }
 
-std::string edfz_t::get_annots( int r )
+void edfz_t::unmap_index()
 {
-  std::map<int,std::string>::const_iterator ii = annots.find( r );
-  if ( ii == annots.end() ) return ".";
-  return ii->second;
+#ifndef WINDOWS
+  if ( imap != NULL && imap_copy.empty() )
+    munmap( (void*)imap , imap_size );
+#endif
+  imap = NULL;
+  imap_size = 0;
+  imap_n = 0;
+  imap_copy.clear();
 }
 
+void edfz_t::own_index()
+{
+  if ( imap == NULL ) return;
+  const int n = imap_n;
+  index.assign( imap_index , imap_index + n );
+  tindex.assign( imap_tindex , imap_tindex + n );
+  annots.resize( n );
+  for (int r=0; r<n; r++)
+    annots[r] = get_annots( r );
+  unmap_index();
+}
 
-bool edfz_t::read_index()
+bool edfz_t::read_index_text( std::ifstream & I1 )
 {
-  std::string indexname = filename + ".idx";
-  if ( ! Helper::fileExists( indexname ) ) return false;
-  index.clear();
-  std::ifstream I1( indexname.c_str() , std::ios::in );
   
   // index version
   std::string line;
@@ -190,7 +298,6 @@ bool edfz_t::read_index()
     Helper::halt( "expecting EDFZv1 format index: second entry = # records" );
 
   // indices
-  int r = 0;
   while ( ! I1.eof() )
     {
       int64_t offset;
@@ -212,19 +319,43 @@ bool edfz_t::read_index()
       if ( ! Helper::str2int64( tok[1] , &tp ) )
 	Helper::halt( "bad .idx:\n" + line );
 
-      index[ r ] = offset ;
-      tindex[ r ] = tp;
-      annots[ r ] = tok[2];
-      ++r;
+      index.push_back( offset );
+      tindex.push_back( tp );
+      annots.push_back( tok[2] );
     }    
   I1.close();
   return true;
 }
 
-bool edfz_t::write_index( const int rs )
+bool edfz_t::write_index( const int rs , const bool binary )
 {
+  own_index();
   record_size = rs;
   std::string indexname = filename + ".idx";
+
+  const int32_t n = index.size();
+  
+  if ( binary )
+    {
+      std::ofstream O1( indexname.c_str() , std::ios::out | std::ios::binary );
+      const int32_t rs32 = record_size;
+      O1.write( edfz_idx_v2 , 8 );
+      O1.write( (const char*)&rs32 , sizeof(int32_t) );
+      O1.write( (const char*)&n , sizeof(int32_t) );
+      O1.write( (const char*)index.data() , sizeof(int64_t) * (uint64_t)n );
+      O1.write( (const char*)tindex.data() , sizeof(uint64_t) * (uint64_t)n );
+      uint64_t a = 0;
+      for (int r=0; r<=n; r++)
+	{
+	  O1.write( (const char*)&a , sizeof(uint64_t) );
+	  if ( r < n ) a += annots[r].size();
+	}
+      for (int r=0; r<n; r++)
+	O1.write( annots[r].data() , annots[r].size() );
+      O1.close();
+      return O1.good();
+    }
+  
   std::ofstream O1( indexname.c_str() , std::ios::out );
   
   // index version
@@ -234,14 +365,78 @@ bool edfz_t::write_index( const int rs )
   O1 << record_size << "\n";
   
   // offsets, and time-stamps
-  std::map<int,int64_t>::const_iterator ii = index.begin();
-  while ( ii != index.end() )
+  for (int r=0; r<n; r++)
+    O1 << index[r] << "\t"
+       << tindex[r] << "\t"
+       << annots[r] << "\n";
+  O1.close();
+  return true;
+}
+
+
+bool edfz_t::index_records( const int hs , const int rs , const int n )
+{
+
+  // block table: compressed offset and uncompressed size of each
+  // (non-empty) BGZF block, i.e. from each block's BSIZE (header) and
+  // ISIZE (footer) fields, without decompressing anything; this does
+  // not depend on how the writer split the data into blocks
+  
+  FILE * in = fopen( filename.c_str() , "rb" );
+  if ( in == NULL ) return false;
+
+  std::vector<int64_t> caddr;
+  std::vector<uint64_t> ustart;
+  
+  int64_t c = 0;
+  uint64_t u = 0;
+  
+  while ( 1 )
     {
-      O1 << ii->second << "\t"
-	 << tindex[ ii->first ] << "\t"
-	 << annots[ ii->first ] << "\n";
-      ++ii;
+      uint8_t h[18];
+      const size_t nh = fread( h , 1 , 18 , in );
+      if ( nh == 0 ) break;
+      if ( nh != 18 || h[0] != 31 || h[1] != 139 || h[12] != 'B' || h[13] != 'C' )
+	{
+	  fclose( in );
+	  return false;
+	}
+      const int block_length = ( h[16] | ( h[17] << 8 ) ) + 1;
+      uint8_t f[4];
+      if ( fseek( in , c + block_length - 4 , SEEK_SET ) != 0 || fread( f , 1 , 4 , in ) != 4 )
+	{
+	  fclose( in );
+	  return false;
+	}
+      const uint32_t isize = f[0] | ( f[1] << 8 ) | ( f[2] << 16 ) | ( (uint32_t)f[3] << 24 );
+      if ( isize != 0 )
+	{
+	  caddr.push_back( c );
+	  ustart.push_back( u );
+	}
+      c += block_length;
+      u += isize;
     }
-  O1.close();
+  
+  fclose( in );
+  
+  // virtual offset of each record start (any time-stamps or annots
+  // already added are kept)
+  own_index();
+  index.assign( n , -1 );
+  tindex.resize( n , 0 );
+  annots.resize( n , "." );
+  
+  int b = 0;
+  for (int r=0; r<n; r++)
+    {
+      const uint64_t x = hs + (uint64_t)rs * r;
+      while ( b + 1 < ustart.size() && ustart[b+1] <= x ) ++b;
+      if ( b >= ustart.size() || x < ustart[b] || x >= u ) 
+	return false;
+      index[r] = ( caddr[b] << 16 ) | (int64_t)( x - ustart[b] );
+    }
+
+  record_size = rs;
   return true;
 }
@@ -40,8 +40,17 @@ struct edfz_t {
     record_size = 0;
     mode = 0;
     index.clear();
+    imap = NULL;
+    imap_size = 0;
+    imap_n = 0;
   }
 
+  ~edfz_t() { unmap_index(); }
+
+  // not copyable (may hold a memory map of the .idx)
+  edfz_t( const edfz_t & ) = delete;
+  edfz_t & operator=( const edfz_t & ) = delete;
+  
   bool open_for_reading( const std::string & fn );
 
   bool open_for_writing( const std::string & fn );
@@ -74,15 +83,40 @@ struct edfz_t {
   
   void add_index( int r , int64_t offset , uint64_t tp , const std::string & a );
   
-  int64_t get_index( int r );
+  int64_t get_index( int r ) const
+  { return r < 0 || r >= n_indexed() ? -1 : imap != NULL ? imap_index[r] : index[r] ; }
+
+  uint64_t get_tindex( int r ) const
+  { return r < 0 || r >= n_indexed() ? 0 : imap != NULL ? imap_tindex[r] : tindex[r] ; }
 
-  uint64_t get_tindex( int r ); 
+  std::string get_annots( int r ) const
+  {
+    if ( r < 0 || r >= n_indexed() ) return ".";
+    if ( imap == NULL ) return annots[r];
+    return std::string( imap_text + imap_aoff[r] , imap_aoff[r+1] - imap_aoff[r] );
+  }
 
-  std::string get_annots( int r );
+  int n_indexed() const { return imap != NULL ? imap_n : index.size(); }
   
+  // reads either form of .idx (text EDFZv1, or binary EDFZv2)
   bool read_index();
 
-  bool write_index( const int rs );
+  bool write_index( const int rs , const bool binary = false );
+
+  // set the offsets of a (closed) BGZF file of n fixed-size records
+  // that follow a header of hs bytes, from its block sizes
+  bool index_records( const int hs , const int rs , const int n );
+
+  bool read_index_text( std::ifstream & I1 );
+
+  // maps the binary form read-only, i.e. lookups then go straight to
+  // the mapped arrays rather than to copies
+  bool read_index_binary();
+
+  void unmap_index();
+
+  // copy a mapped index into index[] etc (i.e. before modifying it)
+  void own_index();
 
   //
   // Members
@@ -93,19 +127,45 @@ struct edfz_t {
   std::string filename;
 
   int mode;  // 0 closed, -1 read from , +1 write to
+
+  //
+  // Index: dense, i.e. directly addressed by record number (0..n-1)
+  //
   
-  // record index number -> index into .edfz
-  std::map<int,int64_t> index;
+  // record index number -> index into .edfz (-1 if not set)
+  std::vector<int64_t> index;
   
   // record index number -> time-stamp
   //  (so we don't need to read whole EDF+ to get records)
-  std::map<int,uint64_t> tindex;
+  std::vector<uint64_t> tindex;
 
   // also track EDF annots separately, rather than load from EDF+
-  std::map<int,std::string> annots;
+  std::vector<std::string> annots;
   
   // as specified by EDF header
   int record_size;
+
+  //
+  // Alternatively, a memory-mapped binary (EDFZv2) index: if imap is
+  // set, index[], tindex[] and annots[] are unused
+  //
+
+  const char * imap;
+
+  uint64_t imap_size;
+
+  int imap_n;
+
+  const int64_t * imap_index;
+
+  const uint64_t * imap_tindex;
+
+  const uint64_t * imap_aoff;
+
+  const char * imap_text;
+
+  // i.e. where mmap() is not available, the file is read into this
+  std::vector<char> imap_copy;
   
 };
 
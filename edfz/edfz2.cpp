@@ -22,28 +22,58 @@
 
 #include "edfz/edfz2.h"
 
-bool edfz2_t::open_for_reading( const std::string & fn )
+bool edfz2_t::open_for_reading( const std::string & fn , const int threads )
 {    
   filename = fn;
+
+  // parallel decompression only applies to BGZF files
+  if ( threads > 1 && bgzf_is_bgzf( fn.c_str() ) )
+    {
+      bz = bgzf_open( fn.c_str() , "r" );
+      if ( bz == NULL ) return false;
+      bgzf_mt( bz , threads , 0 );
+      return true;
+    }
+  
   zin.open( fn.c_str() , std::ios::in | std::ios::binary );
   return zin.good();
 }
 
-bool edfz2_t::open_for_writing( const std::string & fn )
+bool edfz2_t::open_for_writing( const std::string & fn , const int threads , const bool bgzf )
 {    
   filename = fn;
+
+  if ( threads > 1 || bgzf )
+    {
+      bz = bgzf_open( fn.c_str() , "w" );
+      if ( bz == NULL ) return false;
+      bgzf_mt( bz , threads , 0 );
+      return true;
+    }
+  
   zout.open( fn.c_str() , std::ios::out | std::ios::binary );  
   return zout.good();
 }
 
 void edfz2_t::close()
 {
+  if ( bz != NULL ) 
+    {
+      if ( bgzf_close( bz ) != 0 ) 
+	Helper::halt( "problem closing " + filename );
+      bz = NULL;
+    }
   if ( zin.is_open() ) zin.close();
   if ( zout.is_open() ) zout.close();
 }
 
 size_t edfz2_t::read( byte_t * p , const int n )
 {
+  if ( bz != NULL ) 
+    {
+      const ssize_t rdsz = bgzf_read( bz , p , n );
+      return rdsz < 0 ? 0 : rdsz;
+    }
   zin.read(reinterpret_cast<char*>(p), n);
   return zin.gcount();
 }
@@ -51,6 +81,12 @@ size_t edfz2_t::read( byte_t * p , const int n )
 // primary write, returns the index 
 void edfz2_t::write( byte_t * p , const int n )
 {
+  if ( bz != NULL ) 
+    {
+      if ( bgzf_write( bz , p , n ) != n ) 
+	Helper::halt( "problem writing " + filename );
+      return;
+    }
   zout.write( reinterpret_cast<char*>(p), n );
 }
 
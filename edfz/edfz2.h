@@ -29,6 +29,7 @@
 #include <map>
 #include "helper/helper.h"
 #include "helper/zfstream.h"
+#include "edfz/bgzf.h"
 #include <fstream>
 
 typedef unsigned char byte_t;
@@ -37,16 +38,23 @@ typedef unsigned char byte_t;
 // abandon random access.. i.e. will preread all in a single go, but
 // also will use larger record sizes for better compression...
 
+// with threads > 1, files are instead written as BGZF (i.e. still a
+// valid, multi-member gzip file, so readable either way) with blocks
+// compressed in parallel; BGZF files are likewise read with parallel
+// decompression
+
 struct edfz2_t { 
 
   edfz2_t() 
   {
     filename = "";
+    bz = NULL;
   }
   
-  bool open_for_reading( const std::string & fn );
+  bool open_for_reading( const std::string & fn , const int threads = 1 );
   
-  bool open_for_writing( const std::string & fn );
+  // bgzf: write BGZF even if single-threaded (e.g. to be indexed)
+  bool open_for_writing( const std::string & fn , const int threads = 1 , const bool bgzf = false );
   
   void close();
   
@@ -68,6 +76,9 @@ struct edfz2_t {
   gzofstream zout;
 
   gzifstream zin;
+
+  // multithreaded BGZF alternative to zout/zin (threads > 1)
+  BGZF * bz;
       
   std::string filename;
     
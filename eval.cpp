@@ -2741,6 +2741,12 @@ void proc_write( edf_t & edf , param_t & param )
   
   // write a .edfz and .edfz.idx
   const bool edfz = param.yesno( "edfz" );
+
+  // or a channel-major chunked .edfx
+  const bool edfx = param.yesno( "edfx" );
+
+  if ( edfz && edfx )
+    Helper::halt( "cannot specify both edfz and edfx" );
   
   // add 'tag' to new EDF
   std::string filename = edf.filename;
@@ -2757,6 +2763,10 @@ void proc_write( edf_t & edf , param_t & param )
        Helper::file_extension( filename, "EDF.GZ" ) ) 
     filename = filename.substr(0 , filename.size() - 7 );
 
+  if ( Helper::file_extension( filename, "edfx" ) || 
+       Helper::file_extension( filename, "EDFX" ) ) 
+    filename = filename.substr(0 , filename.size() - 5 );
+
   // make edf-tag optional
   if ( param.has( "edf" ) )
     filename = param.requires( "edf" ) + ".edf" ;
@@ -2773,6 +2783,9 @@ void proc_write( edf_t & edf , param_t & param )
 
   // set .edf.gz as main EDFZ file extension
   if ( edfz ) filename += ".gz";
+
+  // .edf --> .edfx
+  if ( edfx ) filename += "x";
   
   //
   // optionally, allow directory change
@@ -5715,6 +5728,168 @@ void cmd_t::parse_special( const std::string & tok0 , const std::string & tok1 )
       globals::edf_stream_read = Helper::yesno( tok1 );
       return;
     }
+
+
+  
+  // memory-map standard EDFs, and decode records directly from the
+  // mapped region (rather than per-record fseek()/fread() calls)
+  if ( Helper::iequals( tok0, "mmap" ) ) 
+    {
+      globals::edf_mmap = Helper::yesno( tok1 );
+      return;
+    }
+
+
+  // hold loaded signals in contiguous, channel-major buffers (rather
+  // than as per-record/per-channel vectors)
+  if ( Helper::iequals( tok0, "channel-store" ) ) 
+    {
+      globals::edf_channel_store = Helper::yesno( tok1 );
+      return;
+    }
+
+
+  // max. size (MB) of a single read of consecutive EDF records (0 means
+  // one record per read)
+  if ( Helper::iequals( tok0, "read-chunk" ) ) 
+    {
+      if ( ! Helper::str2int( tok1 , &globals::edf_read_chunk ) || globals::edf_read_chunk < 0 )
+	Helper::halt( "read-chunk requires a non-negative integer (MB), e.g. read-chunk=16" );
+      return;
+    }
+
+
+  // ask the OS to prefetch the next chunk of records while the current
+  // one is being processed
+  if ( Helper::iequals( tok0, "readahead" ) ) 
+    {
+      globals::edf_readahead = Helper::yesno( tok1 );
+      return;
+    }
+
+
+  // open/warm the next sample-list row's files on a background
+  // thread while the current row is processed (also --prefetch=1)
+  if ( Helper::iequals( tok0, "prefetch" ) || Helper::iequals( tok0, "--prefetch" ) ) 
+    {
+      globals::edf_prefetch = Helper::yesno( tok1 );
+      return;
+    }
+
+
+  // read only the bytes of the requested (sig=) channels from each
+  // record, rather than whole records
+  if ( Helper::iequals( tok0, "selective-read" ) ) 
+    {
+      globals::edf_selective_read = Helper::yesno( tok1 );
+      return;
+    }
+
+
+  // cap memory used by loaded EDF records, e.g. mem-limit=2G (K, M or
+  // G suffix; MB if none; 0 means no limit): least recently used,
+  // unmodified records are dropped, and re-read as needed
+  if ( Helper::iequals( tok0, "mem-limit" ) ) 
+    {
+      std::string t = Helper::toupper( tok1 );
+      double mult = 1024.0 * 1024.0;
+      if ( t.size() > 1 )
+	{
+	  const char c = t[ t.size() - 1 ];
+	  if ( c == 'K' || c == 'M' || c == 'G' )
+	    {
+	      mult = c == 'K' ? 1024.0 : c == 'M' ? 1024.0 * 1024.0 : 1024.0 * 1024.0 * 1024.0;
+	      t = t.substr( 0 , t.size() - 1 );
+	    }
+	}
+      double x = 0;
+      if ( ! Helper::str2dbl( t , &x ) || x < 0 )
+	Helper::halt( "mem-limit requires a size, e.g. mem-limit=2G or mem-limit=500M" );
+      globals::edf_mem_limit = x * mult;
+      return;
+    }
+
+
+  // for continuous EDFs, compute record/sample positions directly when
+  // pulling signals (rather than via timeline lookups)
+  if ( Helper::iequals( tok0, "slice-fast" ) ) 
+    {
+      globals::slice_fast_path = Helper::yesno( tok1 );
+      return;
+    }
+
+
+  // resolve epoch -> record/sample positions via flat per-epoch
+  // tables (rather than a timeline search per slice)
+  if ( Helper::iequals( tok0, "epoch-tables" ) ) 
+    {
+      globals::epoch_tables = Helper::yesno( tok1 );
+      return;
+    }
+
+  // compile MASK expr=... once and evaluate it over blocks of
+  // epochs (rather than re-parsing and re-binding per epoch)
+  if ( Helper::iequals( tok0, "mask-compile" ) ) 
+    {
+      globals::mask_compile = Helper::yesno( tok1 );
+      return;
+    }
+
+
+  // EDF+D: read (or else write) record time-stamps from a <edf>.tidx
+  // sidecar, so that re-attaching need not scan the time-track
+  if ( Helper::iequals( tok0, "tindex" ) ) 
+    {
+      globals::edf_tindex = Helper::yesno( tok1 );
+      return;
+    }
+
+
+  // WRITE: size (MB) of the output buffer records are assembled into
+  // (0 means the original record-by-record writer)
+  if ( Helper::iequals( tok0, "write-buffer" ) ) 
+    {
+      if ( ! Helper::str2int( tok1 , &globals::edf_write_buffer ) || globals::edf_write_buffer < 0 )
+	Helper::halt( "write-buffer requires a non-negative integer (MB), e.g. write-buffer=16" );
+      return;
+    }
+
+
+  // threads for EDFZ compression (WRITE edfz) and decompression
+  // (attaching a BGZF .edfz); >1 means WRITE edfz outputs BGZF
+  if ( Helper::iequals( tok0, "edfz-threads" ) ) 
+    {
+      if ( ! Helper::str2int( tok1 , &globals::edfz_threads ) || globals::edfz_threads < 1 )
+	Helper::halt( "edfz-threads requires a positive integer, e.g. edfz-threads=4" );
+      return;
+    }
+
+  // WRITE edfz also writes a binary .idx (and always as BGZF); on
+  // attaching, a BGZF .edfz with a .idx is then read on demand, via
+  // the index, rather than preloaded
+  if ( Helper::iequals( tok0, "edfz-index" ) ) 
+    {
+      globals::edfz_index = Helper::yesno( tok1 );
+      return;
+    }
+
+  // WRITE edfx: duration (seconds) of each channel chunk
+  if ( Helper::iequals( tok0, "edfx-chunk" ) ) 
+    {
+      if ( ! Helper::str2dbl( tok1 , &globals::edfx_chunk_sec ) || globals::edfx_chunk_sec <= 0 )
+	Helper::halt( "edfx-chunk requires a positive number of seconds, e.g. edfx-chunk=30" );
+      return;
+    }
+
+  // hold new or modified signals (add_signal(), update_signal()) as
+  // float32 in memory, rather than re-quantizing to int16 each time
+  if ( Helper::iequals( tok0, "precision" ) ) 
+    {
+      if ( Helper::iequals( tok1 , "float" ) ) globals::float_signals = true;
+      else if ( Helper::iequals( tok1 , "int16" ) ) globals::float_signals = false;
+      else Helper::halt( "precision should be float or int16" );
+      return;
+    }
   
 
   
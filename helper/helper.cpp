@@ -2988,6 +2988,7 @@ bool Helper::sl_slicer( const std::string & f , int n , int m , int * s1 , int *
   //  --> check if not an .edf
   if ( Helper::file_extension( f , "edf" )
        || Helper::file_extension( f , "edfz" )
+       || Helper::file_extension( f , "edfx" )
        || Helper::file_extension( f , "edf.gz" ) )
     Helper::halt( "cannot use n/m slicing with EDF inputs" );
   
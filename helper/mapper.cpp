@@ -327,6 +327,8 @@ void Helper::channel_annot_mapper( const std::vector<std::string> & tok , bool h
       edf.header.annotation_channel[c] = anchan[c];
     }
 
+  edf.header.labels_changed();
+
 
   //
   // For this dummy EDF, see which canonical signals ( orig --> HARM ) 
@@ -383,6 +385,8 @@ void Helper::channel_annot_mapper( const std::vector<std::string> & tok , bool h
 	}
       ++ss;
     }
+
+  edf1.header.labels_changed();
   
 
   //
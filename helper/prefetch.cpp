@@ -0,0 +1,114 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "helper/prefetch.h"
+#include "helper/helper.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+
+void prefetch_t::start( const std::vector<std::string> & files )
+{
+  wait();
+  edf_file = files.size() ? files[0] : "";
+  okay = true;
+  worker = std::thread( &prefetch_t::run , this , files );
+}
+
+
+void prefetch_t::wait()
+{
+  if ( worker.joinable() ) worker.join();
+}
+
+
+// n.b. runs on the worker thread: only touches files and okay, and
+// never calls Helper::halt() or the logger
+
+void prefetch_t::run( const std::vector<std::string> files )
+{
+
+  std::vector<char> buf( 1024 * 1024 );
+
+  for (int i=0; i<files.size(); i++)
+    {
+
+      const std::string & f = files[i];
+
+      if ( f == "" || f == "." || Helper::is_folder( f ) ) continue;
+
+      FILE * file = fopen( f.c_str() , "rb" );
+      if ( file == NULL )
+	{
+	  if ( i == 0 ) okay = false;
+	  continue;
+	}
+
+#if ! defined(WINDOWS) && defined(POSIX_FADV_WILLNEED)
+      // whole file: the kernel reads ahead asynchronously
+      posix_fadvise( fileno( file ) , 0 , 0 , POSIX_FADV_WILLNEED );
+#endif
+
+      //
+      // EDF: read the fixed header, check its size field against the
+      // number of signals, then read the per-signal header block
+      // (compressed EDFZ/EDFX/.gz are only advised, above)
+      //
+
+      if ( i == 0 )
+	{
+	  if ( Helper::file_extension( f , "edf" ) || Helper::file_extension( f , "rec" ) )
+	    {
+	      bool good = fread( buf.data() , 1 , 256 , file ) == 256;
+
+	      int hdr = 0 , ns = 0;
+	      if ( good )
+		{
+		  good = Helper::str2int( Helper::lrtrim( std::string( buf.data() + 184 , 8 ) ) , &hdr )
+		    && Helper::str2int( Helper::lrtrim( std::string( buf.data() + 252 , 4 ) ) , &ns )
+		    && ns >= 0 && hdr == 256 * ( ns + 1 );
+		}
+
+	      if ( good )
+		{
+		  const size_t nh = 256 * (size_t)ns;
+		  if ( buf.size() < nh ) buf.resize( nh );
+		  good = fread( buf.data() , 1 , nh , file ) == nh;
+		}
+
+	      okay = good;
+	    }
+	  fclose( file );
+	  continue;
+	}
+
+      //
+      // annotation files: typically small, so read them in full (i.e.
+      // into the page cache)
+      //
+
+      while ( fread( buf.data() , 1 , buf.size() , file ) > 0 ) ;
+
+      fclose( file );
+    }
+
+}
@@ -0,0 +1,77 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_PREFETCH_H__
+#define __LUNA_PREFETCH_H__
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <stdint.h>
+
+//
+// Sample-list prefetcher (prefetch=1)
+//
+//  While one sample-list row is being processed, open the next row's
+//  EDF and annotation files on a background thread, read and check the
+//  EDF header and ask the OS to pull the files into the page cache, so
+//  that the following attach() does not start from a cold disk/network
+//  filesystem.  Nothing is parsed into an edf_t here (attach() is not
+//  thread-safe): the background thread only touches files, and the
+//  header check is only reported (by the main loop) once it has joined.
+//
+
+struct prefetch_t
+{
+
+  prefetch_t() : okay(true) { }
+
+  ~prefetch_t() { wait(); }
+
+  // start warming this set of files (EDF first, then annotations);
+  // waits on any previous request first
+  void start( const std::vector<std::string> & files );
+
+  // block until the current request (if any) has finished
+  void wait();
+
+  // EDF of the last request
+  const std::string & edf() const { return edf_file; }
+
+  // whether that EDF could be opened and (for .edf/.rec) had a
+  // well-formed header: waits for the request to finish first, i.e.
+  // okay is only read after the worker thread has been joined
+  bool edf_okay() { wait(); return okay; }
+
+ private:
+
+  void run( const std::vector<std::string> files );
+
+  std::thread worker;
+
+  std::string edf_file;
+
+  // written by the worker thread only
+  bool okay;
+
+};
+
+#endif
@@ -865,57 +865,14 @@ bool Eval::execute( const std::vector<Token> & input )
 
 	      // note: args are in reverse order here
 	      
-	      if      ( c.name() == "if" )     res = func.fn_set( args[0] );
-	      else if ( c.name() == "ifnot" )  res = func.fn_notset( args[0] );
-	      
-	      else if ( c.name() == "sqrt" )   res = func.fn_sqrt( args[0] );
-	      else if ( c.name() == "sqr" )    res = func.fn_sqr( args[0] );
-	      else if ( c.name() == "pow" )    res = func.fn_pow( args[1] , args[0] );
-
-	      else if ( c.name() == "rnd" )    res = func.fn_rnd();
-	      else if ( c.name() == "rand" )   res = func.fn_rnd( args[0] );
-	     			
-	      else if ( c.name() == "exp" )    res = func.fn_exp( args[0] );
-	      else if ( c.name() == "log" )    res = func.fn_log( args[0] );
-	      else if ( c.name() == "log10" )  res = func.fn_log10( args[0] );
-
-	      else if ( c.name() == "abs" )    res = func.fn_abs( args[0] );
-	      else if ( c.name() == "floor" )  res = func.fn_floor( args[0] );
-	      else if ( c.name() == "round" )  res = func.fn_round( args[0] );
-	      
-	      else if ( c.name() == "ifelse" ) res = func.fn_ifelse( args[2], args[1], args[0] );
-	      
-	      // vector functions
-	
-	      else if ( c.name() == "element" )  res = func.fn_vec_extract( args[1] , args[0] );
-	      
-	      else if ( c.name() == "length" )   res = func.fn_vec_length( args[0] );	      
-	      else if ( c.name() == "size" )     res = func.fn_vec_length( args[0] );	      
-	      	      
-	      else if ( c.name() == "min" )      res = func.fn_vec_min( args[0] );	      
-	      else if ( c.name() == "max" )      res = func.fn_vec_maj( args[0] );
-		
-	      else if ( c.name() == "sum" )      res = func.fn_vec_sum( args[0] );
-	      else if ( c.name() == "mean" )     res = func.fn_vec_mean( args[0] );
-	      else if ( c.name() == "sd" )       res = func.fn_vec_sd( args[0] );
-	      else if ( c.name() == "sort" )     res = func.fn_vec_sort( args[0] );
-
-	      else if ( c.name() == "num_func" )  res = func.fn_vec_new_float( args );
-	      else if ( c.name() == "int_func" )  res = func.fn_vec_new_int( args );
-	      else if ( c.name() == "txt_func" )  res = func.fn_vec_new_str( args );     
-	      else if ( c.name() == "bool_func" ) res = func.fn_vec_new_bool( args ); 
-	      else if ( c.name() == "c_func" )    res = func.fn_vec_cat( args );
-	      
-	      else if ( c.name() == "any" )       res = func.fn_vec_any( args[0] );	      
-	      else if ( c.name() == "all" )       res = func.fn_vec_all( args[0] );	      
-	      else if ( c.name() == "contains" )  res = func.fn_vec_any( args[1] , args[0] );
-	      else if ( c.name() == "countif" )   res = func.fn_vec_count( args[1] , args[0] );
-	      	    	      
-	      else
+	      const int id = TokenFunctions::function_id( c.name() );
+	      if ( id == -1 )
 		{
 		  errmsg( "did not recognize function " + c.name() + "()" );
 		  return false;
 		}
+	      
+	      res = func.call( id , args );
 
 		      
 		    }
@@ -1170,31 +1127,40 @@ void Eval::bind( const std::map<std::string,annot_map_t> & inputs ,
 	  // store interval duration (in seconds) as variable name == 'annot_name
 	  accum_dbl[ annot_name + "_sec" ].push_back( instance_idx.interval.duration_sec() );
 
-	  // store arbitrary meta-data
-	  std::map<std::string,avar_t*>::const_iterator kk = instance->data.begin();
-	  while ( kk != instance->data.end() )
+	  // store arbitrary meta-data (read directly from the class store)
+	  const meta_store_t * meta = instance->meta();
+	  if ( meta != NULL )
 	    {
-	      
-	      // variable name is annot.var
-	      
-	      const std::string meta_name = annot_name + "." + kk->first;
-	      
-	      const avar_t * value = kk->second;
-	      
-	      // for now... we cannot read IN vectors
-	      // is okay, as currently no way to specify those from files in any case!
-	      // although note.. could be generated via a prior EVAL statement...
-	      
-	      globals::atype_t type = value->atype();
-	      
-	      if      ( type == globals::A_TXT_T ) accum_txt[ meta_name ].push_back( value->text_value() ); 
-	      else if ( type == globals::A_DBL_T ) accum_dbl[ meta_name ].push_back( value->double_value() );
-	      else if ( type == globals::A_INT_T ) accum_int[ meta_name ].push_back( value->int_value() );
-	      else if ( type == globals::A_BOOL_T ) accum_bool[ meta_name ].push_back( value->bool_value() );
-	      
-	      // next meta-data
-	      ++kk;
-	    } 
+	      const int row = instance->row();
+	      std::map<std::string,int>::const_iterator kk = meta->columns().begin();
+	      while ( kk != meta->columns().end() )
+		{
+		  
+		  const int c = kk->second;
+		  
+		  // for now... we cannot read IN vectors
+		  // is okay, as currently no way to specify those from files in any case!
+		  // although note.. could be generated via a prior EVAL statement...
+		  
+		  globals::atype_t type = meta->type( c , row );
+		  
+		  if ( type == globals::A_TXT_T || type == globals::A_DBL_T || type == globals::A_INT_T || type == globals::A_BOOL_T )
+		    {
+		      
+		      // variable name is annot.var
+		      
+		      const std::string meta_name = annot_name + "." + kk->first;
+		      
+		      if      ( type == globals::A_TXT_T ) accum_txt[ meta_name ].push_back( meta->text_value( c , row ) ); 
+		      else if ( type == globals::A_DBL_T ) accum_dbl[ meta_name ].push_back( meta->double_value( c , row ) );
+		      else if ( type == globals::A_INT_T ) accum_int[ meta_name ].push_back( meta->int_value( c , row ) );
+		      else accum_bool[ meta_name ].push_back( meta->bool_value( c , row ) );
+		    }
+		  
+		  // next meta-data
+		  ++kk;
+		} 
+	    }
 	  
 	  // next instance
 	  ++mm;
@@ -1800,3 +1766,368 @@ void Eval::locate_symbols( std::vector<Token> & tok )
       }
   reset_symbols(); // symbol table
 }
+
+
+
+//
+// EvalBatch: compiled, block-wise evaluation
+//
+
+bool EvalBatch::fail( const std::string & msg , std::string * reason )
+{
+  compiled = false;
+  prog.clear();
+  vars.clear();
+  cols.clear();
+  if ( reason != NULL ) *reason = msg;
+  return false;
+}
+
+bool EvalBatch::compile( const std::string & input , std::string * reason )
+{
+
+  fail( "" , NULL );
+  
+  // parse once, as for a single Eval (no assignments)
+
+  Eval tok( input , true );
+
+  if ( ! tok.valid() ) 
+    return fail( "could not parse expression" , reason );
+
+  // variable tokens (these were reset to UNDEF after parsing, so
+  // identify them from the symbol table)
+
+  std::map<const Token*,int> var_slot;
+  
+  std::map<std::string,std::set<Token*> >::const_iterator vv = tok.vartb.begin();
+  while ( vv != tok.vartb.end() )
+    {
+      const int slot = vars.size();
+      vars.push_back( vv->first );
+      std::set<Token*>::const_iterator kk = vv->second.begin();
+      while ( kk != vv->second.end() )
+	{
+	  var_slot[ *kk ] = slot;
+	  ++kk;
+	}
+      ++vv;
+    }
+
+  //
+  // lower each RPN statement to a flat program, checking the stack
+  // depth as we go (which, unlike the values, does not depend on the
+  // row)
+  //
+
+  prog.resize( tok.neval );
+
+  for (int s=0; s<tok.neval; s++)
+    {
+      
+      const std::vector<Token> & rpn = tok.output[s];
+
+      std::vector<op_t> & code = prog[s];
+
+      int depth = 0;
+
+      for (int i=0; i<rpn.size(); i++)
+	{
+
+	  const Token & c = rpn[i];
+
+	  op_t op;
+	  
+	  if ( c.is_assignment() )
+	    return fail( "assignments not allowed" , reason );
+	  
+	  if ( c.is_ident() )
+	    {
+	      std::map<const Token*,int>::const_iterator ss = var_slot.find( &c );
+	      if ( ss != var_slot.end() )
+		{
+		  op.code = OP_VAR;
+		  op.arg = ss->second;
+		}
+	      else
+		{
+		  op.code = OP_CONST;
+		  op.tok = c;
+		}
+	      ++depth;
+	    }
+	  else if ( c.is_operator() )
+	    {
+	      const int nargs = c.type() == Token::NOT_OPERATOR ? 1 : 2;
+	      if ( depth < nargs ) 
+		return fail( "not enough arguments for " + Token::tok_unmap[ c.type() ] , reason );
+	      op.code = nargs == 1 ? OP_UNARY : OP_BINARY ;
+	      op.tok = c;
+	      depth -= nargs - 1;
+	    }
+	  else if ( c.is_function() )
+	    {
+	      std::map<std::string,int>::const_iterator ff = Token::fn_map.find( c.name() );
+	      const int id = TokenFunctions::function_id( c.name() );
+	      if ( ff == Token::fn_map.end() || id == -1 )
+		return fail( "did not recognize function " + c.name() , reason );
+	      
+	      int nargs = ff->second;
+	      
+	      // variable-length: the count was appended by expand_vargs(),
+	      // so is a constant on the top of the stack
+	      if ( nargs == -1 )
+		{
+		  if ( code.empty() || code.back().code != OP_CONST ) 
+		    return fail( "bad argument count for " + c.name() + "()" , reason );
+		  nargs = code.back().tok.as_int();
+		  code.pop_back();
+		  --depth;
+		}
+	      
+	      if ( nargs < 0 || depth < nargs )
+		return fail( "not enough arguments for " + c.name() + "()" , reason );
+	      
+	      op.code = OP_FUNC;
+	      op.arg = id;
+	      op.nargs = nargs;
+	      depth -= nargs - 1;
+	    }
+	  else
+	    return fail( "badly formed eval expression" , reason );
+	  
+	  code.push_back( op );
+	}
+
+      if ( depth != 1 ) 
+	return fail( "badly formed eval expression" , reason );
+    }
+
+  if ( prog.size() == 0 )
+    return fail( "empty expression" , reason );
+  
+  compiled = true;
+
+  return true;
+}
+
+
+bool EvalBatch::uses( const std::string & annot ) const
+{
+  // as named by Eval::bind(): annot , annot_sec and annot.meta
+  const int n = annot.size();
+  for (int v=0; v<vars.size(); v++)
+    {
+      const std::string & var = vars[v];
+      if ( var.size() < n || var.compare( 0 , n , annot ) != 0 ) continue;
+      if ( var.size() == n ) return true;
+      if ( var[n] == '.' && var.size() > n + 1 ) return true;
+      if ( var.size() == n + 4 && var.compare( n , 4 , "_sec" ) == 0 ) return true;
+    }
+  return false;
+}
+
+
+void EvalBatch::resize( const int n )
+{
+  nrows = n;
+  cols.resize( vars.size() );
+  for (int v=0; v<vars.size(); v++)
+    {
+      cols[v].resize( n );
+      for (int r=0; r<n; r++) cols[v][r].set();
+    }
+}
+
+
+void EvalBatch::bind( const int r , const std::map<std::string,annot_map_t> & inputs )
+{
+  
+  //
+  // the same values that Eval::bind() would give each variable,
+  // i.e. one scalar if a single value, otherwise a vector; where one
+  // name gets values of more than one type, the last set (txt, dbl,
+  // int then bool) wins
+  //
+
+  for (int v=0; v<vars.size(); v++)
+    {
+
+      const std::string & var = vars[v];
+
+      std::vector<std::string> accum_txt;
+      std::vector<double> accum_dbl;
+      std::vector<int> accum_int;
+      std::vector<bool> accum_bool;
+      
+      std::map<std::string,annot_map_t>::const_iterator ii = inputs.begin();
+      while ( ii != inputs.end() )
+	{
+	  
+	  const std::string & annot_name = ii->first;
+	  const int n = annot_name.size();
+
+	  if ( var.size() < n || var.compare( 0 , n , annot_name ) != 0 ) { ++ii; continue; } 
+	  
+	  const bool as_id   = var.size() == n;
+	  const bool as_sec  = var.size() == n + 4 && var.compare( n , 4 , "_sec" ) == 0;
+	  const bool as_meta = var.size() > n + 1 && var[n] == '.';
+
+	  if ( ! ( as_id || as_sec || as_meta ) ) { ++ii; continue; }
+
+	  const std::string meta_name = as_meta ? var.substr( n + 1 ) : "";
+	  
+	  annot_map_t::const_iterator mm = ii->second.begin();
+	  while ( mm != ii->second.end() )
+	    {
+
+	      if ( as_id )
+		accum_txt.push_back( mm->first.id );
+	      else if ( as_sec )
+		accum_dbl.push_back( mm->first.interval.duration_sec() );
+	      else
+		{
+		  const meta_store_t * meta = mm->second->meta();
+		  const int c = meta == NULL ? -1 : meta->find_column( meta_name );
+		  if ( c != -1 )
+		    {
+		      const int row = mm->second->row();
+		      globals::atype_t type = meta->type( c , row );
+		      if      ( type == globals::A_TXT_T ) accum_txt.push_back( meta->text_value( c , row ) ); 
+		      else if ( type == globals::A_DBL_T ) accum_dbl.push_back( meta->double_value( c , row ) );
+		      else if ( type == globals::A_INT_T ) accum_int.push_back( meta->int_value( c , row ) );
+		      else if ( type == globals::A_BOOL_T ) accum_bool.push_back( meta->bool_value( c , row ) );
+		    }
+		}
+	      ++mm;
+	    }
+	  ++ii;
+	}
+
+      Token & t = cols[v][r];
+
+      if ( accum_bool.size() == 1 ) t.set( (bool)accum_bool[0] );
+      else if ( accum_bool.size() ) t.set( accum_bool );
+      else if ( accum_int.size() == 1 ) t.set( accum_int[0] );
+      else if ( accum_int.size() ) t.set( accum_int );
+      else if ( accum_dbl.size() == 1 ) t.set( accum_dbl[0] );
+      else if ( accum_dbl.size() ) t.set( accum_dbl );
+      else if ( accum_txt.size() == 1 ) t.set( accum_txt[0] );
+      else if ( accum_txt.size() ) t.set( accum_txt );
+      else t.set(); // UNDEFINED
+    }
+}
+
+
+void EvalBatch::evaluate( std::vector<int> * res )
+{
+
+  const int n = nrows;
+
+  res->assign( n , -1 );
+
+  if ( ! compiled ) return;
+  
+  // rows still valid (an error in any statement invalidates the row)
+  std::vector<bool> okay( n , true );
+
+  // stack of columns
+  std::vector<std::vector<Token> > stack;
+
+  std::vector<Token> args;
+  
+  for (int s=0; s<prog.size(); s++)
+    {
+
+      stack.clear();
+
+      std::vector<op_t> & code = prog[s];
+
+      for (int i=0; i<code.size(); i++)
+	{
+	  
+	  op_t & op = code[i];
+
+	  if ( op.code == OP_CONST )
+	    {
+	      stack.push_back( std::vector<Token>( n , op.tok ) );
+	    }
+	  else if ( op.code == OP_VAR )
+	    {
+	      stack.push_back( cols[ op.arg ] );
+	    }
+	  else if ( op.code == OP_UNARY )
+	    {
+	      std::vector<Token> & x = stack.back();
+	      for (int r=0; r<n; r++)
+		if ( okay[r] ) x[r] = op.tok.operands( x[r] );
+	    }
+	  else if ( op.code == OP_BINARY )
+	    {
+	      std::vector<Token> & t0 = stack.back();
+	      std::vector<Token> & sc = stack[ stack.size() - 2 ];
+	      for (int r=0; r<n; r++)
+		{
+		  if ( ! okay[r] ) continue;
+		  if ( ! sc[r].is_set() || ! t0[r].is_set() ) 
+		    okay[r] = false;
+		  else
+		    sc[r] = op.tok.operands( t0[r] , sc[r] );
+		}
+	      stack.pop_back();
+	    }
+	  else // OP_FUNC
+	    {
+	      const int k = stack.size();
+	      std::vector<Token> out( n );
+	      args.resize( op.nargs );
+	      for (int r=0; r<n; r++)
+		{
+		  if ( ! okay[r] ) continue;
+		  // reverse order, as popped from the stack
+		  for (int a=0; a<op.nargs; a++)
+		    {
+		      args[a] = stack[ k - 1 - a ][r];
+		      if ( ! args[a].is_set() ) okay[r] = false;
+		    }
+		  if ( okay[r] ) out[r] = func.call( op.arg , args );
+		}
+	      stack.resize( k - op.nargs );
+	      stack.push_back( out );
+	    }
+	}
+      
+    }
+
+  //
+  // value of the final statement, as Eval::value( bool & )
+  //
+
+  const std::vector<Token> & e = stack.back();
+  
+  for (int r=0; r<n; r++)
+    {
+      if ( ! okay[r] ) continue;
+
+      bool b;
+      int i;
+      std::vector<bool> bv;
+      std::vector<int> iv;
+      
+      if ( e[r].is_bool( &b ) ) (*res)[r] = b;
+      else if ( e[r].is_int( &i ) ) (*res)[r] = i != 0;
+      else if ( e[r].is_bool_vector( &bv ) )
+	{
+	  (*res)[r] = 0;
+	  for (int j=0; j<bv.size(); j++)
+	    if ( bv[j] ) { (*res)[r] = 1; break; }
+	}
+      else if ( e[r].is_int_vector( &iv ) )
+	{
+	  (*res)[r] = 0;
+	  for (int j=0; j<iv.size(); j++)
+	    if ( iv[j] ) { (*res)[r] = 1; break; }
+	}
+    }
+  
+}
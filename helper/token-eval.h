@@ -38,6 +38,8 @@ struct instance_idx_t;
 typedef std::map<instance_idx_t,instance_t*> annot_map_t;
 
 struct Eval {
+
+  friend struct EvalBatch;
     
   friend std::ostream & operator<<( std::ostream & out , Eval & rhs )
   {
@@ -170,4 +172,69 @@ struct Eval {
 };
 
 
+
+//
+// Compiled, block-wise evaluation of one expression over many rows
+// (e.g. MASK expr over all epochs): parsed and lowered to a flat
+// program once, with variables resolved to slots and functions to
+// ids; each block of rows is then bound (from the same annotation
+// inputs as Eval::bind(), and to the same values) and evaluated one
+// instruction at a time across all rows.  Expressions with
+// assignments or anything else the general Eval path would need are
+// not compiled (compile() returns F)
+//
+
+struct EvalBatch {
+
+ public:
+
+  EvalBatch() : compiled(false) , nrows(0) { Token::init(); }
+
+  bool compile( const std::string & input , std::string * reason = NULL );
+
+  bool valid() const { return compiled; }
+
+  // could variables in the expression be bound from this annotation class?
+  bool uses( const std::string & annot ) const;
+
+  // set the number of rows in the current block
+  void resize( const int n );
+
+  // bind row r of the block (as Eval::bind(), no accumulator)
+  void bind( const int r , const std::map<std::string,annot_map_t> & inputs );
+
+  // evaluate all rows: -1 invalid, else 0/1 as Eval::value(bool&)
+  void evaluate( std::vector<int> * res );
+
+ private:
+
+  enum op_code_t { OP_CONST , OP_VAR , OP_UNARY , OP_BINARY , OP_FUNC };
+
+  struct op_t
+  {
+    op_t() : code(OP_CONST) , arg(0) , nargs(0) { }
+    op_code_t code;
+    int arg;    // variable slot, or function id
+    int nargs;  // function arguments
+    Token tok;  // constant, or operator
+  };
+
+  bool fail( const std::string & msg , std::string * reason );
+
+  bool compiled;
+
+  // one program per ';'-delimited statement
+  std::vector<std::vector<op_t> > prog;
+
+  // variable slots, and their values for each row in the block
+  std::vector<std::string> vars;
+  std::vector<std::vector<Token> > cols;
+
+  int nrows;
+
+  TokenFunctions func;
+
+};
+
+
 #endif
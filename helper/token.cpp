@@ -2593,6 +2593,58 @@ std::vector<bool> Token::as_bool_vector() const
 //
 
 
+int TokenFunctions::function_id( const std::string & fn )
+{
+  static const char * fns[] = { "if" , "ifnot" , "sqrt" , "sqr" , "pow" , "rnd" , "rand" ,
+				"exp" , "log" , "log10" , "abs" , "floor" , "round" , "ifelse" ,
+				"element" , "length" , "size" , "min" , "max" , "sum" , "mean" ,
+				"sd" , "sort" , "num_func" , "int_func" , "txt_func" , "bool_func" ,
+				"c_func" , "any" , "all" , "contains" , "countif" , NULL };
+  for (int i=0; fns[i] != NULL; i++)
+    if ( fn == fns[i] ) return i;
+  return -1;
+}
+
+Token TokenFunctions::call( const int fn , const std::vector<Token> & args ) const
+{
+  switch ( fn )
+    {
+    case 0  : return fn_set( args[0] );
+    case 1  : return fn_notset( args[0] );
+    case 2  : return fn_sqrt( args[0] );
+    case 3  : return fn_sqr( args[0] );
+    case 4  : return fn_pow( args[1] , args[0] );
+    case 5  : return fn_rnd();
+    case 6  : return fn_rnd( args[0] );
+    case 7  : return fn_exp( args[0] );
+    case 8  : return fn_log( args[0] );
+    case 9  : return fn_log10( args[0] );
+    case 10 : return fn_abs( args[0] );
+    case 11 : return fn_floor( args[0] );
+    case 12 : return fn_round( args[0] );
+    case 13 : return fn_ifelse( args[2], args[1], args[0] );
+    case 14 : return fn_vec_extract( args[1] , args[0] );
+    case 15 : 
+    case 16 : return fn_vec_length( args[0] );
+    case 17 : return fn_vec_min( args[0] );
+    case 18 : return fn_vec_maj( args[0] );
+    case 19 : return fn_vec_sum( args[0] );
+    case 20 : return fn_vec_mean( args[0] );
+    case 21 : return fn_vec_sd( args[0] );
+    case 22 : return fn_vec_sort( args[0] );
+    case 23 : return fn_vec_new_float( args );
+    case 24 : return fn_vec_new_int( args );
+    case 25 : return fn_vec_new_str( args );
+    case 26 : return fn_vec_new_bool( args );
+    case 27 : return fn_vec_cat( args );
+    case 28 : return fn_vec_any( args[0] );
+    case 29 : return fn_vec_all( args[0] );
+    case 30 : return fn_vec_any( args[1] , args[0] );
+    case 31 : return fn_vec_count( args[1] , args[0] );
+    default : return Token();
+    }
+}
+
 Token TokenFunctions::fn_set( const Token & tok ) const
 {
     return tok.is_set();
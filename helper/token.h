@@ -340,6 +340,11 @@ struct  TokenFunctions{
   Token fn_vec_any( const Token & tok1 , const Token & tok2 ) const; // vresus 'tok2'
   Token fn_vec_count( const Token & tok1 , const Token & tok2 ) const;
 
+  // dispatch by name (i.e. as used by Eval and EvalBatch): the id is
+  // -1 if not a known function; args are in reverse order
+  static int function_id( const std::string & fn );
+  Token call( const int fn , const std::vector<Token> & args ) const;
+  
 
   void attach( instance_t * m ); 
   void attach( instance_t * m , instance_t * m2 , const std::set<std::string> * ); 
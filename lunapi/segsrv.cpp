@@ -2722,18 +2722,10 @@ int annot_editor_t::apply_class( annot_t * annot ,
 	new_ch = edit.new_ch.value();
 
       // build new instance
-      instance_t * new_inst = new instance_t;
+      instance_t * new_inst = new instance_t( &annot->meta );
 
       if ( ! edit.clear_meta )
-	{
-	  std::map<std::string,avar_t*>::const_iterator dd = inst->data.begin();
-	  while ( dd != inst->data.end() )
-	    {
-	      new_inst->data[ dd->first ] = dd->second->clone();
-	      new_inst->tracker.insert( new_inst->data[ dd->first ] );
-	      ++dd;
-	    }
-	}
+	new_inst->copy( *inst );
 
       std::map<std::string,std::string>::const_iterator mm = edit.meta.begin();
       while ( mm != edit.meta.end() )
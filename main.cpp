@@ -24,6 +24,8 @@
 #include "main.h"
 #include "param.h"
 #include "tests/tests.h"
+#include "tests/bench.h"
+#include "helper/prefetch.h"
 
 #include <algorithm>
 #include <cctype>
@@ -141,6 +143,20 @@ int main(int argc , char ** argv )
       proc_tests( grp , verbose );
       std::exit( globals::retcode );
     }
+
+  //
+  // micro-benchmarks: luna __LUNA_BENCH__ group [key=value ...]
+  //
+
+  if ( argc >= 2 && strcmp( argv[1] , "__LUNA_BENCH__" ) == 0 )
+    {
+      std::string grp  = argc >= 3 ? argv[2] : "";
+      std::vector<std::string> args;
+      for (int i=3; i<argc; i++) args.push_back( argv[i] );
+      global.api();
+      proc_bench( grp , args );
+      std::exit( globals::retcode );
+    }
   
   
   //
@@ -445,6 +461,38 @@ int main(int argc , char ** argv )
 
 
 
+// files named on a sample-list row (EDF, then any annotation files),
+// for prefetch=1; unlike the main loop below, a malformed row is not
+// an error here (it will be reported when it is actually reached)
+
+static std::vector<std::string> sample_list_row_files( const std::string & line ,
+						       const bool has_project_path )
+{
+  std::vector<std::string> tok = Helper::parse( line , "\t" );
+  if ( tok.size() < 2 ) return std::vector<std::string>();
+
+  if ( tok.size() == 3 && tok[2] == "." ) tok.resize(2);
+  if ( globals::skip_sl_annots || globals::skip_nonedf_annots ) tok.resize(2);
+
+  std::vector<std::string> files;
+  for (int t=1;t<tok.size();t++)
+    {
+      std::vector<std::string> fields = t == 1
+	? std::vector<std::string>( 1 , tok[t] )
+	: Helper::parse( tok[t] , globals::file_list_delimiter );
+
+      for (int f=0;f<fields.size();f++)
+	{
+	  std::string fname = Helper::unquote( fields[f] );
+	  if ( has_project_path && fname != "." && fname[0] != globals::folder_delimiter )
+	    fname = globals::project_path + fname;
+	  files.push_back( t == 1 ? fname : Helper::expand( fname ) );
+	}
+    }
+  return files;
+}
+
+
 void process_edfs( cmd_t & cmd )
 {
   
@@ -465,7 +513,7 @@ void process_edfs( cmd_t & cmd )
 
   std::string f = cmd.data();
 
-  // use .edf (or .EDF extension, or .rec or .edfz or .edf.gz ) to
+  // use .edf (or .EDF extension, or .rec or .edfz or .edfx or .edf.gz ) to
   // indicate 'single EDF' mode, '.rec'
 
   f = f.substr( (int)f.size() - 4 >= 0 ? (int)f.size() - 4 : 0 );
@@ -475,11 +523,11 @@ void process_edfs( cmd_t & cmd )
   if ( ! single_edf ) 
     {
 
-      // also test .edfz or .edf.gz
+      // also test .edfz, .edfx or .edf.gz
       f = cmd.data();
       f = f.substr( (int)f.size() - 5 >= 0 ? (int)f.size() - 5 : 0 );
       
-      if ( Helper::iequals( f , ".edfz" ) ) 
+      if ( Helper::iequals( f , ".edfz" ) || Helper::iequals( f , ".edfx" ) ) 
 	single_edf = true;
       else 
 	{
@@ -573,7 +621,15 @@ void process_edfs( cmd_t & cmd )
   int processed = 0;
   int actual = 0;
 
-  while ( single_edf || ! EDFLIST.eof() )
+  // prefetch=1: the next row is read one step early, and its files
+  // warmed on a background thread while this row is processed
+
+  prefetch_t prefetcher;
+  std::string next_line;
+  bool has_next_line = false;
+  bool prefetched = false;
+  
+  while ( single_edf || has_next_line || ! EDFLIST.eof() )
     {
 
       // each line should contain (tab-delimited)  
@@ -588,8 +644,20 @@ void process_edfs( cmd_t & cmd )
       if ( ! single_edf )
 	{
 	  std::string line;
-	  
-	  Helper::safe_getline( EDFLIST , line);
+
+	  if ( has_next_line )
+	    {
+	      line = next_line;
+	      has_next_line = false;
+
+	      // report the background header check (n.b. edf_okay() waits
+	      // for it to finish)
+	      if ( prefetched && ! prefetcher.edf_okay() )
+		logger << "  ** prefetch: could not open, or bad header in, " << prefetcher.edf() << "\n";
+	      prefetched = false;
+	    }
+	  else
+	    Helper::safe_getline( EDFLIST , line);
 	  
 	  if ( line == "" ) continue;
 
@@ -692,7 +760,8 @@ void process_edfs( cmd_t & cmd )
 	  // remove .edf from ID, making file name ==> ID 
 	  if ( Helper::file_extension( rootname , "edf" ) )
 	    rootname = rootname.substr( 0 , rootname.size() - 4 );
-	  else if ( Helper::file_extension( rootname , "edfz" ) )
+	  else if ( Helper::file_extension( rootname , "edfz" )
+		    || Helper::file_extension( rootname , "edfx" ) )
 	    rootname = rootname.substr( 0 , rootname.size() - 5 );
 	  else if (  Helper::file_extension( rootname , "edf.gz" ) )
 	    rootname = rootname.substr( 0 , rootname.size() - 7 );
@@ -1170,6 +1239,35 @@ void process_edfs( cmd_t & cmd )
 
       cmd.replace_wildcards( rootname );
 
+
+      //
+      // Start warming the next row's files (prefetch=1)
+      //
+
+      if ( globals::edf_prefetch && ! single_edf )
+	{
+	  while ( ! has_next_line && ! EDFLIST.eof() )
+	    {
+	      Helper::safe_getline( EDFLIST , next_line );
+	      has_next_line = next_line != "";
+	    }
+	  
+	  // i.e. do not bother if outside of a row slice
+	  const int next_n = processed + 2;
+	  const bool in_slice = ! ( ( globals::sample_list_min != -1 || globals::sample_list_max != -1 )
+				    && ( next_n < globals::sample_list_min || next_n > globals::sample_list_max ) );
+	  
+	  if ( has_next_line && in_slice )
+	    {
+	      std::vector<std::string> files = sample_list_row_files( next_line , has_project_path );
+	      if ( files.size() ) 
+		{
+		  prefetcher.start( files );
+		  prefetched = true;
+		}
+	    }
+	}
+
       
       //
       // Evaluate all commands
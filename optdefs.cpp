@@ -51,6 +51,22 @@ void optdefs_t::init()
   globals::optdefs().add( "inputs", "include" , OPT_FILE_T , "File of IDs to include" );
   globals::optdefs().add( "inputs", "path" , OPT_PATH_T , "Set project/sample-list 'current path' (i.e. for relative sample list file)");
   globals::optdefs().add( "inputs", "preload" , OPT_BOOL_T , "Read all EDF(+) records on firat attaching" );
+  globals::optdefs().add( "inputs", "mmap" , OPT_BOOL_T , "Memory-map standard EDF(+) files for record reads (falls back to stdio)" );
+  globals::optdefs().add( "inputs", "channel-store" , OPT_BOOL_T , "Hold loaded signals in contiguous per-channel buffers" );
+  globals::optdefs().add( "inputs", "read-chunk" , OPT_INT_T , "Max. MB per read of consecutive EDF records (default 16; 0 = one record per read)" );
+  globals::optdefs().add( "inputs", "readahead" , OPT_BOOL_T , "Prefetch the next chunk of EDF records in the background" );
+  globals::optdefs().add( "inputs", "prefetch" , OPT_BOOL_T , "Warm the next sample-list row's EDF/annotation files in the background (and check its EDF header)" );
+  globals::optdefs().add( "inputs", "selective-read" , OPT_BOOL_T , "Read only the requested channels' bytes from each EDF record" );
+  globals::optdefs().add( "inputs", "mem-limit" , OPT_STR_T , "Cap memory for loaded EDF records, e.g. 2G or 500M (LRU, re-read on demand)" );
+  globals::optdefs().add( "inputs", "slice-fast" , OPT_BOOL_T , "Direct record/sample arithmetic when pulling signals from continuous EDFs (default T)" );
+  globals::optdefs().add( "inputs", "epoch-tables" , OPT_BOOL_T , "Flat per-epoch record/sample tables for epoch-wise signal pulls (default T)" );
+  globals::optdefs().add( "inputs", "mask-compile" , OPT_BOOL_T , "Compiled, block-wise evaluation of MASK expr=... over all epochs (default T)" );
+  globals::optdefs().add( "inputs", "write-buffer" , OPT_INT_T , "MB of EDF records assembled per write in WRITE (default 16; 0 = record-by-record)" );
+  globals::optdefs().add( "inputs", "edfz-threads" , OPT_INT_T , "Threads for EDFZ (BGZF) compression in WRITE and decompression on attach (default 1)" );
+  globals::optdefs().add( "inputs", "edfz-index" , OPT_BOOL_T , "WRITE edfz also writes a .idx; attach indexed BGZF EDFZ on demand, not preloaded" );
+  globals::optdefs().add( "inputs", "edfx-chunk" , OPT_NUM_T , "Seconds of each per-channel compressed chunk in WRITE edfx (default 30)" );
+  globals::optdefs().add( "inputs", "precision" , OPT_STR_T , "Storage of derived signals: int16 (default) or float (int16 only on WRITE)" );
+  globals::optdefs().add( "inputs", "tindex" , OPT_BOOL_T , "Read/write EDF+D record time-stamps via a .tidx sidecar file" );
 
   // logging
   globals::optdefs().add( "logging" , "verbose" , OPT_BOOL_T , "Set verbose logging" );
@@ -0,0 +1,1204 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    LUNA is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+// Luna micro-benchmarks
+// Invocation: luna __LUNA_BENCH__ [group] [key=value ...]
+//
+// Groups: store, decode, read, selective, slice, tscan, write, edfz, edfx,
+//         restructure, epochs, mask, overlap, annots
+//
+// Unless an existing EDF is given (edf=file), each benchmark writes a
+// synthetic EDF to TMPDIR, sized by ns= (channels), sr= (Hz) and nr=
+// (1-second records), and removes it afterwards.  Times are wall-clock
+// seconds; memory is the change in resident set size (Linux only).
+
+#include "bench.h"
+#include "luna.h"
+#include "edf/simd.h"
+#include "timeline/overlap.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+extern logger_t logger;
+
+// ============================================================
+// Helpers
+// ============================================================
+
+static std::map<std::string,std::string> bench_args;
+
+static double arg_num( const std::string & key , const double def )
+{
+  std::map<std::string,std::string>::const_iterator aa = bench_args.find( key );
+  if ( aa == bench_args.end() ) return def;
+  double d = def;
+  if ( ! Helper::str2dbl( aa->second , &d ) )
+    Helper::halt( "bad numeric value for " + key );
+  return d;
+}
+
+static std::string arg_str( const std::string & key , const std::string & def )
+{
+  std::map<std::string,std::string>::const_iterator aa = bench_args.find( key );
+  return aa == bench_args.end() ? def : aa->second;
+}
+
+static double now_sec()
+{
+  return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// current resident set size, in MB (0 if unavailable)
+static double rss_mb()
+{
+#ifndef WINDOWS
+  std::ifstream in( "/proc/self/statm" );
+  long pages = 0 , resident = 0;
+  if ( ! ( in >> pages >> resident ) ) return 0;
+  return resident * (double)sysconf( _SC_PAGESIZE ) / ( 1024.0 * 1024.0 );
+#else
+  return 0;
+#endif
+}
+
+static std::string temp_edf( const std::string & stem )
+{
+  const char * temp_dir = std::getenv("TMPDIR");
+  if ( temp_dir == NULL || *temp_dir == '\0' ) temp_dir = "/tmp";
+  return std::string( temp_dir ) + "/luna_bench_" + stem + ".edf";
+}
+
+static void put_field( std::ofstream & out , const std::string & s , const int n )
+{
+  std::string t = s.substr( 0 , n );
+  t.resize( n , ' ' );
+  out << t;
+}
+
+// standard EDF: ns channels at sr Hz, nr 1-second records (sines + LCG noise);
+// optionally EDF+D, with a time-track and a 1-second gap every 10 records
+static void write_synthetic_edf( const std::string & f , const int ns , const int sr , const int nr , const bool edfd = false )
+{
+  const int nt = edfd ? 15 : 0;  // time-track samples per record
+  const int nsall = edfd ? ns + 1 : ns;
+  
+  std::ofstream out( f.c_str() , std::ios::binary );
+  if ( ! out.good() ) Helper::halt( "could not write " + f );
+
+  put_field( out , "0" , 8 );
+  put_field( out , "bench" , 80 );
+  put_field( out , "bench" , 80 );
+  put_field( out , "01.01.85" , 8 );
+  put_field( out , "22.00.00" , 8 );
+  put_field( out , Helper::int2str( 256 + nsall * 256 ) , 8 );
+  put_field( out , edfd ? "EDF+D" : "" , 44 );
+  put_field( out , Helper::int2str( nr ) , 8 );
+  put_field( out , "1" , 8 );
+  put_field( out , Helper::int2str( nsall ) , 4 );
+
+  for (int s=0;s<ns;s++) put_field( out , "S" + Helper::int2str( s+1 ) , 16 );
+  if ( edfd ) put_field( out , "EDF Annotations" , 16 );
+  for (int s=0;s<nsall;s++) put_field( out , "" , 80 );
+  for (int s=0;s<ns;s++) put_field( out , "uV" , 8 );
+  if ( edfd ) put_field( out , "" , 8 );
+  for (int s=0;s<nsall;s++) put_field( out , "-500" , 8 );
+  for (int s=0;s<nsall;s++) put_field( out , "500" , 8 );
+  for (int s=0;s<nsall;s++) put_field( out , "-32768" , 8 );
+  for (int s=0;s<nsall;s++) put_field( out , "32767" , 8 );
+  for (int s=0;s<nsall;s++) put_field( out , "" , 80 );
+  for (int s=0;s<ns;s++) put_field( out , Helper::int2str( sr ) , 8 );
+  if ( edfd ) put_field( out , Helper::int2str( nt ) , 8 );
+  for (int s=0;s<nsall;s++) put_field( out , "" , 32 );
+
+  std::vector<char> rec( 2 * ns * sr + 2 * nt );
+  uint32_t lcg = 12345;
+  for (int r=0;r<nr;r++)
+    {
+      char * p = rec.data();
+      for (int s=0;s<ns;s++)
+	for (int j=0;j<sr;j++)
+	  {
+	    lcg = lcg * 1664525u + 1013904223u;
+	    const double t = ( r * sr + j ) / (double)sr;
+	    const int16_t d = 8000 * sin( 2 * M_PI * ( 5 + s % 20 ) * t ) + (int)( lcg >> 20 ) - 2048;
+	    *p++ = (char)( d & 0xff );
+	    *p++ = (char)( ( d >> 8 ) & 0xff );
+	  }
+      if ( edfd )
+	{
+	  const std::string tal = "+" + Helper::int2str( r + r / 10 ) + "\x14\x14";
+	  memset( p , 0 , 2 * nt );
+	  memcpy( p , tal.c_str() , tal.size() );
+	}
+      out.write( rec.data() , rec.size() );
+    }
+  out.close();
+}
+
+// attach (optionally only some channels), and pull every channel,
+// whole trace (i.e. as SIGSTATS, PSD etc); returns a checksum, and sets
+// the number of sample bytes (and bytes read from the file)
+static double load_all_channels( const std::string & f , uint64_t * nbytes ,
+				 const std::set<std::string> * sigs = NULL , uint64_t * nread = NULL )
+{
+  annotation_set_t annotations;
+  edf_t edf( &annotations );
+
+  if ( ! edf.attach( f , "bench" , sigs , true ) )
+    Helper::halt( "could not attach " + f );
+
+  double checksum = 0;
+  *nbytes = 0;
+  for (int s=0; s<edf.header.ns; s++)
+    {
+      slice_t slice( edf , s , edf.timeline.wholetrace( true ) );
+      const std::vector<double> * d = slice.pdata();
+      for (int i=0; i<d->size(); i+=97) checksum += (*d)[i];
+      *nbytes += 2 * d->size();
+    }
+  if ( nread != NULL ) *nread = edf.bytes_read();
+  return checksum;
+}
+
+
+// ============================================================
+// store : records[] versus channel-store=T
+// ============================================================
+
+static void bench_store()
+{
+  const int ns = arg_num( "ns" , 64 );
+  const int sr = arg_num( "sr" , 256 );
+  const int nr = arg_num( "nr" , 3600 );
+
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "store" );
+      std::cout << "writing synthetic EDF: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr );
+    }
+
+  std::cout << "\n"
+	    << std::left << std::setw(16) << "store"
+	    << std::right << std::setw(12) << "load(s)"
+	    << std::setw(12) << "MB/s"
+	    << std::setw(12) << "dRSS(MB)"
+	    << std::setw(14) << "checksum" << "\n";
+
+  // channel-store first: its large buffers are returned to the OS
+  // on release, so the records[] RSS is not masked by a freed heap
+
+  for (int mode = 1 ; mode >= 0 ; mode-- )
+    {
+      globals::edf_channel_store = mode == 1;
+
+      const double rss0 = rss_mb();
+      const double t0 = now_sec();
+
+      uint64_t nbytes = 0;
+      const double checksum = load_all_channels( f , &nbytes );
+
+      const double t1 = now_sec();
+      const double rss1 = rss_mb();
+
+      std::cout << std::left << std::setw(16) << ( mode == 1 ? "channel-store" : "records" )
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(12) << std::setprecision(1) << nbytes / ( 1024.0 * 1024.0 ) / ( t1 - t0 )
+		<< std::setw(12) << rss1 - rss0
+		<< std::setw(14) << std::setprecision(2) << checksum << "\n";
+    }
+
+  globals::edf_channel_store = false;
+
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// read : one record per read versus coalesced reads (read-chunk=MB)
+// ============================================================
+
+static void bench_read()
+{
+  const int ns = arg_num( "ns" , 64 );
+  const int sr = arg_num( "sr" , 256 );
+  const int nr = arg_num( "nr" , 3600 );
+  const int chunk = arg_num( "chunk" , 16 );
+
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "read" );
+      std::cout << "writing synthetic EDF: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr );
+    }
+
+  // nb. after the first pass the file will usually be in the page
+  // cache: on a local disk, the differences mostly reflect system call
+  // overhead; drop caches (or use a network mount) to see I/O effects
+
+  std::cout << "\n"
+	    << std::left << std::setw(24) << "reads"
+	    << std::right << std::setw(12) << "load(s)"
+	    << std::setw(12) << "MB/s"
+	    << std::setw(14) << "checksum" << "\n";
+
+  const int save_chunk = globals::edf_read_chunk;
+  const bool save_ra = globals::edf_readahead;
+
+  for (int mode = 0 ; mode < 3 ; mode++ )
+    {
+      globals::edf_read_chunk = mode == 0 ? 0 : chunk;
+      globals::edf_readahead = mode == 2;
+
+      const double t0 = now_sec();
+      uint64_t nbytes = 0;
+      const double checksum = load_all_channels( f , &nbytes );
+      const double t1 = now_sec();
+
+      const std::string label = mode == 0 ? "per-record" :
+	"chunk=" + Helper::int2str( chunk ) + "MB" + ( mode == 2 ? " +readahead" : "" );
+
+      std::cout << std::left << std::setw(24) << label
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(12) << std::setprecision(1) << nbytes / ( 1024.0 * 1024.0 ) / ( t1 - t0 )
+		<< std::setw(14) << std::setprecision(2) << checksum << "\n";
+    }
+
+  globals::edf_read_chunk = save_chunk;
+  globals::edf_readahead = save_ra;
+
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// selective : whole records versus selective-read=T, for a few of
+// many channels
+// ============================================================
+
+static void bench_selective()
+{
+  const int ns = arg_num( "ns" , 200 );
+  const int sr = arg_num( "sr" , 256 );
+  const int nr = arg_num( "nr" , 600 );
+  const int nsel = arg_num( "nsel" , 2 );
+
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "selective" );
+      std::cout << "writing synthetic EDF: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr );
+    }
+
+  // pick nsel channels spread across the record
+  std::set<std::string> sigs;
+  for (int i=0; i<nsel && i<ns; i++)
+    sigs.insert( "S" + Helper::int2str( 1 + (int)( i * ns / (double)nsel ) ) );
+  
+  std::cout << "\nreading " << sigs.size() << " of " << ns << " channels\n\n"
+	    << std::left << std::setw(16) << "reads"
+	    << std::right << std::setw(12) << "load(s)"
+	    << std::setw(14) << "read(MB)"
+	    << std::setw(14) << "checksum" << "\n";
+
+  const bool save_sel = globals::edf_selective_read;
+
+  for (int mode = 0 ; mode < 2 ; mode++ )
+    {
+      globals::edf_selective_read = mode == 1;
+
+      const double t0 = now_sec();
+      uint64_t nbytes = 0 , nread = 0;
+      const double checksum = load_all_channels( f , &nbytes , &sigs , &nread );
+      const double t1 = now_sec();
+
+      std::cout << std::left << std::setw(16) << ( mode == 1 ? "selective" : "whole-record" )
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(14) << std::setprecision(2) << nread / ( 1024.0 * 1024.0 )
+		<< std::setw(14) << checksum << "\n";
+    }
+
+  globals::edf_selective_read = save_sel;
+
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// slice : epoch-wise slices of every channel (as PSD, SIGSTATS etc),
+// general timeline lookups versus the continuous fast path
+// ============================================================
+
+static void bench_slice()
+{
+  const int ns = arg_num( "ns" , 16 );
+  const int sr = arg_num( "sr" , 256 );
+  const int nr = arg_num( "nr" , 8 * 3600 );
+  const double elen = arg_num( "epoch" , 30 );
+  const int reps = arg_num( "reps" , 3 );
+
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "slice" );
+      std::cout << "writing synthetic EDF: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr );
+    }
+
+  annotation_set_t annotations;
+  edf_t edf( &annotations );
+  if ( ! edf.attach( f , "bench" , NULL , true ) )
+    Helper::halt( "could not attach " + f );
+
+  // load everything first, so only slicing is timed
+  edf.read_records( 0 , edf.header.nr_all - 1 );
+  
+  const int ne = edf.timeline.set_epoch( elen , elen );
+
+  std::cout << "\n" << ne << " epochs x " << edf.header.ns << " channels x " << reps << " reps\n\n"
+	    << std::left << std::setw(16) << "path"
+	    << std::right << std::setw(12) << "time(s)"
+	    << std::setw(16) << "slices/s"
+	    << std::setw(16) << "checksum" << "\n";
+  
+  const bool save_fast = globals::slice_fast_path;
+  
+  for (int mode = 0 ; mode < 2 ; mode++ )
+    {
+      globals::slice_fast_path = mode == 1;
+
+      double checksum = 0;
+      uint64_t nslices = 0;
+      const double t0 = now_sec();
+      for (int rep=0; rep<reps; rep++)
+	{
+	  edf.timeline.first_epoch();
+	  while ( 1 )
+	    {
+	      int e = edf.timeline.next_epoch();
+	      if ( e == -1 ) break;
+	      interval_t interval = edf.timeline.epoch( e );
+	      for (int s=0; s<edf.header.ns; s++)
+		{
+		  slice_t slice( edf , s , interval );
+		  const std::vector<double> * d = slice.pdata();
+		  const std::vector<uint64_t> * tp = slice.ptimepoints();
+		  if ( d->size() ) checksum += (*d)[ d->size() / 2 ] + (*tp)[ tp->size() - 1 ] * 1e-12;
+		  ++nslices;
+		}
+	    }
+	}
+      const double t1 = now_sec();
+
+      std::cout << std::left << std::setw(16) << ( mode == 1 ? "fast" : "general" )
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(16) << std::setprecision(0) << nslices / ( t1 - t0 )
+		<< std::setw(16) << std::setprecision(4) << checksum << "\n";
+    }
+
+  globals::slice_fast_path = save_fast;
+
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// tscan : EDF+D attach (record time-stamps), per-record vs bulk
+// ============================================================
+
+static void bench_tscan()
+{
+  const int ns = arg_num( "ns" , 4 );
+  const int sr = arg_num( "sr" , 128 );
+  const int nr = arg_num( "nr" , 80000 );
+  
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "tscan" );
+      std::cout << "writing synthetic EDF+D: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr , true );
+    }
+
+  std::cout << "\n" << std::left << std::setw(20) << "path"
+	    << std::right << std::setw(12) << "time(s)"
+	    << std::setw(20) << "checksum" << "\n";
+
+  const bool save_tindex = globals::edf_tindex;
+  
+  for (int mode = 0 ; mode < 4 ; mode++ )
+    {
+      // 0: attach, then also per-record reads (i.e. the original cost);
+      // 1: bulk scan; 2: bulk, writes .tidx; 3: reads .tidx
+      globals::edf_tindex = mode >= 2;
+      
+      const double t0 = now_sec();
+      annotation_set_t annotations;
+      edf_t edf( &annotations );
+      if ( ! edf.attach( f , "bench" , NULL , true ) )
+	Helper::halt( "could not attach " + f );
+      
+      if ( mode == 0 ) 
+	{
+	  // i.e. original behavior: one seek + read per record
+	  edf.cached_EDF_timepoints.clear();
+	  for (int r=0; r<edf.header.nr_all; r++)
+	    edf.timepoint_from_EDF( r );
+	}
+      const double t1 = now_sec();
+
+      double checksum = 0;
+      for (int r=0; r<edf.header.nr_all; r++)
+	checksum += edf.timeline.timepoint( r ) * 1e-12;
+
+      const char * label[] = { "bulk+per-record" , "bulk" , "bulk+write-tidx" , "read-tidx" };
+      std::cout << std::left << std::setw(20) << label[mode]
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(20) << std::setprecision(4) << checksum << "\n";
+    }
+
+  globals::edf_tindex = save_tindex;
+
+  std::remove( ( f + ".tidx" ).c_str() );
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// restructure : RE after heavy epoch masking (in-place compaction)
+// ============================================================
+
+static void bench_restructure()
+{
+  const int ns = arg_num( "ns" , 8 );
+  const int sr = arg_num( "sr" , 128 );
+  const int nr = arg_num( "nr" , 24 * 3600 );
+  
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "restructure" );
+      std::cout << "writing synthetic EDF: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr );
+    }
+
+  std::cout << "\n" << std::left << std::setw(12) << "masked"
+	    << std::right << std::setw(12) << "load(s)"
+	    << std::setw(12) << "RE(s)"
+	    << std::setw(12) << "NR2"
+	    << std::setw(12) << "epochs" << "\n";
+
+  const double fracs[] = { 0.1 , 0.5 , 0.9 };
+
+  for (int k=0; k<3; k++)
+    {
+      annotation_set_t annotations;
+      edf_t edf( &annotations );
+      if ( ! edf.attach( f , "bench" , NULL , true ) )
+	Helper::halt( "could not attach " + f );
+
+      // all records in memory (i.e. as after any whole-trace command)
+      const double t0 = now_sec();
+      edf.read_records( 0 , edf.header.nr_all - 1 );
+      const double t1 = now_sec();
+
+      // 30-second epochs; mask a (scattered) fraction of them
+      const int ne = edf.timeline.set_epoch( 30 , 30 );
+      uint32_t lcg = 4321;
+      for (int e=0; e<ne; e++)
+	{
+	  lcg = lcg * 1664525u + 1013904223u;
+	  if ( ( lcg >> 8 ) / (double)( 1 << 24 ) < fracs[k] )
+	    edf.timeline.set_epoch_mask( e );
+	}
+
+      edf.restructure();
+      const double t2 = now_sec();
+
+      std::cout << std::left << std::setw(12) << fracs[k]
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(12) << t2 - t1
+		<< std::setw(12) << edf.header.nr
+		<< std::setw(12) << edf.timeline.num_epochs() << "\n";
+    }
+
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// epochs : sliding (30s/1s) epoch-wise slices of every channel, as
+// for a sliding-epoch PSD; timeline search vs flat epoch tables
+// ============================================================
+
+static void bench_epochs()
+{
+  const int ns = arg_num( "ns" , 4 );
+  const int sr = arg_num( "sr" , 128 );
+  const int nr = arg_num( "nr" , 8 * 3600 );
+  const double elen = arg_num( "epoch" , 30 );
+  const double einc = arg_num( "inc" , 1 );
+  const int reps = arg_num( "reps" , 2 );
+  
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  std::cout << std::left << std::setw(12) << "EDF"
+	    << std::setw(12) << "path"
+	    << std::right << std::setw(10) << "epochs"
+	    << std::setw(12) << "time(s)"
+	    << std::setw(16) << "slices/s"
+	    << std::setw(16) << "checksum" << "\n";
+  
+  const bool save_tables = globals::epoch_tables;
+  
+  for (int edfd = 0 ; edfd <= 1 ; edfd++ )
+    {
+      if ( ! synthetic && edfd ) break;
+      
+      if ( synthetic )
+	{
+	  f = temp_edf( "epochs" );
+	  write_synthetic_edf( f , ns , sr , nr , edfd );
+	}
+
+      annotation_set_t annotations;
+      edf_t edf( &annotations );
+      if ( ! edf.attach( f , "bench" , NULL , true ) )
+	Helper::halt( "could not attach " + f );
+      
+      // load everything first, so only slicing is timed
+      edf.read_records( 0 , edf.header.nr_all - 1 );
+      
+      for (int mode = 0 ; mode < 2 ; mode++ )
+	{
+	  globals::epoch_tables = mode == 1;
+	  
+	  // i.e. fresh tables each time
+	  const int ne = edf.timeline.set_epoch( elen , einc );
+	  
+	  double checksum = 0;
+	  uint64_t nslices = 0;
+	  const double t0 = now_sec();
+	  for (int rep=0; rep<reps; rep++)
+	    {
+	      edf.timeline.first_epoch();
+	      while ( 1 )
+		{
+		  int e = edf.timeline.next_epoch();
+		  if ( e == -1 ) break;
+		  interval_t interval = edf.timeline.epoch( e );
+		  for (int s=0; s<edf.header.ns; s++)
+		    {
+		      slice_t slice( edf , s , interval );
+		      const std::vector<double> * d = slice.pdata();
+		      if ( d->size() ) checksum += (*d)[ d->size() / 2 ] + d->size() * 1e-6;
+		      ++nslices;
+		    }
+		}
+	    }
+	  const double t1 = now_sec();
+	  
+	  std::cout << std::left << std::setw(12) << ( edf.header.continuous ? "EDF" : "EDF+D" )
+		    << std::setw(12) << ( mode == 1 ? "tables" : "search" )
+		    << std::right << std::setw(10) << ne
+		    << std::fixed << std::setprecision(3)
+		    << std::setw(12) << t1 - t0
+		    << std::setw(16) << std::setprecision(0) << nslices / ( t1 - t0 )
+		    << std::setw(16) << std::setprecision(4) << checksum << "\n";
+	}
+      
+      if ( synthetic ) std::remove( f.c_str() );
+    }
+  
+  globals::epoch_tables = save_tables;
+}
+
+
+// ============================================================
+// mask : MASK expr=... over sliding (30s/1s) epochs, with a stage
+// track, dense events with meta-data and other, unused classes;
+// per-epoch Eval vs compiled, block-wise evaluation
+// ============================================================
+
+static void bench_mask()
+{
+  const int nr = arg_num( "nr" , 8 * 3600 );
+  const double elen = arg_num( "epoch" , 30 );
+  const double einc = arg_num( "inc" , 1 );
+  const int nclass = arg_num( "classes" , 8 );
+  const std::string expr = arg_str( "expr" , "if(N2) && arousal_sec > 3" );
+
+  annotation_set_t annotations;
+  edf_t edf( &annotations );
+  edf.init_empty( "bench" , nr , 1 , "01.01.85" , "22.00.00" );
+
+  // stages, every 30s
+  annot_t * n2 = annotations.add( "N2" );
+  annot_t * n3 = annotations.add( "N3" );
+  for (int s=0; s+30<=nr; s+=30)
+    ( ( s / 30 ) % 3 ? n2 : n3 )->add( "." , interval_t( s * globals::tp_1sec , ( s + 30 ) * globals::tp_1sec ) , "." );
+
+  // events (every ~20s, 1-10s), with a numeric meta-field
+  uint32_t lcg = 1234;
+  int nev = 0;
+  annot_t * ar = annotations.add( "arousal" );
+  for (int s=0; s<nr-20; s+=20)
+    {
+      lcg = lcg * 1664525u + 1013904223u;
+      const uint64_t start = ( s + ( lcg >> 28 ) ) * globals::tp_1sec;
+      const uint64_t dur = ( 1 + ( ( lcg >> 8 ) % 10 ) ) * globals::tp_1sec;
+      instance_t * instance = ar->add( "." , interval_t( start , start + dur ) , "." );
+      instance->set( "amp" , ( ( lcg >> 4 ) & 255 ) / 16.0 );
+      ++nev;
+    }
+
+  // unrelated classes, not referenced by the expression
+  for (int c=0; c<nclass; c++)
+    {
+      annot_t * other = annotations.add( "other" + Helper::int2str( c ) );
+      for (int s=c; s<nr-5; s+=15)
+	other->add( "." , interval_t( s * globals::tp_1sec , ( s + 5 ) * globals::tp_1sec ) , "." );
+    }
+  
+  const int ne = edf.timeline.set_epoch( elen , einc );
+
+  std::cout << "expr [" << expr << "], " << ne << " epochs, "
+	    << nev << " events, " << nclass + 3 << " classes\n\n";
+  
+  std::cout << std::left << std::setw(12) << "path"
+	    << std::right << std::setw(12) << "time(s)"
+	    << std::setw(16) << "epochs/s"
+	    << std::setw(12) << "retained" << "\n";
+
+  const bool save_compile = globals::mask_compile;
+
+  for (int mode = 0 ; mode < 2 ; mode++ )
+    {
+      globals::mask_compile = mode == 1;
+      edf.timeline.clear_epoch_mask();
+      const double t0 = now_sec();
+      edf.timeline.apply_eval_mask( expr , 2 );
+      const double t1 = now_sec();
+      std::cout << std::left << std::setw(12) << ( mode == 1 ? "compiled" : "per-epoch" )
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(16) << std::setprecision(0) << ne / ( t1 - t0 )
+		<< std::setw(12) << edf.timeline.num_epochs() << "\n";
+    }
+
+  globals::mask_compile = save_compile;
+}
+
+
+// ============================================================
+// overlap : epoch x annotation overlaps for sliding (30s/1s) epochs
+// and dense events; one interval-tree query per epoch vs one sweep
+// ============================================================
+
+static void bench_overlap()
+{
+  const int nr = arg_num( "nr" , 8 * 3600 );
+  const double elen = arg_num( "epoch" , 30 );
+  const double einc = arg_num( "inc" , 1 );
+  const double spacing = arg_num( "spacing" , 5 );
+
+  annotation_set_t annotations;
+  edf_t edf( &annotations );
+  edf.init_empty( "bench" , nr , 1 , "01.01.85" , "22.00.00" );
+
+  uint32_t lcg = 4321;
+  annot_t * a = annotations.add( "events" );
+  int nev = 0;
+  for (double t = 0; t < nr - 10; t += spacing )
+    {
+      lcg = lcg * 1664525u + 1013904223u;
+      const uint64_t start = t * globals::tp_1sec + ( lcg >> 8 ) % globals::tp_1sec;
+      const uint64_t dur = ( 1 + ( lcg >> 28 ) ) * globals::tp_1sec / 2;
+      a->add( "." , interval_t( start , start + dur ) , "." );
+      ++nev;
+    }
+
+  const int ne = edf.timeline.set_epoch( elen , einc );
+  
+  std::vector<interval_t> epochs( ne );
+  for (int e=0; e<ne; e++) epochs[e] = edf.timeline.epoch( e );
+  
+  std::cout << ne << " epochs, " << nev << " events\n\n";
+  
+  std::cout << std::left << std::setw(12) << "path"
+	    << std::right << std::setw(12) << "time(s)"
+	    << std::setw(16) << "epochs/s"
+	    << std::setw(12) << "hits" << "\n";
+
+  for (int mode = 0 ; mode < 2 ; mode++ )
+    {
+      uint64_t nhits = 0;
+      const double t0 = now_sec();
+      if ( mode == 0 )
+	{
+	  for (int e=0; e<ne; e++)
+	    nhits += a->extract( epochs[e] ).size();
+	}
+      else
+	{
+	  annot_sweep_t sweep( epochs );
+	  sweep.run( a );
+	  for (int e=0; e<ne; e++)
+	    nhits += sweep.count( e );
+	}
+      const double t1 = now_sec();
+      std::cout << std::left << std::setw(12) << ( mode == 1 ? "sweep" : "tree" )
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(16) << std::setprecision(0) << ne / ( t1 - t0 )
+		<< std::setw(12) << nhits << "\n";
+    }
+}
+
+
+// ============================================================
+// annots : loading a large .annot with per-event meta-data
+// ============================================================
+
+static void bench_annots()
+{
+  const int nev = arg_num( "nev" , 200000 );
+  const int nr = arg_num( "nr" , 24 * 3600 );
+
+  const char * temp_dir = std::getenv("TMPDIR");
+  if ( temp_dir == NULL || *temp_dir == '\0' ) temp_dir = "/tmp";
+  const std::string f = std::string( temp_dir ) + "/luna_bench_annots.annot";
+
+  const char * stages[] = { "W" , "N1" , "N2" , "N3" , "R" };
+
+  {
+    std::ofstream out( f.c_str() );
+    out << "# ev | bench events | conf[num] stage[txt] n[int] tag[txt]\n";
+    uint32_t lcg = 999;
+    for (int i=0; i<nev; i++)
+      {
+	lcg = lcg * 1664525u + 1013904223u;
+	const double start = ( nr - 10 ) * (double)i / nev;
+	out << "ev\t.\t.\t" << start << "\t" << start + 0.5 + ( lcg >> 29 ) << "\t"
+	    << "conf=" << ( lcg >> 16 ) / 65536.0
+	    << ";stage=" << stages[ ( lcg >> 8 ) % 5 ]
+	    << ";n=" << (int)( ( lcg >> 4 ) % 100 )
+	    << ";tag=t" << i % 1000 << "\n";
+      }
+  }
+
+  annotation_set_t annotations;
+  edf_t edf( &annotations );
+  edf.init_empty( "bench" , nr , 1 , "01.01.85" , "22.00.00" );
+
+  const double m0 = rss_mb();
+  const double t0 = now_sec();
+  if ( ! annot_t::load( f , edf ) )
+    Helper::halt( "could not load " + f );
+  const double t1 = now_sec();
+  const double m1 = rss_mb();
+
+  annot_t * a = annotations.find( "ev" );
+  if ( a == NULL ) Helper::halt( "no ev annotations loaded" );
+
+  // full columnar scan of the meta-data
+  double checksum = 0;
+  const double t2 = now_sec();
+  annot_map_t::const_iterator ii = a->interval_events.begin();
+  while ( ii != a->interval_events.end() )
+    {
+      const meta_store_t * meta = ii->second->meta();
+      if ( meta != NULL )
+	for (int c=0; c<meta->num_columns(); c++)
+	  checksum += meta->double_value( c , ii->second->row() );
+      ++ii;
+    }
+  const double t3 = now_sec();
+
+  std::remove( f.c_str() );
+
+  std::cout << a->num_interval_events() << " events, "
+	    << a->meta.num_values() << " meta-data values, "
+	    << a->meta.num_strings() << " distinct strings\n\n";
+
+  std::cout << std::fixed << std::setprecision(3)
+	    << "load time(s)      " << t1 - t0 << "\n"
+	    << "load RSS (MB)     " << std::setprecision(1) << m1 - m0 << "\n"
+	    << "meta store (MB)   " << a->meta.bytes() / ( 1024.0 * 1024.0 ) << "\n"
+	    << "bytes/event       " << std::setprecision(0) << ( m1 - m0 ) * 1024.0 * 1024.0 / nev << "\n"
+	    << "scan time(s)      " << std::setprecision(3) << t3 - t2 << "\n"
+	    << "checksum          " << std::setprecision(1) << checksum << "\n";
+}
+
+
+// ============================================================
+// write : WRITE throughput, record-by-record vs buffered/passthrough
+// ============================================================
+
+static void bench_write()
+{
+  const int ns = arg_num( "ns" , 16 );
+  const int sr = arg_num( "sr" , 256 );
+  const int nr = arg_num( "nr" , 8 * 3600 );
+  
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "write" );
+      std::cout << "writing synthetic EDF: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr );
+    }
+
+  const std::string out = temp_edf( "write_out" );
+
+  std::cout << "\n" << std::left << std::setw(12) << "records"
+	    << std::setw(16) << "writer"
+	    << std::right << std::setw(12) << "time(s)"
+	    << std::setw(12) << "MB/s" << "\n";
+  
+  const int save_wbuf = globals::edf_write_buffer;
+  
+  for (int loaded = 0 ; loaded < 2 ; loaded++ )
+    for (int mode = 0 ; mode < 2 ; mode++ )
+      {
+	globals::edf_write_buffer = mode == 0 ? 0 : save_wbuf > 0 ? save_wbuf : 16 ;
+	
+	annotation_set_t annotations;
+	edf_t edf( &annotations );
+	if ( ! edf.attach( f , "bench" , NULL , true ) )
+	  Helper::halt( "could not attach " + f );
+
+	// i.e. as after a command that has touched every record
+	if ( loaded ) edf.read_records( 0 , edf.header.nr_all - 1 );
+	
+	const double t0 = now_sec();
+	edf.write( out , false , 0 , false , NULL );
+	const double t1 = now_sec();
+
+	FILE * in = fopen( out.c_str() , "rb" );
+	const double mb = in ? edf_t::get_filesize( in ) / ( 1024.0 * 1024.0 ) : 0 ;
+	if ( in ) fclose( in );
+	std::remove( out.c_str() );
+	
+	std::cout << std::left << std::setw(12) << ( loaded ? "in-memory" : "on-disk" )
+		  << std::setw(16) << ( mode == 0 ? "per-record" : "buffered" )
+		  << std::right << std::fixed << std::setprecision(3)
+		  << std::setw(12) << t1 - t0
+		  << std::setw(12) << std::setprecision(1) << mb / ( t1 - t0 ) << "\n";
+      }
+  
+  globals::edf_write_buffer = save_wbuf;
+
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// edfz : WRITE edfz and attach, by number of BGZF threads
+// ============================================================
+
+static void bench_edfz()
+{
+  const int ns = arg_num( "ns" , 16 );
+  const int sr = arg_num( "sr" , 256 );
+  const int nr = arg_num( "nr" , 2 * 3600 );
+  const int maxt = arg_num( "threads" , 4 );
+  
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "edfz" );
+      std::cout << "writing synthetic EDF: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr );
+    }
+
+  const std::string out = temp_edf( "edfz_out" ) + ".gz";
+
+  std::cout << "\n" << std::left << std::setw(10) << "threads"
+	    << std::right << std::setw(12) << "write(s)"
+	    << std::setw(12) << "MB/s"
+	    << std::setw(12) << "attach(s)"
+	    << std::setw(12) << "MB/s"
+	    << std::setw(16) << "checksum" << "\n";
+
+  const int save_threads = globals::edfz_threads;
+  
+  for (int threads = 1 ; threads <= maxt ; threads *= 2 )
+    {
+      globals::edfz_threads = threads;
+
+      double mb = 0;
+      double t0, t1;
+      {
+	annotation_set_t annotations;
+	edf_t edf( &annotations );
+	if ( ! edf.attach( f , "bench" , NULL , true ) )
+	  Helper::halt( "could not attach " + f );
+	edf.read_records( 0 , edf.header.nr_all - 1 );
+	mb = (double)edf.header.nr_all * edf.record_size / ( 1024.0 * 1024.0 );
+	t0 = now_sec();
+	edf.write( out , true , 0 , false , NULL );
+	t1 = now_sec();
+      }
+      
+      // attach (i.e. decompresses everything) and pull all channels
+      uint64_t nbytes = 0;
+      const double t2 = now_sec();
+      const double checksum = load_all_channels( out , &nbytes );
+      const double t3 = now_sec();
+      
+      std::cout << std::left << std::setw(10) << threads
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(12) << std::setprecision(1) << mb / ( t1 - t0 )
+		<< std::setw(12) << std::setprecision(3) << t3 - t2
+		<< std::setw(12) << std::setprecision(1) << mb / ( t3 - t2 )
+		<< std::setw(16) << std::setprecision(4) << checksum << "\n";
+      
+      std::remove( out.c_str() );
+    }
+  
+  globals::edfz_threads = save_threads;
+
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// edfx : one channel from a many-channel recording, EDF versus
+// channel-major chunked EDFX
+// ============================================================
+
+static void bench_edfx()
+{
+  const int ns = arg_num( "ns" , 128 );
+  const int sr = arg_num( "sr" , 256 );
+  const int nr = arg_num( "nr" , 3600 );
+  const int nsel = arg_num( "nsel" , 1 );
+
+  std::string f = arg_str( "edf" , "" );
+  const bool synthetic = f == "";
+
+  if ( synthetic )
+    {
+      f = temp_edf( "edfx" );
+      std::cout << "writing synthetic EDF: " << ns << " channels, " << sr << " Hz, " << nr << " records\n";
+      write_synthetic_edf( f , ns , sr , nr );
+    }
+  
+  const std::string out = temp_edf( "edfx_out" ) + "x";
+  
+  double tw = 0;
+  {
+    annotation_set_t annotations;
+    edf_t edf( &annotations );
+    if ( ! edf.attach( f , "bench" , NULL , true ) )
+      Helper::halt( "could not attach " + f );
+    const double t0 = now_sec();
+    edf.write( out , false , 0 , false , NULL );
+    tw = now_sec() - t0;
+  }
+  
+  std::set<std::string> sigs;
+  for (int i=0; i<nsel && i<ns; i++)
+    sigs.insert( "S" + Helper::int2str( 1 + (int)( i * ns / (double)nsel ) ) );
+
+  std::cout << "wrote EDFX in " << std::fixed << std::setprecision(3) << tw << "s\n"
+	    << "\nreading " << sigs.size() << " of " << ns << " channels\n\n"
+	    << std::left << std::setw(16) << "input"
+	    << std::right << std::setw(12) << "load(s)"
+	    << std::setw(14) << "read(MB)"
+	    << std::setw(14) << "checksum" << "\n";
+  
+  const bool save_sel = globals::edf_selective_read;
+
+  for (int mode = 0 ; mode < 3 ; mode++ )
+    {
+      globals::edf_selective_read = mode == 1;
+
+      const double t0 = now_sec();
+      uint64_t nbytes = 0 , nread = 0;
+      const double checksum = load_all_channels( mode == 2 ? out : f , &nbytes , &sigs , &nread );
+      const double t1 = now_sec();
+
+      std::cout << std::left << std::setw(16) << ( mode == 0 ? "EDF" : mode == 1 ? "EDF selective" : "EDFX" )
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << t1 - t0
+		<< std::setw(14) << std::setprecision(2) << nread / ( 1024.0 * 1024.0 )
+		<< std::setw(14) << checksum << "\n";
+    }
+
+  globals::edf_selective_read = save_sel;
+
+  std::remove( out.c_str() );
+  if ( synthetic ) std::remove( f.c_str() );
+}
+
+
+// ============================================================
+// decode : EDF bytes --> int16 --> physical, per kernel set
+// ============================================================
+
+static void bench_decode()
+{
+  const int n    = arg_num( "n" , 1 << 24 );
+  const int reps = arg_num( "reps" , 10 );
+
+  // random little-endian samples
+  std::vector<unsigned char> bytes( 2 * (size_t)n );
+  uint32_t lcg = 12345;
+  for (size_t i=0; i<bytes.size(); i++)
+    {
+      lcg = lcg * 1664525u + 1013904223u;
+      bytes[i] = lcg >> 24;
+    }
+
+  std::vector<int16_t> dig( n );
+  std::vector<double> phys( n ) , ref( n );
+  std::vector<float> physf( n );
+
+  const double bv = 1000.0 / 65535.0;
+  const double offset = 0.5;
+
+  std::cout << "samples: " << n << " x " << reps << " reps\n\n"
+	    << std::left << std::setw(10) << "kernel"
+	    << std::right << std::setw(16) << "decode(MS/s)"
+	    << std::setw(16) << "phys64(MS/s)"
+	    << std::setw(16) << "phys32(MS/s)"
+	    << std::setw(12) << "identical" << "\n";
+  
+  const std::string dflt = edf_simd::kernel();
+  const std::vector<std::string> kernels = edf_simd::available();
+  
+  // evaluate in reverse order, so scalar (the reference) comes first
+  for (int k = kernels.size() - 1 ; k >= 0 ; k-- )
+    {
+      edf_simd::force( kernels[k] );
+
+      double t0 = now_sec();
+      for (int r=0; r<reps; r++)
+	edf_simd::decode_int16( bytes.data() , dig.data() , n );
+      double t1 = now_sec();
+      for (int r=0; r<reps; r++)
+	edf_simd::dig2phys( dig.data() , phys.data() , n , bv , offset );
+      double t2 = now_sec();
+      for (int r=0; r<reps; r++)
+	edf_simd::dig2phys( dig.data() , physf.data() , n , bv , offset );
+      double t3 = now_sec();
+
+      if ( kernels[k] == "scalar" ) ref = phys;
+      
+      bool identical = true;
+      for (int i=0; i<n; i++)
+	if ( phys[i] != ref[i] || physf[i] != (float)ref[i] ) { identical = false; break; }
+
+      const double ms = n * (double)reps / 1e6;
+      std::cout << std::left << std::setw(10) << kernels[k]
+		<< std::right << std::fixed << std::setprecision(1)
+		<< std::setw(16) << ms / ( t1 - t0 )
+		<< std::setw(16) << ms / ( t2 - t1 )
+		<< std::setw(16) << ms / ( t3 - t2 )
+		<< std::setw(12) << ( identical ? "yes" : "NO" ) << "\n";
+    }
+
+  edf_simd::force( dflt );
+}
+
+
+// ============================================================
+// Main entry point
+// ============================================================
+
+void proc_bench( const std::string & group , const std::vector<std::string> & args )
+{
+
+  bench_args.clear();
+  for (int i=0; i<args.size(); i++)
+    {
+      std::vector<std::string> tok = Helper::parse( args[i] , "=" );
+      if ( tok.size() != 2 ) Helper::halt( "expecting key=value arguments: " + args[i] );
+      bench_args[ tok[0] ] = tok[1];
+    }
+
+  logger.off();
+
+  std::cout << "\n=== Luna benchmarks [group=" << group << "] ===\n\n";
+
+  if ( group == "store" ) bench_store();
+  else if ( group == "decode" ) bench_decode();
+  else if ( group == "read" ) bench_read();
+  else if ( group == "selective" ) bench_selective();
+  else if ( group == "slice" ) bench_slice();
+  else if ( group == "tscan" ) bench_tscan();
+  else if ( group == "write" ) bench_write();
+  else if ( group == "edfz" ) bench_edfz();
+  else if ( group == "edfx" ) bench_edfx();
+  else if ( group == "restructure" ) bench_restructure();
+  else if ( group == "epochs" ) bench_epochs();
+  else if ( group == "mask" ) bench_mask();
+  else if ( group == "overlap" ) bench_overlap();
+  else if ( group == "annots" ) bench_annots();
+  else Helper::halt( "unknown benchmark group: " + group );
+
+  std::cout << "\n";
+}
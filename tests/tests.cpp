@@ -24,13 +24,14 @@
 // Invocation: luna __LUNA_TESTS__ [group] [verbose]
 //
 // Groups: all, signal, epoch, mask, filter, resample, psd, spindles,
-//         hypno, annot, write, script, eval, lunapi, segsrv
+//         hypno, annot, write, edf, script, eval, lunapi, segsrv
 //
 // All tests use fully synthetic in-memory data (no external files needed).
 // Exit code: 0 = all pass, 1 = any failure.
 
 #include "tests.h"
 #include "luna.h"
+#include "main.h"
 #include "lunapi/lunapi.h"
 #include "lunapi/segsrv.h"
 #include "helper/token-eval.h"
@@ -38,6 +39,10 @@
 #include "dsp/ipc.h"
 #include "dsp/ssa.h"
 #include "dsp/tsync.h"
+#include "edfz/bgzf.h"
+#include "edf/simd.h"
+#include "helper/prefetch.h"
+#include "timeline/overlap.h"
 
 #include <cmath>
 #include <cstdio>
@@ -268,6 +273,87 @@ static lunapi_inst_ptr make_sine_inst( lunapi_t * eng,
   return make_inst( eng, sig, sr, nr, rs, label );
 }
 
+// A 300s instance in rs-second records: EEG and EMG (both at 256 Hz)
+// and, optionally, ECG at 128 Hz; if edfd, only epochs 2, 3 and 7 are
+// retained (i.e. the record structure is rebuilt, so EDF+D if written)
+static lunapi_inst_ptr make_test_inst( lunapi_t * eng,
+				       const std::string & id,
+				       bool ecg = false,
+				       int rs = 30,
+				       bool edfd = false )
+{
+  auto p = eng->inst( id );
+  p->empty_edf( id, 300 / rs, rs, "01.01.85", "22.00.00" );
+  p->insert_signal( "EEG", make_two_sines(256,300,10.0,1.0,3.0,20.0), 256 );
+  p->insert_signal( "EMG", make_noise(256*300,5.0), 256 );
+  if ( ecg ) p->insert_signal( "ECG", make_noise(128*300,2.0), 128 );
+  if ( edfd ) p->eval( "EPOCH len=30 & MASK epoch=2-3,7 & RE" );
+  return p;
+}
+
+// As above, written to a temp file; returns the .edf filename
+static std::string write_temp_edf( lunapi_t * eng,
+				   const std::string & stem,
+				   bool ecg = false,
+				   int rs = 30,
+				   bool edfd = false )
+{
+  const std::string tmp = temp_base_path( stem );
+  auto p = make_test_inst( eng, "T_w", ecg, rs, edfd );
+  p->eval( "WRITE edf=" + tmp + ( edfd ? " EDF+D" : " force-edf=T" ) );
+  return tmp + ".edf";
+}
+
+// All samples of channels chs, stacked as one column (i.e. as data()
+// requires a single sampling rate, read one channel at a time)
+static Eigen::MatrixXd channel_data( lunapi_inst_ptr p,
+				     const std::vector<std::string> & chs )
+{
+  std::vector<Eigen::MatrixXd> d;
+  int n = 0;
+  for (int c=0; c<chs.size(); c++)
+    {
+      d.push_back( std::get<1>( p->data( { chs[c] }, {}, false ) ) );
+      n += d.back().rows();
+    }
+  Eigen::MatrixXd x( n , 1 );
+  n = 0;
+  for (int c=0; c<d.size(); c++)
+    {
+      x.block( n , 0 , d[c].rows() , 1 ) = d[c].col(0);
+      n += d[c].rows();
+    }
+  return x;
+}
+
+// Attach an EDF with options set (e.g. mmap=T), optionally run some
+// commands, and return the data for channels chs; options are then
+// set back to the values in reset (also if anything throws)
+static Eigen::MatrixXd read_with_options( lunapi_t * eng,
+					  const std::string & edf,
+					  const std::vector<std::string> & chs,
+					  const std::map<std::string,std::string> & opts = {},
+					  const std::map<std::string,std::string> & reset = {},
+					  const std::string & cmds = "" )
+{
+  for (const auto & o : opts) eng->var( o.first , o.second );
+  try {
+    auto p = eng->inst( "T_r" );
+    if ( ! p->attach_edf( edf ) ) throw std::runtime_error( "could not attach " + edf );
+    if ( cmds != "" ) p->eval( cmds );
+    Eigen::MatrixXd d = channel_data( p , chs );
+    for (const auto & o : reset) eng->var( o.first , o.second );
+    return d;
+  } catch(...) { for (const auto & o : reset) eng->var( o.first , o.second ); throw; }
+}
+
+// Non-empty and exactly equal
+static bool same_data( const Eigen::MatrixXd & a, const Eigen::MatrixXd & b )
+{
+  return a.rows() > 0 && a.rows() == b.rows() && a.cols() == b.cols()
+    && ( a - b ).cwiseAbs().maxCoeff() == 0;
+}
+
 // Extract scalar from rtables (searches all strata for the command)
 static double get_val( lunapi_inst_ptr p,
 		       const std::string & cmd,
@@ -599,6 +685,441 @@ static void test_signal( lunapi_t * eng,
            lag_match && delay_recovered && both_peak_over_zero && both_peaks_high,
            m.str(), V);
   } catch(std::exception & e) { record(R,"signal/ipc-lag-vs-tsync-ht",false,e.what(),V); }
+
+  // A9 — cached signal_list() results follow channel drops, adds and
+  // renames (i.e. the hashed label index is rebuilt when labels change)
+  try {
+    annotation_set_t annotations;
+    edf_t edf( &annotations );
+    edf.init_empty( "T_sl" , 10 , 1 , "01.01.85" , "22.00.00" , true );
+    edf.add_signal( "EEG" , 128 , std::vector<double>( 1280 , 1.0 ) );
+    edf.add_signal( "EMG" , 64 , std::vector<double>( 640 , 2.0 ) );
+    edf.add_signal( "ECG" , 64 , std::vector<double>( 640 , 3.0 ) );
+    
+    bool pass = edf.header.signal( "emg" ) == 1 && edf.header.signal_list( "EEG,ECG" ).size() == 2;
+    // a second lookup (i.e. from the cache) agrees
+    pass = pass && edf.header.signal( "EMG" ) == 1 && edf.header.signal_list( "E*" ).size() == 3;
+    
+    edf.drop_signal( 0 );
+    pass = pass && edf.header.signal( "EMG" , true ) == 0 && edf.header.signal( "EEG" , true ) == -1
+      && edf.header.signal_list( "E*" ).size() == 2;
+    
+    edf.add_signal( "EEG2" , 128 , std::vector<double>( 1280 , 1.0 ) );
+    pass = pass && edf.header.signal( "eeg2" , true ) == 2 && edf.header.signal_list( "E*" ).size() == 3;
+    
+    edf.header.rename_channel( "ECG" , "EKG" );
+    signal_list_t sl = edf.header.signal_list( "EKG" );
+    pass = pass && sl.size() == 1 && sl(0) == 1 && sl.label(0) == "EKG";
+    
+    std::ostringstream m; m << "ns=" << edf.header.ns;
+    record(R,"signal/label-cache-invalidation", pass , m.str(), V);
+  } catch(std::exception & e) { record(R,"signal/label-cache-invalidation",false,e.what(),V); }
+
+  // A10 — update_signal() write-back: every kernel set gives the same
+  // header min/max and digital samples as the scalar path
+  try {
+    std::vector<double> x = make_two_sines( 256 , 30 , 10.0 , 50.0 , 3.0 , 20.0 );
+    x[0] = -0.0; x[5] = 0.0; x[17] = 1e9; x[33] = -1e9; x[100] = 0.123456789;
+    
+    std::vector<std::vector<int16_t> > dig;
+    std::vector<double> hdr;
+    const std::vector<std::string> kernels = edf_simd::available();
+    
+    for (int k=0; k<kernels.size(); k++)
+      {
+	edf_simd::force( kernels[k] );
+	annotation_set_t annotations;
+	edf_t edf( &annotations );
+	edf.init_empty( "T_us" , 30 , 1 , "01.01.85" , "22.00.00" , true );
+	edf.add_signal( "EEG" , 256 , std::vector<double>( x.size() , 1.0 ) );
+	edf.add_signal( "EMG" , 256 , std::vector<double>( x.size() , 1.0 ) );
+	edf.update_signal( 0 , &x );
+	int16_t dmin = -2000 , dmax = 2000;
+	double pmin = -40 , pmax = 40;
+	edf.update_signal( 1 , &x , &dmin , &dmax , &pmin , &pmax );
+	std::vector<int16_t> d;
+	for (int s=0; s<2; s++)
+	  {
+	    for (int r=0; r<30; r++)
+	      {
+		const int16_t * p = edf.record_samples( r , s );
+		d.insert( d.end() , p , p + 256 );
+	      }
+	    hdr.push_back( edf.header.physical_min[s] );
+	    hdr.push_back( edf.header.physical_max[s] );
+	  }
+	dig.push_back( d );
+      }
+    edf_simd::force( kernels[0] );
+    
+    bool pass = dig.size() > 0;
+    for (int k=1; k<dig.size(); k++)
+      if ( dig[k] != dig[0] || memcmp( &hdr[4*k] , &hdr[0] , 4 * sizeof(double) ) ) pass = false;
+    std::ostringstream m; m << "kernels=" << kernels.size();
+    record(R,"signal/update-signal-identical", pass , m.str(), V);
+  } catch(std::exception & e) { record(R,"signal/update-signal-identical",false,e.what(),V); }
+
+  // A11 — precision=float: derived signals are returned at float32
+  // precision (not quantized), survive dropping an earlier channel,
+  // and give the same int16 encoding (+/-1 LSB) once synced for WRITE
+  try {
+    std::vector<double> x = make_two_sines( 128 , 20 , 10.0 , 50.0 , 3.0 , 20.0 );
+    x[7] = 1e4;  // i.e. a wide physical range, so int16 steps are coarse
+    
+    std::vector<std::vector<int16_t> > dig( 2 );
+    double maxerr[2] = { 0 , 0 };
+    bool slots_ok = true;
+    
+    for (int f=0; f<2; f++)
+      {
+	globals::float_signals = f == 1;
+	annotation_set_t annotations;
+	edf_t edf( &annotations );
+	edf.init_empty( "T_fl" , 20 , 1 , "01.01.85" , "22.00.00" , true );
+	edf.add_signal( "EMG" , 128 , std::vector<double>( x.size() , 1.0 ) );
+	edf.add_signal( "EEG" , 128 , x );
+	edf.drop_signal( 0 );
+	const int s = edf.header.signal( "EEG" );
+	slots_ok = slots_ok && s == 0 && edf.has_float_store( s ) == ( f == 1 );
+	
+	slice_t slice( edf , s , edf.timeline.wholetrace() );
+	const std::vector<double> * d = slice.pdata();
+	slots_ok = slots_ok && d->size() == x.size();
+	for (int i=0; i<d->size() && i<x.size(); i++)
+	  maxerr[f] = std::max( maxerr[f] , fabs( (*d)[i] - x[i] ) );
+	
+	edf.sync_float_store();
+	for (int r=0; r<20; r++)
+	  {
+	    const int16_t * p = edf.record_samples( r , s );
+	    dig[f].insert( dig[f].end() , p , p + 128 );
+	  }
+      }
+    globals::float_signals = false;
+    
+    int maxd = 0;
+    for (int i=0; i<dig[0].size() && i<dig[1].size(); i++)
+      maxd = std::max( maxd , abs( (int)dig[0][i] - (int)dig[1][i] ) );
+    
+    const bool pass = slots_ok && dig[0].size() == dig[1].size() && maxd <= 1
+      && maxerr[1] < 1e-3 && maxerr[1] < maxerr[0] / 10.0;
+    std::ostringstream m;
+    m << "int16 err=" << maxerr[0] << " float err=" << maxerr[1] << " max LSB diff=" << maxd;
+    record(R,"signal/float-store", pass , m.str(), V);
+  } catch(std::exception & e) { globals::float_signals = false; record(R,"signal/float-store",false,e.what(),V); }
+
+  // A12 — precision=float: REFERENCE (which reads records directly,
+  // via get_pdata()) sees the float-backed values of a channel added
+  // by add_signal() and of one re-scaled by update_signal(), i.e. as
+  // with int16 storage
+  try {
+    std::vector<double> xa = make_two_sines( 128 , 20 , 10.0 , 50.0 , 3.0 , 20.0 );
+    std::vector<double> xb = make_two_sines( 128 , 20 , 2.0 , 5.0 , 1.0 , 10.0 );
+    std::vector<double> ya( xa.size() );
+    for (int i=0; i<xa.size(); i++) ya[i] = 100.0 * xa[i];
+
+    std::vector<std::vector<double> > res( 2 );
+    for (int f=0; f<2; f++)
+      {
+	globals::float_signals = f == 1;
+	annotation_set_t annotations;
+	edf_t edf( &annotations );
+	edf.init_empty( "T_flref" , 20 , 1 , "01.01.85" , "22.00.00" , true );
+	edf.add_signal( "A" , 128 , xa );
+	edf.add_signal( "B" , 128 , xb );
+	const int sa = edf.header.signal( "A" );
+	edf.update_signal( sa , &ya );  // new physical range, so new bitvalue/offset
+	edf.reference( edf.header.signal_list( "A" ) , edf.header.signal_list( "B" ) ,
+		       false , "" , 0 , false , false );
+	slice_t slice( edf , sa , edf.timeline.wholetrace() );
+	res[f] = *slice.pdata();
+      }
+    globals::float_signals = false;
+
+    // i.e. within a few int16 steps (~0.2 units, for a +/-7000 range)
+    double maxerr[2] = { 0 , 0 };
+    for (int f=0; f<2; f++)
+      for (int i=0; i<res[f].size() && i<xa.size(); i++)
+	maxerr[f] = std::max( maxerr[f] , fabs( res[f][i] - ( ya[i] - xb[i] ) ) );
+
+    const bool pass = res[0].size() == xa.size() && res[1].size() == xa.size()
+      && maxerr[0] < 1.0 && maxerr[1] < 1.0;
+    std::ostringstream m;
+    m << "int16 err=" << maxerr[0] << " float err=" << maxerr[1];
+    record(R,"signal/float-store-reference", pass , m.str(), V);
+  } catch(std::exception & e) { globals::float_signals = false; record(R,"signal/float-store-reference",false,e.what(),V); }
+
+  // A13 — continuous fast path (slice-fast) gives the same samples and
+  // time-points as the general timeline path, incl. unaligned intervals
+  try {
+    const std::string edf = write_temp_edf( eng, "test_fastslice" );
+
+    std::vector<std::tuple<double,double> > secs;
+    secs.push_back( std::make_tuple( 0.0 , 300.0 ) );
+    secs.push_back( std::make_tuple( 1.003 , 27.5 ) );
+    secs.push_back( std::make_tuple( 9.99 , 10.01 ) );
+    
+    auto p1 = eng->inst("T_fs1");
+    p1->attach_edf( edf );
+    eng->var("slice-fast","F");
+    auto p2 = eng->inst("T_fs2");
+    p2->attach_edf( edf );
+    eng->var("slice-fast","T");
+
+    // (one channel at a time)
+    bool pass = true;
+    int nchk = 0;
+    const std::vector<std::string> chs = { "EEG" , "EMG" };
+    for (int c=0; c<chs.size(); c++)
+      {
+	auto d1 = std::get<1>( p1->slices( p1->seconds2intervals( secs ) , { chs[c] }, {}, true ) );
+	auto d2 = std::get<1>( p2->slices( p2->seconds2intervals( secs ) , { chs[c] }, {}, true ) );
+	if ( d1.size() != 3 || d1.size() != d2.size() ) pass = false;
+	for (int i=0; pass && i<d1.size(); i++, nchk++)
+	  pass = same_data( d1[i] , d2[i] );
+      }
+    std::ostringstream m; m << "intervals checked=" << nchk;
+    record(R,"signal/slice-fast-matches-timeline", pass, m.str(), V);
+    std::remove( edf.c_str() );
+  } catch(std::exception & e) { record(R,"signal/slice-fast-matches-timeline",false,e.what(),V); }
+
+  // A14 — signal_view_t gives the same samples, time-points and
+  // records as slice_t (records[] and channel-store backed)
+  try {
+    const std::string edf_file = write_temp_edf( eng, "test_sview" );
+
+    bool pass = true;
+    int nchk = 0;
+    for (int mode = 0 ; mode < 2 ; mode++ )
+      {
+	globals::edf_channel_store = mode == 1;
+	annotation_set_t annotations;
+	edf_t edf( &annotations );
+	if ( ! edf.attach( edf_file , "T_sv" , NULL , true ) )
+	  throw std::runtime_error( "could not attach" );
+	
+	std::vector<interval_t> ivals;
+	ivals.push_back( edf.timeline.wholetrace() );
+	ivals.push_back( interval_t( 1.003 * globals::tp_1sec , 27.5 * globals::tp_1sec ) );
+	ivals.push_back( interval_t( 9.99 * globals::tp_1sec , 10.01 * globals::tp_1sec ) );
+	
+	for (int i=0; i<ivals.size(); i++)
+	  for (int s=0; s<edf.header.ns; s++)
+	    {
+	      signal_view_t view( edf , s , ivals[i] );
+	      slice_t slice( edf , s , ivals[i] );
+	      const std::vector<double> * d = slice.pdata();
+	      const std::vector<uint64_t> * tp = slice.ptimepoints();
+	      const std::vector<int> * rec = slice.precords();
+	      const std::vector<double> x = view.physical();
+	      if ( view.size() != d->size() || x != *d ) pass = false;
+	      for (int j=0; pass && j<view.size(); j++)
+		if ( view[j] != (*d)[j] || view.timepoint(j) != (*tp)[j] || view.record(j) != (*rec)[j] )
+		  pass = false;
+	      ++nchk;
+	    }
+      }
+    globals::edf_channel_store = false;
+    
+    std::ostringstream m; m << "views checked=" << nchk;
+    record(R,"signal/view-matches-slice", pass, m.str(), V);
+    std::remove( edf_file.c_str() );
+  } catch(std::exception & e) { globals::edf_channel_store = false; record(R,"signal/view-matches-slice",false,e.what(),V); }
+
+  // A15 — eigen_matslice_t::extract() (double and float) matches
+  // per-channel slice_t values and time-points
+  try {
+    const std::string edf_file = write_temp_edf( eng, "test_mslice" );
+
+    bool pass = true;
+    int nchk = 0;
+    for (int mode = 0 ; mode < 2 ; mode++ )
+      {
+	globals::edf_channel_store = mode == 1;
+	annotation_set_t annotations;
+	edf_t edf( &annotations );
+	if ( ! edf.attach( edf_file , "T_ms" , NULL , true ) )
+	  throw std::runtime_error( "could not attach" );
+	signal_list_t signals = edf.header.signal_list( "*" );
+	
+	std::vector<interval_t> ivals;
+	ivals.push_back( edf.timeline.wholetrace() );
+	ivals.push_back( interval_t( 1.003 * globals::tp_1sec , 27.5 * globals::tp_1sec ) );
+	ivals.push_back( interval_t( 9.99 * globals::tp_1sec , 10.01 * globals::tp_1sec ) );
+
+	// reused (i.e. preallocated after the first) output
+	Eigen::MatrixXf Xf;
+	
+	for (int i=0; i<ivals.size(); i++)
+	  {
+	    eigen_matslice_t mslice( edf , signals , ivals[i] );
+	    const Eigen::MatrixXd & X = mslice.data_ref();
+	    const std::vector<uint64_t> * mtp = mslice.ptimepoints();
+	    const int n = eigen_matslice_t::extract( edf , signals , ivals[i] , Xf );
+	    if ( X.cols() != signals.size() || n != X.rows() || Xf.rows() != n ) pass = false;
+	    for (int s=0; pass && s<signals.size(); s++)
+	      {
+		slice_t slice( edf , signals(s) , ivals[i] );
+		const std::vector<double> * d = slice.pdata();
+		const std::vector<uint64_t> * tp = slice.ptimepoints();
+		if ( d->size() != n || *tp != *mtp ) pass = false;
+		for (int j=0; pass && j<n; j++)
+		  if ( X(j,s) != (*d)[j] || Xf(j,s) != (float)(*d)[j] ) pass = false;
+		++nchk;
+	      }
+	  }
+      }
+    globals::edf_channel_store = false;
+    
+    std::ostringstream m; m << "channels checked=" << nchk;
+    record(R,"signal/matslice-extract-matches-slice", pass, m.str(), V);
+    std::remove( edf_file.c_str() );
+  } catch(std::exception & e) { globals::edf_channel_store = false; record(R,"signal/matslice-extract-matches-slice",false,e.what(),V); }
+
+  // A16 — dig2phys kernels (double and float): every kernel set gives
+  // bit-identical values to edf_record_t::dig2phys(), incl. at the
+  // int16 extremes, for lengths either side of the vector widths
+  try {
+    const std::vector<std::string> kernels = edf_simd::available();
+    const int lens[] = { 1 , 7 , 8 , 9 , 17 };
+    const double scales[][2] = { { 0.0030518043793392844 , 0.5 } ,   // i.e. +/-100 uV
+				 { -1.7e-4 , -12345.0 } ,            // flipped
+				 { 1.0 , 0.0 } };
+    bool pass = kernels.size() > 0;
+    int nchk = 0;
+    for (int k=0; k<kernels.size(); k++)
+      {
+	edf_simd::force( kernels[k] );
+	for (int l=0; l<5; l++)
+	  for (int c=0; c<3; c++)
+	    {
+	      const int n = lens[l];
+	      std::vector<int16_t> d( n );
+	      const int16_t fixed[] = { -32768 , 32767 , 0 , -1 , 1 };
+	      for (int i=0; i<n; i++)
+		d[i] = i < 5 ? fixed[ ( i + l ) % 5 ] : (int16_t)( ( i * 7919 ) % 65536 - 32768 );
+	      const double bv = scales[c][0] , os = scales[c][1];
+	      std::vector<double> x( n );
+	      std::vector<float> xf( n );
+	      edf_simd::dig2phys( d.data() , x.data() , n , bv , os );
+	      edf_simd::dig2phys( d.data() , xf.data() , n , bv , os );
+	      for (int i=0; i<n; i++)
+		{
+		  const double y = edf_record_t::dig2phys( d[i] , bv , os );
+		  const float yf = y;
+		  if ( memcmp( &x[i] , &y , sizeof(double) ) || memcmp( &xf[i] , &yf , sizeof(float) ) ) pass = false;
+		}
+	      ++nchk;
+	    }
+      }
+    edf_simd::force( kernels[0] );
+    std::ostringstream m; m << "kernels=" << kernels.size() << " arrays=" << nchk;
+    record(R,"signal/dig2phys-kernels-identical", pass , m.str(), V);
+  } catch(std::exception & e) { record(R,"signal/dig2phys-kernels-identical",false,e.what(),V); }
+
+  // A17 — signal_view_t::record_iterator: the per-record steps give the
+  // same values and records as slice_t (incl. unaligned intervals), and
+  // STATS min=T (whose whole-trace mean is taken that way) gives the
+  // same MEAN as STATS
+  try {
+    const std::string edf_file = write_temp_edf( eng, "test_viter", true );
+
+    bool pass = true;
+    int nchk = 0;
+    for (int mode = 0 ; mode < 2 ; mode++ )
+      {
+	globals::edf_channel_store = mode == 1;
+	annotation_set_t annotations;
+	edf_t edf( &annotations );
+	if ( ! edf.attach( edf_file , "T_vi" , NULL , true ) )
+	  throw std::runtime_error( "could not attach" );
+	
+	std::vector<interval_t> ivals;
+	ivals.push_back( edf.timeline.wholetrace() );
+	ivals.push_back( interval_t( 1.003 * globals::tp_1sec , 57.5 * globals::tp_1sec ) );
+	ivals.push_back( interval_t( 29.99 * globals::tp_1sec , 30.01 * globals::tp_1sec ) );
+	
+	for (int i=0; i<ivals.size(); i++)
+	  for (int s=0; s<edf.header.ns; s++)
+	    {
+	      signal_view_t view( edf , s , ivals[i] );
+	      slice_t slice( edf , s , ivals[i] );
+	      const std::vector<double> * d = slice.pdata();
+	      const std::vector<int> * rec = slice.precords();
+	      int k = 0;
+	      for ( signal_view_t::record_iterator rr = view.by_record() ; rr.more() ; rr.next() )
+		{
+		  if ( rr.index() != k || rr.size() < 1 || rr.size() > edf.header.n_samples[s] ) pass = false;
+		  for (int j=0; pass && j<rr.size(); j++, k++)
+		    if ( k >= d->size() || rr[j] != (*d)[k] || rr.record() != (*rec)[k] ) pass = false;
+		}
+	      if ( k != d->size() ) pass = false;
+	      ++nchk;
+	    }
+      }
+    globals::edf_channel_store = false;
+
+    auto p1 = eng->inst("T_vi1");
+    p1->attach_edf( edf_file );
+    p1->eval( "STATS sig=EMG" );
+    auto p2 = eng->inst("T_vi2");
+    p2->attach_edf( edf_file );
+    p2->eval( "STATS sig=EMG min=T" );
+    const double m1 = get_val( p1, "STATS", "MEAN" ) , m2 = get_val( p2, "STATS", "MEAN" );
+    pass = pass && m1 == m2;
+    
+    std::ostringstream m; m << "views checked=" << nchk << " mean=" << m1 << "/" << m2;
+    record(R,"signal/view-record-iterator", pass, m.str(), V);
+    std::remove( edf_file.c_str() );
+  } catch(std::exception & e) { globals::edf_channel_store = false; record(R,"signal/view-record-iterator",false,e.what(),V); }
+
+  // A18 — precision=float: signal_view_t (by sample, in bulk and by
+  // record) reads the float-backed values, as slice_t; and a channel
+  // added by add_signal() (whose int16 form is deferred) is written
+  // with its samples, i.e. not zeros
+  try {
+    std::vector<double> x = make_two_sines( 128 , 20 , 10.0 , 50.0 , 3.0 , 20.0 );
+    x[7] = 1e4;
+    const std::string tmp = temp_base_path("test_fview");
+    
+    globals::float_signals = true;
+    annotation_set_t a1;
+    edf_t e1( &a1 );
+    e1.init_empty( "T_fv1" , 20 , 1 , "01.01.85" , "22.00.00" , true );
+    e1.add_signal( "EEG" , 128 , x );
+    bool pass = e1.has_float_store( 0 ) && e1.float_store_stale( 0 );
+    
+    const std::vector<double> d = *slice_t( e1 , 0 , e1.timeline.wholetrace() ).pdata();
+    {
+      signal_view_t view( e1 , 0 , e1.timeline.wholetrace() );
+      pass = pass && view.size() == d.size() && view.physical() == d;
+      for (int i=0; pass && i<view.size(); i++)
+	if ( view[i] != d[i] ) pass = false;
+      int k = 0;
+      for ( signal_view_t::record_iterator rr = view.by_record() ; rr.more() ; rr.next() )
+	for (int j=0; j<rr.size(); j++, k++)
+	  if ( k >= d.size() || rr[j] != d[k] ) pass = false;
+      pass = pass && k == d.size();
+    }
+    
+    e1.write( tmp + ".edf" );
+    pass = pass && ! e1.float_store_stale( 0 );
+    globals::float_signals = false;
+    
+    annotation_set_t a2;
+    edf_t e2( &a2 );
+    if ( ! e2.attach( tmp + ".edf" , "T_fv2" , NULL , true ) )
+      throw std::runtime_error( "could not attach" );
+    const std::vector<double> y = *slice_t( e2 , 0 , e2.timeline.wholetrace() ).pdata();
+    double maxerr = 0;
+    for (int i=0; i<y.size() && i<x.size(); i++)
+      maxerr = std::max( maxerr , fabs( y[i] - x[i] ) );
+    pass = pass && y.size() == x.size() && maxerr < 2 * e2.header.bitvalue[0];
+    
+    std::ostringstream m; m << "written err=" << maxerr;
+    record(R,"signal/float-store-view-write", pass , m.str(), V);
+    std::remove( (tmp + ".edf").c_str() );
+  } catch(std::exception & e) { globals::float_signals = false; record(R,"signal/float-store-view-write",false,e.what(),V); }
 }
 
 // ============================================================
@@ -673,6 +1194,54 @@ static void test_epoch( lunapi_t * eng,
     std::ostringstream m; m << "NE1=" << ne1 << " NE2=" << ne2;
     record(R,"epoch/dump-stable", approx_equal(ne1,ne2,0.5), m.str(), V);
   } catch(std::exception & e) { record(R,"epoch/dump-stable",false,e.what(),V); }
+
+  // B7 — flat epoch tables: on a discontinuous (post-RE) timeline,
+  // sliding 30s/1s epochs resolve to the same records/samples (and
+  // first/last records) as the timeline search, on repeated passes
+  try {
+    annotation_set_t annotations;
+    edf_t edf( &annotations );
+    edf.init_empty( "T_etab" , 600 , 1 , "01.01.85" , "22.00.00" , true );
+    edf.add_signal( "EEG" , 16 , make_sine( 16 , 600 , 2 , 1 ) );
+    edf.add_signal( "EMG" , 4 , make_sine( 4 , 600 , 1 , 1 ) );
+    
+    const int ne0 = edf.timeline.set_epoch( 30 , 30 );
+    for (int e=0; e<ne0; e+=4) edf.timeline.set_epoch_mask( e );
+    edf.restructure();
+    
+    const int ne = edf.timeline.set_epoch( 30 , 1 );
+    const bool save = globals::epoch_tables;
+    bool pass = ne > 0 && ! edf.header.continuous;
+    int nchk = 0;
+    for (int pass_n = 0 ; pass_n < 2 ; pass_n++ )
+      {
+	edf.timeline.first_epoch();
+	while ( pass )
+	  {
+	    const int e = edf.timeline.next_epoch();
+	    if ( e == -1 ) break;
+	    const interval_t interval = edf.timeline.epoch( e );
+	    for (int s=0; s<2; s++)
+	      {
+		int a[4] , b[4];
+		globals::epoch_tables = true;
+		const bool ok1 = edf.timeline.interval2records( interval , edf.header.n_samples[s] , a , a+1 , a+2 , a+3 );
+		globals::epoch_tables = false;
+		const bool ok2 = edf.timeline.interval2records( interval , edf.header.n_samples[s] , b , b+1 , b+2 , b+3 );
+		if ( ok1 != ok2 || ( ok1 && ( a[0] != b[0] || a[1] != b[1] || a[2] != b[2] || a[3] != b[3] ) ) ) pass = false;
+		++nchk;
+	      }
+	    globals::epoch_tables = true;
+	    int r1 = 0 , r2 = 0;
+	    const std::set<int> recs = edf.timeline.records_in_interval( interval );
+	    if ( ! edf.timeline.epoch_records( e , &r1 , &r2 )
+		 || recs.size() == 0 || r1 != *recs.begin() || r2 != *recs.rbegin() ) pass = false;
+	  }
+      }
+    globals::epoch_tables = save;
+    std::ostringstream m; m << "NE=" << ne << " checks=" << nchk;
+    record(R,"epoch/flat-tables", pass && nchk == 4 * ne , m.str(), V);
+  } catch(std::exception & e) { record(R,"epoch/flat-tables",false,e.what(),V); }
 }
 
 // ============================================================
@@ -802,6 +1371,163 @@ static void test_mask( lunapi_t * eng,
     m << "dur before=" << dur_before << " after=" << dur_after << " (exp≈3000s)";
     record(R,"mask/re-duration", dur_after < dur_before && approx_equal(dur_after,3000.0,60.0), m.str(), V);
   } catch(std::exception & e) { record(R,"mask/re-duration",false,e.what(),V); }
+
+  // C11 — FREEZE copies share record storage (copy-on-write): a copy
+  // points at the same samples until one side is modified, after
+  // which the other is unchanged; and THAW restores a masked dataset
+  try {
+    annotation_set_t annotations;
+    edf_t edf( &annotations );
+    edf.init_empty( "T_cow" , 10 , 1 , "01.01.85" , "22.00.00" , true );
+    std::vector<double> x = make_sine( 64 , 10 , 5 , 1 );
+    edf.add_signal( "EEG" , 64 , x );
+    edf.add_signal( "EMG" , 64 , x );
+    
+    edf_t copy( &annotations );
+    copy = edf;
+    copy.update_edf_pointers( &copy );
+    
+    bool pass = copy.record_samples( 3 , 0 ) == edf.record_samples( 3 , 0 );
+    
+    std::vector<int16_t> before( edf.record_samples( 3 , 0 ) , edf.record_samples( 3 , 0 ) + 64 );
+    std::vector<double> y( x.size() , 0.5 );
+    copy.update_signal( 0 , &y );
+    std::vector<int16_t> after( edf.record_samples( 3 , 0 ) , edf.record_samples( 3 , 0 ) + 64 );
+    
+    pass = pass && before == after 
+      && copy.record_samples( 3 , 0 ) != edf.record_samples( 3 , 0 )
+      && copy.record_samples( 3 , 1 ) == edf.record_samples( 3 , 1 );
+    
+    auto p = make_sine_inst(eng);
+    const double dur0 = p->last_sec();
+    p->eval( "EPOCH len=30 & FREEZE F1 & MASK epoch=1-100 & RE & THAW F1" );
+    const double dur1 = p->last_sec();
+    pass = pass && approx_equal( dur0 , dur1 , 0.5 );
+    
+    std::ostringstream m; m << "dur before=" << dur0 << " after THAW=" << dur1;
+    record(R,"mask/freeze-cow", pass , m.str(), V);
+  } catch(std::exception & e) { record(R,"mask/freeze-cow",false,e.what(),V); }
+
+  // C12 — RE compacts records[] and the timeline maps in place: after
+  // two rounds, only retained records remain, in step across maps
+  try {
+    annotation_set_t annotations;
+    edf_t edf( &annotations );
+    edf.init_empty( "T_re" , 300 , 1 , "01.01.85" , "22.00.00" , true );
+    edf.add_signal( "EEG" , 16 , make_sine( 16 , 300 , 2 , 1 ) );
+    
+    const int ne = edf.timeline.set_epoch( 30 , 30 );
+    for (int e=0; e<ne; e+=3) edf.timeline.set_epoch_mask( e );
+    edf.restructure();
+    const int ne2 = edf.timeline.set_epoch( 30 , 30 );
+    edf.timeline.set_epoch_mask( 1 );
+    edf.restructure();
+    
+    const timeline_t & tl = edf.timeline;
+    bool pass = ne == 10 && ne2 == 6 && edf.header.nr == 150 && edf.records.size() == 150
+      && tl.rec2tp.size() == 150 && tl.rec2tp_end.size() == 150
+      && tl.tp2rec.size() == 150 && tl.rec2orig_rec.size() == 150;
+    
+    int cnt = 0;
+    std::map<int,uint64_t>::const_iterator rr = tl.rec2tp.begin();
+    std::map<int,edf_record_t>::const_iterator qq = edf.records.begin();
+    while ( pass && rr != tl.rec2tp.end() && qq != edf.records.end() )
+      {
+	std::map<int,int>::const_iterator oo = tl.rec2orig_rec.find( rr->first );
+	std::map<uint64_t,int>::const_iterator tt = tl.tp2rec.find( rr->second );
+	pass = qq->first == rr->first
+	  && oo != tl.rec2orig_rec.end() && oo->second == cnt++
+	  && tt != tl.tp2rec.end() && tt->second == rr->first;
+	++rr; ++qq;
+      }
+    
+    std::ostringstream m; m << "nr=" << edf.header.nr << " epochs=" << ne << "," << ne2;
+    record(R,"mask/re-inplace-maps", pass , m.str(), V);
+  } catch(std::exception & e) { record(R,"mask/re-inplace-maps",false,e.what(),V); }
+
+  // C13 — bit-vector epoch mask and CHEP bit-matrix: word-parallel
+  // ops across word boundaries, label interning, merge and retain
+  try {
+    bitvec_t a( 130 ) , b( 130 , true );
+    for (int i=0; i<130; i+=3) a[i] = true;
+    const size_t na = a.count();
+    bitvec_t c = a; c.flip();
+    bitvec_t d = a; d &= b;
+    bitvec_t f = a; f.andnot( a );
+    bool pass = na == 44 && c.count() == 130 - na && d.count() == na && ! f.any()
+      && b.count() == 130 && a[129] && ! a[128];
+    a.resize( 200 , true );
+    pass = pass && a.count() == na + 70;
+    
+    chep_mask_t m;
+    for (int e=1; e<=100; e++)
+      for (int ch=0; ch<70; ch++)
+	if ( ( e + ch ) % 7 == 0 ) m.set( e , m.channel( "C" + std::to_string( ch ) ) );
+    m.add_row( 150 );
+    std::vector<int> cc = m.column_counts();
+    pass = pass && m.num_channels() == 70 && m.rows().size() == 101 && m.has_row( 150 ) && m.count( 150 ) == 0
+      && m.get( 7 , m.find_channel( "C0" ) ) && m.get( 1 , m.find_channel( "C69" ) )
+      && ! m.get( 2 , m.find_channel( "C69" ) ) && cc[ m.find_channel( "C0" ) ] == 14
+      && m.unset( 7 , m.find_channel( "C0" ) ) && ! m.unset( 7 , m.find_channel( "C0" ) );
+    
+    chep_mask_t m2;
+    m2.set( 3 , m2.channel( "X" ) );
+    m2.set( 7 , m2.channel( "C0" ) );
+    m.merge( m2 );
+    pass = pass && m.get( 3 , m.find_channel( "X" ) ) && m.get( 7 , m.find_channel( "C0" ) );
+    
+    std::set<int> keep_e = { 3 , 7 , 150 };
+    std::set<std::string> keep_ch = { "C0" , "X" };
+    m.retain( keep_e , keep_ch );
+    pass = pass && m.rows().size() == 2 && m.count( 3 ) == 1 && m.count( 7 ) == 1 && ! m.has_row( 150 );
+    
+    std::ostringstream msg; msg << "bits=" << na << " rows=" << m.rows().size();
+    record(R,"mask/bitset-chep", pass , msg.str(), V);
+  } catch(std::exception & e) { record(R,"mask/bitset-chep",false,e.what(),V); }
+
+  // C14 — compiled MASK expr (block-wise over all epochs) gives the
+  // same matches as the per-epoch Eval path, for sliding epochs that
+  // span several blocks and see zero, one or two events each
+  try {
+    std::vector<std::tuple<double,double>> ar;
+    for (int i = 0; i < 470; i++)
+      ar.push_back( { i * 45.0 + 7 , i * 45.0 + 9 + ( i % 9 ) } );
+    auto n2 = make_stage_annots(300, 30.0);
+    auto n3 = make_stage_annots(420, 30.0);
+    for (auto & iv : n3) {
+      std::get<0>(iv) += 300*30.0;
+      std::get<1>(iv) += 300*30.0;
+    }
+    
+    const std::vector<std::string> exprs = {
+      "if(N2)" ,
+      "ar_sec > 5" ,
+      "sum( ar_sec ) > 8 || if(N3)" ,
+      "length( ar ) == 2 ; if(N2)" };
+    
+    const bool save = globals::mask_compile;
+    bool pass = true;
+    std::ostringstream m;
+    for (int x = 0; x < exprs.size(); x++)
+      {
+	double nm[2] , nr[2];
+	for (int mode = 0; mode < 2; mode++)
+	  {
+	    globals::mask_compile = mode == 1;
+	    auto p = make_sine_inst(eng);
+	    p->insert_annotation("N2", n2);
+	    p->insert_annotation("N3", n3);
+	    p->insert_annotation("ar", ar);
+	    p->eval("EPOCH len=30 inc=10 & MASK expr=\"" + exprs[x] + "\"");
+	    nm[mode] = get_val(p,"MASK","N_MATCHES");
+	    nr[mode] = get_val(p,"MASK","N_RETAINED");
+	  }
+	pass = pass && nm[0] == nm[1] && nr[0] == nr[1] && nm[0] > 0;
+	m << " [" << exprs[x] << "] " << nm[1] << "/" << nm[0];
+      }
+    globals::mask_compile = save;
+    record(R,"mask/compiled-expr", pass , m.str(), V);
+  } catch(std::exception & e) { globals::mask_compile = true; record(R,"mask/compiled-expr",false,e.what(),V); }
 }
 
 // ============================================================
@@ -1231,6 +1957,99 @@ static void test_annot( lunapi_t * eng,
     m << "no-interp=" << fa.size() << " interp30=" << fai.size() << " (exp 1 and >=4)";
     record(R,"annot/fetch-interp", pass, m.str(), V);
   } catch(std::exception & e) { record(R,"annot/fetch-interp",false,e.what(),V); }
+
+  // I7 — sweep-line overlaps: for unsorted windows of varying length,
+  // and events including zero-duration points and fully-spanning
+  // intervals, the same instances (in the same order) as extract()
+  // and extract_complete_overlap()
+  try {
+    annotation_set_t annotations;
+    annot_t * a = annotations.add( "EVT" );
+    uint32_t lcg = 77;
+    for (int i = 0; i < 2000; i++)
+      {
+	lcg = lcg * 1664525u + 1013904223u;
+	const uint64_t start = ( lcg >> 12 ) % 100000;
+	const uint64_t dur = i % 10 == 0 ? 0 : i % 50 == 1 ? 5000 : ( lcg >> 4 ) % 200;
+	a->add( i % 3 ? "x" : "y" , interval_t( start , start + dur ) , "." );
+      }
+    std::vector<interval_t> windows;
+    for (int i = 0; i < 3000; i++)
+      {
+	lcg = lcg * 1664525u + 1013904223u;
+	const uint64_t start = i % 7 == 0 ? ( lcg >> 8 ) % 100000 : i * 33;
+	windows.push_back( interval_t( start , start + ( i % 5 == 0 ? 1 : 30 + ( lcg >> 20 ) % 300 ) ) );
+      }
+    
+    annot_sweep_t sweep( windows );
+    bool pass = true;
+    uint64_t nhits = 0;
+    for (int complete = 0; complete < 2; complete++)
+      {
+	sweep.run( a , complete == 1 );
+	for (int w = 0; w < windows.size(); w++)
+	  {
+	    annot_map_t ref = complete ? a->extract_complete_overlap( windows[w] ) : a->extract( windows[w] );
+	    if ( ref.size() != sweep.count( w ) ) { pass = false; break; }
+	    int i = 0;
+	    for (auto rr = ref.begin(); rr != ref.end(); ++rr, ++i)
+	      if ( ! ( rr->first.interval == sweep.idx( w , i ).interval ) || rr->first.id != sweep.idx( w , i ).id )
+		pass = false;
+	    nhits += ref.size();
+	  }
+      }
+    std::ostringstream m; m << "windows=" << windows.size() << " hits=" << nhits;
+    record(R,"annot/sweep-overlaps", pass && nhits > 0 , m.str(), V);
+  } catch(std::exception & e) { record(R,"annot/sweep-overlaps",false,e.what(),V); }
+
+  // I8 — columnar instance meta-data: values of each type read back
+  // (via find(), data iteration and print()) as the avar_t types would
+  // give them, overwriting with a new type, and row reuse after remove()
+  try {
+    annotation_set_t annotations;
+    annot_t * a = annotations.add( "EVT" );
+    instance_t * i1 = a->add( "a" , interval_t( 0 , 10 ) , "." );
+    instance_t * i2 = a->add( "b" , interval_t( 5 , 20 ) , "." );
+    i1->set( "n" , 3 );
+    i1->set( "x" , 2.5 );
+    i1->set( "s" , std::string( "N2" ) );
+    i1->set( "f" );
+    i1->set( "b" , true );
+    i1->set( "v" , std::vector<int>{ 1 , 2 , 3 } );
+    i2->set( "s" , std::string( "N2" ) );
+    i2->set( "n" , std::string( "7" ) );  // new type for existing key
+    i2->set( "n" , 8.0 );                 // and again
+    
+    bool pass = true;
+    std::ostringstream m;
+    if ( i1->find( "n" )->int_value() != 3 || i1->find( "x" )->text_value() != "2.5" ) pass = false;
+    if ( i1->find( "f" )->atype() != globals::A_FLAG_T || i1->find( "f" )->text_value() != "." ) pass = false;
+    if ( i1->find( "b" )->text_value() != "true" || i1->find( "v" )->text_value() != "3" ) pass = false;
+    if ( i1->find( "missing" ) != NULL || i2->find( "x" ) != NULL ) pass = false;
+    if ( i2->type( "n" ) != globals::A_DBL_T || i2->find( "n" )->int_value() != 8 ) pass = false;
+    if ( i1->data.size() != 6 || i2->data.size() != 2 ) pass = false;
+
+    std::string keys;
+    for (auto dd = i1->data.begin(); dd != i1->data.end(); ++dd) keys += dd->first;
+    if ( keys != "bfnsvx" ) pass = false;
+    
+    const std::string p1 = i1->print();
+    if ( p1 != "b=true;f=.;n=3;s=N2;v=1,2,3;x=2.5" ) pass = false;
+    m << p1 << " | " << i2->print();
+
+    // copy, then remove an instance and reuse its (now empty) row
+    instance_t * i3 = a->add( "c" , interval_t( 30 , 40 ) , "." );
+    i3->copy( *i1 );
+    if ( i3->print() != p1 ) pass = false;
+    a->remove( "a" , interval_t( 0 , 10 ) , "." );
+    instance_t * i4 = a->add( "d" , interval_t( 50 , 60 ) , "." );
+    i4->set( "s" , std::string( "R" ) );
+    if ( i4->data.size() != 1 || i4->print() != "s=R" ) pass = false;
+    if ( a->meta.num_values() != 9 || a->meta.num_strings() != 3 ) pass = false;
+    m << " values=" << a->meta.num_values() << " strings=" << a->meta.num_strings();
+
+    record(R,"annot/meta-store", pass, m.str(), V);
+  } catch(std::exception & e) { record(R,"annot/meta-store",false,e.what(),V); }
 }
 
 // ============================================================
@@ -1297,8 +2116,463 @@ static void test_write( lunapi_t * eng,
     record(R,"write/stats-preserved", pass, m.str(), V);
     std::remove( (tmp + ".edf").c_str() );
   } catch(std::exception & e) { record(R,"write/stats-preserved",false,e.what(),V); }
+
+  // J4 — buffered/passthrough WRITE gives byte-identical files to the
+  // record-by-record writer (untouched, dropped/derived channels,
+  // channel-store, EDF+D)
+  try {
+    const std::string edf = write_temp_edf( eng, "test_wbuf", true );
+    
+    auto slurp = []( const std::string & f ) {
+      std::string b;
+      FILE * in = fopen( f.c_str() , "rb" );
+      if ( in == NULL ) return b;
+      char c[ 65536 ];
+      size_t n;
+      while ( ( n = fread( c , 1 , sizeof(c) , in ) ) > 0 ) b.append( c , n );
+      fclose( in );
+      return b;
+    };
+
+    const char * scripts[] = { "" , 
+			       "SIGNALS drop=EMG" , 
+			       "STATS sig=EEG & COPY sig=EEG tag=_D & SIGNALS drop=ECG" ,
+			       "" ,   // i.e. with the channel store
+			       "EPOCH len=30 & MASK epoch=2-3,7 & RE" };
+    
+    bool pass = true;
+    int nfiles = 0;
+    for (int i=0; i<5; i++)
+      {
+	std::string ref;
+	const int wbuf[] = { 0 , 1 , 16 };
+	for (int k=0; k<3; k++)
+	  {
+	    eng->var( "write-buffer" , Helper::int2str( wbuf[k] ) );
+	    eng->var( "channel-store" , i == 3 ? "T" : "F" );
+	    auto p1 = eng->inst("T_wb1");
+	    p1->attach_edf( edf );
+	    if ( i == 3 ) std::get<1>( p1->data({"EEG"}, {}, false) ); // i.e. fill the channel store
+	    const std::string out = edf + "_out";
+	    const std::string cmd = scripts[i];
+	    p1->eval( cmd + ( cmd == "" ? "" : " & " ) + "WRITE edf=" + out );
+	    const std::string b = slurp( out + ".edf" );
+	    std::remove( (out + ".edf").c_str() );
+	    if ( b.size() < 256 ) pass = false;
+	    if ( k == 0 ) ref = b;
+	    else if ( b != ref ) pass = false;
+	    ++nfiles;
+	  }
+      }
+    eng->var( "write-buffer" , "16" );
+    eng->var( "channel-store" , "F" );
+
+    std::ostringstream m; m << "files compared=" << nfiles;
+    record(R,"write/write-buffer-identical", pass, m.str(), V);
+    std::remove( edf.c_str() );
+  } catch(std::exception & e) { eng->var( "write-buffer" , "16" ); eng->var( "channel-store" , "F" ); record(R,"write/write-buffer-identical",false,e.what(),V); }
+
+  // J5 — multithreaded BGZF: byte-identical to single-threaded BGZF
+  // output, read back intact (incl. after seeks), and EDFZ written with
+  // edfz-threads=4 attaches with the same data either way
+  try {
+    const std::string tmp = temp_base_path("test_bgzf");
+    std::vector<uint8_t> raw( 3 * BGZF_BLOCK_SIZE + 12345 );
+    uint32_t lcg = 1;
+    for (size_t i=0; i<raw.size(); i++)
+      {
+	lcg = lcg * 1664525u + 1013904223u;
+	// first block all-random (i.e. will not compress into one block)
+	raw[i] = i < BGZF_BLOCK_SIZE ? ( lcg >> 24 ) : ( i / 7 ) % 13;
+      }
+    
+    std::string ref;
+    bool pass = true;
+    for (int threads = 1 ; threads <= 4 ; threads += 3 )
+      {
+	const std::string f = tmp + ".bgz";
+	BGZF * bz = bgzf_open( f.c_str() , "w" );
+	bgzf_mt( bz , threads , 1 );
+	// uneven writes, and a mid-stream flush
+	bgzf_write( bz , raw.data() , 1000 );
+	bgzf_flush( bz );
+	bgzf_write( bz , raw.data() + 1000 , raw.size() - 1000 );
+	bgzf_close( bz );
+	
+	std::string b;
+	FILE * in = fopen( f.c_str() , "rb" );
+	char c[ 65536 ];
+	size_t n;
+	while ( in && ( n = fread( c , 1 , sizeof(c) , in ) ) > 0 ) b.append( c , n );
+	if ( in ) fclose( in );
+	if ( threads == 1 ) ref = b;
+	else if ( b != ref || b.size() == 0 ) pass = false;
+
+	// read back (multithreaded, with a seek to a block start)
+	bz = bgzf_open( f.c_str() , "r" );
+	bgzf_mt( bz , 4 , 1 );
+	std::vector<uint8_t> back( raw.size() );
+	if ( bgzf_read( bz , back.data() , back.size() ) != back.size() || back != raw ) pass = false;
+	bgzf_seek( bz , 0 , SEEK_SET );
+	if ( bgzf_read( bz , back.data() , 500 ) != 500 || memcmp( back.data() , raw.data() , 500 ) ) pass = false;
+	bgzf_close( bz );
+	std::remove( f.c_str() );
+      }
+
+    auto p = make_test_inst( eng, "T_bz0" );
+    auto d0 = channel_data( p , {"EEG","EMG"} );
+    eng->var( "edfz-threads" , "4" );
+    p->eval( std::string("WRITE edfz edf=") + tmp );
+    auto p1 = eng->inst("T_bz1");
+    p1->attach_edf( tmp + ".edf.gz" );
+    auto d1 = channel_data( p1 , {"EEG","EMG"} );
+    eng->var( "edfz-threads" , "1" );
+    auto p2 = eng->inst("T_bz2");
+    p2->attach_edf( tmp + ".edf.gz" );
+    auto d2 = channel_data( p2 , {"EEG","EMG"} );
+    
+    pass = pass && d0.rows() > 0 && d1.rows() == d0.rows() && d2.rows() == d0.rows()
+      && ( d1 - d2 ).cwiseAbs().maxCoeff() == 0
+      && ( d0 - d1 ).cwiseAbs().maxCoeff() < 1e-2;
+    std::ostringstream m; m << "rows=" << d1.rows() << "/" << d2.rows();
+    record(R,"write/bgzf-threads-identical", pass, m.str(), V);
+    std::remove( (tmp + ".edf.gz").c_str() );
+  } catch(std::exception & e) { eng->var( "edfz-threads" , "1" ); record(R,"write/bgzf-threads-identical",false,e.what(),V); }
+
+  // J6 — EDFZ .idx: binary (EDFZv2) and text (EDFZv1) forms round-trip
+  // to the same dense index
+  try {
+    const std::string tmp = temp_base_path("test_edfzidx");
+    edfz_t z0;
+    z0.filename = tmp + ".edfz";
+    const int nr = 500;
+    for (int r=0; r<nr; r++)
+      z0.add_index( r , 1000 + (int64_t)r * 777 , (uint64_t)r * 30000000000ULL ,
+		    r % 50 == 0 ? "Arousal|+" + std::to_string(r) : "." );
+    
+    bool pass = true;
+    for (int binary = 0 ; binary <= 1 ; binary++ )
+      {
+	z0.write_index( 1234 , binary );
+	edfz_t z1;
+	z1.filename = z0.filename;
+	if ( ! z1.read_index() || z1.n_indexed() != nr || z1.record_size != 1234 ) pass = false;
+	for (int r=0; r<nr; r++)
+	  if ( z1.get_index(r) != z0.get_index(r)
+	       || z1.get_tindex(r) != z0.get_tindex(r)
+	       || z1.get_annots(r) != z0.get_annots(r) ) pass = false;
+	if ( z1.get_index( nr ) != -1 || z1.get_annots( -1 ) != "." ) pass = false;
+      }
+    std::ostringstream m; m << "records=" << nr;
+    record(R,"write/edfz-index-roundtrip", pass, m.str(), V);
+    std::remove( (tmp + ".edfz.idx").c_str() );
+  } catch(std::exception & e) { record(R,"write/edfz-index-roundtrip",false,e.what(),V); }
+
+  // J7 — EDFX (channel-major chunks): attaches with the same data and
+  // record time-stamps as the equivalent EDF (incl. EDF+D, a partial
+  // final chunk, and single-channel reads)
+  try {
+    const std::string tmp = temp_base_path("test_edfx");
+    bool pass = true;
+    int nrec = 0;
+    for (int edfd = 0 ; edfd <= 1 ; edfd++ )
+      {
+	auto p = make_test_inst( eng, "T_ec0", false, edfd ? 1 : 30, edfd );
+	globals::edfx_chunk_sec = 7;
+	p->eval( std::string("WRITE edf=") + tmp + "a" + ( edfd ? " EDF+D" : " force-edf=T" ) );
+	p->eval( std::string("WRITE edfx=T edf=") + tmp + "b" + ( edfd ? " EDF+D" : " force-edf=T" ) );
+	globals::edfx_chunk_sec = 30;
+	
+	annotation_set_t a1 , a2;
+	edf_t e1( &a1 ) , e2( &a2 );
+	if ( ! e1.attach( tmp + "a.edf" , "T_ec1" , NULL , true )
+	     || ! e2.attach( tmp + "b.edfx" , "T_ec2" , NULL , true ) )
+	  throw std::runtime_error( "could not attach" );
+	nrec = e2.header.nr_all;
+	if ( nrec != e1.header.nr_all || e2.header.continuous != e1.header.continuous ) pass = false;
+	for (int r=0; r<nrec && pass; r++)
+	  if ( e1.timeline.timepoint( r ) != e2.timeline.timepoint( r ) ) pass = false;
+	
+	auto p1 = eng->inst("T_ec1");
+	p1->attach_edf( tmp + "a.edf" );
+	auto p2 = eng->inst("T_ec2");
+	p2->attach_edf( tmp + "b.edfx" );
+	auto d1 = channel_data( p1 , {"EEG","EMG"} );
+	auto d2 = channel_data( p2 , {"EEG","EMG"} );
+	auto s1 = channel_data( p1 , {"EMG"} );
+	auto s2 = channel_data( p2 , {"EMG"} );
+	pass = pass && same_data( d1 , d2 ) && same_data( s1 , s2 );
+	
+	std::remove( (tmp + "a.edf").c_str() );
+	std::remove( (tmp + "b.edfx").c_str() );
+      }
+    std::ostringstream m; m << "EDF+D records=" << nrec;
+    record(R,"write/edfx-roundtrip", pass && nrec == 90, m.str(), V);
+  } catch(std::exception & e) { globals::edfx_chunk_sec = 30; record(R,"write/edfx-roundtrip",false,e.what(),V); }
+}
+
+
+// ============================================================
+// Group J2: EDF reading and storage options
+// ============================================================
+
+static void test_edf( lunapi_t * eng,
+		      std::vector<test_result_t> & R, bool V )
+{
+  const std::vector<std::string> chs = { "EEG" , "EMG" };
+  
+  // J2.1 — mmap=T reads exactly the same samples as standard reads
+  try {
+    const std::string edf = write_temp_edf( eng, "test_mmap" );
+    auto d1 = read_with_options( eng, edf, chs );
+    auto d2 = read_with_options( eng, edf, chs, {{"mmap","T"}}, {{"mmap","F"}} );
+    std::ostringstream m; m << "rows=" << d1.rows() << "/" << d2.rows();
+    record(R,"edf/mmap-matches-fread", same_data(d1,d2), m.str(), V);
+    std::remove( edf.c_str() );
+  } catch(std::exception & e) { record(R,"edf/mmap-matches-fread",false,e.what(),V); }
+
+  // J2.2 — channel-store=T: same samples, and edits (FLIP) still apply
+  try {
+    const std::string edf = write_temp_edf( eng, "test_cstore" );
+    const std::map<std::string,std::string> on = {{"channel-store","T"}}, off = {{"channel-store","F"}};
+    auto d1 = read_with_options( eng, edf, chs );
+    auto f1 = read_with_options( eng, edf, chs, {}, {}, "FLIP sig=EMG" );
+    auto d2 = read_with_options( eng, edf, chs, on, off );
+    auto f2 = read_with_options( eng, edf, chs, on, off, "FLIP sig=EMG" );
+    bool pass = same_data(d1,d2) && same_data(f1,f2) && ! same_data(d1,f1);
+    std::ostringstream m; m << "rows=" << d1.rows() << "/" << d2.rows();
+    record(R,"edf/channel-store-matches-records", pass, m.str(), V);
+    std::remove( edf.c_str() );
+  } catch(std::exception & e) { eng->var("channel-store","F"); record(R,"edf/channel-store-matches-records",false,e.what(),V); }
+
+  // J2.3 — coalesced (multi-record) reads match one-record-per-read
+  try {
+    const std::string edf = write_temp_edf( eng, "test_rchunk" );
+    auto d1 = read_with_options( eng, edf, chs, {{"read-chunk","0"}}, {{"read-chunk","16"}} );
+    auto d2 = read_with_options( eng, edf, chs, {{"readahead","T"}}, {{"readahead","F"}} );
+    std::ostringstream m; m << "rows=" << d1.rows() << "/" << d2.rows();
+    record(R,"edf/read-chunk-matches-per-record", same_data(d1,d2), m.str(), V);
+    std::remove( edf.c_str() );
+  } catch(std::exception & e) { record(R,"edf/read-chunk-matches-per-record",false,e.what(),V); }
+
+  // J2.4 — selective-read=T with sig= reads the same samples for the
+  // requested channel, also once the read set changes to another of
+  // the same size (i.e. the read spans are rebuilt, not reused)
+  try {
+    const std::string edf = write_temp_edf( eng, "test_selread", true );
+    auto d1 = read_with_options( eng, edf, {"EMG"}, {{"sig","EMG"}}, {{"sig","."}} );
+    auto d2 = read_with_options( eng, edf, {"EMG"}, {{"sig","EMG"},{"selective-read","T"}}, {{"sig","."},{"selective-read","F"}} );
+    bool pass = same_data(d1,d2);
+    
+    // EMG then EEG (both 256 Hz) into the same slot (with EEG's
+    // scaling); one record per read, so none are left in the read
+    // buffer (bar the last)
+    globals::edf_selective_read = true;
+    globals::edf_read_chunk = 0;
+    annotation_set_t a1 , a2;
+    edf_t e1( &a1 ) , e2( &a2 );
+    const std::set<std::string> emg = { "EMG" } , eeg = { "EEG" };
+    if ( ! e1.attach( edf , "T_sr1" , &emg , true ) || ! e2.attach( edf , "T_sr2" , &eeg , true ) )
+      throw std::runtime_error( "could not attach" );
+    slice_t slice( e1 , 0 , e1.timeline.wholetrace() );
+    e1.inp_signals_n = e2.inp_signals_n;
+    e1.header.bitvalue[0] = e2.header.bitvalue[0];
+    e1.header.offset[0] = e2.header.offset[0];
+    e1.records.clear();
+    const int nr = e1.header.nr_all - 1;
+    for (int r=0; r<nr; r++)
+      {
+	e1.ensure_loaded( r );
+	e2.ensure_loaded( r );
+	if ( e1.records.find( r )->second.get_pdata( 0 ) != e2.records.find( r )->second.get_pdata( 0 ) ) pass = false;
+      }
+    globals::edf_selective_read = false;
+    globals::edf_read_chunk = 16;
+    
+    std::ostringstream m; m << "rows=" << d1.rows() << "/" << d2.rows();
+    record(R,"edf/selective-read-matches-full", pass, m.str(), V);
+    std::remove( edf.c_str() );
+  } catch(std::exception & e) { globals::edf_selective_read = false; globals::edf_read_chunk = 16; record(R,"edf/selective-read-matches-full",false,e.what(),V); }
+
+  // J2.5 — mem-limit: records evicted by epoch-wise reads are re-read,
+  // and modified (FLIP) records are kept
+  try {
+    const std::string edf = write_temp_edf( eng, "test_memlim" );
+    const std::string cmds = "EPOCH len=30 & STATS sig=EEG epoch & FLIP sig=EMG & STATS sig=EEG epoch";
+    auto d1 = read_with_options( eng, edf, chs, {}, {}, cmds );
+    auto d2 = read_with_options( eng, edf, chs, {{"mem-limit","20K"}}, {{"mem-limit","0"}}, cmds );
+    std::ostringstream m; m << "rows=" << d1.rows() << "/" << d2.rows();
+    record(R,"edf/mem-limit-reread-matches", same_data(d1,d2), m.str(), V);
+    std::remove( edf.c_str() );
+  } catch(std::exception & e) { record(R,"edf/mem-limit-reread-matches",false,e.what(),V); }
+
+  // J2.6 — EDF+D: bulk time-track scan (plain and mmap), and the .tidx
+  // sidecar, give the same record time-stamps as per-record reads, for
+  // small (1s) records and for large (10s) ones, whose time-tracks are
+  // read one by one
+  try {
+    bool pass = true;
+    int nrec[2] = { 0 , 0 };
+    for (int large = 0 ; large <= 1 ; large++ )
+      {
+	const int rs = large ? 10 : 1;
+	const std::string edf_file = write_temp_edf( eng, large ? "test_tscan_l" : "test_tscan" , false , rs , true );
+	
+	for (int mode = 0 ; mode < 4 ; mode++ )
+	  {
+	    globals::edf_mmap = mode == 1;
+	    globals::edf_tindex = mode >= 2;  // 2: writes .tidx, 3: reads it
+	    annotation_set_t annotations;
+	    edf_t edf( &annotations );
+	    if ( ! edf.attach( edf_file , "T_ts" , NULL , true ) )
+	      throw std::runtime_error( "could not attach" );
+	    if ( edf.header.continuous ) pass = false;
+	    nrec[large] = edf.header.nr_all;
+	    if ( edf.cached_EDF_timepoints.size() != nrec[large] ) pass = false;
+	    
+	    std::map<int,uint64_t> scanned = edf.cached_EDF_timepoints;
+	    edf.cached_EDF_timepoints.clear();
+	    for (int r=0; r<nrec[large]; r++)
+	      if ( edf.timepoint_from_EDF( r ) != scanned[r] || edf.timeline.timepoint( r ) != scanned[r] )
+		pass = false;
+	    if ( mode >= 2 && ! Helper::fileExists( edf_file + ".tidx" ) ) pass = false;
+	  }
+	globals::edf_mmap = false;
+	globals::edf_tindex = false;
+	std::remove( edf_file.c_str() );
+	std::remove( (edf_file + ".tidx").c_str() );
+      }
+    
+    std::ostringstream m; m << "records=" << nrec[0] << "/" << nrec[1];
+    record(R,"edf/edfd-tscan-matches-per-record", pass && nrec[0] == 90 && nrec[1] == 9, m.str(), V);
+  } catch(std::exception & e) { globals::edf_mmap = globals::edf_tindex = false; record(R,"edf/edfd-tscan-matches-per-record",false,e.what(),V); }
+
+  // J2.7 — prefetch=1: the background pass reads and checks a written
+  // EDF's header (and reads annotation files); missing/truncated EDFs
+  // are flagged rather than halting
+  try {
+    const std::string edf = write_temp_edf( eng, "test_prefetch" );
+    const std::string tmp = edf.substr( 0 , edf.size() - 4 );
+    { std::ofstream A( ( tmp + ".annot" ).c_str() ); A << "class\tinstance\tstart\tstop\nN2\t.\t0\t30\n"; }
+    { std::ofstream T( ( tmp + "-bad.edf" ).c_str() ); T << "0       truncated"; }
+    
+    prefetch_t pf;
+    pf.start( { tmp + ".edf" , tmp + ".annot" , "." } );
+    bool pass = pf.edf_okay() && pf.edf() == tmp + ".edf";
+    std::ostringstream m; m << "good=" << pass;
+    
+    pf.start( { tmp + "-bad.edf" } );
+    pass = pass && ! pf.edf_okay() && pf.edf() == tmp + "-bad.edf";
+    pf.start( { tmp + "-missing.edf" , tmp + ".annot" } );
+    pass = pass && ! pf.edf_okay();
+    
+    record(R,"edf/prefetch-checks-inputs", pass, m.str(), V);
+    std::remove( (tmp + ".edf").c_str() );
+    std::remove( (tmp + ".annot").c_str() );
+    std::remove( (tmp + "-bad.edf").c_str() );
+  } catch(std::exception & e) { record(R,"edf/prefetch-checks-inputs",false,e.what(),V); }
+
+  // J2.8 — mem-limit with FREEZE/THAW: once FREEZE has closed the
+  // inputs, records must no longer be evicted (as they cannot be re-read)
+  try {
+    const std::string edf = write_temp_edf( eng, "test_memfrz" );
+    const char * scripts[] = { "EPOCH len=30 & FREEZE F1 & STATS sig=EEG epoch" ,
+			       "EPOCH len=30 & FREEZE F1 & STATS sig=EEG epoch & MASK epoch=1-5 & RE & STATS sig=EEG epoch & THAW F1 & STATS sig=EEG epoch" };
+    bool pass = true;
+    for (int i=0; i<2; i++)
+      {
+	auto d1 = read_with_options( eng, edf, chs, {}, {}, scripts[i] );
+	auto d2 = read_with_options( eng, edf, chs, {{"mem-limit","20K"}}, {{"mem-limit","0"}}, scripts[i] );
+	if ( ! same_data(d1,d2) ) pass = false;
+      }
+    record(R,"edf/mem-limit-freeze-thaw", pass, "", V);
+    std::remove( edf.c_str() );
+  } catch(std::exception & e) { record(R,"edf/mem-limit-freeze-thaw",false,e.what(),V); }
+
+  // J2.9 — edfz-index=T: WRITE edfz also writes a .idx, and the EDFZ
+  // then attaches via the index (i.e. records read on demand, not
+  // preloaded) with the same data and record time-stamps (incl. EDF+D)
+  try {
+    const std::string tmp = temp_base_path("test_edfzidx2");
+    const std::string z = tmp + ".edf.gz";
+    bool pass = true;
+    int nrec = 0;
+    for (int edfd = 0 ; edfd <= 1 ; edfd++ )
+      {
+	auto p = make_test_inst( eng, "T_zi0", false, edfd ? 1 : 30, edfd );
+	eng->var( "edfz-index" , "T" );
+	p->eval( std::string("WRITE edfz edf=") + tmp + ( edfd ? " EDF+D" : "" ) );
+	if ( ! Helper::fileExists( z + ".idx" ) ) pass = false;
+	
+	annotation_set_t a1 , a2;
+	edf_t e1( &a1 ) , e2( &a2 );
+	if ( ! e1.attach( z , "T_zi1" , NULL , true ) ) throw std::runtime_error( "could not attach" );
+	eng->var( "edfz-index" , "F" );
+	if ( ! e2.attach( z , "T_zi2" , NULL , true ) ) throw std::runtime_error( "could not attach" );
+	nrec = e1.header.nr_all;
+	if ( nrec != e2.header.nr_all || e1.header.continuous != e2.header.continuous
+	     || e1.records.size() != 0 || e2.records.size() != nrec ) pass = false;
+	for (int r=0; r<nrec && pass; r++)
+	  if ( e1.timeline.timepoint( r ) != e2.timeline.timepoint( r ) ) pass = false;
+	
+	auto d1 = read_with_options( eng, z, chs, {{"edfz-index","T"}}, {{"edfz-index","F"}} );
+	auto d2 = read_with_options( eng, z, chs );
+	pass = pass && same_data( d1 , d2 );
+	
+	std::remove( z.c_str() );
+	std::remove( (z + ".idx").c_str() );
+      }
+    std::ostringstream m; m << "EDF+D records=" << nrec;
+    record(R,"edf/edfz-index-attach-matches-preload", pass && nrec == 90, m.str(), V);
+  } catch(std::exception & e) { eng->var( "edfz-index" , "F" ); record(R,"edf/edfz-index-attach-matches-preload",false,e.what(),V); }
+
+  // J2.10 — prefetch=1 in a sample-list run (incl. blank lines, and row
+  // slices up to the last row) processes the same rows as without
+  try {
+    const std::string edf = write_temp_edf( eng, "test_pflist" );
+    const std::string tmp = edf.substr( 0 , edf.size() - 4 );
+    const std::string slst = tmp + ".lst";
+    { std::ofstream L( slst.c_str() );
+      L << "id1\t" << edf << "\n\nid2\t" << edf << "\n\n\nid3\t" << edf << "\nid4\t" << edf << "\n\n"; }
+    
+    const std::string ids[] = { "id1" , "id2" , "id3" , "id4" };
+    const int rows[3][2] = { { -1 , -1 } , { 2 , 3 } , { 4 , 4 } };
+    const int expected[3] = { 4 , 2 , 1 };
+    const std::string input0 = cmd_t::input;
+    bool pass = true;
+    std::ostringstream m;
+    for (int k=0; k<3; k++)
+      {
+	std::set<std::string> done[2];
+	for (int pf=0; pf<2; pf++)
+	  {
+	    globals::edf_prefetch = pf == 1;
+	    globals::sample_list_min = rows[k][0];
+	    globals::sample_list_max = rows[k][1];
+	    cmd_t::input = slst;
+	    cmd_t cmd( "WRITE edf=" + tmp + "_^ force-edf=T" );
+	    process_edfs( cmd );
+	    for (int i=0; i<4; i++)
+	      if ( Helper::fileExists( tmp + "_" + ids[i] + ".edf" ) )
+		{
+		  done[pf].insert( ids[i] );
+		  std::remove( (tmp + "_" + ids[i] + ".edf").c_str() );
+		}
+	  }
+	if ( done[0] != done[1] || done[0].size() != expected[k] ) pass = false;
+	m << ( k ? " " : "" ) << "rows=" << done[0].size() << "/" << done[1].size();
+      }
+    globals::edf_prefetch = false;
+    globals::sample_list_min = globals::sample_list_max = -1;
+    cmd_t::input = input0;
+    
+    record(R,"edf/prefetch-sample-list-rows", pass, m.str(), V);
+    std::remove( edf.c_str() );
+    std::remove( slst.c_str() );
+  } catch(std::exception & e) { globals::edf_prefetch = false; globals::sample_list_min = globals::sample_list_max = -1; record(R,"edf/prefetch-sample-list-rows",false,e.what(),V); }
 }
 
+
 // ============================================================
 // Group K: Script syntax
 // ============================================================
@@ -2407,6 +3681,7 @@ void proc_tests( const std::string & group, const bool verbose )
   RUN("hypno",    test_hypno)
   RUN("annot",    test_annot)
   RUN("write",    test_write)
+  RUN("edf",      test_edf)
   RUN("script",   test_script)
   RUN("eval",     test_eval)
   RUN("lunapi",   test_lunapi)
@@ -0,0 +1,343 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "timeline/bitmask.h"
+
+#include <algorithm>
+
+
+//
+// bitvec_t
+//
+
+int bitvec_t::popcount( uint64_t x )
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll( x );
+#else
+  x = x - ( ( x >> 1 ) & 0x5555555555555555ULL );
+  x = ( x & 0x3333333333333333ULL ) + ( ( x >> 2 ) & 0x3333333333333333ULL );
+  x = ( x + ( x >> 4 ) ) & 0x0f0f0f0f0f0f0f0fULL;
+  return ( x * 0x0101010101010101ULL ) >> 56;
+#endif
+}
+
+void bitvec_t::trim()
+{
+  if ( n & 63 ) w.back() &= ( 1ULL << ( n & 63 ) ) - 1ULL;
+}
+
+void bitvec_t::resize( const size_t n1 , const bool x )
+{
+  if ( n1 <= n )
+    {
+      n = n1;
+      w.resize( ( n + 63 ) >> 6 );
+      trim();
+      return;
+    }
+
+  const size_t n0 = n;
+  w.resize( ( n1 + 63 ) >> 6 , x ? ~0ULL : 0ULL );
+  n = n1;
+
+  // new bits within the old last word
+  if ( x )
+    for (size_t i = n0; i < n1 && ( i & 63 ) ; i++)
+      w[ i >> 6 ] |= 1ULL << ( i & 63 );
+
+  trim();
+}
+
+size_t bitvec_t::count() const
+{
+  size_t c = 0;
+  for (size_t i=0; i<w.size(); i++) c += popcount( w[i] );
+  return c;
+}
+
+bool bitvec_t::any() const
+{
+  for (size_t i=0; i<w.size(); i++) if ( w[i] ) return true;
+  return false;
+}
+
+void bitvec_t::flip()
+{
+  for (size_t i=0; i<w.size(); i++) w[i] = ~w[i];
+  trim();
+}
+
+bitvec_t & bitvec_t::operator&=( const bitvec_t & rhs )
+{
+  const size_t nw = std::min( w.size() , rhs.w.size() );
+  for (size_t i=0; i<nw; i++) w[i] &= rhs.w[i];
+  for (size_t i=nw; i<w.size(); i++) w[i] = 0;
+  return *this;
+}
+
+bitvec_t & bitvec_t::operator|=( const bitvec_t & rhs )
+{
+  const size_t nw = std::min( w.size() , rhs.w.size() );
+  for (size_t i=0; i<nw; i++) w[i] |= rhs.w[i];
+  trim();
+  return *this;
+}
+
+bitvec_t & bitvec_t::andnot( const bitvec_t & rhs )
+{
+  const size_t nw = std::min( w.size() , rhs.w.size() );
+  for (size_t i=0; i<nw; i++) w[i] &= ~rhs.w[i];
+  return *this;
+}
+
+
+//
+// chep_mask_t
+//
+
+void chep_mask_t::clear()
+{
+  labels.clear();
+  label2col.clear();
+  present.clear();
+  bits.clear();
+  wpr = 1;
+}
+
+int chep_mask_t::channel( const std::string & ch )
+{
+  std::unordered_map<std::string,int>::const_iterator ii = label2col.find( ch );
+  if ( ii != label2col.end() ) return ii->second;
+  const int c = labels.size();
+  labels.push_back( ch );
+  label2col[ ch ] = c;
+  reserve( -1 , c + 1 );
+  return c;
+}
+
+int chep_mask_t::find_channel( const std::string & ch ) const
+{
+  std::unordered_map<std::string,int>::const_iterator ii = label2col.find( ch );
+  return ii == label2col.end() ? -1 : ii->second;
+}
+
+bitvec_t chep_mask_t::columns( const std::vector<std::string> & chs ) const
+{
+  bitvec_t cols( labels.size() );
+  for (int i=0; i<chs.size(); i++)
+    {
+      const int c = find_channel( chs[i] );
+      if ( c != -1 ) cols[c] = true;
+    }
+  return cols;
+}
+
+void chep_mask_t::reserve( const int e , const int ncols )
+{
+  const int nr = present.size();
+
+  // widen rows?
+  const int wpr1 = ( ncols + 63 ) >> 6;
+  if ( wpr1 > wpr )
+    {
+      std::vector<uint64_t> b1( (size_t)nr * wpr1 , 0ULL );
+      for (int r=0; r<nr; r++)
+	std::copy( bits.begin() + (size_t)r * wpr , bits.begin() + (size_t)( r + 1 ) * wpr ,
+		   b1.begin() + (size_t)r * wpr1 );
+      bits.swap( b1 );
+      wpr = wpr1;
+    }
+
+  // more rows?
+  if ( e >= nr )
+    {
+      present.resize( e + 1 );
+      bits.resize( (size_t)( e + 1 ) * wpr , 0ULL );
+    }
+}
+
+void chep_mask_t::add_row( const int e )
+{
+  if ( e < 0 ) return;
+  reserve( e , labels.size() );
+  present[e] = true;
+}
+
+void chep_mask_t::drop_row( const int e )
+{
+  if ( ! has_row( e ) ) return;
+  present[e] = false;
+  std::fill( bits.begin() + (size_t)e * wpr , bits.begin() + (size_t)( e + 1 ) * wpr , 0ULL );
+}
+
+std::vector<int> chep_mask_t::rows() const
+{
+  std::vector<int> r;
+  const std::vector<uint64_t> & pw = present.words();
+  for (size_t i=0; i<pw.size(); i++)
+    {
+      uint64_t x = pw[i];
+      while ( x )
+	{
+	  const int b = bitvec_t::popcount( ( x & ( ~x + 1ULL ) ) - 1ULL ); // lowest set bit
+	  r.push_back( i * 64 + b );
+	  x &= x - 1ULL;
+	}
+    }
+  return r;
+}
+
+void chep_mask_t::set( const int e , const int c )
+{
+  if ( e < 0 || c < 0 ) return;
+  add_row( e );
+  bits[ (size_t)e * wpr + ( c >> 6 ) ] |= 1ULL << ( c & 63 );
+}
+
+bool chep_mask_t::unset( const int e , const int c )
+{
+  if ( ! get( e , c ) ) return false;
+  bits[ (size_t)e * wpr + ( c >> 6 ) ] &= ~( 1ULL << ( c & 63 ) );
+  return true;
+}
+
+int chep_mask_t::count( const int e ) const
+{
+  if ( ! has_row( e ) ) return 0;
+  int n = 0;
+  const uint64_t * p = &bits[ (size_t)e * wpr ];
+  for (int i=0; i<wpr; i++) n += bitvec_t::popcount( p[i] );
+  return n;
+}
+
+int chep_mask_t::count( const int e , const bitvec_t & cols ) const
+{
+  if ( ! has_row( e ) ) return 0;
+  int n = 0;
+  const uint64_t * p = &bits[ (size_t)e * wpr ];
+  const std::vector<uint64_t> & cw = cols.words();
+  const int nw = std::min( (int)cw.size() , wpr );
+  for (int i=0; i<nw; i++) n += bitvec_t::popcount( p[i] & cw[i] );
+  return n;
+}
+
+std::vector<int> chep_mask_t::column_counts() const
+{
+  std::vector<int> n( labels.size() , 0 );
+  const int nr = present.size();
+  for (int r=0; r<nr; r++)
+    {
+      const uint64_t * p = &bits[ (size_t)r * wpr ];
+      for (int i=0; i<wpr; i++)
+	{
+	  uint64_t x = p[i];
+	  while ( x )
+	    {
+	      ++n[ i * 64 + bitvec_t::popcount( ( x & ( ~x + 1ULL ) ) - 1ULL ) ];
+	      x &= x - 1ULL;
+	    }
+	}
+    }
+  return n;
+}
+
+void chep_mask_t::set_row( const int e , const bitvec_t & cols )
+{
+  if ( e < 0 ) return;
+  add_row( e );
+  uint64_t * p = &bits[ (size_t)e * wpr ];
+  const std::vector<uint64_t> & cw = cols.words();
+  const int nw = std::min( (int)cw.size() , wpr );
+  for (int i=0; i<nw; i++) p[i] |= cw[i];
+}
+
+void chep_mask_t::unset_row( const int e , const bitvec_t & cols )
+{
+  if ( e < 0 ) return;
+  add_row( e );
+  uint64_t * p = &bits[ (size_t)e * wpr ];
+  const std::vector<uint64_t> & cw = cols.words();
+  const int nw = std::min( (int)cw.size() , wpr );
+  for (int i=0; i<nw; i++) p[i] &= ~cw[i];
+}
+
+void chep_mask_t::and_row( const int e , const bitvec_t & cols )
+{
+  if ( e < 0 ) return;
+  add_row( e );
+  uint64_t * p = &bits[ (size_t)e * wpr ];
+  const std::vector<uint64_t> & cw = cols.words();
+  for (int i=0; i<wpr; i++) p[i] &= i < cw.size() ? cw[i] : 0ULL;
+}
+
+void chep_mask_t::merge( const chep_mask_t & rhs )
+{
+  // map rhs columns to ours
+  std::vector<int> cmap( rhs.labels.size() );
+  for (int c=0; c<rhs.labels.size(); c++)
+    cmap[c] = channel( rhs.labels[c] );
+
+  const bool same_layout = wpr == rhs.wpr && labels.size() == rhs.labels.size()
+    && std::equal( labels.begin() , labels.end() , rhs.labels.begin() );
+
+  const std::vector<int> r = rhs.rows();
+  for (int i=0; i<r.size(); i++)
+    {
+      const int e = r[i];
+      add_row( e );
+      const uint64_t * q = &rhs.bits[ (size_t)e * rhs.wpr ];
+      uint64_t * p = &bits[ (size_t)e * wpr ];
+      if ( same_layout )
+	for (int j=0; j<wpr; j++) p[j] |= q[j];
+      else
+	for (int c=0; c<rhs.labels.size(); c++)
+	  if ( ( q[ c >> 6 ] >> ( c & 63 ) ) & 1ULL )
+	    p[ cmap[c] >> 6 ] |= 1ULL << ( cmap[c] & 63 );
+    }
+}
+
+void chep_mask_t::retain( const std::set<int> & keep_rows , const std::set<std::string> & keep_channels )
+{
+  std::vector<std::string> chs( keep_channels.begin() , keep_channels.end() );
+  const bitvec_t cols = columns( chs );
+  const std::vector<int> r = rows();
+  for (int i=0; i<r.size(); i++)
+    {
+      if ( keep_rows.find( r[i] ) == keep_rows.end() )
+	drop_row( r[i] );
+      else
+	{
+	  and_row( r[i] , cols );
+	  if ( count( r[i] ) == 0 ) drop_row( r[i] );
+	}
+    }
+}
+
+std::vector<int> chep_mask_t::sorted_columns() const
+{
+  std::map<std::string,int> s;
+  for (int c=0; c<labels.size(); c++) s[ labels[c] ] = c;
+  std::vector<int> r;
+  std::map<std::string,int>::const_iterator ii = s.begin();
+  while ( ii != s.end() ) { r.push_back( ii->second ); ++ii; }
+  return r;
+}
@@ -0,0 +1,200 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_BITMASK_H__
+#define __LUNA_BITMASK_H__
+
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <stdint.h>
+#include <cstddef>
+
+//
+// Dense bit vector (the epoch mask): indexed like std::vector<bool>,
+// but with word-at-a-time AND/OR/NOT and popcount
+//
+
+struct bitvec_t
+{
+
+  struct reference
+  {
+    reference( uint64_t * w , const uint64_t b ) : w(w) , b(b) { }
+    operator bool() const { return ( *w & b ) != 0; }
+    reference & operator=( const bool x ) { if ( x ) *w |= b; else *w &= ~b; return *this; }
+    reference & operator=( const reference & r ) { return *this = (bool)r; }
+  private:
+    uint64_t * w;
+    uint64_t b;
+  };
+
+  bitvec_t() : n(0) { }
+
+  explicit bitvec_t( const size_t n1 , const bool x = false ) : n(0) { resize( n1 , x ); }
+
+  size_t size() const { return n; }
+
+  void clear() { w.clear(); n = 0; }
+
+  void resize( const size_t n1 , const bool x = false );
+
+  void assign( const size_t n1 , const bool x ) { clear(); resize( n1 , x ); }
+
+  bool operator[]( const size_t i ) const { return ( w[ i >> 6 ] >> ( i & 63 ) ) & 1ULL; }
+
+  reference operator[]( const size_t i ) { return reference( &w[ i >> 6 ] , 1ULL << ( i & 63 ) ); }
+
+  // number of set bits
+  size_t count() const;
+
+  // true if any bit set
+  bool any() const;
+
+  // NOT, i.e. flip all n bits
+  void flip();
+
+  // AND, OR and AND-NOT with another (same-sized) vector
+  bitvec_t & operator&=( const bitvec_t & rhs );
+  bitvec_t & operator|=( const bitvec_t & rhs );
+  bitvec_t & andnot( const bitvec_t & rhs );
+
+  // words, i.e. for combining with chep_mask_t rows
+  const std::vector<uint64_t> & words() const { return w; }
+
+  static int popcount( uint64_t x );
+
+ private:
+
+  // clear any bits past n in the last word
+  void trim();
+
+  std::vector<uint64_t> w;
+  size_t n;
+
+};
+
+
+//
+// CHEP mask: dense (display) epoch x channel bit-matrix, with the
+// channel labels interned to columns.  Rows are 1-based display
+// epochs; as with the former map<int,set<string> >, a row can be
+// present but have no channels set (e.g. after unset())
+//
+
+struct chep_mask_t
+{
+
+  chep_mask_t() : wpr(1) { }
+
+  void clear();
+
+  // no rows present
+  bool empty() const { return ! present.any(); }
+
+  //
+  // channels (columns)
+  //
+
+  // column for label, adding it if needed
+  int channel( const std::string & ch );
+
+  // column for label, or -1
+  int find_channel( const std::string & ch ) const;
+
+  const std::string & label( const int c ) const { return labels[c]; }
+
+  int num_channels() const { return labels.size(); }
+
+  // column selection for a set of labels (unknown labels are skipped)
+  bitvec_t columns( const std::vector<std::string> & chs ) const;
+
+  //
+  // rows (epochs)
+  //
+
+  bool has_row( const int e ) const { return e >= 0 && e < present.size() && present[e]; }
+
+  void add_row( const int e );
+
+  void drop_row( const int e );
+
+  // present rows, in order
+  std::vector<int> rows() const;
+
+  //
+  // cells
+  //
+
+  bool get( const int e , const int c ) const
+  {
+    if ( c < 0 || ! has_row( e ) ) return false;
+    return ( bits[ (size_t)e * wpr + ( c >> 6 ) ] >> ( c & 63 ) ) & 1ULL;
+  }
+
+  // set (adds the row)
+  void set( const int e , const int c );
+
+  // T if was set
+  bool unset( const int e , const int c );
+
+  //
+  // word-parallel row/column operations
+  //
+
+  // channels set in row e (optionally, only those in cols)
+  int count( const int e ) const;
+  int count( const int e , const bitvec_t & cols ) const;
+
+  // per-column totals over all rows
+  std::vector<int> column_counts() const;
+
+  // row |= cols  /  row &= ~cols  /  row &= cols  (all add the row)
+  void set_row( const int e , const bitvec_t & cols );
+  void unset_row( const int e , const bitvec_t & cols );
+  void and_row( const int e , const bitvec_t & cols );
+
+  // OR in another mask (matched on channel labels)
+  void merge( const chep_mask_t & rhs );
+
+  // keep only these rows and channels; rows left empty are dropped
+  void retain( const std::set<int> & keep_rows , const std::set<std::string> & keep_channels );
+
+  // columns in label order (i.e. as the former std::set<std::string>)
+  std::vector<int> sorted_columns() const;
+
+ private:
+
+  // ensure storage for row e and ncols columns
+  void reserve( const int e , const int ncols );
+
+  std::vector<std::string> labels;
+  std::unordered_map<std::string,int> label2col;
+
+  bitvec_t present;
+  std::vector<uint64_t> bits; // row-major, wpr words per row
+  int wpr;
+
+};
+
+#endif
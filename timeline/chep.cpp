@@ -38,7 +38,7 @@ extern logger_t logger;
 
 bool timeline_t::is_chep_mask_set() const
 {
-  return chep.size() != 0;
+  return ! chep.empty();
 } 
 
 void timeline_t::clear_chep_mask()
@@ -46,50 +46,32 @@ void timeline_t::clear_chep_mask()
   chep.clear();
 } 
 
-std::map<int,std::set<std::string> > timeline_t::make_chep_copy() const
+chep_mask_t timeline_t::make_chep_copy() const
 {
   return chep;
 }
 
 void timeline_t::set_chep_mask( const int e , const std::string & s )
 {
-  chep[ display_epoch( e ) ].insert(s);
+  chep.set( display_epoch( e ) , chep.channel( s ) );
 } 
 
-void timeline_t::merge_chep_mask( const std::map<int,std::set<std::string> > & m ) 
+void timeline_t::merge_chep_mask( const chep_mask_t & m ) 
 {
-  if ( chep.size() == 0 ) { chep = m ; return; } 
-  std::map<int,std::set<std::string> >::const_iterator ii = m.begin();
-  while ( ii != m.end() )
-    {
-      std::set<std::string>::const_iterator jj = ii->second.begin();
-      while ( jj != ii->second.end() )
-	{
-	  chep[ ii->first ].insert( *jj );
-	  ++jj;
-	}
-      ++ii;
-    }
+  if ( chep.empty() ) { chep = m ; return; } 
+  chep.merge( m );
 }
 
 
 bool timeline_t::unset_chep_mask( const int e , const std::string & s ) 
 { 
   // return T if anything removed
-  int e1 = display_epoch( e );    
-  std::map<int,std::set<std::string> >::iterator ii = chep.find( e1 ) ;
-  if ( ii == chep.end() ) return false;
-  std::set<std::string>::iterator jj = ii->second.find( s );
-  if ( jj == ii->second.end() ) return false;
-  ii->second.erase( jj );
-  return true; 
+  return chep.unset( display_epoch( e ) , chep.find_channel( s ) );
 } 
 
 bool timeline_t::masked( const int e , const std::string & s ) const 
 {
-  std::map<int,std::set<std::string> >::const_iterator ee = chep.find( display_epoch( e ) );
-  if ( ee == chep.end() ) return false;
-  return ee->second.find( s ) != ee->second.end() ;
+  return chep.get( display_epoch( e ) , chep.find_channel( s ) );
 }
 
 // save/load cheps
@@ -133,13 +115,11 @@ std::vector<std::string> timeline_t::masked_channels( const int e0 , const signa
   //  std::cerr << " e , e0 = " << e << " " << e0 << "\n";
   std::vector<std::string> m;
   const int ns = signals.size();
-  bool any_masked = chep.find( e ) != chep.end() ;
-  if ( ! any_masked ) return m; // all good
+  if ( ! chep.has_row( e ) ) return m; // all good
 
-  const std::set<std::string> & masked = chep.find(e)->second ;
   for (int s=0; s<ns; s++) 
     {
-      if ( masked.find( signals.label(s) ) != masked.end() )
+      if ( chep.get( e , chep.find_channel( signals.label(s) ) ) )
 	m.push_back( signals.label(s) );
     }
   return m;
@@ -153,18 +133,16 @@ std::vector<std::string> timeline_t::unmasked_channels( const int e0 , const sig
 
   std::vector<std::string> u;
   const int ns = signals.size();
-  bool any_masked = chep.find( e ) != chep.end() ;
-  if ( ! any_masked ) 
+  if ( ! chep.has_row( e ) ) 
     {
       // all good
       for (int s=0; s<ns; s++) u.push_back( signals.label(s) );
       return u; 
     }
 
-  const std::set<std::string> & masked = chep.find(e)->second ;
   for (int s=0; s<ns; s++) 
     {
-      if ( masked.find( signals.label(s) ) == masked.end() )
+      if ( ! chep.get( e , chep.find_channel( signals.label(s) ) ) )
 	u.push_back( signals.label(s) );
     }
   return u;
@@ -184,19 +162,25 @@ void timeline_t::collapse_chep2epoch( signal_list_t signals , const double pct ,
   // if more than pct channels are masked --> set epoch mask [ default 0 ]
   // automatically adjust main 'mask' (using set_mask(), i.e. respecting mask_mode etc)
   
-  int epoch = 0; 
   int masked = 0;
-  int masks_set = 0;
 
-  std::map<int,std::set<std::string> >::iterator ee = chep.begin();
-  while ( ee != chep.end() )
+  // all of 'signals' as a column set, so that each masked epoch's row
+  // can be set in one go
+  std::vector<std::string> labels( signals.size() );
+  for (int s=0;s<signals.size();s++) labels[s] = signals.label(s);
+  for (int s=0;s<signals.size();s++) chep.channel( labels[s] );
+  const bitvec_t cols = chep.columns( labels );
+  
+  const std::vector<int> rows = chep.rows();
+  
+  for (int i=0; i<rows.size(); i++)
     {
       // **assume** same signals overlap
 
-      int sz = ee->second.size();
-
-      int epoch = ee->first;
-
+      const int epoch = rows[i];
+      
+      const int sz = chep.count( epoch );
+      
       if ( ( k != 0 && sz >= k ) || 
 	   ( sz / (double)signals.size() > pct ) ) 
 	{
@@ -208,13 +192,8 @@ void timeline_t::collapse_chep2epoch( signal_list_t signals , const double pct ,
 	    if ( set_epoch_mask( epoch0 ) ) ++masked;
 	  
 	  // and also set all CHEP masks (to signals) for this epoch
-	  for (int s=0;s<signals.size();s++) ee->second.insert( signals.label(s) );
-	  
+	  chep.set_row( epoch , cols );
 	}
-      
-      if ( mask[epoch] ) ++masks_set; 
-    
-      ++ee;
     }
   
   logger << masked << " epochs\n";
@@ -243,29 +222,22 @@ signal_list_t timeline_t::collapse_chep2ch( signal_list_t signals ,
   if ( k ) logger << " with " << k << " or more masked epochs";
   if ( pct < 1 ) logger << (k?", or " : " with > " ) << pct *100 << "% masked epochs:";
 
-  // count of bad epochs per channel
-  std::map<std::string,int> c;
+  // count of bad epochs per channel (one pass over the bit-matrix)
   int ns = signals.size();
   int ne = num_epochs();
-  for (int i=0; i<ns; i++) c[ signals.label(i) ] = 0;
+  const std::vector<int> colcnt = chep.column_counts();
+  
+  std::map<std::string,int> c;
+  for (int i=0; i<ns; i++)
+    {
+      const int col = chep.find_channel( signals.label(i) );
+      c[ signals.label(i) ] = col == -1 ? 0 : colcnt[ col ];
+    }
   
   // get channel slots lookup-table 
   std::map<std::string,int> l2s;
   for (int i=0; i<ns; i++) 
     l2s[ signals.label(i) ] = signals(i);
-
-
-  std::map<int,std::set<std::string> >::const_iterator ee = chep.begin();
-  while ( ee != chep.end() )
-    {
-      std::set<std::string>::const_iterator ss = ee->second.begin();
-      while ( ss != ee->second.end() )
-	{
-	  if ( c.find( *ss ) != c.end() ) c[ *ss ]++;
-	  ++ss;
-	}
-      ++ee;
-    }
   
   signal_list_t good_signals;
   signal_list_t bad_signals;
@@ -290,35 +262,31 @@ signal_list_t timeline_t::collapse_chep2ch( signal_list_t signals ,
   std::set<std::string> good_sigs;
   for (int i=0;i<good_signals.size();i++) 
     good_sigs.insert( good_signals.label(i) );
- 
+
+  // bad and good channels, as column sets
+  std::vector<std::string> bad_labels, good_labels;
+  for (int i=0; i<ns; i++) 
+    {
+      const std::string label = signals.label(i);
+      if ( good_sigs.find( label ) == good_sigs.end() ) bad_labels.push_back( label );
+      else good_labels.push_back( label );
+      chep.channel( label );
+    }
+  
   // set all epochs as masked for a 'bad channel'?
-  if ( bad_set_all_bad ) 
+  if ( bad_set_all_bad && bad_labels.size() ) 
     {
-      for (int i=0; i<ns; i++) 
-	{
-	  const std::string label = signals.label(i);
-	  if ( good_sigs.find( label ) == good_sigs.end() ) 
-	    {
-	      logger << " " << label;
-	      for (int e=0;e<ne;e++) chep[ display_epoch( e ) ].insert( label );
-	    }
-	}
+      for (int i=0; i<bad_labels.size(); i++) 
+	logger << " " << bad_labels[i];
+      const bitvec_t cols = chep.columns( bad_labels );
+      for (int e=0;e<ne;e++) chep.set_row( display_epoch( e ) , cols );
     }
       
   // set all eoochs as unmasked for a 'good channel'?
-  if ( good_set_all_good )
+  if ( good_set_all_good && good_labels.size() )
     {
-      for (int i=0; i<ns; i++) 
-	{
-	  const std::string label = signals.label(i);
-	  if ( good_sigs.find( label ) != good_sigs.end() ) 
-	    for (int e=0;e<ne;e++) 
-	      {
-		int e1 = display_epoch( e );
-		std::set<std::string>::iterator ii = chep[ e1 ].find( label );
-		if ( ii != chep[e1].end() ) chep[ e1 ].erase( ii );
-	      }
-	}
+      const bitvec_t cols = chep.columns( good_labels );
+      for (int e=0;e<ne;e++) chep.unset_row( display_epoch( e ) , cols );
     }
 
   logger << "\n";
@@ -360,7 +328,7 @@ void timeline_t::dump_chep_mask( signal_list_t signals , bool write_out )
       if ( write_out )
 	writer.epoch( depoch );
 
-      if ( chep.find( depoch ) == chep.end() )
+      if ( ! chep.has_row( depoch ) )
 	{
 	  for (int s=0;s<ns;s++)     
 	    {
@@ -384,8 +352,6 @@ void timeline_t::dump_chep_mask( signal_list_t signals , bool write_out )
 	  
 	  track_epochs[ depoch ]++;
 
-	  const std::set<std::string> & ss = chep.find( depoch )->second;
-
 	  for (int s=0;s<ns;s++)     
 	    {
 	      
@@ -394,7 +360,7 @@ void timeline_t::dump_chep_mask( signal_list_t signals , bool write_out )
 	      // track total
 	      ++total_total;
 	      
-	      bool masked = ss.find( label ) != ss.end() ;
+	      bool masked = chep.get( depoch , chep.find_channel( label ) );
 		  
 	      if ( write_out )
 		{
@@ -504,7 +470,7 @@ void timeline_t::read_chep_file( const std::string & f , bool reset )
       if ( FIN.eof() ) break;
       if ( ch == "" ) break;      
       int chn = edf->header.signal( ch , silent_mode );      
-      if ( chn != -1 ) chep[ e ].insert( ch );  // i.e. expecting display epoch encoding (1-based)
+      if ( chn != -1 ) chep.set( e , chep.channel( ch ) );  // i.e. expecting display epoch encoding (1-based)
     }
   
   FIN.close();
@@ -514,20 +480,14 @@ void timeline_t::write_chep_file( const std::string & f ) const
 {
   std::ofstream FOUT( f.c_str() , std::ios::out );
   if ( FOUT.bad() ) Helper::halt( "could not open " + f );
-  std::map<int,std::set<std::string> >::const_iterator ee = chep.begin();
-  while ( ee != chep.end() )
-    {
-      const std::set<std::string> & chs = ee->second;
-      std::set<std::string>::const_iterator cc = chs.begin();
-      while ( cc != chs.end() )
-	{
-	  FOUT << ee->first << "\t" 
-	       << *cc << "\n";
-	  //	       << edf->header.label[ *cc ] << "\n";
-	  ++cc;
-	}
-      ++ee;
-    }
+  // epochs in order, then channels in label order
+  const std::vector<int> rows = chep.rows();
+  const std::vector<int> cols = chep.sorted_columns();
+  for (int i=0; i<rows.size(); i++)
+    for (int j=0; j<cols.size(); j++)
+      if ( chep.get( rows[i] , cols[j] ) )
+	FOUT << rows[i] << "\t" 
+	     << chep.label( cols[j] ) << "\n";
   FOUT.close();
 }
 
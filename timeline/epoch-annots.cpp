@@ -21,6 +21,7 @@
 //    --------------------------------------------------------------------
 
 #include "timeline.h"
+#include "timeline/overlap.h"
 
 #include "edf/edf.h"
 #include "edf/slice.h"
@@ -74,6 +75,15 @@ void timeline_t::annotate_epochs( const std::string & label ,
   if ( annot == NULL ) return;
 
 
+  //
+  // all epoch overlaps for this class, in one sweep
+  //
+
+  annot_sweep_t sweep( epochs );
+
+  sweep.run( annot );
+  
+
   //
   // for each epoch 
   //
@@ -97,29 +107,24 @@ void timeline_t::annotate_epochs( const std::string & label ,
       if ( e0 == -1 ) 
 	Helper::halt( "internal error in annotate_epochs()" );
 
-      interval_t interval = epoch( e );
-      
-      annot_map_t events = annot->extract( interval );
-      
       // search for a matching value (at least one)
       
-      annot_map_t::const_iterator ii = events.begin();
-
-      while ( ii != events.end() )
+      const int nh = sweep.count( e );
+      
+      for (int i=0; i<nh; i++)
 	{	
 	  
-	  const instance_idx_t & instance_idx = ii->first;
-	  const instance_t * instance = ii->second;
+	  const instance_idx_t & instance_idx = sweep.idx( e , i );
 
 	  if ( values.find( instance_idx.id ) != values.end() )
 	    {	      
 	      // nb. store w.r.t. original epoch encoding e0
-	      eannots[ label ][ e0 ] = true;
+	      std::vector<bool> & ea = eannots[ label ];
+	      if ( e0 >= ea.size() ) ea.resize( e0 + 1 , false );
+	      ea[ e0 ] = true;
 	      break;
 	    }	      
 	  
-	  ++ii;
-	  
 	}
       
     } // next epoch
@@ -136,14 +141,18 @@ void timeline_t::annotate_epoch( const std::string & label , int e )
   if ( has_epoch_mapping() )
     {
       // off-the-grid  
-      if ( epoch_curr2orig.find( e ) == epoch_curr2orig.end() ) 
+      if ( e < 0 || e >= epoch_curr2orig.size() ) 
 	return;
       
       // convert query to the original mapping
-      e = epoch_curr2orig.find( e )->second;
+      e = epoch_curr2orig[ e ];
     }
+
+  if ( e < 0 ) return;
   
-  eannots[ label ][ e ] = true;
+  std::vector<bool> & ea = eannots[ label ];
+  if ( e >= ea.size() ) ea.resize( e + 1 , false );
+  ea[ e ] = true;
 }
 
   
@@ -161,7 +170,7 @@ void timeline_t::clear_epoch_annotations()
 std::set<std::string> timeline_t::epoch_annotations() const
 {
   std::set<std::string> r;
-  std::map<std::string,std::map<int,bool> >::const_iterator ii = eannots.begin();
+  std::map<std::string,std::vector<bool> >::const_iterator ii = eannots.begin();
   while ( ii != eannots.end() )
     {
       r.insert( ii->first );
@@ -185,7 +194,7 @@ bool timeline_t::epoch_annotation(const std::string & k, int e) const
 {
   
   // look up this annotation 'k'
-  std::map<std::string,std::map<int,bool> >::const_iterator ii = eannots.find( k );
+  std::map<std::string,std::vector<bool> >::const_iterator ii = eannots.find( k );
   
   // annotation k does not exist anywhere
   if ( ii == eannots.end() ) return false;
@@ -194,15 +203,14 @@ bool timeline_t::epoch_annotation(const std::string & k, int e) const
   if ( has_epoch_mapping() ) 
     {
       // off-the-grid
-      if ( epoch_curr2orig.find( e ) == epoch_curr2orig.end() ) return false;
+      if ( e < 0 || e >= epoch_curr2orig.size() ) return false;
       // convert query to the original mapping
-      e = epoch_curr2orig.find( e )->second;
+      e = epoch_curr2orig[ e ];
     }
   
   // now we have the correct original-EDF epoch number, do
   // we have an flag? if not, means FALSE
-  if ( ii->second.find( e ) == ii->second.end() ) return false;
+  if ( e < 0 || e >= ii->second.size() ) return false;
   
-  // return the boolean value (i.e. could still be set FALSE explicitly)
-  return ii->second.find( e )->second; 
+  return ii->second[ e ]; 
 }
@@ -27,6 +27,7 @@
 #include "edf/slice.h"
 #include "miscmath/crandom.h"
 #include "helper/token-eval.h"
+#include "timeline/overlap.h"
 
 #include "db/db.h"
 #include "helper/logger.h"
@@ -62,15 +63,9 @@ void timeline_t::flip_epoch_mask()
   int cnt_now_unmasked = 0;
   
   // flip all (i.e. every epoch will change)
-  for (int e=0;e<ne;e++)
-    {
-      
-      mask[e] = ! mask[e];
-      
-      if ( mask[e] ) ++cnt_mask_set;
-      else ++cnt_mask_unset;
-
-    }
+  mask.flip();
+  cnt_mask_set = mask.count();
+  cnt_mask_unset = ne - cnt_mask_set;
   
   logger << "  flipped all epoch masks\n";
   logger << "  total of " << cnt_mask_unset << " of " << epochs.size() << " retained\n";
@@ -323,84 +318,84 @@ void timeline_t::apply_epoch_mask2( const std::map<annot_t *,std::set<std::strin
   int cnt_basic_match = 0;  // basic count of matches, whether changes mask or not
 
   //
-  // Iterate over epochs
+  // Count class-level matches for all epochs, one sweep per class
   //
 
-  for (int e=0;e<ne;e++)
+  // for and/or logic
+  //   i.e. AND matches = n_matches == n_annots
+  //        OR  matches = n_matches > 0 ;    
+  
+  // note that AND logic is at the class level: annotations are always
+  // considered as OR matches 
+  
+  const int n_annots = annots.size();
+
+  std::vector<int> n_matches( ne , 0 );
+
+  annot_sweep_t sweep( epochs );
+  
+  std::map<annot_t *,std::set<std::string> >::const_iterator aa = annots.begin();
+  while ( aa != annots.end() )
     {
       
-      // for and/or logic
-      //   i.e. AND matches = n_matches == n_annots
-      //        OR  matches = n_matches > 0 ;    
+      // get the annotation
+      annot_t * a = aa->first;
+      
+      // empty? i.e. no instances, implies no epoch will match either
+      if ( a == NULL )
+	{
+	  ++aa;
+	  continue;
+	}
+      
+      // require this epoch fully-spanned (by a each annotation of this class) to be a match?
+      const bool full = fullspan.find( aa->first->name ) != fullspan.end();
       
-      // note that AND logic is at the class level: annotations are always
-      // considered as OR matches 
+      // otherwise, get overlapping annots
+      sweep.run( a , full );
       
-      int n_annots = annots.size();
-      int n_matches = 0;
-
-      // get the epoch 
-      interval_t interval = epoch( e );
+      const bool check_instance_value = aa->second.size() != 0; 
       
-      // consider all annots
-      std::map<annot_t *,std::set<std::string> >::const_iterator aa = annots.begin();
-      while ( aa != annots.end() )
+      for (int e=0;e<ne;e++)
 	{
-
-	  // get the annotation
-	  annot_t * a = aa->first;
-	  
-	  // empty? i.e. no instances, implies this epoch will not match either
-	  if ( a == NULL )
-	    {
-	      ++aa;
-	      continue;
-	    }
-	  
-	  // require this epoch fully-spanned (by a each annotation of this class) to be a match?
-	  const bool full = fullspan.find( aa->first->name ) != fullspan.end();
-	  
-	  // otherwise, get overlapping annots
-	  annot_map_t events = full ? a->extract_complete_overlap( interval ) : a->extract( interval );
-
-	  const bool check_instance_value = aa->second.size() != 0; 
-
 	  if ( check_instance_value ) 
 	    {
 	      // do any of the instance IDs match any of the values?
 	      // check each of potentially multiple events, but otherwise stop
 	      // at the first match
-	      annot_map_t::const_iterator ii = events.begin();
-	      while ( ii != events.end() )
-		{		  
-		  const instance_idx_t & instance_idx = ii->first;	      
-		  if ( aa->second.find( instance_idx.id ) != aa->second.end() )
-		    {
-		      // at least one value matches: we can count this as a class-level
-		      // match and move on to the next annot class
-		      ++n_matches;
-		      break;
-		    }
-		  ++ii;
-		}
+	      const int nh = sweep.count( e );
+	      for (int i=0; i<nh; i++)
+		if ( aa->second.find( sweep.idx( e , i ).id ) != aa->second.end() )
+		  {
+		    // at least one value matches: we can count this as a class-level
+		    // match and move on to the next epoch
+		    ++n_matches[e];
+		    break;
+		  }
 	    }
 	  else 
 	    {
 	      // otherwise, simply note if we see one or 1 in this area: 
-	      if ( events.size() != 0 ) ++n_matches;
+	      if ( sweep.any( e ) ) ++n_matches[e];
 	    }
-	  
-	  // early stopping if on OR mode?
-	  if ( or_match && n_matches > 0 ) break;
-	  
-	  // next annotation
-	  ++aa;
 	}
       
+      // next annotation
+      ++aa;
+    }
+  
+
+  //
+  // Iterate over epochs
+  //
+
+  for (int e=0;e<ne;e++)
+    {
+      
       // do we get a match?
       //  can apply either OR or AND logic across multiple annot clases here
       
-      const bool matches = or_match ? n_matches != 0 : n_matches == n_annots ; 
+      const bool matches = or_match ? n_matches[e] != 0 : n_matches[e] == n_annots ; 
       
       // count basic matches
       
@@ -554,62 +549,132 @@ void timeline_t::apply_eval_mask( const std::string & str , int mask_mode , cons
 
   
   //
-  // Iterate over epochs
+  // Evaluate the expression for every epoch: -1 invalid, else 0/1
   //
 
-  first_epoch();
+  std::vector<int> retval( ne , -1 );
   
-  int acc_total = 0 , acc_retval = 0 , acc_valid = 0; 
+  EvalBatch batch;
+
+  std::string reason;
   
-  while ( 1 ) 
+  if ( globals::mask_compile && ! verbose && batch.compile( expression , &reason ) )
     {
-      
-      int e = next_epoch_ignoring_mask() ;
-
-      if ( e == -1 ) break;
-      
-      interval_t interval = epoch( e );
-	  
-      std::map<std::string,annot_map_t> inputs;
-      
-      // get each annotations
-      for (int a=0;a<names.size();a++)
-	{
-	  
-	  annot_t * annot = annotations->find( names[a] );
-	  
-	  // get overlapping annotations for this epoch
-	  annot_map_t events = annot->extract( interval );
-	  
-	  // store
-	  inputs[ names[a] ] = events;
-	}
 
       //
-      // create a dummy new instance for the output variables (not saved)
+      // compiled once: bind and evaluate blocks of epochs, pulling
+      // only the annotations that the expression can refer to
       //
       
-      instance_t dummy;
+      std::vector<annot_t*> used;
+      for (int a=0;a<names.size();a++)
+	if ( batch.uses( names[a] ) )
+	  used.push_back( annotations->find( names[a] ) );
+
+      // epoch x class overlaps, one sweep per class
+      std::vector<annot_sweep_t> sweeps( used.size() , annot_sweep_t( epochs ) );
+      for (int a=0;a<used.size();a++)
+	sweeps[a].run( used[a] );
       
-      //
-      // evaluate the expression, but note, this is set to not 
-      // allow any assignments.... this makes it cleaner and easier 
-      // to spot bad//undefined variables as errors.
-      //
+      const int block = 1024;
 
-      const bool no_assignments = true;
+      std::vector<int> res;
       
-      Eval tok( expression , no_assignments );
+      for (int e0 = 0 ; e0 < ne ; e0 += block )
+	{
+	  const int n = e0 + block < ne ? block : ne - e0 ;
 
-      tok.bind( inputs , &dummy );
+	  batch.resize( n );
 
-      bool is_valid = tok.evaluate( verbose );
-      
-      bool matches;
-      
-      if ( ! tok.value( matches ) ) is_valid = false;
+	  for (int r=0; r<n; r++)
+	    {
+	      std::map<std::string,annot_map_t> inputs;
+	      for (int a=0;a<used.size();a++)
+		inputs[ used[a]->name ] = sweeps[a].extract( e0 + r );
+	      batch.bind( r , inputs );
+	    }
 
+	  batch.evaluate( &res );
+
+	  for (int r=0; r<n; r++)
+	    retval[ e0 + r ] = res[r];
+	}
+      
+    }
+  else
+    {
 
+      if ( globals::mask_compile && ! verbose )
+	logger << "  evaluating expression per epoch (" << reason << ")\n";
+      
+      first_epoch();
+      
+      while ( 1 ) 
+	{
+	  
+	  int e = next_epoch_ignoring_mask() ;
+	  
+	  if ( e == -1 ) break;
+	  
+	  interval_t interval = epoch( e );
+	  
+	  std::map<std::string,annot_map_t> inputs;
+	  
+	  // get each annotations
+	  for (int a=0;a<names.size();a++)
+	    {
+	      
+	      annot_t * annot = annotations->find( names[a] );
+	      
+	      // get overlapping annotations for this epoch
+	      annot_map_t events = annot->extract( interval );
+	      
+	      // store
+	      inputs[ names[a] ] = events;
+	    }
+	  
+	  //
+	  // create a dummy new instance for the output variables (not saved)
+	  //
+	  
+	  instance_t dummy;
+	  
+	  //
+	  // evaluate the expression, but note, this is set to not 
+	  // allow any assignments.... this makes it cleaner and easier 
+	  // to spot bad//undefined variables as errors.
+	  //
+	  
+	  const bool no_assignments = true;
+	  
+	  Eval tok( expression , no_assignments );
+	  
+	  tok.bind( inputs , &dummy );
+	  
+	  bool is_valid = tok.evaluate( verbose );
+	  
+	  bool matches;
+	  
+	  if ( ! tok.value( matches ) ) is_valid = false;
+	  
+	  retval[ e ] = is_valid ? matches : -1 ;
+	  
+	}
+    }
+  
+  
+  //
+  // Apply to the mask
+  //
+  
+  int acc_total = 0 , acc_retval = 0 , acc_valid = 0; 
+  
+  for (int e = 0 ; e < ne ; e++ )
+    {
+      
+      bool is_valid = retval[e] != -1;
+      
+      bool matches = retval[e] == 1;
 
       //
       // Flip?
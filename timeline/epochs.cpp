@@ -159,6 +159,7 @@ int timeline_t::calc_epochs()
   rec2epoch.clear();
   
   epoch2rec.clear();
+  etable.clear();
 
   //
   // Easy case for continuous EDFs ( == cumul_ungapped)
@@ -785,6 +786,7 @@ void timeline_t::unepoch()
   // record/epoch mappings
   rec2epoch.clear();
   epoch2rec.clear();
+  etable.clear();
 
 }
  
@@ -881,6 +883,7 @@ int timeline_t::reset_epochs()
 
   rec2epoch.clear();
   epoch2rec.clear();
+  etable.clear();
 
   for (int e=0; e<epochs.size(); e++)
     {
@@ -1096,10 +1099,7 @@ int timeline_t::next_epoch_ignoring_mask()
 int timeline_t::num_epochs() const 
 {
   if ( ! mask_set ) return epochs.size();
-  int r = 0;
-  for (int i=0;i<mask.size();i++)
-    if ( ! mask[i] ) ++r;
-  return r;
+  return mask.size() - mask.count();
 }
 
 // all epochs
@@ -1117,15 +1117,54 @@ interval_t timeline_t::epoch( const int e ) const
 bool timeline_t::epoch_records( const int e , int * a , int * b ) const 
 {
   *a = *b = 0;
-  std::map<int,std::set<int> >::const_iterator rr = epoch2rec.find( e );
-  if ( rr == epoch2rec.end() ) return false;
-  const std::set<int> & recs = rr->second;
-  *a = *recs.begin();
-  *b = *recs.rbegin();
+  if ( ! etable.built ) build_epoch_table();
+  if ( e < 0 || e >= etable.first_rec.size() || etable.first_rec[e] == -1 ) return false;
+  *a = etable.first_rec[e];
+  *b = etable.last_rec[e];
   return true;
 }
 
 
+void timeline_t::build_epoch_table() const
+{
+  // first/last record per epoch, in one pass over epoch2rec;
+  // per-SR sample offsets are filled by interval2records()
+  etable.clear();
+  etable.first_rec.assign( epochs.size() , -1 );
+  etable.last_rec.assign( epochs.size() , -1 );
+  std::map<int,std::set<int> >::const_iterator rr = epoch2rec.begin();
+  while ( rr != epoch2rec.end() )
+    {
+      if ( rr->first >= 0 && rr->first < epochs.size() && rr->second.size() )
+	{
+	  etable.first_rec[ rr->first ] = *rr->second.begin();
+	  etable.last_rec[ rr->first ] = *rr->second.rbegin();
+	}
+      ++rr;
+    }
+  etable.built = true;
+}
+
+
+int timeline_t::epoch_hint( const interval_t & interval ) const
+{
+  const int ne = epochs.size();
+  const int cand[3] = { current_epoch , etable.last + 1 , etable.last };
+  for (int i=0; i<3; i++)
+    {
+      const int e = cand[i];
+      if ( e >= 0 && e < ne
+	   && epochs[e].start == interval.start
+	   && epochs[e].stop == interval.stop )
+	{
+	  etable.last = e;
+	  return e;
+	}
+    }
+  return -1;
+}
+
+
   
 //
 // Epoch mappings
@@ -1145,24 +1184,24 @@ bool timeline_t::has_epoch_mapping() const
 int timeline_t::original_epoch(int e)
 {
   if ( ! has_epoch_mapping() ) return e;
-  if ( epoch_curr2orig.find(e) == epoch_curr2orig.end() ) return -1;
-  return epoch_curr2orig.find(e)->second;
+  if ( e < 0 || e >= epoch_curr2orig.size() ) return -1;
+  return epoch_curr2orig[e];
 }
 
 // 1-based epoch mapping
 int timeline_t::display_epoch(int e) const
 {      
   if ( ! has_epoch_mapping() ) return e+1;
-  if ( epoch_curr2orig.find(e) == epoch_curr2orig.end() ) return -1;
-  return epoch_curr2orig.find(e)->second + 1 ;
+  if ( e < 0 || e >= epoch_curr2orig.size() ) return -1;
+  return epoch_curr2orig[e] + 1 ;
 }
 
 
 int timeline_t::display2curr_epoch(int e) const 
 {
   if ( ! has_epoch_mapping() ) return e-1;    
-  if ( epoch_orig2curr.find(e-1) == epoch_orig2curr.end() ) return -1;
-  return epoch_orig2curr.find(e-1)->second ;
+  if ( e < 1 || e > epoch_orig2curr.size() ) return -1;
+  return epoch_orig2curr[e-1] ;
 }
 
 
@@ -1224,8 +1263,9 @@ void timeline_t::set_epoch_mapping()
 	  if ( ! masked_epoch( epoch ) )
 	    {
 	      //	      std::cout << " adding epoch-mapping: " << epoch << " --> " << curr << "\n";
+	      if ( epoch >= epoch_orig2curr.size() ) epoch_orig2curr.resize( epoch + 1 , -1 );
 	      epoch_orig2curr[ epoch ] = curr;
-	      epoch_curr2orig[ curr ] = epoch;
+	      epoch_curr2orig.push_back( epoch );
 	      ++curr;
 	    }
 	}
@@ -1234,7 +1274,7 @@ void timeline_t::set_epoch_mapping()
     {
       //logger << "  using existing epoch-mapping\n";
       
-      std::map<int,int> copy_curr2orig = epoch_curr2orig;
+      std::vector<int> copy_curr2orig = epoch_curr2orig;
       clear_epoch_mapping();      
       int curr = 0;       
       while ( 1 ) 
@@ -1245,10 +1285,11 @@ void timeline_t::set_epoch_mapping()
 
 	  if ( ! masked_epoch( epoch ) )
 	    {
-	      int orig = copy_curr2orig[ epoch ];
+	      int orig = epoch < copy_curr2orig.size() ? copy_curr2orig[ epoch ] : 0 ;
 	      //std::cout << " remapping " << orig << " --> " << curr << "\n";
+	      if ( orig >= epoch_orig2curr.size() ) epoch_orig2curr.resize( orig + 1 , -1 );
 	      epoch_orig2curr[ orig ] = curr;
-	      epoch_curr2orig[ curr ] = orig;
+	      epoch_curr2orig.push_back( orig );
 	      ++curr;
 	    }
 	  
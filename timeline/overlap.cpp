@@ -0,0 +1,130 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+
+#include "timeline/overlap.h"
+
+#include <algorithm>
+
+
+void annot_sweep_t::set_windows( const std::vector<interval_t> & windows )
+{
+  win = windows;
+
+  const int nw = win.size();
+
+  order.resize( nw );
+  for (int w=0; w<nw; w++) order[w] = w;
+
+  // epochs will typically already be in order
+  bool sorted = true;
+  for (int w=1; w<nw; w++)
+    if ( win[w].start < win[w-1].start ) { sorted = false; break; }
+  
+  if ( ! sorted )
+    std::stable_sort( order.begin() , order.end() ,
+		      [&]( int a , int b ) { return win[a].start < win[b].start; } );
+
+  first.assign( nw , 0 );
+  n.assign( nw , 0 );
+  hits.clear();
+}
+
+
+void annot_sweep_t::run( const annot_t * annot , const bool complete )
+{
+
+  const int nw = win.size();
+
+  first.assign( nw , 0 );
+  n.assign( nw , 0 );
+  hits.clear();
+
+  if ( annot == NULL ) return;
+  
+  const annot_map_t & events = annot->interval_events;
+
+  annot_map_t::const_iterator ee = events.begin();
+
+  // instances that might still overlap this or a later window, in
+  // annot_map_t (i.e. start) order
+  std::vector<const entry_t*> active;
+  
+  for (int k=0; k<nw; k++)
+    {
+
+      const int w = order[k];
+      
+      const uint64_t qs = win[w].start;
+      const uint64_t qe = win[w].stop;
+
+      // add all instances starting before the end of this window; any
+      // with stop < start are skipped: interval_tree_t::build() drops
+      // these (i.e. they never reach its overlaps(), and extract() halts
+      // on the size mismatch), so they cannot match here either
+      while ( ee != events.end() && ee->first.interval.start < qe )
+	{
+	  if ( ee->first.interval.stop >= ee->first.interval.start )
+	    active.push_back( &(*ee) );
+	  ++ee;
+	}
+      
+      // drop those that end before this window (windows are in start
+      // order, so these cannot overlap any later window either), and
+      // record hits
+      
+      first[w] = hits.size();
+
+      int j = 0;
+
+      for (int i=0; i<active.size(); i++)
+	{
+	  const interval_t & iv = active[i]->first.interval;
+
+	  const bool point = iv.start == iv.stop;
+	  
+	  if ( point ? iv.start < qs : iv.stop <= qs ) continue;
+	  
+	  active[j++] = active[i];
+	  
+	  // overlaps [qs,qe) , as interval_tree_t
+	  if ( iv.start >= qe ) continue;
+	  
+	  if ( complete && ! win[w].is_completely_spanned_by( iv ) ) continue;
+	  
+	  hits.push_back( active[i] );
+	}
+
+      active.resize( j );
+      
+      n[w] = hits.size() - first[w];
+    }
+  
+}
+
+
+annot_map_t annot_sweep_t::extract( const int w ) const
+{
+  annot_map_t r;
+  for (int i=0; i<n[w]; i++)
+    r.insert( r.end() , *hits[ first[w] + i ] );
+  return r;
+}
@@ -0,0 +1,91 @@
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_OVERLAP_H__
+#define __LUNA_OVERLAP_H__
+
+#include "intervals/intervals.h"
+#include "annot/annot.h"
+
+#include <vector>
+#include <stdint.h>
+
+//
+// Sweep-line window x annotation overlap engine
+//
+//  For a fixed set of windows (typically all epochs), find the
+//  instances of an annotation class that overlap each window, in one
+//  merge-style pass over the windows (sorted by start) and the
+//  instances (already sorted by start in annot_map_t order), rather
+//  than one interval-tree query per window.  Overlap is defined as for
+//  annot_t::extract() (or extract_complete_overlap(), if complete), and
+//  each window's hits are kept in annot_map_t order, in one flat array
+//
+//  annot_sweep_t sweep( epochs );
+//  sweep.run( annot );
+//  for (int e=0; e<sweep.size(); e++)
+//    for (int i=0; i<sweep.count(e); i++) ... sweep.idx(e,i) ...
+//
+
+struct annot_sweep_t
+{
+
+  typedef annot_map_t::value_type entry_t;
+
+  annot_sweep_t() { } 
+
+  explicit annot_sweep_t( const std::vector<interval_t> & windows ) { set_windows( windows ); }
+
+  void set_windows( const std::vector<interval_t> & windows );
+
+  int size() const { return win.size(); }
+
+  // map this class's instances onto all windows (replacing any previous run);
+  // complete = T means the window must be fully spanned by the instance
+  void run( const annot_t * annot , const bool complete = false );
+
+  // hits for window w
+  int count( const int w ) const { return n[w]; }
+
+  bool any( const int w ) const { return n[w] != 0; }
+
+  const instance_idx_t & idx( const int w , const int i ) const { return hits[ first[w] + i ]->first; }
+
+  instance_t * instance( const int w , const int i ) const { return hits[ first[w] + i ]->second; }
+
+  // as annot_t::extract( window w )
+  annot_map_t extract( const int w ) const;
+
+ private:
+
+  std::vector<interval_t> win;
+
+  // windows in start order
+  std::vector<int> order;
+
+  // per-window offset into, and count of, hits[]
+  std::vector<uint32_t> first;
+  std::vector<uint32_t> n;
+  std::vector<const entry_t*> hits;
+
+};
+
+#endif
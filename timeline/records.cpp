@@ -68,6 +68,15 @@ bool timeline_t::retained(const int r ) const
   return i != rec2tp.end();
 }
 
+bool timeline_t::simple_records() const
+{
+  if ( ! edf->header.continuous ) return false;
+  const int nr = edf->header.nr;
+  return nr > 0 && rec2tp.size() == nr
+    && rec2tp.begin()->first == 0 
+    && rec2tp.rbegin()->first == nr - 1;
+}
+
 interval_t timeline_t::record2interval( int r ) const
 { 
   std::map<int,uint64_t>::const_iterator ll = rec2tp.find(r);
@@ -257,6 +266,51 @@ bool timeline_t::interval2records( const interval_t & interval ,
 				   int * start_smp , 
 				   int * stop_rec , 
 				   int * stop_smp ) const
+{
+
+  //
+  // Epoch-wise pulls (the usual case): use the per-epoch table for
+  // this sampling rate, resolving each epoch only once
+  //
+
+  const int e = globals::epoch_tables ? epoch_hint( interval ) : -1 ;
+  
+  if ( e == -1 )
+    return interval2records_search( interval , n_samples_per_record , 
+				    start_rec , start_smp , stop_rec , stop_smp );
+  
+  epoch_table_t::offsets_t & o = etable.smp[ n_samples_per_record ];
+  
+  if ( o.okay.size() != epochs.size() )
+    {
+      const int ne = epochs.size();
+      o.start_rec.assign( ne , 0 );
+      o.start_smp.assign( ne , 0 );
+      o.stop_rec.assign( ne , 0 );
+      o.stop_smp.assign( ne , 0 );
+      o.okay.assign( ne , -1 );
+    }
+  
+  if ( o.okay[e] == -1 )
+    o.okay[e] = interval2records_search( interval , n_samples_per_record , 
+					 &o.start_rec[e] , &o.start_smp[e] ,
+					 &o.stop_rec[e] , &o.stop_smp[e] );
+  
+  *start_rec = o.start_rec[e];
+  *start_smp = o.start_smp[e];
+  *stop_rec  = o.stop_rec[e];
+  *stop_smp  = o.stop_smp[e];
+
+  return o.okay[e] == 1;
+}
+
+
+bool timeline_t::interval2records_search( const interval_t & interval , 
+					  uint64_t n_samples_per_record , 
+					  int * start_rec , 
+					  int * start_smp , 
+					  int * stop_rec , 
+					  int * stop_smp ) const
 
 {
   
@@ -94,6 +94,8 @@ void timeline_t::init_timeline( bool okay_to_reinit )
   rec2orig_rec.clear();
   
   clear_epoch_mapping();
+
+  etable.clear();
   
   //
   // Continuous timeline?
@@ -165,42 +167,64 @@ void timeline_t::restructure( const std::set<int> & keep , const bool preserve_c
   total_duration_tp = 
     (uint64_t)edf->header.nr * edf->header.record_duration_tp;      
   last_time_point_tp = 0;
-  
-  std::map<uint64_t,int> copy_tp2rec;  
-  std::map<int,uint64_t> copy_rec2tp;    
-  std::map<int,uint64_t> copy_rec2tp_end;
 
-  int r = first_record();
+  // any per-epoch record/sample tables refer to the old records
+  etable.clear();
 
-  while ( r != -1 ) 
-    {
-      if ( keep.find(r) != keep.end() )
-	{	  
-	  uint64_t tp = rec2tp[r];
-	  copy_rec2tp[r] = tp;
-	  copy_rec2tp_end[r] = rec2tp_end[r];
-	  copy_tp2rec[tp] = r;
-	  if ( rec2tp_end[r] > last_time_point_tp ) 
-	    last_time_point_tp = rec2tp_end[r];
-	}
-      
-      r = next_record(r);
-    }  
+  //
+  // compact the record maps in place, in a single ordered pass:
+  // dropped records are erased (rather than each map being rebuilt
+  // and copied back); rec2tp, rec2tp_end and rec2orig_rec are all
+  // keyed by record, so are walked in step (rec2orig_rec may also
+  // hold records dropped by a prior RE, which are erased here too)
+  //
+  
+  std::map<int,uint64_t>::iterator rr = rec2tp.begin();
+  std::map<int,uint64_t>::iterator ee = rec2tp_end.begin();
+  std::map<int,int>::iterator oo = rec2orig_rec.begin();
+  std::set<int>::const_iterator kk = keep.begin();
   
-  // copy over
-
-  tp2rec     = copy_tp2rec;
-  rec2tp     = copy_rec2tp;
-  rec2tp_end = copy_rec2tp_end;
-
-  // set rec2orig_rec
   int cnt = 0;
-  std::map<int,uint64_t>::const_iterator rr = rec2tp.begin();
+  
   while ( rr != rec2tp.end() )
     {
-      rec2orig_rec[ rr->first ] = cnt++;
-      ++rr;
+      const int r = rr->first;
+
+      while ( kk != keep.end() && *kk < r ) ++kk;
+      while ( ee != rec2tp_end.end() && ee->first < r ) ee = rec2tp_end.erase( ee );
+      while ( oo != rec2orig_rec.end() && oo->first < r ) oo = rec2orig_rec.erase( oo );
+      
+      const bool kept = kk != keep.end() && *kk == r;
+      const bool has_end = ee != rec2tp_end.end() && ee->first == r;
+      const bool has_orig = oo != rec2orig_rec.end() && oo->first == r;
+      
+      if ( kept )
+	{
+	  if ( has_end )
+	    {
+	      if ( ee->second > last_time_point_tp )
+		last_time_point_tp = ee->second;
+	      ++ee;
+	    }
+	  
+	  if ( ! has_orig )
+	    oo = rec2orig_rec.insert( oo , std::make_pair( r , 0 ) );
+	  oo->second = cnt++;
+	  ++oo;
+	  
+	  ++rr;
+	}
+      else
+	{
+	  tp2rec.erase( rr->second );
+	  if ( has_end ) ee = rec2tp_end.erase( ee );
+	  if ( has_orig ) oo = rec2orig_rec.erase( oo );
+	  rr = rec2tp.erase( rr );
+	}
     }
+  
+  rec2tp_end.erase( ee , rec2tp_end.end() );
+  rec2orig_rec.erase( oo , rec2orig_rec.end() );
 
   // reset epochs (but retain epoch-level annotations)
   reset_epochs();
@@ -231,6 +255,9 @@ void timeline_t::create_discontinuous_timeline( const std::vector<uint64_t> & tp
     (uint64_t)edf->header.nr * edf->header.record_duration_tp;      
   last_time_point_tp = 0;
 
+  // any per-epoch record/sample tables refer to the old records
+  etable.clear();
+
   // check
   if ( edf->header.nr != tps.size() )
     Helper::halt( "internal error in timeline_t::create_discontinuous_timeline()" );
@@ -35,6 +35,7 @@
 #include "helper/logger.h"
 #include "timeline/hypno.h"
 #include "timeline/cache.h"
+#include "timeline/bitmask.h"
 
 #include "edf/signal-list.h"
 #include "defs/defs.h"
@@ -118,6 +119,10 @@ struct timeline_t
   int next_record(const int r) const; // -1 if at end
 
   bool retained(const int r ) const;
+
+  // continuous, with every record 0..nr-1 retained: i.e. record r
+  // starts at r * record_duration_tp, and no map lookups are needed
+  bool simple_records() const;
   
   
   //
@@ -446,11 +451,11 @@ struct timeline_t
   
   void clear_chep_mask();
 
-  std::map<int,std::set<std::string> > make_chep_copy() const;
+  chep_mask_t make_chep_copy() const;
 
   void set_chep_mask( const int e , const std::string & s );
 
-  void merge_chep_mask( const std::map<int,std::set<std::string> > & m ) ;
+  void merge_chep_mask( const chep_mask_t & m ) ;
 
   bool unset_chep_mask( const int e , const std::string & s ) ;
 
@@ -640,14 +645,14 @@ struct timeline_t
   
   int current_epoch;
 
-  std::vector<bool> mask;
+  bitvec_t mask;
   
   bool mask_set;
   
   int mask_mode;
   
-  // epoch -> ch ; presence implies mask set
-  std::map<int,std::set<std::string> > chep;
+  // (display) epoch x ch ; presence of an epoch row implies mask set
+  chep_mask_t chep;
   
   // epoch to record mapping
   std::map<int,std::set<int> > epoch2rec;
@@ -659,9 +664,51 @@ private:
 
   // original <--> current epoch mappings
   // i.e. track if masks have been applied
-  
-  std::map<int,int> epoch_orig2curr;
-  std::map<int,int> epoch_curr2orig;
+  // (flat: -1 for no mapping; both empty if no mapping set)
+  
+  std::vector<int> epoch_orig2curr;
+  std::vector<int> epoch_curr2orig;
+
+  // Flat per-epoch tables (struct-of-arrays, indexed by current epoch):
+  // the first/last record of each epoch (from epoch2rec), and, per
+  // samples-per-record, the interval2records() result for each epoch,
+  // resolved once on first use.  Cleared whenever epoch2rec is rebuilt
+  // or the records change; epochs[] itself holds the start/stop tp
+
+  struct epoch_table_t
+  {
+    struct offsets_t
+    {
+      std::vector<int> start_rec, start_smp, stop_rec, stop_smp;
+      std::vector<signed char> okay; // -1 not yet resolved
+    };
+    
+    epoch_table_t() : built(false) , last(-1) { } 
+
+    void clear() { first_rec.clear(); last_rec.clear(); smp.clear(); built = false; last = -1; }
+
+    bool built;
+    std::vector<int> first_rec, last_rec; // -1 if no records
+    std::map<uint64_t,offsets_t> smp;     // keyed on samples per record
+    int last;                             // last epoch matched, i.e. a hint
+  };
+
+  mutable epoch_table_t etable;
+
+  void build_epoch_table() const;
+
+  // index of the epoch with exactly this interval (via the current
+  // epoch pointer, or the last match), else -1
+  int epoch_hint( const interval_t & interval ) const;
+
+  // the underlying search for interval2records(), i.e. when the
+  // interval is not a current epoch (or epoch-tables=F)
+  bool interval2records_search( const interval_t & interval , 
+				uint64_t srate , 
+				int * start_rec , 
+				int * start_smp , 
+				int * stop_rec , 
+				int * stop_smp ) const;
 
   // Epoch annotations 
 
@@ -669,7 +716,7 @@ private:
   // where epoch is *always* with regard to the original value
   
   // boolean epoch-based annotations
-  std::map<std::string,std::map<int,bool> > eannots;
+  std::map<std::string,std::vector<bool> > eannots;
   
 };
 